@@ -155,14 +155,21 @@ int evws_is_valid_connection(struct evws *ws, struct evws_connection *conn) {
 
 // Error callback
 static void cb_error(struct bufferevent *bev, short what, void *ctx) {
-	struct evws_connection *conn = ctx;
-	if (conn->next.tqe_next != NULL) {
-		conn->next.tqe_next->next.tqe_prev = conn->next.tqe_prev;
-	} else {
-		(&(conn->ws->connections))->tqh_last = conn->next.tqe_prev;
+	evws_connection_close(ctx);
+}
+
+// Unlink connection from its websocket and free it
+void evws_connection_close(struct evws_connection *conn) {
+	// connections are only linked once the handshake completed
+	if (conn->next.tqe_prev != NULL) {
+		if (conn->next.tqe_next != NULL) {
+			conn->next.tqe_next->next.tqe_prev = conn->next.tqe_prev;
+		} else {
+			(&(conn->ws->connections))->tqh_last = conn->next.tqe_prev;
+		}
+		*(conn)->next.tqe_prev = conn->next.tqe_next;
 	}
-	*(conn)->next.tqe_prev = conn->next.tqe_next;
-	
+
 	evws_connection_free(conn);
 }
 
@@ -452,22 +459,14 @@ NEXT_FRAME:
 	}
 }
 
-void evws_send_data(struct evws_connection *conn, enum evws_opcode opcode, const char *data, uint64_t length) {
-	char* writePtr = NULL;
-	char *sendbuf = NULL;
-	struct evbuffer *buffer = NULL;
-	
-	sendbuf = malloc(length + 10); // payload + header without masking key
-	if(sendbuf == NULL)
-		return;
-	
-	writePtr = sendbuf;
-	
+size_t evws_frame_header(char *header, enum evws_opcode opcode, uint64_t length) {
+	char* writePtr = header;
+
 	writePtr[0] = (1 << 7); // set fin header and zero out RSV
 	writePtr[0] += opcode; // set opcode
 	writePtr++;
 	writePtr[0] = (0 << 7); // we don't mask replies
-	
+
 	if (length < 126) {
 		writePtr[0] += (uint8_t)length;
 		writePtr++;
@@ -476,10 +475,10 @@ void evws_send_data(struct evws_connection *conn, enum evws_opcode opcode, const
 		writePtr[1] = (((uint16_t)length) >> 8) & 0xff;
 		writePtr[2] = ((uint16_t)length) & 0xff;
 		writePtr += 3;
-	} else if(length < (1ull << 63)) {
-		writePtr[0] = 126;
+	} else {
+		writePtr[0] = 127;
 		// integer division and bitmask ought to be endian agnostic
-		writePtr[1] = (length / 0x0100000000000000) & 0xff;
+		writePtr[1] = (length / 0x0100000000000000) & 0x7f; // most significant bit must be 0
 		writePtr[2] = (length / 0x0001000000000000) & 0xff;
 		writePtr[3] = (length / 0x0000010000000000) & 0xff;
 		writePtr[4] = (length / 0x0000000100000000) & 0xff;
@@ -489,13 +488,15 @@ void evws_send_data(struct evws_connection *conn, enum evws_opcode opcode, const
 		writePtr[8] = (length / 0x0000000000000001) & 0xff;
 		writePtr += 9;
 	}
-	
-	memcpy(writePtr, data, length);
-	writePtr += length;
-	
-	buffer = bufferevent_get_output(conn->bufev);
-	evbuffer_add(buffer, sendbuf, writePtr - sendbuf);
-	free(sendbuf);
+	return writePtr - header;
+}
+
+void evws_send_data(struct evws_connection *conn, enum evws_opcode opcode, const char *data, uint64_t length) {
+	char header[EVWS_MAX_HEADER_SIZE];
+	struct evbuffer *buffer = bufferevent_get_output(conn->bufev);
+
+	evbuffer_add(buffer, header, evws_frame_header(header, opcode, length));
+	evbuffer_add(buffer, data, length);
 }
 
 
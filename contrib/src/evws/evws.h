@@ -74,6 +74,9 @@ struct evws_header {
 	char *value;
 };
 
+/// Largest header of an unmasked frame as written by evws_frame_header
+#define EVWS_MAX_HEADER_SIZE 10
+
 struct evws_frame {
 	/**
 	 * Indicates that this is the final fragment in a message.  The first
@@ -195,6 +198,7 @@ struct evws {
 struct evws_connection *evws_connection_new(struct evws *ws, evutil_socket_t fd);
 void evws_connection_free(struct evws_connection *conn);
 int evws_is_valid_connection(struct evws *ws, struct evws_connection *conn);
+void evws_connection_close(struct evws_connection *conn);
 
 struct evws_frame *evws_frame_new();
 void evws_frame_free(struct evws_frame *frame);
@@ -211,6 +215,8 @@ int evws_set_cb(struct evws * ws, const char * pattern, cb_frame_type message_cb
 cb_frame_type evws_set_gencb(struct evws *ws, cb_frame_type cb, void * arg);
 void evws_broadcast(struct evws *ws, const char *uri, enum evws_opcode opcode, const char *data, uint64_t length);
 void evws_send_data(struct evws_connection *conn, enum evws_opcode opcode, const char *data, uint64_t length);
+// write the header for an unmasked frame with length bytes of payload, returns its size
+size_t evws_frame_header(char *header, enum evws_opcode opcode, uint64_t length);
 
 #ifdef __cplusplus
 }
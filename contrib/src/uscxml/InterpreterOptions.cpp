@@ -43,7 +43,7 @@ void InterpreterOptions::printUsageAndExit(const char* progName) {
 #ifdef BUILD_AS_PLUGINS
 	printf(" [-p pluginPath]");
 #endif
-	printf(" [-tN]");
+	printf(" [-tN] [--profile=FILE]");
 #ifdef HTTPS_ENABLED
 	printf(" [-sN] [--certificate=FILE | --private-key=FILE --public-key=FILE] ");
 #endif
@@ -62,6 +62,7 @@ void InterpreterOptions::printUsageAndExit(const char* progName) {
 	printf("\t-sN       : port for HTTPS server\n");
 	printf("\t-wN       : port for WebSocket server\n");
     printf("\t-d        : start with debugger attachable\n");
+	printf("\t--profile : accumulate transition and state counts into FILE\n");
 	printf("\n");
     exit(1);
 }
@@ -79,6 +80,7 @@ InterpreterOptions InterpreterOptions::fromCmdLine(int argc, char** argv) {
 		{"certificate",   required_argument, 0, 0},
 		{"private-key",   required_argument, 0, 0},
 		{"public-key",    required_argument, 0, 0},
+		{"profile",       required_argument, 0, 0},
 		{"plugin-path",   required_argument, 0, 'p'},
 		{"loglevel",      required_argument, 0, 'l'},
 		{0, 0, 0, 0}
@@ -121,6 +123,8 @@ InterpreterOptions InterpreterOptions::fromCmdLine(int argc, char** argv) {
 				currOptions->certificate = optarg;
 			} else if (iequals(longOptions[optionInd].name, "public-key")) {
 				currOptions->publicKey = optarg;
+			} else if (iequals(longOptions[optionInd].name, "profile")) {
+				currOptions->profile = optarg;
 			}
 			break;
 		}
@@ -59,6 +59,7 @@ public:
 	unsigned short httpsPort;
 	unsigned short wsPort;
 	std::string pluginPath;
+	std::string profile;
 	std::string certificate;
 	std::string privateKey;
 	std::string publicKey;
@@ -4,6 +4,7 @@
 #include "uscxml/debug/InterpreterIssue.h"
 #include "uscxml/debug/DebuggerServlet.h"
 #include "uscxml/interpreter/InterpreterMonitor.h"
+#include "uscxml/debug/ProfileMonitor.h"
 #include "uscxml/util/DOM.h"
 
 #include "uscxml/interpreter/Logging.h"
@@ -54,6 +55,7 @@ int main(int argc, char** argv) {
 
 	// instantiate and configure interpreters
 	std::list<Interpreter> interpreters;
+	std::map<std::string, ProfileMonitor*> profileMonitors; // one per profile file
 	for(size_t i = 0; i < options.interpreters.size(); i++) {
 
 //		InterpreterOptions* currOptions = options.interpreters[0].second;
@@ -82,6 +84,16 @@ int main(int argc, char** argv) {
 					interpreter.addMonitor(vm);
 				}
 
+				if (options.profile.size() > 0 || options.interpreters[i].second->profile.size() > 0) {
+					std::string profile = (options.interpreters[i].second->profile.size() > 0 ?
+					                       options.interpreters[i].second->profile :
+					                       options.profile);
+					if (profileMonitors.find(profile) == profileMonitors.end()) {
+						profileMonitors[profile] = new ProfileMonitor(profile);
+					}
+					interpreter.addMonitor(profileMonitors[profile]);
+				}
+
 				interpreters.push_back(interpreter);
 
 			} else {
@@ -128,5 +140,10 @@ int main(int argc, char** argv) {
 		while(true)
 			std::this_thread::sleep_for(std::chrono::seconds(1));
 	}
+
+	// profiles are only flushed periodically, write what is left
+	for (auto& monitor : profileMonitors) {
+		delete monitor.second;
+	}
 	return EXIT_SUCCESS;
 }
@@ -3,6 +3,7 @@
 #include "uscxml/util/String.h"
 #include "uscxml/transform/ChartToC.h"
 #include "uscxml/transform/ChartToJava.h"
+#include "uscxml/transform/ChartToCpp.h"
 #include "uscxml/transform/ChartToVHDL.h"
 #include "uscxml/transform/ChartToPromela.h"
 
@@ -42,10 +43,16 @@ void printUsageAndExit(const char* progName) {
 	printf("\t-t pml         : convert to spin/promela program\n");
 	printf("\t-t vhdl        : convert to VHDL hardware description\n");
 	printf("\t-t java        : convert to Java classes\n");
+	printf("\t-t cpp         : convert to C++ class template\n");
 	printf("\t-t flat        : flatten to SCXML state-machine\n");
 	printf("\t-a FILE        : write annotated SCXML document for transformation\n");
 	printf("\t-X {PARAMETER} : pass additional parameters to the transformation\n");
 	printf("\t    prefix=ID    - prefix all symbols and identifiers with ID (-tc)\n");
+	printf("\t    bitops=words - operate on bit arrays in 64bit words (-tc)\n");
+	printf("\t    bitops=simd  - operate on bit arrays with SSE2 / AVX2 if available (-tc)\n");
+	printf("\t    batch=on     - emit uscxml_step_batch() for many instances of a machine (-tc)\n");
+	printf("\t    className=ID - name of the generated class template (-tcpp)\n");
+	printf("\t    profile=FILE - mark hot and cold code per uscxml-browser --profile=FILE (-tc)\n");
 	printf("\t-v             : be verbose\n");
 	printf("\t-lN            : Set loglevel to N\n");
 	printf("\t-i URL         : Input file (defaults to STDIN)\n");
@@ -192,6 +199,7 @@ int main(int argc, char** argv) {
 	        outType != "c" &&
 	        outType != "vhdl" &&
 	        outType != "java" &&
+	        outType != "cpp" &&
 	        outType != "min" &&
 	        std::find(options.begin(), options.end(), "priority") == options.end() &&
 	        std::find(options.begin(), options.end(), "domain") == options.end() &&
@@ -298,6 +306,21 @@ int main(int argc, char** argv) {
 			}
 		}
 
+		if (outType == "cpp") {
+			transformer = ChartToCpp::transform(interpreter);
+			transformer.setExtensions(extensions);
+			transformer.setOptions(options);
+
+			if (outputFile.size() == 0 || outputFile == "-") {
+				transformer.writeTo(std::cout);
+			} else {
+				std::ofstream outStream;
+				outStream.open(outputFile.c_str());
+				transformer.writeTo(outStream);
+				outStream.close();
+			}
+		}
+
 		if (outType == "vhdl") {
 			transformer = ChartToVHDL::transform(interpreter);
 			transformer.setExtensions(extensions);
@@ -73,6 +73,8 @@
 
 %ignore uscxml::DataModel::DataModel(const std::shared_ptr<DataModelImpl>);
 %ignore uscxml::DataModel::DataModel(const DataModel&);
+%ignore uscxml::DataModel::evalAsBoolBatch;
+%ignore uscxml::DataModelImpl::evalAsBoolBatch;
 
 
 %ignore uscxml::WrappedDataModel::create(DataModelCallbacks*);
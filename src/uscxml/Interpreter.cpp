@@ -22,6 +22,8 @@
 #include "uscxml/Interpreter.h"
 #include "uscxml/interpreter/InterpreterImpl.h"
 #include "uscxml/util/DOM.h"
+#include "uscxml/util/DOMBuilder.h"
+#include "uscxml/util/MappedFile.h"
 #include "uscxml/util/URL.h"
 #include "uscxml/util/MD5.hpp"
 
@@ -37,8 +39,11 @@
 
 #include <assert.h>
 #include <algorithm>
+#include <list>
 #include <memory>
 #include <mutex>
+#include <sys/stat.h>
+#include <time.h>
 
 #define VERBOSE 0
 
@@ -60,6 +65,23 @@ static URL normalizeURL(const std::string url) {
 	return absUrl;
 }
 
+static XERCESC_NS::DOMDocument* parseDocument(const char* data, size_t length) {
+	try {
+		// stream the document into a DOM without the nodes we never read
+		return DOMBuilder::parse(data, length);
+
+	} catch (const XERCESC_NS::SAXParseException& toCatch) {
+		ERROR_PLATFORM_THROW(X(toCatch.getMessage()).str());
+	} catch (const XERCESC_NS::RuntimeException& toCatch) {
+		ERROR_PLATFORM_THROW(X(toCatch.getMessage()).str());
+	} catch (const XERCESC_NS::XMLException& toCatch) {
+		ERROR_PLATFORM_THROW(X(toCatch.getMessage()).str());
+	} catch (const XERCESC_NS::DOMException& toCatch) {
+		ERROR_PLATFORM_THROW(X(toCatch.getMessage()).str());
+	}
+	return NULL;
+}
+
 Interpreter Interpreter::fromXML(const std::string& xml, const std::string& baseURL) {
 
 	URL absUrl = normalizeURL(baseURL);
@@ -67,37 +89,177 @@ Interpreter Interpreter::fromXML(const std::string& xml, const std::string& base
 	std::shared_ptr<InterpreterImpl> interpreterImpl(new InterpreterImpl());
 	Interpreter interpreter(interpreterImpl);
 
-	std::unique_ptr<XERCESC_NS::XercesDOMParser> parser(new XERCESC_NS::XercesDOMParser());
-	std::unique_ptr<XERCESC_NS::ErrorHandler> errHandler(new XERCESC_NS::HandlerBase());
+	interpreterImpl->_document = parseDocument(xml.data(), xml.size());
+	interpreterImpl->_baseURL = absUrl;
+	interpreterImpl->_md5 = md5(xml);
+	InterpreterImpl::addInstance(interpreterImpl);
 
-	try {
-		parser->setValidationScheme(XERCESC_NS::XercesDOMParser::Val_Always);
-		parser->setDoNamespaces(true);
-		parser->useScanner(XERCESC_NS::XMLUni::fgWFXMLScanner);
+	return interpreter;
+}
 
-		parser->setErrorHandler(errHandler.get());
+static std::mutex _templateMutex;
+
+/// The templates per URL or markup, the most recently used in front
+struct TemplateCache {
+	struct Entry {
+		std::shared_ptr<DocumentTemplate> tmpl;
+		time_t mtime = 0; // of a local file, to skip hashing unchanged ones
+		size_t size = 0;
+		time_t checked = 0; // when we saw mtime, it is ambiguous within that second
+		std::list<std::string>::iterator recent;
+	};
+
+	std::map<std::string, Entry> entries;
+	std::list<std::string> recent;
+	size_t maxEntries = 64;
+
+	/// Only called with _templateMutex locked
+	Entry* find(const std::string& key) {
+		auto entry = entries.find(key);
+		if (entry == entries.end())
+			return NULL;
+		recent.splice(recent.begin(), recent, entry->second.recent);
+		return &entry->second;
+	}
 
-		XERCESC_NS::MemBufInputSource is((XMLByte*)xml.c_str(), xml.size(), X("fake"));
-		parser->parse(is);
+	/// Insert or replace an entry and forget the least recently used beyond the limit
+	Entry& put(const std::string& key, std::shared_ptr<DocumentTemplate> tmpl) {
+		Entry* entry = find(key);
+		if (entry == NULL) {
+			recent.push_front(key);
+			entry = &entries[key];
+			entry->recent = recent.begin();
+		}
+		entry->tmpl = tmpl;
+		evict();
+		return *entry;
+	}
 
-		interpreterImpl->_document = parser->adoptDocument();
-		interpreterImpl->_baseURL = absUrl;
-		interpreterImpl->_md5 = md5(xml);
-		InterpreterImpl::addInstance(interpreterImpl);
+	void evict() {
+		// never the entry we just used
+		while(entries.size() > std::max(maxEntries, (size_t)1)) {
+			entries.erase(recent.back());
+			recent.pop_back();
+		}
+	}
+};
 
-	} catch (const XERCESC_NS::SAXParseException& toCatch) {
-		ERROR_PLATFORM_THROW(X(toCatch.getMessage()).str());
-	} catch (const XERCESC_NS::RuntimeException& toCatch) {
-		ERROR_PLATFORM_THROW(X(toCatch.getMessage()).str());
-	} catch (const XERCESC_NS::XMLException& toCatch) {
-		ERROR_PLATFORM_THROW(X(toCatch.getMessage()).str());
-	} catch (const XERCESC_NS::DOMException& toCatch) {
-		ERROR_PLATFORM_THROW(X(toCatch.getMessage()).str());
+static TemplateCache& getTemplates() {
+	// never deallocated as documents must not outlive xerces
+	static TemplateCache* templates = new TemplateCache();
+	return *templates;
+}
+
+/// The cached template for a key if it is for the given content
+static std::shared_ptr<DocumentTemplate> getTemplate(const std::string& key, const std::string& md5) {
+	std::lock_guard<std::mutex> lock(_templateMutex);
+	TemplateCache::Entry* entry = getTemplates().find(key);
+	if (entry != NULL && entry->tmpl->md5 == md5)
+		return entry->tmpl;
+	return std::shared_ptr<DocumentTemplate>();
+}
+
+static std::shared_ptr<DocumentTemplate> addTemplate(const std::string& key, const char* data, size_t length, const std::string& md5, const URL& absUrl) {
+	std::shared_ptr<DocumentTemplate> tmpl(new DocumentTemplate(parseDocument(data, length), absUrl, md5));
+
+	std::lock_guard<std::mutex> lock(_templateMutex);
+	TemplateCache::Entry* entry = getTemplates().find(key);
+	if (entry != NULL && entry->tmpl->md5 == md5) {
+		// another thread was faster
+		return entry->tmpl;
 	}
+	// replaces the template for an older content
+	getTemplates().put(key, tmpl);
+	return tmpl;
+}
+
+Interpreter Interpreter::fromTemplate(std::shared_ptr<DocumentTemplate> tmpl) {
+	std::shared_ptr<InterpreterImpl> interpreterImpl(new InterpreterImpl());
+	Interpreter interpreter(interpreterImpl);
+
+	// the document is copied from the template on first use
+	interpreterImpl->_template = tmpl;
+	interpreterImpl->_baseURL = tmpl->baseURL;
+	interpreterImpl->_md5 = tmpl->md5;
+	InterpreterImpl::addInstance(interpreterImpl);
 
 	return interpreter;
 }
 
+Interpreter Interpreter::fromTemplate(const std::string& url) {
+	URL absUrl = normalizeURL(url);
+	std::string key = absUrl;
+
+	// the content behind the URL might have changed, only parsing is saved
+	std::shared_ptr<DocumentTemplate> tmpl;
+	std::string fileName = absUrl.localPath();
+	if (fileName.size() > 0) {
+		struct stat st;
+		bool hasStat = (stat(fileName.c_str(), &st) == 0);
+
+		if (hasStat) {
+			// a file that was not touched since we hashed it is not read again
+			std::lock_guard<std::mutex> lock(_templateMutex);
+			TemplateCache::Entry* entry = getTemplates().find(key);
+			if (entry != NULL && entry->mtime == st.st_mtime && entry->size == (size_t)st.st_size && entry->mtime < entry->checked)
+				tmpl = entry->tmpl;
+		}
+		if (tmpl)
+			return fromTemplate(tmpl);
+
+		time_t checked = time(NULL);
+		MappedFile file(fileName);
+		std::string md5 = uscxml::md5(file.data(), file.size());
+		tmpl = getTemplate(key, md5);
+		if (!tmpl) {
+			tmpl = addTemplate(key, file.data(), file.size(), md5, absUrl);
+		}
+
+		if (hasStat) {
+			std::lock_guard<std::mutex> lock(_templateMutex);
+			TemplateCache::Entry* entry = getTemplates().find(key);
+			if (entry != NULL && entry->tmpl == tmpl) {
+				entry->mtime = st.st_mtime;
+				entry->size = st.st_size;
+				entry->checked = checked;
+			}
+		}
+	} else {
+		std::string xml = absUrl.getInContent();
+		std::string md5 = uscxml::md5(xml);
+		tmpl = getTemplate(key, md5);
+		if (!tmpl) {
+			tmpl = addTemplate(key, xml.data(), xml.size(), md5, absUrl);
+		}
+	}
+	return fromTemplate(tmpl);
+}
+
+Interpreter Interpreter::fromTemplate(const std::string& xml, const std::string& baseURL) {
+	URL absUrl = normalizeURL(baseURL);
+	std::string md5 = uscxml::md5(xml);
+	// there is no location whose content could change
+	std::string key = (std::string)absUrl + "#" + md5;
+
+	std::shared_ptr<DocumentTemplate> tmpl = getTemplate(key, md5);
+	if (!tmpl) {
+		tmpl = addTemplate(key, xml.data(), xml.size(), md5, absUrl);
+	}
+	return fromTemplate(tmpl);
+}
+
+void Interpreter::clearTemplates() {
+	std::lock_guard<std::mutex> lock(_templateMutex);
+	getTemplates().entries.clear();
+	getTemplates().recent.clear();
+}
+
+void Interpreter::setMaxTemplates(size_t maxTemplates) {
+	std::lock_guard<std::mutex> lock(_templateMutex);
+	getTemplates().maxEntries = maxTemplates;
+	getTemplates().evict();
+}
+
 Interpreter Interpreter::fromElement(XERCESC_NS::DOMElement* scxml, const std::string& baseURL) {
 	URL absUrl = normalizeURL(baseURL);
 
@@ -150,6 +312,22 @@ Interpreter Interpreter::fromURL(const std::string& url) {
 	URL absUrl = normalizeURL(url);
 
 #if 1
+	std::string fileName = absUrl.localPath();
+	if (fileName.size() > 0) {
+		// parse right from the mapping without a copy into a string
+		MappedFile file(fileName);
+
+		std::shared_ptr<InterpreterImpl> interpreterImpl(new InterpreterImpl());
+		Interpreter interpreter(interpreterImpl);
+
+		interpreterImpl->_document = parseDocument(file.data(), file.size());
+		interpreterImpl->_baseURL = absUrl;
+		interpreterImpl->_md5 = md5(file.data(), file.size());
+		InterpreterImpl::addInstance(interpreterImpl);
+
+		return interpreter;
+	}
+
 	// Xercesc is hard to build with SSL on windows, whereas curl uses winssl
 	return fromXML(absUrl.getInContent(), absUrl);
 #else
@@ -192,11 +370,9 @@ Interpreter Interpreter::fromURL(const std::string& url) {
 }
 
 Interpreter Interpreter::fromSessionId(const std::string& sessionId) {
-	std::lock_guard<std::recursive_mutex> lock(InterpreterImpl::_instanceMutex);
-	std::map<std::string, std::weak_ptr<InterpreterImpl> > instances = InterpreterImpl::getInstances();
-	if (instances.find(sessionId) != instances.end()) {
-		return Interpreter(instances[sessionId].lock());
-	}
+	std::shared_ptr<InterpreterImpl> instance = InterpreterImpl::getInstance(sessionId);
+	if (instance)
+		return Interpreter(instance);
 	return Interpreter();
 }
 
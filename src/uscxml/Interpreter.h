@@ -46,6 +46,7 @@ class InterpreterMonitor;
 class LambdaMonitor;
 class InterpreterImpl;
 class InterpreterIssue;
+struct DocumentTemplate;
 
 class MicroStepCallbacks;
 class DataModelCallbacks;
@@ -123,6 +124,34 @@ public:
 	 */
 	static Interpreter fromClone(const Interpreter& other);
 
+	/**
+	 * Instantiate an Interpeter from a process-wide cache of prepared documents.
+	 * There is one template per URL, it is replaced when the content changes.
+	 * Local files are only read again when their mtime or size changed, other
+	 * documents are fetched every time. Every session created from the template
+	 * copies it when it is first used.
+	 * @param url An absolute URL to locate the SCXML document.
+	 */
+	static Interpreter fromTemplate(const std::string& url);
+	/**
+	 * Instantiate an Interpeter from a cached template of the given markup.
+	 * Templates are keyed by the baseURL and the MD5 of the markup.
+	 * @param xml Textual representation of an SCXML document.
+	 * @param baseURL An absolute URL to resolve relative URLs in the document.
+	 */
+	static Interpreter fromTemplate(const std::string& xml,
+	                                const std::string& baseURL);
+	/**
+	 * Forget all cached templates, e.g. after the documents changed. Sessions
+	 * already created from a template are not affected.
+	 */
+	static void clearTemplates();
+	/**
+	 * Bound the number of cached templates, the least recently used are
+	 * forgotten first. There are at most 64 by default.
+	 */
+	static void setMaxTemplates(size_t maxTemplates);
+
 	/**
 	 * Get the instance of an interpreter with a given sessionId.
 	 * @param other The session ID.
@@ -262,6 +291,8 @@ public:
 #endif
 
 protected:
+	static Interpreter fromTemplate(std::shared_ptr<DocumentTemplate> tmpl);
+
 	std::shared_ptr<InterpreterImpl> _impl;
 
 };
@@ -147,16 +147,11 @@ Data DebugSession::debugAttach(const Data& data) {
 	bool interpreterFound = false;
 
 	// find interpreter for sessionid
-	std::map<std::string, std::weak_ptr<InterpreterImpl> > instances = InterpreterImpl::getInstances();
-	for (auto weakInstance : instances) {
-
-		std::shared_ptr<InterpreterImpl> instance = weakInstance.second.lock();
-		if (instance && instance->getSessionId() == interpreterId) {
-			_interpreter = instance;
-			_debugger->attachSession(_interpreter.getImpl()->getSessionId(), shared_from_this());
-			interpreterFound = true;
-			break;
-		}
+	std::shared_ptr<InterpreterImpl> instance = InterpreterImpl::getInstance(interpreterId);
+	if (instance) {
+		_interpreter = instance;
+		_debugger->attachSession(_interpreter.getImpl()->getSessionId(), shared_from_this());
+		interpreterFound = true;
 	}
 
 	if (!interpreterFound) {
@@ -29,6 +29,9 @@ namespace uscxml {
 void DebuggerServlet::pushData(std::shared_ptr<DebugSession> session, Data pushData) {
 	LOGD(USCXML_DEBUG) << "trying to push " << pushData.at("replyType").atom << std::endl;
 
+	// interpreters push while the client polls from one of the server's event loops
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+
 	if (!session) {
 		if (_sendQueues.size() > 0) // logging is not aware of its interpreter
 			_sendQueues.begin()->second.push(pushData);
@@ -40,6 +43,7 @@ void DebuggerServlet::pushData(std::shared_ptr<DebugSession> session, Data pushD
 }
 
 void DebuggerServlet::serverPushData(std::shared_ptr<DebugSession> session) {
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
 	if (_sendQueues[session].isEmpty())
 		return;
 
@@ -93,6 +97,9 @@ bool DebuggerServlet::requestFromHTTP(const HTTPServer::Request& request) {
 	if (!request.data.hasKey("path"))
 		return false; //		returnError(request);
 
+	// we read most of the request and keep long-standing polls
+	request.decode();
+
 	if (isCORS(request)) {
 		handleCORS(request);
 		return true;
@@ -112,24 +119,30 @@ bool DebuggerServlet::requestFromHTTP(const HTTPServer::Request& request) {
 	}
 
 	// get session or return error
-	if (false) {
-	} else if (!request.data.at("content").hasKey("session")) {
+	std::shared_ptr<DebugSession> session;
+	if (!request.data.at("content").hasKey("session")) {
 		replyData.compound["status"] = Data("failure", Data::VERBATIM);
 		replyData.compound["reason"] = Data("No session given", Data::VERBATIM);
-	} else if (_sessionForId.find(request.data.at("content").at("session").atom) == _sessionForId.end()) {
-		replyData.compound["status"] = Data("failure", Data::VERBATIM);
-		replyData.compound["reason"] = Data("No such session", Data::VERBATIM);
+	} else {
+		std::lock_guard<std::recursive_mutex> lock(_mutex);
+		auto sessionIter = _sessionForId.find(request.data.at("content").at("session").atom);
+		if (sessionIter == _sessionForId.end()) {
+			replyData.compound["status"] = Data("failure", Data::VERBATIM);
+			replyData.compound["reason"] = Data("No such session", Data::VERBATIM);
+		} else {
+			session = sessionIter->second;
+		}
 	}
 	if (!replyData.empty()) {
 		returnData(request, replyData);
 		return true;
 	}
 
-	std::shared_ptr<DebugSession> session = _sessionForId[request.data.at("content").at("session").atom];
-
+	// sessions lock themselves and push to us with their lock held, never call them with ours
 	if (false) {
 	} else if (boost::starts_with(request.data.at("path").atom, "/debug/poll")) {
 		// save long-standing client poll
+		std::lock_guard<std::recursive_mutex> lock(_mutex);
 		_clientConns[session] = request;
 		serverPushData(session);
 
@@ -196,26 +209,36 @@ void DebuggerServlet::processConnect(const HTTPServer::Request& request) {
 }
 
 void DebuggerServlet::processDisconnect(const HTTPServer::Request& request) {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
 	Data replyData;
 
 	if (!request.data.at("content").hasKey("session")) {
 		replyData.compound["status"] = Data("failure", Data::VERBATIM);
 		replyData.compound["reason"] = Data("No session given", Data::VERBATIM);
 		returnData(request, replyData);
+		return;
 	}
 
 	std::string sessionId = request.data.at("content").at("session").atom;
 
-	if (_sessionForId.find(sessionId) == _sessionForId.end()) {
+	std::shared_ptr<DebugSession> session;
+	{
+		std::lock_guard<std::recursive_mutex> lock(_mutex);
+		if (_sessionForId.find(sessionId) != _sessionForId.end())
+			session = _sessionForId[sessionId];
+	}
+
+	if (!session) {
 		replyData.compound["status"] = Data("failure", Data::VERBATIM);
 		replyData.compound["reason"] = Data("No such session", Data::VERBATIM);
 	} else {
 		replyData.compound["status"] = Data("success", Data::VERBATIM);
 		detachSession(sessionId);
-		_sessionForId[sessionId]->debugStop(request.data["content"]);
-		_clientConns.erase(_sessionForId[sessionId]);
-		_sendQueues.erase(_sessionForId[sessionId]);
+		session->debugStop(request.data["content"]);
+
+		// the session might have pushed while stopping
+		std::lock_guard<std::recursive_mutex> lock(_mutex);
+		_clientConns.erase(session);
+		_sendQueues.erase(session);
 		_sessionForId.erase(sessionId);
 	}
 
@@ -23,11 +23,22 @@
 #include "uscxml/util/DOM.h"
 #include "uscxml/util/String.h"
 #include "uscxml/util/Predicates.h"
+#include "uscxml/util/StateIndex.h"
 #include "uscxml/interpreter/InterpreterImpl.h"
 #include "uscxml/plugins/Factory.h"
 
 #include <xercesc/dom/DOMDocument.hpp>
 
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+// documents with fewer elements are validated on the calling thread
+#define USCXML_ISSUE_CONCURRENT_ELEMENTS 2048
+
 using namespace XERCESC_NS;
 
 namespace uscxml {
@@ -143,6 +154,62 @@ NEXT_PAIR:
 	return true;
 }
 
+/**
+ * A transition with the attributes needed to check for redundancy, event
+ * names are tokenized once per transition rather than once per pair.
+ */
+struct TransitionDescriptor {
+	DOMElement* transition;
+	bool hasCond;
+	bool hasEvent;
+	std::string event;
+	std::list<std::string> events;
+};
+
+typedef std::function<void(std::list<InterpreterIssue>& issues)> IssueCheck;
+
+/**
+ * Run the given checks, concurrently if requested. Every check collects into
+ * its own list and the lists are concatenated in the order of the checks, so
+ * the issues are reported in the same order either way.
+ */
+static void runChecks(const std::vector<IssueCheck>& checks, bool concurrent, std::list<InterpreterIssue>& issues) {
+	std::vector<std::list<InterpreterIssue> > results(checks.size());
+	std::vector<std::exception_ptr> errors(checks.size());
+
+	size_t nrThreads = (concurrent ? std::min<size_t>(std::thread::hardware_concurrency(), checks.size()) : 0);
+	if (nrThreads > 1) {
+		std::atomic<size_t> next(0);
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < nrThreads; i++) {
+			workers.push_back(std::thread([&checks, &results, &errors, &next]() {
+				for (size_t check = next++; check < checks.size(); check = next++) {
+					try {
+						checks[check](results[check]);
+					} catch (...) {
+						errors[check] = std::current_exception();
+					}
+				}
+			}));
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		for (auto& error : errors) {
+			if (error)
+				std::rethrow_exception(error);
+		}
+	} else {
+		for (size_t i = 0; i < checks.size(); i++) {
+			checks[i](results[i]);
+		}
+	}
+
+	for (auto& result : results) {
+		issues.splice(issues.end(), result);
+	}
+}
+
 std::list<InterpreterIssue> InterpreterIssue::forInterpreter(InterpreterImpl* interpreter) {
 	// some things we need to prepare first
 	if (interpreter->_factory == NULL)
@@ -178,7 +245,9 @@ std::list<InterpreterIssue> InterpreterIssue::forInterpreter(InterpreterImpl* in
 	std::list<DOMElement*> scxmls = nodeSets["scxml"];
 	scxmls.push_back(_scxml);
 
-	std::list<XERCESC_NS::DOMElement*> reachable = getReachableStates(_scxml);
+	StateIndex stateIndex(_scxml);
+	std::list<XERCESC_NS::DOMElement*> reachableStates = stateIndex.getReachableStates();
+	std::set<XERCESC_NS::DOMElement*> reachable(reachableStates.begin(), reachableStates.end());
 
 	std::list<DOMElement*>& states = nodeSets["state"];
 	std::list<DOMElement*>& parallels = nodeSets["parallel"];
@@ -335,10 +404,26 @@ std::list<InterpreterIssue> InterpreterIssue::forInterpreter(InterpreterImpl* in
 	}
 
 
+	std::unordered_set<const DOMElement*> finalSet(finals.begin(), finals.end());
+
+	// transitions per parent in document order
+	std::unordered_map<const DOMNode*, std::vector<TransitionDescriptor> > transitionsPerParent;
+	for (auto tIter = transitions.begin(); tIter != transitions.end(); tIter++) {
+		TransitionDescriptor desc;
+		desc.transition = *tIter;
+		desc.hasCond = HAS_ATTR(desc.transition, kXMLCharCond);
+		desc.hasEvent = HAS_ATTR(desc.transition, kXMLCharEvent);
+		if (desc.hasEvent) {
+			desc.event = ATTR(desc.transition, kXMLCharEvent);
+			desc.events = tokenize(desc.event);
+		}
+		transitionsPerParent[desc.transition->getParentNode()].push_back(desc);
+	}
+
 	for (auto stateIter = allStates.begin(); stateIter != allStates.end(); stateIter++) {
 		DOMElement* state = static_cast<DOMElement*>(*stateIter);
 
-		if (DOMUtils::isMember(state, finals) && !HAS_ATTR(state, kXMLCharId)) // id is not required for finals
+		if (finalSet.find(state) != finalSet.end() && !HAS_ATTR(state, kXMLCharId)) // id is not required for finals
 			continue;
 
 		// check for existance of id attribute - this not actually required!
@@ -372,7 +457,7 @@ std::list<InterpreterIssue> InterpreterIssue::forInterpreter(InterpreterImpl* in
 				if (!HAS_ATTR(transition, kXMLCharTarget)) {
 					issues.push_back(InterpreterIssue("Transition in history pseudo-state '" + stateId + "' has no target", transition, InterpreterIssue::USCXML_ISSUE_FATAL));
 				} else {
-					std::list<DOMElement*> targetStates = getTargetStates(transition, _scxml);
+					std::list<DOMElement*> targetStates = stateIndex.getTargetStates(transition);
 					for (auto tIter = targetStates.begin(); tIter != targetStates.end(); tIter++) {
 						DOMElement* target = *tIter;
 						if (HAS_ATTR(state, kXMLCharType) && ATTR(state, kXMLCharType) == "deep") {
@@ -390,7 +475,7 @@ std::list<InterpreterIssue> InterpreterIssue::forInterpreter(InterpreterImpl* in
 		}
 
 		// check whether state is reachable
-		if (!DOMUtils::isMember(state, reachable) && areFromSameMachine(state, interpreter->_scxml)) {
+		if (reachable.find(state) == reachable.end() && areFromSameMachine(state, interpreter->_scxml)) {
 			issues.push_back(InterpreterIssue("State with id '" + stateId + "' is unreachable", state, InterpreterIssue::USCXML_ISSUE_WARNING));
 		}
 
@@ -402,69 +487,74 @@ std::list<InterpreterIssue> InterpreterIssue::forInterpreter(InterpreterImpl* in
 		seenStates[ATTR(state, kXMLCharId)] = state;
 	}
 
-	for (auto tIter = transitions.begin(); tIter != transitions.end(); tIter++) {
-		DOMElement* transition = *tIter;
+	// the remaining structural checks only read the DOM and are independent
+	std::vector<IssueCheck> checks;
 
-		// check for valid target
-		if (HAS_ATTR(transition, kXMLCharTarget)) {
-			std::list<std::string> targetIds = tokenize(ATTR(transition, kXMLCharTarget));
-			if (targetIds.size() == 0) {
-				issues.push_back(InterpreterIssue("Transition has empty target state list", transition, InterpreterIssue::USCXML_ISSUE_FATAL));
-			}
+	// check for valid target
+	checks.push_back([&](std::list<InterpreterIssue>& issues) {
+		for (auto tIter = transitions.begin(); tIter != transitions.end(); tIter++) {
+			DOMElement* transition = *tIter;
 
-			for (std::list<std::string>::iterator targetIter = targetIds.begin(); targetIter != targetIds.end(); targetIter++) {
-				if (seenStates.find(*targetIter) == seenStates.end()) {
-					issues.push_back(InterpreterIssue("Transition has non-existant target state with id '" + *targetIter + "'", transition, InterpreterIssue::USCXML_ISSUE_FATAL));
-					continue;
+			if (HAS_ATTR(transition, kXMLCharTarget)) {
+				std::list<std::string> targetIds = tokenize(ATTR(transition, kXMLCharTarget));
+				if (targetIds.size() == 0) {
+					issues.push_back(InterpreterIssue("Transition has empty target state list", transition, InterpreterIssue::USCXML_ISSUE_FATAL));
+				}
+
+				for (std::list<std::string>::iterator targetIter = targetIds.begin(); targetIter != targetIds.end(); targetIter++) {
+					if (seenStates.find(*targetIter) == seenStates.end()) {
+						issues.push_back(InterpreterIssue("Transition has non-existant target state with id '" + *targetIter + "'", transition, InterpreterIssue::USCXML_ISSUE_FATAL));
+						continue;
+					}
 				}
 			}
 		}
-	}
+	});
 
 	// check for redundancy of transition
-	for (auto stateIter = allStates.begin(); stateIter != allStates.end(); stateIter++) {
-		DOMElement* state = *stateIter;
-		std::list<DOMElement*> transitions = DOMUtils::filterChildElements(XML_PREFIX(state).str() + "transition", state, false);
+	checks.push_back([&](std::list<InterpreterIssue>& issues) {
+		for (auto stateIter = allStates.begin(); stateIter != allStates.end(); stateIter++) {
+			auto perParent = transitionsPerParent.find(*stateIter);
+			if (perParent == transitionsPerParent.end())
+				continue;
+			const std::vector<TransitionDescriptor>& transitions = perParent->second;
 
-		for (auto tIter = transitions.begin(); tIter != transitions.end(); tIter++) {
-			DOMElement* transition = *tIter;
-			for (auto t2Iter = transitions.begin(); t2Iter != tIter; t2Iter++) {
-				DOMElement* earlierTransition = *t2Iter;
-
-				// will the earlier transition always be enabled when the later is?
-				if (!HAS_ATTR(earlierTransition, kXMLCharCond)) {
-					// earlier transition has no condition -> check event descriptor
-					if (!HAS_ATTR(earlierTransition, kXMLCharEvent)) {
-						// earlier transition is eventless
-						issues.push_back(InterpreterIssue("Transition can never be optimally enabled", transition, InterpreterIssue::USCXML_ISSUE_INFO));
-						goto NEXT_TRANSITION;
-
-					} else if (HAS_ATTR(transition, kXMLCharEvent)) {
-						// does the earlier transition match all our events?
-						std::list<std::string> events = tokenize(ATTR(transition, kXMLCharEvent));
-
-						bool allMatched = true;
-						for (std::list<std::string>::iterator eventIter = events.begin(); eventIter != events.end(); eventIter++) {
-							if (!nameMatch(ATTR(earlierTransition, kXMLCharEvent), *eventIter)) {
-								allMatched = false;
-								break;
-							}
-						}
+			for (auto tIter = transitions.begin(); tIter != transitions.end(); tIter++) {
+				for (auto t2Iter = transitions.begin(); t2Iter != tIter; t2Iter++) {
 
-						if (allMatched) {
-							issues.push_back(InterpreterIssue("Transition can never be optimally enabled", transition, InterpreterIssue::USCXML_ISSUE_INFO));
+					// will the earlier transition always be enabled when the later is?
+					if (!t2Iter->hasCond) {
+						// earlier transition has no condition -> check event descriptor
+						if (!t2Iter->hasEvent) {
+							// earlier transition is eventless
+							issues.push_back(InterpreterIssue("Transition can never be optimally enabled", tIter->transition, InterpreterIssue::USCXML_ISSUE_INFO));
 							goto NEXT_TRANSITION;
+
+						} else if (tIter->hasEvent) {
+							// does the earlier transition match all our events?
+							bool allMatched = true;
+							for (auto eventIter = tIter->events.begin(); eventIter != tIter->events.end(); eventIter++) {
+								if (!nameMatch(t2Iter->event, *eventIter)) {
+									allMatched = false;
+									break;
+								}
+							}
+
+							if (allMatched) {
+								issues.push_back(InterpreterIssue("Transition can never be optimally enabled", tIter->transition, InterpreterIssue::USCXML_ISSUE_INFO));
+								goto NEXT_TRANSITION;
+							}
 						}
 					}
 				}
-			}
 NEXT_TRANSITION:
-			;
+				;
+			}
 		}
-	}
+	});
 
 	// check for useless history elements
-	{
+	checks.push_back([&](std::list<InterpreterIssue>& issues) {
 		for (auto histIter = histories.begin(); histIter != histories.end(); histIter++) {
 			DOMElement* history = *histIter;
 
@@ -482,10 +572,10 @@ NEXT_TRANSITION:
 				continue;
 			}
 		}
-	}
+	});
 
 	// check for valid initial attribute
-	{
+	checks.push_back([&](std::list<InterpreterIssue>& issues) {
 		std::list<DOMElement*> withInitialAttr;
 		withInitialAttr.insert(withInitialAttr.end(), allStates.begin(), allStates.end());
 		withInitialAttr.push_back(_scxml);
@@ -494,34 +584,24 @@ NEXT_TRANSITION:
 			DOMElement* state = *stateIter;
 
 			if (HAS_ATTR(state, kXMLCharInitial)) {
-				std::list<DOMElement*> childs;
-				std::list<DOMElement*> tmp;
-				tmp = DOMUtils::filterChildElements(XML_PREFIX(state).str() + "state", state, true);
-				childs.insert(childs.end(), tmp.begin(), tmp.end());
-				tmp = DOMUtils::filterChildElements(XML_PREFIX(state).str() + "parallel", state, true);
-				childs.insert(childs.end(), tmp.begin(), tmp.end());
-				tmp = DOMUtils::filterChildElements(XML_PREFIX(state).str() + "final", state, true);
-				childs.insert(childs.end(), tmp.begin(), tmp.end());
-				tmp = DOMUtils::filterChildElements(XML_PREFIX(state).str() + "history", state, true);
-				childs.insert(childs.end(), tmp.begin(), tmp.end());
-
 				std::list<std::string> intials = tokenize(ATTR(state, kXMLCharInitial));
 				for (std::list<std::string>::iterator initIter = intials.begin(); initIter != intials.end(); initIter++) {
-					if (seenStates.find(*initIter) == seenStates.end()) {
+					auto seenState = seenStates.find(*initIter);
+					if (seenState == seenStates.end()) {
 						issues.push_back(InterpreterIssue("Initial attribute has invalid target state with id '" + *initIter + "'", state, InterpreterIssue::USCXML_ISSUE_FATAL));
 						continue;
 					}
 					// value of the 'initial' attribute [..] must be descendants of the containing <state> or <parallel> element
-					if (!DOMUtils::isMember(seenStates[*initIter], childs)) {
+					if (!DOMUtils::isDescendant(seenState->second, state)) {
 						issues.push_back(InterpreterIssue("Initial attribute references non-child state '" + *initIter + "'", state, InterpreterIssue::USCXML_ISSUE_FATAL));
 					}
 				}
 			}
 		}
-	}
+	});
 
 	// check for legal configuration of target sets
-	{
+	checks.push_back([&](std::list<InterpreterIssue>& issues) {
 		std::map<DOMElement*, std::string > targetIdSets;
 		for (auto iter = transitions.begin(); iter != transitions.end(); iter++) {
 			DOMElement* transition = *iter;
@@ -553,9 +633,10 @@ NEXT_TRANSITION:
 			std::list<DOMElement*> targets;
 			std::list<std::string> targetIds = tokenize(setIter->second);
 			for (auto tgtIter = targetIds.begin(); tgtIter != targetIds.end(); tgtIter++) {
-				if (seenStates.find(*tgtIter) == seenStates.end())
+				auto seenState = seenStates.find(*tgtIter);
+				if (seenState == seenStates.end())
 					goto NEXT_SET;
-				targets.push_back(seenStates[*tgtIter]);
+				targets.push_back(seenState->second);
 			}
 			if (!hasLegalCompletion(targets)) {
 				issues.push_back(InterpreterIssue("Target states cause illegal configuration", setIter->first, InterpreterIssue::USCXML_ISSUE_FATAL));
@@ -563,10 +644,10 @@ NEXT_TRANSITION:
 NEXT_SET:
 			;
 		}
-	}
+	});
 
 	// check for valid initial transition
-	{
+	checks.push_back([&](std::list<InterpreterIssue>& issues) {
 		std::list<DOMElement*> initTrans;
 
 		for (auto iter = initials.begin(); iter != initials.end(); iter++) {
@@ -602,30 +683,20 @@ NEXT_SET:
 			if (!isState(state))
 				continue; // syntax will catch this one
 
-			std::list<DOMElement*> childs;
-			std::list<DOMElement*> tmp;
-			tmp = DOMUtils::filterChildElements(XML_PREFIX(state).str() + "state", state, true);
-			childs.insert(childs.end(), tmp.begin(), tmp.end());
-			tmp = DOMUtils::filterChildElements(XML_PREFIX(state).str() + "parallel", state, true);
-			childs.insert(childs.end(), tmp.begin(), tmp.end());
-			tmp = DOMUtils::filterChildElements(XML_PREFIX(state).str() + "final", state, true);
-			childs.insert(childs.end(), tmp.begin(), tmp.end());
-			tmp = DOMUtils::filterChildElements(XML_PREFIX(state).str() + "history", state, true);
-			childs.insert(childs.end(), tmp.begin(), tmp.end());
-
 			std::list<std::string> intials = tokenize(ATTR(transition, kXMLCharTarget));
 			for (std::list<std::string>::iterator initIter = intials.begin(); initIter != intials.end(); initIter++) {
 				// the 'target' of a <transition> inside an <initial> or <history> element: all the states must be descendants of the containing <state> or <parallel> element
-				if (!DOMUtils::isMember(seenStates[*initIter], childs)) {
+				auto seenState = seenStates.find(*initIter);
+				if (seenState == seenStates.end() || !DOMUtils::isDescendant(seenState->second, state)) {
 					issues.push_back(InterpreterIssue("Target of initial transition references non-child state '" + *initIter + "'", transition, InterpreterIssue::USCXML_ISSUE_FATAL));
 				}
 			}
 		}
-	}
+	});
 
 
 	// check that all invokers exists
-	{
+	checks.push_back([&](std::list<InterpreterIssue>& issues) {
 		for (auto iter = invokes.begin(); iter != invokes.end(); iter++) {
 			DOMElement* invoke = *iter;
 			if (HAS_ATTR(invoke, kXMLCharType) && !_factory->hasInvoker(ATTR(invoke, kXMLCharType))) {
@@ -645,10 +716,10 @@ NEXT_SET:
 				continue;
 			}
 		}
-	}
+	});
 
 	// check that all io processors exists
-	{
+	checks.push_back([&](std::list<InterpreterIssue>& issues) {
 		for (auto iter = sends.begin(); iter != sends.end(); iter++) {
 			DOMElement* send = *iter;
 			if (HAS_ATTR(send, kXMLCharType) && !_factory->hasIOProcessor(ATTR(send, kXMLCharType))) {
@@ -659,23 +730,25 @@ NEXT_SET:
 				continue;
 			}
 		}
-	}
+	});
 
 	// check that all custom executable content is known
-	{
+	checks.push_back([&](std::list<InterpreterIssue>& issues) {
 		std::list<DOMElement*> allExecContentContainers;
 		allExecContentContainers.insert(allExecContentContainers.end(), onEntries.begin(), onEntries.end());
 		allExecContentContainers.insert(allExecContentContainers.end(), onExits.begin(), onExits.end());
 		allExecContentContainers.insert(allExecContentContainers.end(), transitions.begin(), transitions.end());
 		allExecContentContainers.insert(allExecContentContainers.end(), finalizes.begin(), finalizes.end());
 
+		std::unordered_set<const DOMElement*> execContentElems(allExecContents.begin(), allExecContents.end());
+
 		for (auto bIter = allExecContentContainers.begin(); bIter != allExecContentContainers.end(); bIter++) {
 			DOMElement* block = *bIter;
 			std::list<DOMNode*> execContents = DOMUtils::filterChildType(DOMNode::ELEMENT_NODE, block);
 			for (auto ecIter = execContents.begin(); ecIter != execContents.end(); ecIter++) {
 				DOMElement* execContent = static_cast<DOMElement*>(*ecIter);
 				// SCXML specific executable content, always available
-				if (DOMUtils::isMember(execContent, allExecContents)) {
+				if (execContentElems.find(execContent) != execContentElems.end()) {
 					continue;
 				}
 
@@ -685,10 +758,10 @@ NEXT_SET:
 				}
 			}
 		}
-	}
+	});
 
 	// check that all SCXML elements have valid parents and required attributes
-	{
+	checks.push_back([&](std::list<InterpreterIssue>& issues) {
 		for (auto iter = allElements.begin(); iter != allElements.end(); iter++) {
 			DOMElement* element = *iter;
 			std::string localName = LOCALNAME(element);
@@ -721,10 +794,10 @@ NEXT_SET:
 				continue;
 			}
 		}
-	}
+	});
 
 	// check attribute constraints
-	{
+	checks.push_back([&](std::list<InterpreterIssue>& issues) {
 		for (auto iter = initials.begin(); iter != initials.end(); iter++) {
 			DOMElement* initial = *iter;
 			if (initial->getParentNode() && initial->getParentNode()->getNodeType() == DOMNode::ELEMENT_NODE) {
@@ -841,7 +914,9 @@ NEXT_SET:
 
 			}
 		}
-	}
+	});
+
+	runChecks(checks, allElements.size() >= USCXML_ISSUE_CONCURRENT_ELEMENTS, issues);
 
 	// check that the datamodel is known if not already instantiated
 	if (!interpreter->_dataModel) {
@@ -917,7 +992,7 @@ NEXT_SET:
 		for (auto iter = withExprAttrs.begin(); iter != withExprAttrs.end(); iter++) {
 			DOMElement* withExprAttr = *iter;
 			if (HAS_ATTR(withExprAttr, kXMLCharExpr)) {
-				if (DOMUtils::isMember(withExprAttr, datas) || DOMUtils::isMember(withExprAttr, assigns)) {
+				if (LOCALNAME(withExprAttr) == "data" || LOCALNAME(withExprAttr) == "assign") {
 					if (!_dataModel.isValidSyntax("foo = " + ATTR(withExprAttr, kXMLCharExpr))) { // TODO: this is ECMAScripty!
 						issues.push_back(InterpreterIssue("Syntax error in expr attribute", withExprAttr, InterpreterIssue::USCXML_ISSUE_WARNING));
 						continue;
@@ -0,0 +1,242 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#include "ProfileMonitor.h"
+#include "uscxml/Interpreter.h"
+#include "uscxml/interpreter/InterpreterImpl.h"
+#include "uscxml/util/DOM.h"
+#include "uscxml/util/Convenience.h"
+#include "uscxml/util/MD5.hpp"
+#include "uscxml/util/UUID.h"
+#include "uscxml/interpreter/Logging.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdio.h> // remove, rename
+
+namespace uscxml {
+
+ProfileMonitor::ProfileMonitor(const std::string& profileFile, std::chrono::seconds flushInterval) :
+	_profileFile(profileFile),
+	_flushInterval(flushInterval),
+	_lastFlush(std::chrono::steady_clock::now()),
+	_isProfiling(false),
+	_events(0) {
+
+	std::ifstream profileStream(_profileFile);
+	if (profileStream) {
+		std::stringstream ss;
+		ss << profileStream.rdbuf();
+		_initial = Data::fromJSON(ss.str());
+		if (_initial.empty() && ss.str().size() > 0) {
+			LOG(_logger, USCXML_WARN) << "Ignoring unparseable profile at " << _profileFile << std::endl;
+		}
+		if (_initial.hasKey("document")) {
+			_documentId = _initial["document"]["md5"].atom;
+			_documentURL = _initial["document"]["url"].atom;
+		}
+	}
+}
+
+ProfileMonitor::~ProfileMonitor() {
+	try {
+		write();
+	} catch (...) {}
+}
+
+std::string ProfileMonitor::documentId(const Interpreter& interpreter) {
+	std::string documentId = interpreter.getImpl()->getDocumentId();
+	if (documentId.length() == 0 && interpreter.getImpl()->getDocument() != NULL) {
+		// not every way to create an interpreter remembers the md5
+		std::stringstream ss;
+		ss << *(interpreter.getImpl()->getDocument());
+		documentId = md5(ss.str());
+	}
+	return documentId;
+}
+
+ProfileMonitor::Session* ProfileMonitor::sessionFor(const std::string& sessionId) {
+	auto sessionIter = _sessions.find(sessionId);
+	if (sessionIter != _sessions.end())
+		return (sessionIter->second.isProfiled ? &sessionIter->second : NULL);
+
+	Session& session = _sessions[sessionId];
+	Interpreter interpreter = Interpreter::fromSessionId(sessionId);
+	if (!interpreter)
+		return NULL;
+
+	std::string documentId = ProfileMonitor::documentId(interpreter);
+	std::string documentURL = interpreter.getImpl()->getBaseURL();
+
+	if (_documentId != documentId) {
+		if (_isProfiling) {
+			LOG(_logger, USCXML_WARN) << "Not profiling " << documentURL << " into " << _profileFile << ", it is for " << _documentURL << std::endl;
+			return NULL;
+		}
+		if (_documentId.length() > 0) {
+			LOG(_logger, USCXML_WARN) << "Discarding profile at " << _profileFile << ", it was recorded for another version of " << _documentURL << std::endl;
+			_initial = Data();
+		}
+	}
+
+	_documentId = documentId;
+	_documentURL = documentURL;
+	_isProfiling = true;
+	session.isProfiled = true;
+	return &session;
+}
+
+const std::string& ProfileMonitor::keyFor(Session* session, const XERCESC_NS::DOMElement* element) {
+	auto keyIter = session->keys.find(element);
+	if (keyIter != session->keys.end())
+		return keyIter->second;
+	// only ever compute an element's XPath once
+	return session->keys[element] = DOMUtils::xPathForNode(element);
+}
+
+void ProfileMonitor::beforeProcessingEvent(const std::string& sessionId, const Event& event) {
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	Session* session = sessionFor(sessionId);
+	if (session == NULL)
+		return;
+
+	_events++;
+	for (auto state : session->active) {
+		_dwell[keyFor(session, state)]++;
+	}
+}
+
+void ProfileMonitor::beforeTakingTransition(const std::string& sessionId, const XERCESC_NS::DOMElement* transition) {
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	Session* session = sessionFor(sessionId);
+	if (session == NULL)
+		return;
+
+	_taken[keyFor(session, transition)]++;
+}
+
+void ProfileMonitor::beforeEnteringState(const std::string& sessionId, const std::string& stateName, const XERCESC_NS::DOMElement* state) {
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	Session* session = sessionFor(sessionId);
+	if (session == NULL)
+		return;
+
+	_entered[keyFor(session, state)]++;
+	session->active.insert(state);
+}
+
+void ProfileMonitor::beforeExitingState(const std::string& sessionId, const std::string& stateName, const XERCESC_NS::DOMElement* state) {
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	Session* session = sessionFor(sessionId);
+	if (session == NULL)
+		return;
+
+	session->active.erase(state);
+}
+
+bool ProfileMonitor::isFlushDue() {
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	return std::chrono::steady_clock::now() - _lastFlush >= _flushInterval;
+}
+
+void ProfileMonitor::onStableConfiguration(const std::string& sessionId) {
+	if (isFlushDue())
+		write();
+}
+
+void ProfileMonitor::afterCompletion(const std::string& sessionId) {
+	{
+		std::lock_guard<std::recursive_mutex> lock(_mutex);
+		// the document might be gone with the interpreter
+		_sessions.erase(sessionId);
+	}
+	if (isFlushDue())
+		write();
+}
+
+void ProfileMonitor::add(Data& profile, const std::string& section, const std::string& key, const std::string& counter, size_t value) {
+	Data& entry = profile[section][key][counter];
+	size_t previous = (entry.atom.size() > 0 ? strTo<size_t>(entry.atom) : 0);
+	entry = Data(previous + value, Data::INTERPRETED);
+}
+
+Data ProfileMonitor::getProfile() {
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+
+	Data profile = _initial;
+	if (_documentId.length() > 0) {
+		profile["document"]["md5"] = Data(_documentId, Data::VERBATIM);
+		profile["document"]["url"] = Data(_documentURL, Data::VERBATIM);
+	}
+	size_t events = (profile.hasKey("events") ? strTo<size_t>(profile["events"].atom) : 0);
+	profile["events"] = Data(events + _events, Data::INTERPRETED);
+
+	for (auto taken : _taken) {
+		add(profile, "transitions", taken.first, "taken", taken.second);
+	}
+	for (auto entered : _entered) {
+		add(profile, "states", entered.first, "entered", entered.second);
+	}
+	for (auto dwell : _dwell) {
+		add(profile, "states", dwell.first, "dwell", dwell.second);
+	}
+	return profile;
+}
+
+void ProfileMonitor::write() {
+	// writers take turns, so an older profile never replaces a newer one
+	std::lock_guard<std::mutex> writeLock(_writeMutex);
+
+	Data profile;
+	{
+		// the interpreters only wait for the counters to be merged, not for the file
+		std::lock_guard<std::recursive_mutex> lock(_mutex);
+		profile = getProfile();
+
+		_initial = profile;
+		_events = 0;
+		_taken.clear();
+		_entered.clear();
+		_dwell.clear();
+		_lastFlush = std::chrono::steady_clock::now();
+	}
+
+	// readers of the profile file never see a partial one
+	std::string tmpFile = _profileFile + "." + UUID::getUUID();
+	{
+		std::ofstream profileStream(tmpFile);
+		if (profileStream)
+			profileStream << profile.asJSON() << std::endl;
+		if (!profileStream) {
+			LOG(_logger, USCXML_WARN) << "Cannot write profile to " << tmpFile << std::endl;
+			remove(tmpFile.c_str());
+			return;
+		}
+	}
+#ifdef _WIN32
+	// rename will not replace an existing file
+	remove(_profileFile.c_str());
+#endif
+	if (rename(tmpFile.c_str(), _profileFile.c_str()) != 0) {
+		LOG(_logger, USCXML_WARN) << "Cannot write profile to " << _profileFile << std::endl;
+		remove(tmpFile.c_str());
+	}
+}
+
+}
@@ -0,0 +1,107 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#ifndef PROFILEMONITOR_H_7A3D90C2
+#define PROFILEMONITOR_H_7A3D90C2
+
+#include "uscxml/Common.h"              // for USCXML_API
+#include "uscxml/interpreter/InterpreterMonitor.h"
+#include "uscxml/messages/Data.h"
+
+#include <mutex>
+#include <map>
+#include <set>
+#include <chrono>
+#include <string>
+
+namespace uscxml {
+
+/**
+ * @ingroup debug
+ * A monitor recording how often transitions are taken and states are
+ * entered and active for use with `uscxml-transform -X profile=FILE`.
+ *
+ * Elements are identified by their XPath in the document. Dwell counts the
+ * events processed while a state was active, i.e. the number of times its
+ * transitions were considered. An existing profile is read when the monitor
+ * is created and the new counts are added on write(), so a profile can be
+ * accumulated over many runs. The profile is written at most every
+ * flushInterval when an interpreter is stable or completes, and on destruction.
+ * It is replaced atomically by writing a temporary file next to it first.
+ *
+ * A profile is for a single document, identified by its md5 as given by
+ * documentId(). Use one monitor per profile file for all interpreters of the
+ * document, interpreters of other documents are not counted.
+ */
+class USCXML_API ProfileMonitor : public InterpreterMonitor {
+public:
+	ProfileMonitor(const std::string& profileFile,
+	               std::chrono::seconds flushInterval = std::chrono::seconds(60));
+	virtual ~ProfileMonitor();
+
+	virtual void beforeProcessingEvent(const std::string& sessionId, const Event& event);
+	virtual void beforeTakingTransition(const std::string& sessionId, const XERCESC_NS::DOMElement* transition);
+	virtual void beforeEnteringState(const std::string& sessionId, const std::string& stateName, const XERCESC_NS::DOMElement* state);
+	virtual void onStableConfiguration(const std::string& sessionId);
+	virtual void afterCompletion(const std::string& sessionId);
+
+	virtual void beforeExitingState(const std::string& sessionId, const std::string& stateName, const XERCESC_NS::DOMElement* state);
+
+	/// The accumulated profile
+	Data getProfile();
+	/// Write the accumulated profile to the profile file
+	void write();
+
+	/// The md5 identifying the interpreter's document in a profile
+	static std::string documentId(const Interpreter& interpreter);
+
+protected:
+	class Session {
+	public:
+		bool isProfiled = false;
+		std::map<const XERCESC_NS::DOMElement*, std::string> keys; // XPaths per element
+		std::set<const XERCESC_NS::DOMElement*> active;
+	};
+
+	Session* sessionFor(const std::string& sessionId);
+	bool isFlushDue();
+	const std::string& keyFor(Session* session, const XERCESC_NS::DOMElement* element);
+	void add(Data& profile, const std::string& section, const std::string& key, const std::string& counter, size_t value);
+
+	std::recursive_mutex _mutex;
+	std::mutex _writeMutex;
+	std::string _profileFile;
+	std::chrono::seconds _flushInterval;
+	std::chrono::time_point<std::chrono::steady_clock> _lastFlush;
+
+	std::map<std::string, Session> _sessions;
+	std::string _documentId;
+	std::string _documentURL;
+	bool _isProfiling; // whether we settled on a document
+
+	Data _initial;
+	size_t _events;
+	std::map<std::string, size_t> _taken;
+	std::map<std::string, size_t> _entered;
+	std::map<std::string, size_t> _dwell;
+};
+
+}
+
+#endif /* end of include guard: PROFILEMONITOR_H_7A3D90C2 */
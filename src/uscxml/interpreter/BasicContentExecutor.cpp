@@ -23,6 +23,7 @@
 #include "uscxml/util/Predicates.h"
 #include "uscxml/util/UUID.h"
 #include "uscxml/util/URL.h"
+#include "uscxml/util/MappedFile.h"
 
 #include <xercesc/dom/DOM.hpp>
 #include <xercesc/parsers/XercesDOMParser.hpp>
@@ -622,7 +623,17 @@ Data BasicContentExecutor::elementAsData(XERCESC_NS::DOMElement* element) {
 		if (!url.isAbsolute()) {
 			url = URL::resolve(url, _callbacks->getBaseURL());
 		}
-		std::string content = url.getInContent();
+		// local files are parsed right from the mapping
+		std::shared_ptr<MappedFile> file;
+		std::string content;
+		std::string fileName = url.localPath();
+		if (fileName.size() > 0) {
+			file = std::make_shared<MappedFile>(fileName);
+		} else {
+			content = url.getInContent();
+		}
+		const char* data = (file ? file->data() : content.data());
+		size_t length = (file ? file->size() : content.size());
 
 		// append as XML?
 		try {
@@ -634,7 +645,7 @@ Data BasicContentExecutor::elementAsData(XERCESC_NS::DOMElement* element) {
 			std::unique_ptr<XERCESC_NS::ErrorHandler> errHandler(new XERCESC_NS::HandlerBase());
 			parser->setErrorHandler(errHandler.get());
 
-			XERCESC_NS::MemBufInputSource is((XMLByte*)content.c_str(), content.size(), X("fake"));
+			XERCESC_NS::MemBufInputSource is((const XMLByte*)data, length, X("fake"));
 			is.setPublicId(X(url));
 
 			parser->parse(is);
@@ -647,7 +658,7 @@ Data BasicContentExecutor::elementAsData(XERCESC_NS::DOMElement* element) {
 		}
 
 		// append as text (are we leaking?)
-		XERCESC_NS::DOMText* textNode = element->getOwnerDocument()->createTextNode(X(content));
+		XERCESC_NS::DOMText* textNode = element->getOwnerDocument()->createTextNode(X(std::string(data, length)));
 		element->appendChild(textNode);
 	}
 SOURCE_APPEND_DONE:
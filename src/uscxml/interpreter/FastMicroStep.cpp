@@ -756,11 +756,49 @@ CONFLICTING_TRANS:
 	_tmpStates = boost::dynamic_bitset<BITSET_BLOCKTYPE>(_states.size(), false);
 	_conflicts = boost::dynamic_bitset<BITSET_BLOCKTYPE>(_transitions.size(), false);
 	_transSet = boost::dynamic_bitset<BITSET_BLOCKTYPE>(_transitions.size(), false);
+	_pendingConflicts = boost::dynamic_bitset<BITSET_BLOCKTYPE>(_transitions.size(), false);
 
 	_isInitialized = true;
 
 }
 
+size_t FastMicroStep::evaluateGuards(size_t first) {
+	/*
+	 * Batch the guards of all candidates from first on that are reached no matter
+	 * which of them turn out to be enabled. We stop at the first candidate that
+	 * conflicts with one before, it is only reached if that one is not taken.
+	 */
+	_guards.clear();
+	_guardCandidates.clear();
+	_pendingConflicts.reset();
+
+	size_t k;
+	for (k = first; k < _candidates.size(); k++) {
+		size_t i = _candidates[k];
+
+		/* pre-empted by a transition we already took, never reached */
+		if (BIT_HAS(i, _conflicts))
+			continue;
+
+		/* only reached if no transition before is taken */
+		if (BIT_HAS(i, _pendingConflicts))
+			break;
+
+		_pendingConflicts |= USCXML_GET_TRANS(i).conflicts;
+		if (USCXML_GET_TRANS(i).cond.size() > 0) {
+			_guardCandidates.push_back(k);
+			_guards.push_back(USCXML_GET_TRANS(i).cond);
+		}
+	}
+
+	/* a single call into the datamodel, errors are raised in document order */
+	_callbacks->isTrue(_guards, _batchResults);
+	for (size_t j = 0; j < _guardCandidates.size(); j++) {
+		_guardResults[_guardCandidates[j]] = _batchResults[j];
+	}
+	return k;
+}
+
 std::string FastMicroStep::toBase64(const boost::dynamic_bitset<BITSET_BLOCKTYPE>& bitset) {
 	std::vector<boost::dynamic_bitset<BITSET_BLOCKTYPE>::block_type> bytes(bitset.num_blocks() + 1);
 	boost::to_block_range(bitset, bytes.begin());
@@ -938,43 +976,62 @@ SELECT_TRANSITIONS:
 	// we read an event - unset stable to signal onstable again later
 	_flags &= ~USCXML_CTX_STABLE;
 
+	/* collect the active and matching transitions */
+	_candidates.clear();
 	for (i = 0; i < _transitions.size(); i++) {
 		/* never select history or initial transitions automatically */
 		if unlikely(USCXML_GET_TRANS(i).type & (USCXML_TRANS_HISTORY | USCXML_TRANS_INITIAL))
 			continue;
 
 		/* is the transition active? */
-		if (BIT_HAS(USCXML_GET_TRANS(i).source, _configuration)) {
-			/* is it non-conflicting? */
-			if (!BIT_HAS(i, _conflicts)) {
-				/* is it spontaneous with an event or vice versa? */
-				if ((USCXML_GET_TRANS(i).event.size() == 0 && !_event) ||
-				        (USCXML_GET_TRANS(i).event.size() != 0 && _event)) {
-					/* is it enabled? */
-					if ((!_event || _callbacks->isMatched(_event, USCXML_GET_TRANS(i).event)) &&
-					        (USCXML_GET_TRANS(i).cond.size() == 0 || _callbacks->isTrue(USCXML_GET_TRANS(i).cond))) {
-
-						/* remember that we found a transition */
-						_flags |= USCXML_CTX_TRANSITION_FOUND;
-
-						/* transitions that are pre-empted */
-						_conflicts |= USCXML_GET_TRANS(i).conflicts;
-
-						/* states that are directly targeted (resolve as entry-set later) */
-						_targetSet |= USCXML_GET_TRANS(i).target;
-
-						/* states that will be left */
-						for (auto documentOrder = _exitSets[i].first;
-						        documentOrder <= _exitSets[i].second;
-						        documentOrder++) {
-							_exitSet[documentOrder] = true;
-						}
+		if (!BIT_HAS(USCXML_GET_TRANS(i).source, _configuration))
+			continue;
 
-						BIT_SET_AT(i, _transSet);
-					}
-				}
-			}
+		/* is it spontaneous with an event or vice versa? */
+		if ((USCXML_GET_TRANS(i).event.size() == 0) == !!_event)
+			continue;
+
+		/* is it matched? */
+		if (_event && !_callbacks->isMatched(_event, USCXML_GET_TRANS(i).event))
+			continue;
+
+		_candidates.push_back(i);
+	}
+
+	_guardResults.assign(_candidates.size(), false);
+	j = 0; // candidates before have their guards evaluated
+	for (k = 0; k < _candidates.size(); k++) {
+		i = _candidates[k];
+
+		/* is it non-conflicting? */
+		if (BIT_HAS(i, _conflicts))
+			continue;
+
+		/* is it enabled? */
+		if (USCXML_GET_TRANS(i).cond.size() > 0) {
+			if (k >= j)
+				j = evaluateGuards(k);
+			if (!_guardResults[k])
+				continue;
+		}
+
+		/* remember that we found a transition */
+		_flags |= USCXML_CTX_TRANSITION_FOUND;
+
+		/* transitions that are pre-empted */
+		_conflicts |= USCXML_GET_TRANS(i).conflicts;
+
+		/* states that are directly targeted (resolve as entry-set later) */
+		_targetSet |= USCXML_GET_TRANS(i).target;
+
+		/* states that will be left */
+		for (auto documentOrder = _exitSets[i].first;
+		        documentOrder <= _exitSets[i].second;
+		        documentOrder++) {
+			_exitSet[documentOrder] = true;
 		}
+
+		BIT_SET_AT(i, _transSet);
 	}
 
 #ifdef USCXML_VERBOSE
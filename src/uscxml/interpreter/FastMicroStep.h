@@ -156,6 +156,17 @@ private:
 	boost::dynamic_bitset<BITSET_BLOCKTYPE> _conflicts;
 	boost::dynamic_bitset<BITSET_BLOCKTYPE> _transSet;
 
+	// candidate transitions and their guards for batched evaluation
+	std::vector<size_t> _candidates;
+	std::vector<bool> _guardResults; ///< per candidate
+	std::vector<size_t> _guardCandidates;
+	std::vector<std::string> _guards;
+	std::vector<bool> _batchResults;
+	boost::dynamic_bitset<BITSET_BLOCKTYPE> _pendingConflicts;
+
+	/// Evaluate the guards of all candidates reached from first on, return the first one left out
+	size_t evaluateGuards(size_t first);
+
 #ifdef USCXML_VERBOSE
 	void printStateNames(const boost::dynamic_bitset<BITSET_BLOCKTYPE>& bitset);
 #endif
@@ -51,26 +51,27 @@
 
 namespace uscxml {
 
-std::map<std::string, std::weak_ptr<InterpreterImpl> > InterpreterImpl::_instances;
+// sessions are removed when destroyed, expired ones are skipped until then
+// registering copies a shard, 256 keep them small for some thousand sessions
+ShardedMap<std::weak_ptr<InterpreterImpl> > InterpreterImpl::_instances(256, [](const std::weak_ptr<InterpreterImpl>& instance) {
+	return instance.expired();
+});
 std::recursive_mutex InterpreterImpl::_instanceMutex;
 
 std::map<std::string, std::weak_ptr<InterpreterImpl> > InterpreterImpl::getInstances() {
-	std::lock_guard<std::recursive_mutex> lock(_instanceMutex);
-	std::map<std::string, std::weak_ptr<InterpreterImpl> >::iterator instIter = _instances.begin();
-	while(instIter != _instances.end()) {
-		if (!instIter->second.lock()) {
-			_instances.erase(instIter++);
-		} else {
-			instIter++;
-		}
-	}
-	return _instances;
+	return _instances.toMap();
+}
+
+std::shared_ptr<InterpreterImpl> InterpreterImpl::getInstance(const std::string& sessionId) {
+	std::weak_ptr<InterpreterImpl> instance;
+	if (_instances.find(sessionId, instance))
+		return instance.lock();
+	return std::shared_ptr<InterpreterImpl>();
 }
 
 void InterpreterImpl::addInstance(std::shared_ptr<InterpreterImpl> interpreterImpl) {
-	std::lock_guard<std::recursive_mutex> lock(_instanceMutex);
-	assert(_instances.find(interpreterImpl->getSessionId()) == _instances.end());
-	_instances[interpreterImpl->getSessionId()] = interpreterImpl;
+	assert(!getInstance(interpreterImpl->getSessionId()));
+	_instances.insert(interpreterImpl->getSessionId(), interpreterImpl);
 }
 
 InterpreterImpl::InterpreterImpl() : _isInitialized(false), _document(NULL), _scxml(NULL), _state(USCXML_INSTANTIATED) {
@@ -106,10 +107,7 @@ InterpreterImpl::~InterpreterImpl() {
 	if (_lambdaMonitor)
 		delete _lambdaMonitor;
 
-	{
-		std::lock_guard<std::recursive_mutex> lock(_instanceMutex);
-		_instances.erase(getSessionId());
-	}
+	_instances.erase(getSessionId());
 
 //    assert(_invokers.size() == 0);
 //    ::xercesc_3_1::XMLPlatformUtils::Terminate();
@@ -261,8 +259,51 @@ std::string InterpreterImpl::serialize() {
 }
 
 
+DocumentTemplate::DocumentTemplate(XERCESC_NS::DOMDocument* document, const URL& baseURL, const std::string& md5) :
+	document(document),
+	baseURL(baseURL),
+	md5(md5) {
+
+	// let an interpreter download the scripts into the document, it deletes the document if this fails
+	std::shared_ptr<InterpreterImpl> setup(new InterpreterImpl());
+	setup->_document = document;
+	setup->_baseURL = baseURL;
+	setup->setupDOM();
+
+	xmlPrefix = setup->_xmlPrefix;
+	setup->_document = NULL;
+}
+
+DocumentTemplate::~DocumentTemplate() {
+	if (document)
+		delete document;
+}
+
+void InterpreterImpl::cloneTemplate() {
+	XERCESC_NS::DOMImplementation* implementation = XERCESC_NS::DOMImplementationRegistry::getDOMImplementation(X("core"));
+	_document = implementation->createDocument();
+	_document->appendChild(_document->importNode(_template->document->getDocumentElement(), true));
+
+	// scripts were downloaded into the template, but user data is not imported
+	std::list<DOMElement*> templateScripts = DOMUtils::filterChildElements(_template->xmlPrefix + "script", _template->document->getDocumentElement(), true);
+	std::list<DOMElement*> scripts = DOMUtils::filterChildElements(_template->xmlPrefix + "script", _document->getDocumentElement(), true);
+	auto templateIter = templateScripts.begin();
+	auto scriptIter = scripts.begin();
+	for (; templateIter != templateScripts.end() && scriptIter != scripts.end(); templateIter++, scriptIter++) {
+		if ((*templateIter)->getUserData(X("downloaded")) != NULL) {
+			(*scriptIter)->setUserData(X("downloaded"), (*scriptIter)->getLastChild(), NULL);
+		}
+	}
+
+	_template.reset();
+}
+
 void InterpreterImpl::setupDOM() {
 
+	if (!_document && _template) {
+		cloneTemplate();
+	}
+
 	if (!_document) {
 		ERROR_PLATFORM_THROW("Interpreter has no XML document");
 	}
@@ -303,6 +344,9 @@ SCXML_STOP_SEARCH:
 		// download all script, see issue 134
 		std::list<DOMElement*> scripts = DOMUtils::filterChildElements(_xmlPrefix + "script", _scxml, true);
 		for (auto script : scripts) {
+			if (script->getUserData(X("downloaded")) != NULL)
+				continue; // copied from a template
+
 			if (HAS_ATTR(script, kXMLCharSource)) {
 				std::string src = ATTR(script, kXMLCharSource);
 				std::string contents;
@@ -400,7 +444,13 @@ void InterpreterImpl::init() {
 	}
 
 	if (!_microStepper) {
-		_microStepper = MicroStep(std::shared_ptr<MicroStepImpl>(new LargeMicroStep(this)));
+		// e.g. USCXML_MICROSTEPPER=fast, other microsteppers have to be registered with the factory
+		const char* envMicroStepper = getenv("USCXML_MICROSTEPPER");
+		if (envMicroStepper != NULL && _factory->hasMicroStepper(envMicroStepper)) {
+			_microStepper = MicroStep(_factory->createMicroStepper(envMicroStepper, this));
+		} else {
+			_microStepper = MicroStep(std::shared_ptr<MicroStepImpl>(new LargeMicroStep(this)));
+		}
 	}
 	_microStepper.init(_scxml);
 
@@ -476,6 +526,18 @@ bool InterpreterImpl::isTrue(const std::string& expr) {
 	}
 }
 
+void InterpreterImpl::isTrue(const std::vector<std::string>& exprs, std::vector<bool>& result) {
+	_dataModel.evalAsBoolBatch(exprs, result, _guardErrors);
+
+	// deliver errors in document order, just as isTrue(expr) one by one
+	for (size_t i = 0; i < _guardErrors.size(); i++) {
+		if (!_guardErrors[i])
+			continue;
+		LOG(getLogger(), USCXML_ERROR) << _guardErrors[i];
+		enqueueInternal(_guardErrors[i]);
+	}
+}
+
 
 bool InterpreterImpl::checkValidSendType(const std::string& type, const std::string& target) {
 
@@ -494,6 +556,8 @@ bool InterpreterImpl::checkValidSendType(const std::string& type, const std::str
 }
 
 Event InterpreterImpl::dequeueExternal(size_t blockMs) {
+	if (_dataModel)
+		_dataModel.releaseEvent(_currEvent);
 	_currEvent = _externalQueue.dequeue(blockMs);
 	if (_currEvent) {
 		_dataModel.setEvent(_currEvent);
@@ -29,6 +29,7 @@
 
 #include "uscxml/Common.h"
 #include "uscxml/util/URL.h"
+#include "uscxml/util/ShardedMap.h"
 #include "uscxml/plugins/Factory.h"
 #include "uscxml/plugins/DataModelImpl.h"
 #include "uscxml/plugins/IOProcessorImpl.h"
@@ -45,6 +46,21 @@ namespace uscxml {
 class InterpreterMonitor;
 class InterpreterIssue;
 
+/**
+ * A parsed document with its scripts downloaded, shared by the sessions
+ * created via Interpreter::fromTemplate.
+ */
+struct USCXML_API DocumentTemplate {
+	/// Takes ownership of the document and prepares it as setupDOM would
+	DocumentTemplate(XERCESC_NS::DOMDocument* document, const URL& baseURL, const std::string& md5);
+	~DocumentTemplate();
+
+	XERCESC_NS::DOMDocument* document;
+	std::string xmlPrefix;
+	URL baseURL;
+	std::string md5;
+};
+
 /**
  * @ingroup interpreter
  * @ingroup impl
@@ -97,6 +113,8 @@ public:
 	 MicrostepCallbacks
 	 */
 	virtual Event dequeueInternal() {
+		if (_dataModel)
+			_dataModel.releaseEvent(_currEvent);
 		_currEvent = _internalQueue.dequeue(0);
 		if (_currEvent)
 			_dataModel.setEvent(_currEvent);
@@ -104,6 +122,7 @@ public:
 	}
 	virtual Event dequeueExternal(size_t blockMs);
 	virtual bool isTrue(const std::string& expr);
+	virtual void isTrue(const std::vector<std::string>& exprs, std::vector<bool>& result);
 
 	virtual void raiseDoneEvent(XERCESC_NS::DOMElement* state, XERCESC_NS::DOMElement* doneData) {
 		_execContent.raiseDoneEvent(state, doneData);
@@ -151,12 +170,20 @@ public:
 	virtual const std::map<std::string, Invoker>& getInvokers() {
 		return _invokers;
 	}
+	virtual std::string getDocumentId() {
+		return _md5;
+	}
+	/// The template the session was created from, until it copied its document
+	std::shared_ptr<DocumentTemplate> getTemplate() const {
+		return _template;
+	}
 
 	virtual bool isInState(const std::string& stateId) {
 		return _microStepper.isInState(stateId);
 	}
 	virtual XERCESC_NS::DOMDocument* getDocument() const {
-		return _document;
+		// never hand out the document shared by a template
+		return const_cast<InterpreterImpl*>(this)->getDocument();
 	}
 
 	/**
@@ -268,8 +295,11 @@ public:
 	}
 
 	static std::map<std::string, std::weak_ptr<InterpreterImpl> > getInstances();
+	static std::shared_ptr<InterpreterImpl> getInstance(const std::string& sessionId); ///< The running session with the id or NULL
 
 	virtual XERCESC_NS::DOMDocument* getDocument() {
+		if (!_document && _template)
+			cloneTemplate();
 		return _document;
 	}
 
@@ -290,12 +320,13 @@ protected:
 	bool _isInitialized;
 	XERCESC_NS::DOMDocument* _document;
 	XERCESC_NS::DOMElement* _scxml;
+	std::shared_ptr<DocumentTemplate> _template; // until we copied its document
 
 	std::map<std::string, std::tuple<std::string, std::string, std::string> > _delayedEventTargets;
 
 	virtual void init();
 
-	static std::map<std::string, std::weak_ptr<InterpreterImpl> > _instances;
+	static ShardedMap<std::weak_ptr<InterpreterImpl> > _instances;
 	static std::recursive_mutex _instanceMutex;
 	std::recursive_mutex _delayMutex;
 	std::recursive_mutex _serializationMutex;
@@ -307,6 +338,7 @@ protected:
 	friend class SCXMLIOProcessor;
 	friend class DebugSession;
 	friend class Debugger;
+	friend struct DocumentTemplate;
 
 	std::string _xmlPrefix;
 	std::string _xmlNS;
@@ -329,6 +361,7 @@ protected:
 
 	Event _currEvent;
 	Event _invokeReq;
+	std::vector<ErrorEvent> _guardErrors; ///< errors of the last batch of guards
 
 	std::map<std::string, IOProcessor> _ioProcs;
 	std::map<std::string, Invoker> _invokers;
@@ -340,6 +373,7 @@ protected:
 
 private:
 	void setupDOM();
+	void cloneTemplate();
 };
 
 }
@@ -431,6 +431,8 @@ void LargeMicroStep::init(XERCESC_NS::DOMElement* scxml) {
 	_transitions.resize(tmp.size());
 	_conflicting.resize(tmp.size());
 	_compatible.resize(tmp.size());
+	_candidates.resize(tmp.size());
+	_candidateIndex.resize(tmp.size());
 
 	for (i = 0; i < _transitions.size(); i++) {
 		_transitions[i] = new Transition(i);
@@ -659,6 +661,32 @@ SELECT_TRANSITIONS:
 	{
 		BENCHMARK("select transitions");
 
+		// collect the active and matching transitions in the order we visit them below
+		_candidates.reset();
+		_candidateList.clear();
+		for (auto state : _configurationPostFix) {
+			for (auto transition : state->transitions) {
+				/* never select history or initial transitions automatically */
+				if unlikely(transition->type & (USCXML_TRANS_HISTORY | USCXML_TRANS_INITIAL))
+					continue;
+
+				/* is it spontaneous with an event or vice versa? */
+				if ((transition->event.size() == 0 && _event) ||
+				        (transition->event.size() != 0 && !_event))
+					continue;
+
+				/* is it matched? */
+				if (_event && !_callbacks->isMatched(_event, transition->event))
+					continue;
+
+				_candidates[transition->postFixOrder] = true;
+				_candidateIndex[transition->postFixOrder] = _candidateList.size();
+				_candidateList.push_back(transition);
+			}
+		}
+		_guardResults.assign(_candidateList.size(), false);
+		size_t evaluated = 0; // candidates before have their guards evaluated
+
 		// iterate active states in postfix order and find transitions
 		for (auto stateIter = _configurationPostFix.begin(); stateIter != _configurationPostFix.end();) {
 			State* state = *stateIter++;
@@ -668,13 +696,8 @@ SELECT_TRANSITIONS:
 			for (auto transIter = state->transitions.begin(); transIter != state->transitions.end();) {
 				Transition* transition = *transIter++;
 
-				/* never select history or initial transitions automatically */
-				if unlikely(transition->type & (USCXML_TRANS_HISTORY | USCXML_TRANS_INITIAL))
-					continue;
-
-				/* is it spontaneous with an event or vice versa? */
-				if ((transition->event.size() == 0 && _event) ||
-				        (transition->event.size() != 0 && !_event))
+				/* is it active and matched? */
+				if (!_candidates[transition->postFixOrder])
 					continue;
 
 				/* check whether it is explicitly conflicting or compatible, calculate if neither */
@@ -719,13 +742,14 @@ SELECT_TRANSITIONS:
 					}
 				}
 
-				/* is it matched? */
-				if (_event && !_callbacks->isMatched(_event, transition->event))
-					continue;
-
 				/* is it enabled? */
-				if (transition->cond.size() > 0 && !_callbacks->isTrue(transition->cond))
-					continue;
+				if (transition->cond.size() > 0) {
+					size_t candidate = _candidateIndex[transition->postFixOrder];
+					if (candidate >= evaluated)
+						evaluated = evaluateGuards(candidate);
+					if (!_guardResults[candidate])
+						continue;
+				}
 
 				// This transition is fine and ought to be taken!
 
@@ -1306,6 +1330,61 @@ void LargeMicroStep::resortStates(DOMElement* element, const X& xmlPrefix) {
 	}
 }
 
+bool LargeMicroStep::mayPreempt(Transition* t1, Transition* t2) {
+	// the remaining transitions of a state and its ancestors are skipped
+	if (t1->source == t2->source || t1->source->ancestors.find(t2->source) != t1->source->ancestors.end())
+		return true;
+
+	std::pair<uint32_t, uint32_t> exit1 = getExitSet(t1);
+	std::pair<uint32_t, uint32_t> exit2 = getExitSet(t2);
+	return (exit1.first != 0 && exit2.first != 0 &&
+	        ((exit1.first <= exit2.first && exit1.second >= exit2.first) ||
+	         (exit2.first <= exit1.first && exit2.second >= exit1.first)));
+}
+
+size_t LargeMicroStep::evaluateGuards(size_t first) {
+	/*
+	 * Batch the guards of all candidates from first on that are reached no matter
+	 * which of them turn out to be enabled. We stop at the first candidate that
+	 * a transition taken or pending before might pre-empt.
+	 */
+	_guards.clear();
+	_guardCandidates.clear();
+	_pending.clear();
+
+	size_t k;
+	for (k = first; k < _candidateList.size(); k++) {
+		Transition* transition = _candidateList[k];
+
+		bool reached = true;
+		for (auto taken : _transSet) {
+			if (mayPreempt(taken, transition)) {
+				reached = false;
+				break;
+			}
+		}
+		for (size_t j = 0; reached && j < _pending.size(); j++) {
+			if (mayPreempt(_pending[j], transition))
+				reached = false;
+		}
+		if (!reached && k > first)
+			break;
+
+		_pending.push_back(transition);
+		if (transition->cond.size() > 0) {
+			_guardCandidates.push_back(k);
+			_guards.push_back(transition->cond);
+		}
+	}
+
+	/* a single call into the datamodel, errors are raised in document order */
+	_callbacks->isTrue(_guards, _batchResults);
+	for (size_t j = 0; j < _guardCandidates.size(); j++) {
+		_guardResults[_guardCandidates[j]] = _batchResults[j];
+	}
+	return k;
+}
+
 std::pair<uint32_t, uint32_t> LargeMicroStep::getExitSet(const Transition* transition) {
 	if (_exitSetCache.find(transition->postFixOrder) == _exitSetCache.end()) {
 		std::pair<uint32_t, uint32_t> statesToExit;
@@ -182,6 +182,21 @@ private:
 
 	boost::container::flat_set<Transition*, TransitionOrder> _transSet;
 
+	// active and matching transitions and their guards for batched evaluation
+	boost::dynamic_bitset<BITSET_BLOCKTYPE> _candidates;
+	std::vector<size_t> _candidateIndex; ///< position in _candidateList per transition
+	std::vector<Transition*> _candidateList;
+	std::vector<bool> _guardResults; ///< per candidate
+	std::vector<size_t> _guardCandidates;
+	std::vector<std::string> _guards;
+	std::vector<bool> _batchResults;
+	std::vector<Transition*> _pending;
+
+	/// Evaluate the guards of all candidates reached from first on, return the first one left out
+	size_t evaluateGuards(size_t first);
+	/// Whether taking t1 might cause the selection to skip t2
+	bool mayPreempt(Transition* t1, Transition* t2);
+
 	// adapted from http://www.cplusplus.com/reference/algorithm/set_intersection/
 	template <class iter_t1, class iter_t2, class compare = StateOrder>
 	bool intersects(iter_t1 first1, iter_t1 last1, iter_t2 first2, iter_t2 last2) {
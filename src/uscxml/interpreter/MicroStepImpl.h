@@ -23,6 +23,7 @@
 #include <list>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "uscxml/Common.h"
 #include "uscxml/Interpreter.h"
@@ -47,6 +48,8 @@ public:
 
 	/** Datamodel */
 	virtual bool isTrue(const std::string& expr) = 0;
+	/// Evaluate guards in a single batch and in order, failed ones raise their error as isTrue(expr) would
+	virtual void isTrue(const std::vector<std::string>& exprs, std::vector<bool>& result) = 0;
 	virtual void initData(XERCESC_NS::DOMElement* element) = 0;
 
 	/** Executable Content */
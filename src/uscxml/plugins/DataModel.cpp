@@ -38,6 +38,10 @@ void DataModel::setEvent(const Event& event) {
 	return _impl->setEvent(event);
 }
 
+void DataModel::releaseEvent(Event& event) {
+	return _impl->releaseEvent(event);
+}
+
 Data DataModel::getAsData(const std::string& content) {
 	return _impl->getAsData(content);
 }
@@ -54,6 +58,12 @@ bool DataModel::evalAsBool(const std::string& expr) {
 	return _impl->evalAsBool(expr);
 }
 
+void DataModel::evalAsBoolBatch(const std::vector<std::string>& exprs,
+                                std::vector<bool>& result,
+                                std::vector<ErrorEvent>& errors) {
+	_impl->evalAsBoolBatch(exprs, result, errors);
+}
+
 uint32_t DataModel::getLength(const std::string& expr) {
 	return _impl->getLength(expr);
 }
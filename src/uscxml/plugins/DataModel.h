@@ -26,6 +26,7 @@
 #include <list>
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace uscxml {
 
@@ -51,6 +52,8 @@ public:
 
 	/// @copydoc DataModelImpl::setEvent()
 	virtual void setEvent(const Event& event);
+	/// @copydoc DataModelImpl::releaseEvent()
+	virtual void releaseEvent(Event& event);
 
 	/// @copydoc DataModelImpl::getAsData()
 	virtual Data getAsData(const std::string& content);
@@ -60,6 +63,10 @@ public:
 	virtual void eval(const std::string& content);
 	/// @copydoc DataModelImpl::evalAsBool()
 	virtual bool evalAsBool(const std::string& expr);
+	/// @copydoc DataModelImpl::evalAsBoolBatch()
+	virtual void evalAsBoolBatch(const std::vector<std::string>& exprs,
+	                             std::vector<bool>& result,
+	                             std::vector<ErrorEvent>& errors);
 
 	/// @copydoc DataModelImpl::getLength()
 	virtual uint32_t getLength(const std::string& expr);
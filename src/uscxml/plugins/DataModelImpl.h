@@ -33,6 +33,7 @@ class DOMNode;
 #include <list>
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace uscxml {
 
@@ -56,6 +57,10 @@ public:
 #endif
 	virtual const std::map<std::string, Invoker>& getInvokers() = 0;
 	virtual Logger getLogger() = 0;
+	/// Identifies the content of the session's document, e.g. its md5, empty if unknown
+	virtual std::string getDocumentId() {
+		return "";
+	}
 };
 
 class USCXML_API DataModelExtension {
@@ -142,6 +147,13 @@ public:
 	 */
 	virtual void setEvent(const Event& event) = 0;
 
+	/**
+	 * The event last passed to setEvent() is about to be replaced.
+	 * A datamodel still referring to its data can take it over.
+	 * @param event The event as it was passed to setEvent().
+	 */
+	virtual void releaseEvent(Event& event) {}
+
 	/**
 	 * Experimental extension to have dynamic content in string literals.
 	 * This function was used to replace ${foo} expressions on the data-model,
@@ -201,6 +213,19 @@ public:
 	 */
 	virtual bool evalAsBool(const std::string& expr) = 0;
 
+	/**
+	 * Evaluate a batch of expressions as booleans within a single entry into the data-model.
+	 * The microsteppers pass the guards of the transitions they will reach in document order,
+	 * every expression is evaluated exactly once and in the given order, even if an earlier
+	 * one raised an error. The default implementation just calls evalAsBool() for every expression.
+	 * @param exprs Expressions in the data-model's language.
+	 * @param result Whether the respective expression evaluates as `true`.
+	 * @param errors The error raised by the respective expression, an unnamed event if there was none.
+	 */
+	virtual void evalAsBoolBatch(const std::vector<std::string>& exprs,
+	                             std::vector<bool>& result,
+	                             std::vector<ErrorEvent>& errors);
+
 	/**
 	 * Determine whether a given variable / location is declared.
 	 * @param expr The variable / location to check.
@@ -97,6 +97,10 @@
 #   include "uscxml/plugins/datamodel/promela/PromelaDataModel.h"
 #endif
 
+#ifdef WITH_DM_NATIVE
+#   include "uscxml/plugins/datamodel/native/NativeDataModel.h"
+#endif
+
 
 #ifdef WITH_INV_SCXML
 #   include "uscxml/plugins/invoker/scxml/USCXMLInvoker.h"
@@ -255,6 +259,13 @@ void Factory::registerPlugins() {
 	}
 #endif
 
+#ifdef WITH_DM_NATIVE
+	{
+		NativeDataModel* dataModel = new NativeDataModel();
+		registerDataModel(dataModel);
+	}
+#endif
+
 	{
 		NullDataModel* dataModel = new NullDataModel();
 		registerDataModel(dataModel);
@@ -547,6 +558,20 @@ void DataModelImpl::addExtension(DataModelExtension* ext) {
 	ERROR_EXECUTION_THROW("DataModel does not support extensions");
 }
 
+void DataModelImpl::evalAsBoolBatch(const std::vector<std::string>& exprs,
+                                    std::vector<bool>& result,
+                                    std::vector<ErrorEvent>& errors) {
+	result.assign(exprs.size(), false);
+	errors.assign(exprs.size(), ErrorEvent());
+	for (size_t i = 0; i < exprs.size(); i++) {
+		try {
+			result[i] = evalAsBool(exprs[i]);
+		} catch (ErrorEvent e) {
+			errors[i] = e;
+		}
+	}
+}
+
 size_t DataModelImpl::replaceExpressions(std::string& content) {
 	std::stringstream ss;
 	size_t replacements = 0;
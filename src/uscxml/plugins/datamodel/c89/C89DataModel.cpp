@@ -25,14 +25,131 @@
 
 #include "uscxml/messages/Event.h"
 #include "uscxml/util/DOM.h"
+#include "uscxml/util/Convenience.h"
+
+#include <set>
+#include <sstream>
 
 namespace uscxml {
 
-C89DataModel::C89DataModel() {
+/**
+ * picoc reports errors by longjmp'ing to its exit point, these helpers keep the
+ * frames in between free of C++ objects with non-trivial destructors.
+ */
+
+struct PicocResult {
+	enum Type {
+		NONE,
+		INTEGER,
+		FLOAT,
+		STRING
+	};
+	Type type;
+	long integer;
+	double fp;
+	std::string string;
+};
+
+static bool picocLex(Picoc* pc, const char* source, int length, void** tokens) {
+	if (PicocPlatformSetExitPoint(pc))
+		return false;
+
+	*tokens = LexAnalyse(pc, TableStrRegister(pc, "c89"), source, length, NULL);
+	return true;
+}
+
+static bool picocEvalExpression(Picoc* pc, const char* source, void* tokens, PicocResult* result) {
+	struct ParseState parser;
+	struct Value* value = NULL;
+
+	if (PicocPlatformSetExitPoint(pc))
+		return false;
+
+	LexInitParser(&parser, pc, source, tokens, TableStrRegister(pc, "c89"), TRUE, FALSE);
+
+	result->type = PicocResult::NONE;
+	if (!ExpressionParse(&parser, &value))
+		return true;
+
+	switch (value->Typ->Base) {
+	case TypeFP:
+		result->type = PicocResult::FLOAT;
+		result->fp = value->Val->FP;
+		break;
+	case TypeArray:
+		if (value->Typ->FromType->Base == TypeChar) {
+			result->type = PicocResult::STRING;
+			result->string = &value->Val->ArrayMem[0];
+		}
+		break;
+	case TypePointer:
+		if (value->Typ->FromType->Base == TypeChar && value->Val->Pointer != NULL) {
+			result->type = PicocResult::STRING;
+			result->string = (const char*)value->Val->Pointer;
+			break;
+		}
+	// fall through
+	default:
+		if (IS_NUMERIC_COERCIBLE(value) || value->Typ->Base == TypePointer) {
+			result->type = PicocResult::INTEGER;
+			result->integer = ExpressionCoerceInteger(value);
+		}
+		break;
+	}
+
+	VariableStackPop(&parser, value);
+	return true;
+}
+
+static bool picocEvalStatements(Picoc* pc, const char* source, void* tokens) {
+	struct ParseState parser;
+	enum ParseResult ok;
+
+	if (PicocPlatformSetExitPoint(pc))
+		return false;
+
+	LexInitParser(&parser, pc, source, tokens, TableStrRegister(pc, "c89"), TRUE, FALSE);
+	do {
+		ok = ParseStatement(&parser, TRUE);
+	} while (ok == ParseResultOk);
+
+	return ok != ParseResultError;
+}
+
+static std::string asCString(const std::string& content) {
+	std::stringstream ss;
+	ss << "\"";
+	for (size_t i = 0; i < content.size(); i++) {
+		switch (content[i]) {
+		case '"':
+			ss << "\\\"";
+			break;
+		case '\\':
+			ss << "\\\\";
+			break;
+		case '\n':
+			ss << "\\n";
+			break;
+		case '\t':
+			ss << "\\t";
+			break;
+		case '\r':
+			ss << "\\r";
+			break;
+		default:
+			ss << content[i];
+		}
+	}
+	ss << "\"";
+	return ss.str();
+}
+
+C89DataModel::C89DataModel() : _cacheTokens(true) {
 }
 
 std::shared_ptr<DataModelImpl> C89DataModel::create(DataModelCallbacks* callbacks) {
 	std::shared_ptr<C89DataModel> dm(new C89DataModel());
+	dm->_callbacks = callbacks;
 	dm->setup();
 	return dm;
 }
@@ -41,12 +158,131 @@ void C89DataModel::setup() {
 	PicocInitialise(&_pc, PICOC_STACK_SIZE);
 	PicocIncludeAllSystemHeaders(&_pc);
 
+	_cacheTokens = !envVarIsTrue("USCXML_NOCACHE_C89_TOKENS");
+	if (_cacheTokens)
+		precompile();
 }
 
 C89DataModel::~C89DataModel() {
+	for (std::map<std::string, Tokens>::iterator tokIter = _tokenCache.begin(); tokIter != _tokenCache.end(); tokIter++) {
+		HeapFreeMem(&_pc, tokIter->second.tokens);
+	}
 	PicocCleanup(&_pc);
 }
 
+void C89DataModel::precompile() {
+	if (_callbacks == NULL || _callbacks->getDocument() == NULL)
+		return;
+
+	XERCESC_NS::DOMElement* scxml = _callbacks->getDocument()->getDocumentElement();
+	if (scxml == NULL)
+		return;
+
+	std::string prefix = XML_PREFIX(scxml).str();
+	std::set<std::string> elementNames;
+	elementNames.insert(prefix + "transition");
+	elementNames.insert(prefix + "if");
+	elementNames.insert(prefix + "elseif");
+	elementNames.insert(prefix + "data");
+	elementNames.insert(prefix + "assign");
+	elementNames.insert(prefix + "log");
+	elementNames.insert(prefix + "param");
+	elementNames.insert(prefix + "send");
+	elementNames.insert(prefix + "foreach");
+
+	// lex every expression of the document once, evaluation will only parse the cached tokens
+	std::list<XERCESC_NS::DOMElement*> elements = DOMUtils::inDocumentOrder(elementNames, scxml);
+	for (auto element : elements) {
+		try {
+			if (HAS_ATTR(element, kXMLCharCond))
+				getTokens(ATTR(element, kXMLCharCond), true);
+			if (HAS_ATTR(element, kXMLCharExpr)) {
+				if (TAGNAME(element) == prefix + "assign" && HAS_ATTR(element, kXMLCharLocation)) {
+					getTokens(ATTR(element, kXMLCharLocation) + " = (" + ATTR(element, kXMLCharExpr) + ");", true);
+				} else {
+					getTokens(ATTR(element, kXMLCharExpr), true);
+				}
+			}
+			if (HAS_ATTR(element, kXMLCharEventExpr))
+				getTokens(ATTR(element, kXMLCharEventExpr), true);
+			if (HAS_ATTR(element, kXMLCharTargetExpr))
+				getTokens(ATTR(element, kXMLCharTargetExpr), true);
+		} catch (ErrorEvent e) {
+			// syntax errors are reported when the expression is evaluated
+		}
+	}
+}
+
+C89DataModel::Tokens* C89DataModel::getTokens(const std::string& source, bool cache) {
+	std::map<std::string, Tokens>::iterator tokIter = _tokenCache.find(source);
+	if (tokIter != _tokenCache.end())
+		return &tokIter->second;
+
+	Tokens* tokens = (cache ? &_tokenCache[source] : new Tokens());
+	tokens->source = source;
+	tokens->tokens = NULL;
+
+	if (!picocLex(&_pc, tokens->source.c_str(), tokens->source.size(), &tokens->tokens)) {
+		if (cache) {
+			_tokenCache.erase(source);
+		} else {
+			delete tokens;
+		}
+		ERROR_EXECUTION_THROW("Cannot tokenize '" + source + "'");
+	}
+	return tokens;
+}
+
+void C89DataModel::releaseTokens(Tokens* tokens) {
+	std::map<std::string, Tokens>::iterator tokIter = _tokenCache.find(tokens->source);
+	if (tokIter != _tokenCache.end() && &tokIter->second == tokens)
+		return;
+
+	HeapFreeMem(&_pc, tokens->tokens);
+	delete tokens;
+}
+
+Data C89DataModel::evalTokensAsData(Tokens* tokens) {
+	PicocResult result;
+	if (!picocEvalExpression(&_pc, tokens->source.c_str(), tokens->tokens, &result))
+		ERROR_EXECUTION_THROW("Cannot evaluate '" + tokens->source + "'");
+
+	switch (result.type) {
+	case PicocResult::INTEGER:
+		return Data(result.integer);
+	case PicocResult::FLOAT:
+		return Data(result.fp);
+	case PicocResult::STRING:
+		return Data(result.string, Data::VERBATIM);
+	default:
+		break;
+	}
+	return Data();
+}
+
+bool C89DataModel::evalTokensAsBool(Tokens* tokens) {
+	PicocResult result;
+	if (!picocEvalExpression(&_pc, tokens->source.c_str(), tokens->tokens, &result))
+		ERROR_EXECUTION_THROW("Cannot evaluate '" + tokens->source + "'");
+
+	switch (result.type) {
+	case PicocResult::INTEGER:
+		return result.integer != 0;
+	case PicocResult::FLOAT:
+		return result.fp != 0;
+	case PicocResult::STRING:
+		return true;
+	default:
+		break;
+	}
+	return false;
+}
+
+void C89DataModel::evalTokens(Tokens* tokens) {
+	if (!picocEvalStatements(&_pc, tokens->source.c_str(), tokens->tokens))
+		ERROR_EXECUTION_THROW("Cannot execute '" + tokens->source + "'");
+}
+
 void C89DataModel::addExtension(DataModelExtension* ext) {
 	ERROR_EXECUTION_THROW("Extensions unimplemented in C89 datamodel");
 }
@@ -55,51 +291,152 @@ void C89DataModel::setEvent(const Event& event) {
 }
 
 Data C89DataModel::evalAsData(const std::string& content) {
-	Data data;
-	return data;
+	Tokens* tokens = getTokens(content, false);
+	try {
+		Data data = evalTokensAsData(tokens);
+		releaseTokens(tokens);
+		return data;
+	} catch (...) {
+		releaseTokens(tokens);
+		throw;
+	}
+}
+
+void C89DataModel::eval(const std::string& content) {
+	// functions defined in scripts keep referring to their tokens, never release them
+	evalTokens(getTokens(content, true));
 }
 
 bool C89DataModel::isValidSyntax(const std::string& expr) {
+	try {
+		releaseTokens(getTokens(expr, false));
+	} catch (ErrorEvent e) {
+		return false;
+	}
 	return true;
 }
 
 uint32_t C89DataModel::getLength(const std::string& expr) {
-	return 0;
+	Data length = evalAsData("sizeof(" + expr + ") / sizeof((" + expr + ")[0])");
+	if (!isInteger(length.atom.c_str(), 10))
+		ERROR_EXECUTION_THROW("'" + expr + "' does not evaluate to an array");
+	return strTo<uint32_t>(length.atom);
 }
 
 void C89DataModel::setForeach(const std::string& item,
                               const std::string& array,
                               const std::string& index,
                               uint32_t iteration) {
+	if (!isDeclared(item))
+		ERROR_EXECUTION_THROW("'" + item + "' is not declared");
+
+	Tokens* tokens = getTokens(item + " = (" + array + ")[" + toStr(iteration) + "];", false);
+	try {
+		evalTokens(tokens);
+	} catch (...) {
+		releaseTokens(tokens);
+		throw;
+	}
+	releaseTokens(tokens);
+
+	if (index.length() > 0) {
+		assign(index, Data(iteration, Data::INTERPRETED));
+	}
 }
 
 bool C89DataModel::isDeclared(const std::string& expr) {
-	return true;
+	return VariableDefined(&_pc, TableStrRegister(&_pc, expr.c_str())) != 0;
 }
 
 
 void C89DataModel::assign(const std::string& location,
                           const Data& data,
                           const std::map<std::string, std::string>& attr) {
+	if (location.length() == 0)
+		ERROR_EXECUTION_THROW("Assign element has neither id nor location");
+
+	std::string value;
+
+	if (data.node || data.compound.size() > 0 || data.array.size() > 0) {
+		ERROR_EXECUTION_THROW("Cannot assign structured data to '" + location + "' in c89 datamodel");
+	} else if (data.atom.length() == 0) {
+		value = "0";
+	} else if (data.type == Data::INTERPRETED) {
+		value = data.atom;
+	} else {
+		value = asCString(data.atom);
+	}
+
+	Tokens* tokens = getTokens(location + " = (" + value + ");", false);
+	try {
+		evalTokens(tokens);
+	} catch (...) {
+		releaseTokens(tokens);
+		throw;
+	}
+	releaseTokens(tokens);
 }
 
 void C89DataModel::init(const std::string& location,
                         const Data& data,
                         const std::map<std::string, std::string>& attr) {
+	if (!isDeclared(location)) {
+		std::string type;
+		if (attr.find("type") != attr.end()) {
+			type = attr.at("type");
+		} else {
+			// derive the declaration from the initial value
+			Data value = data;
+			if (data.type == Data::INTERPRETED && data.atom.length() > 0)
+				value = evalAsData(data.atom);
+
+			if (value.atom.length() == 0 || isInteger(value.atom.c_str(), 10)) {
+				type = "int";
+			} else if (value.type == Data::INTERPRETED && isNumeric(value.atom.c_str(), 10)) {
+				type = "double";
+			} else {
+				type = "char*";
+			}
+		}
+		evalTokens(getTokens(type + " " + location + ";", true));
+	}
+
+	if (!data.empty())
+		assign(location, data, attr);
 }
 
 bool C89DataModel::evalAsBool(const std::string& expr) {
-	return false;
+	Tokens* tokens = getTokens(expr, false);
+	try {
+		bool result = evalTokensAsBool(tokens);
+		releaseTokens(tokens);
+		return result;
+	} catch (...) {
+		releaseTokens(tokens);
+		throw;
+	}
 }
 
 Data C89DataModel::getAsData(const std::string& content) {
-	Data data;
-	return data;
+	try {
+		return evalAsData(content);
+	} catch (ErrorEvent e) {
+	}
+	return Data(content, Data::VERBATIM);
 }
 
 
 std::string C89DataModel::andExpressions(std::list<std::string> exprs) {
-	return "";
+	if (exprs.size() == 0)
+		return "";
+
+	std::stringstream ss;
+	std::string andOp;
+	for (std::list<std::string>::iterator exprIter = exprs.begin(); exprIter != exprs.end(); exprIter++) {
+		ss << andOp << "(" << *exprIter << ")";
+		andOp = " && ";
+	}
+	return ss.str();
 }
 
 
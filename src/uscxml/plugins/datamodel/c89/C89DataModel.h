@@ -22,6 +22,7 @@
 
 #include "uscxml/plugins/DataModelImpl.h"
 #include <list>
+#include <map>
 
 #ifndef WIN32
 #define UNIX_HOST
@@ -79,6 +80,7 @@ public:
 
 	virtual bool evalAsBool(const std::string& expr);
 	virtual Data evalAsData(const std::string& expr);
+	virtual void eval(const std::string& content);
 	virtual Data getAsData(const std::string& content);
 
 	virtual bool isDeclared(const std::string& expr);
@@ -95,6 +97,30 @@ public:
 
 protected:
 	virtual void setup();
+
+	/// Lexed picoc tokens for a source string, the source has to outlive them
+	struct Tokens {
+		std::string source;
+		void* tokens;
+	};
+
+	/**
+	 * The cached tokens for source or lex them, keeping them cached if cache is set.
+	 *
+	 * Only the expressions of the document are cached when the datamodel is set up,
+	 * everything else is lexed per evaluation so the cache does not grow at runtime.
+	 */
+	Tokens* getTokens(const std::string& source, bool cache);
+	void releaseTokens(Tokens* tokens);
+	void precompile();
+
+	Data evalTokensAsData(Tokens* tokens);
+	bool evalTokensAsBool(Tokens* tokens);
+	void evalTokens(Tokens* tokens);
+
+	std::map<std::string, Tokens> _tokenCache;
+	bool _cacheTokens;
+
 	Picoc _pc;
 };
 
@@ -20,6 +20,7 @@
 #include "uscxml/Common.h"
 #include "uscxml/util/URL.h"
 #include "uscxml/util/String.h"
+#include "uscxml/util/Convenience.h"
 
 #include "JSCDataModel.h"
 
@@ -29,6 +30,8 @@
 #endif
 #include "uscxml/interpreter/Logging.h"
 
+#include <algorithm>
+#include <sstream>
 #include <vector>
 #include <string>
 #include <boost/algorithm/string.hpp>
@@ -102,11 +105,22 @@ bool pluginConnect(pluma::Host& host) {
 
 JSCDataModel::JSCDataModel() {
 	_ctx = NULL;
+	_cacheScripts = true;
 }
 
 JSCDataModel::~JSCDataModel() {
-	if (_ctx)
+	if (_ctx) {
+		clearScripts();
 		JSGlobalContextRelease(_ctx);
+
+		// release the group with its last datamodel
+		std::lock_guard<std::mutex> lock(_initMutex);
+		std::map<std::string, ContextGroup>::iterator groupIter = _contextGroups.find(_documentId);
+		if (_documentId.size() > 0 && groupIter != _contextGroups.end() && --groupIter->second.users == 0) {
+			JSContextGroupRelease(groupIter->second.group);
+			_contextGroups.erase(groupIter);
+		}
+	}
 }
 
 void JSCDataModel::addExtension(DataModelExtension* ext) {
@@ -191,6 +205,7 @@ JSClassDefinition JSCDataModel::jsIOProcessorsClassDef = { 0, 0, "ioProcessors",
 JSClassDefinition JSCDataModel::jsInvokersClassDef = { 0, 0, "invokers", 0, 0, 0, 0, 0, jsInvokerHasProp, jsInvokerGetProp, 0, 0, jsInvokerListProps, 0, 0, 0, 0 };
 
 std::mutex JSCDataModel::_initMutex;
+std::map<std::string, JSCDataModel::ContextGroup> JSCDataModel::_contextGroups;
 
 #ifndef NO_XERCESC
 
@@ -252,7 +267,23 @@ std::shared_ptr<DataModelImpl> JSCDataModel::create(DataModelCallbacks* callback
 }
 
 void JSCDataModel::setup() {
-	_ctx = JSGlobalContextCreate(NULL);
+	_cacheScripts = !envVarIsTrue("USCXML_NOCACHE_JSC_SCRIPTS");
+
+	{
+		// sessions of the same document share a heap and the code JSC compiled for it
+		std::lock_guard<std::mutex> lock(_initMutex);
+		_documentId = _callbacks->getDocumentId();
+		if (_documentId.size() > 0) {
+			if (_contextGroups.find(_documentId) == _contextGroups.end()) {
+				_contextGroups[_documentId].group = JSContextGroupCreate();
+				_contextGroups[_documentId].users = 0;
+			}
+			_contextGroups[_documentId].users++;
+			_ctx = JSGlobalContextCreateInGroup(_contextGroups[_documentId].group, NULL);
+		} else {
+			_ctx = JSGlobalContextCreate(NULL);
+		}
+	}
 
 #ifndef NO_XERCESC
 	JSObjectRef exports;
@@ -657,7 +688,7 @@ bool JSCDataModel::isLocation(const std::string& expr) {
 #endif
 
 bool JSCDataModel::isValidSyntax(const std::string& expr) {
-	JSStringRef scriptJS = JSStringCreateWithUTF8CString(expr.c_str());
+	JSStringRef scriptJS = getScript(expr);
 	JSValueRef exception = NULL;
 	bool valid = JSCheckScriptSyntax(_ctx, scriptJS, NULL, 0, &exception);
 	JSStringRelease(scriptJS);
@@ -673,7 +704,7 @@ bool JSCDataModel::isLegalDataValue(const std::string& expr) {
 }
 
 bool JSCDataModel::isDeclared(const std::string& expr) {
-	JSStringRef scriptJS = JSStringCreateWithUTF8CString(expr.c_str());
+	JSStringRef scriptJS = getScript(expr);
 	JSValueRef exception = NULL;
 	JSValueRef result = JSEvaluateScript(_ctx, scriptJS, NULL, NULL, 0, &exception);
 	JSStringRelease(scriptJS);
@@ -685,12 +716,109 @@ bool JSCDataModel::isDeclared(const std::string& expr) {
 }
 
 bool JSCDataModel::evalAsBool(const std::string& expr) {
-	JSValueRef result = evalAsValue(expr);
+	JSObjectRef condition = getCondition(expr);
+	if (condition == NULL) {
+		JSValueRef result = evalAsValue(expr);
+		return JSValueToBoolean(_ctx, result);
+	}
+
+	JSValueRef exception = NULL;
+	JSValueRef result = JSObjectCallAsFunction(_ctx, condition, NULL, 0, NULL, &exception);
+	if (exception)
+		handleException(exception);
+
 	return JSValueToBoolean(_ctx, result);
 }
 
+void JSCDataModel::evalAsBoolBatch(const std::vector<std::string>& exprs,
+                                   std::vector<bool>& result,
+                                   std::vector<ErrorEvent>& errors) {
+	result.assign(exprs.size(), false);
+	errors.assign(exprs.size(), ErrorEvent());
+
+	// every guard is evaluated exactly once via its own cached function
+	for (size_t i = 0; i < exprs.size(); i++) {
+		JSObjectRef condition = getCondition(exprs[i]);
+		if (condition == NULL) {
+			try {
+				result[i] = evalAsBool(exprs[i]);
+			} catch (ErrorEvent e) {
+				errors[i] = e;
+			}
+			continue;
+		}
+
+		JSValueRef exception = NULL;
+		JSValueRef value = JSObjectCallAsFunction(_ctx, condition, NULL, 0, NULL, &exception);
+		if (exception) {
+			try {
+				handleException(exception);
+			} catch (ErrorEvent e) {
+				errors[i] = e;
+			}
+		} else {
+			result[i] = JSValueToBoolean(_ctx, value);
+		}
+	}
+}
+
+JSStringRef JSCDataModel::getScript(const std::string& expr) {
+	if (!_cacheScripts)
+		return JSStringCreateWithUTF8CString(expr.c_str());
+
+	std::map<std::string, JSStringRef>::iterator scriptIter = _scripts.find(expr);
+	if (scriptIter == _scripts.end()) {
+		if (_scripts.size() >= USCXML_JSC_MAX_CACHED_SCRIPTS)
+			clearScripts();
+		scriptIter = _scripts.insert(std::make_pair(expr, JSStringCreateWithUTF8CString(expr.c_str()))).first;
+	}
+
+	// callers release their reference as with a fresh string
+	return JSStringRetain(scriptIter->second);
+}
+
+JSObjectRef JSCDataModel::getCondition(const std::string& expr) {
+	if (!_cacheScripts)
+		return NULL;
+
+	std::map<std::string, JSObjectRef>::iterator condIter = _conditions.find(expr);
+	if (condIter != _conditions.end())
+		return condIter->second;
+
+	if (_conditions.size() >= USCXML_JSC_MAX_CACHED_SCRIPTS)
+		clearScripts();
+
+	// the newline keeps trailing line comments from swallowing the parenthesis
+	JSStringRef body = JSStringCreateWithUTF8CString(("return (" + expr + "\n);").c_str());
+	JSValueRef exception = NULL;
+	JSObjectRef condition = JSObjectMakeFunction(_ctx, NULL, 0, NULL, body, NULL, 0, &exception);
+	JSStringRelease(body);
+
+	if (exception || condition == NULL) {
+		// not a plain expression, it will be evaluated as a script
+		condition = NULL;
+	} else {
+		JSValueProtect(_ctx, condition);
+	}
+	_conditions[expr] = condition;
+	return condition;
+}
+
+void JSCDataModel::clearScripts() {
+	for (std::map<std::string, JSStringRef>::iterator scriptIter = _scripts.begin(); scriptIter != _scripts.end(); scriptIter++) {
+		JSStringRelease(scriptIter->second);
+	}
+	_scripts.clear();
+
+	for (std::map<std::string, JSObjectRef>::iterator condIter = _conditions.begin(); condIter != _conditions.end(); condIter++) {
+		if (condIter->second != NULL)
+			JSValueUnprotect(_ctx, condIter->second);
+	}
+	_conditions.clear();
+}
+
 JSValueRef JSCDataModel::evalAsValue(const std::string& expr, bool dontThrow) {
-	JSStringRef scriptJS = JSStringCreateWithUTF8CString(expr.c_str());
+	JSStringRef scriptJS = getScript(expr);
 	JSValueRef exception = NULL;
 	JSValueRef result = JSEvaluateScript(_ctx, scriptJS, NULL, NULL, 0, &exception);
 	JSStringRelease(scriptJS);
@@ -23,6 +23,7 @@
 #include "uscxml/config.h"
 #include "uscxml/plugins/DataModelImpl.h"
 #include <list>
+#include <map>
 #include <set>
 #include <mutex>
 
@@ -38,6 +39,8 @@
 #include "uscxml/plugins/Plugins.h"
 #endif
 
+#define USCXML_JSC_MAX_CACHED_SCRIPTS 4096
+
 namespace uscxml {
 class Event;
 class Data;
@@ -79,6 +82,9 @@ public:
 	virtual Data getAsData(const std::string& content);
 	virtual Data evalAsData(const std::string& expr);
 	virtual bool evalAsBool(const std::string& expr);
+	virtual void evalAsBoolBatch(const std::vector<std::string>& exprs,
+	                             std::vector<bool>& result,
+	                             std::vector<ErrorEvent>& errors);
 
 	virtual bool isDeclared(const std::string& expr);
 
@@ -113,6 +119,9 @@ protected:
 	JSValueRef getDataAsValue(const Data& data);
 	Data getValueAsData(const JSValueRef value);
 	JSValueRef evalAsValue(const std::string& expr, bool dontThrow = false);
+	JSStringRef getScript(const std::string& expr);
+	JSObjectRef getCondition(const std::string& expr);
+	void clearScripts();
 
 	void handleException(JSValueRef exception);
 
@@ -124,6 +133,17 @@ protected:
 	Event _event;
 	JSGlobalContextRef _ctx;
 
+	std::map<std::string, JSStringRef> _scripts;
+	std::map<std::string, JSObjectRef> _conditions; ///< NULL for conditions that are no plain expressions
+	bool _cacheScripts;
+
+	struct ContextGroup {
+		JSContextGroupRef group;
+		size_t users;
+	};
+	std::string _documentId;
+	static std::map<std::string, ContextGroup> _contextGroups; ///< one per document content
+
 	static std::mutex _initMutex;
 
 };
@@ -25,6 +25,7 @@
 #include "uscxml/Common.h"
 #include "uscxml/util/URL.h"
 #include "uscxml/util/String.h"
+#include "uscxml/util/Convenience.h"
 
 #include "V8DataModel.h"
 
@@ -74,7 +75,7 @@ bool pluginConnect(pluma::Host& host) {
 }
 #endif
 
-V8DataModel::V8DataModel() {
+V8DataModel::V8DataModel() : _cacheScripts(true) {
 //  _contexts.push_back(v8::Context::New());
 }
 
@@ -153,6 +154,7 @@ v8::Handle<v8::Value> V8DataModel::jsExtension(const v8::Arguments& args) {
 }
 
 std::mutex V8DataModel::_initMutex;
+std::map<std::string, v8::Persistent<v8::Script> > V8DataModel::_scriptCache;
 
 //v8::Isolate* V8DataModel::_isolate = NULL;
 
@@ -183,6 +185,8 @@ void V8DataModel::setup() {
 	// TODO: we cannot use one isolate per thread as swig's type will be unknown :(
 	// We could register them by hand and avoid the _export_ globals in swig?
 
+	_cacheScripts = !envVarIsTrue("USCXML_NOCACHE_V8_SCRIPTS");
+
 	v8::Locker locker;
 	v8::HandleScope scope;
 
@@ -653,8 +657,7 @@ bool V8DataModel::isValidSyntax(const std::string& expr) {
 	v8::TryCatch tryCatch;
 	v8::Context::Scope contextScope(_context);
 
-	v8::Handle<v8::String> source = v8::String::New(expr.c_str());
-	v8::Handle<v8::Script> script = v8::Script::Compile(source);
+	v8::Handle<v8::Script> script = getScript(expr);
 
 	if (script.IsEmpty() || tryCatch.HasCaught()) {
 		return false;
@@ -717,8 +720,7 @@ bool V8DataModel::isDeclared(const std::string& expr) {
 	v8::HandleScope scope();
 	v8::Context::Scope contextScope(_context); // segfaults at newinstance without!
 
-	v8::Local<v8::String> source = v8::String::New(expr.c_str());
-	v8::Local<v8::Script> script = v8::Script::Compile(source);
+	v8::Local<v8::Script> script = getScript(expr);
 
 	v8::Local<v8::Value> result;
 	if (!script.IsEmpty())
@@ -740,6 +742,26 @@ bool V8DataModel::evalAsBool(const std::string& expr) {
 }
 
 
+void V8DataModel::evalAsBoolBatch(const std::vector<std::string>& exprs,
+                                  std::vector<bool>& result,
+                                  std::vector<ErrorEvent>& errors) {
+	// enter the isolate and context once for all guards
+	v8::Locker locker;
+	v8::HandleScope handleScope;
+	v8::Context::Scope contextScope(_context);
+
+	result.assign(exprs.size(), false);
+	errors.assign(exprs.size(), ErrorEvent());
+	for (size_t i = 0; i < exprs.size(); i++) {
+		try {
+			v8::Handle<v8::Value> value = evalAsValue(exprs[i]);
+			result[i] = value->ToBoolean()->BooleanValue();
+		} catch (ErrorEvent e) {
+			errors[i] = e;
+		}
+	}
+}
+
 void V8DataModel::assign(const std::string& location, const Data& data, const std::map<std::string, std::string>& attr) {
 
 	v8::Locker locker;
@@ -800,8 +822,7 @@ v8::Handle<v8::Value> V8DataModel::evalAsValue(const std::string& expr, bool don
 
 	v8::TryCatch tryCatch;
 
-	v8::Local<v8::String> source = v8::String::New(expr.c_str());
-	v8::Local<v8::Script> script = v8::Script::Compile(source);
+	v8::Local<v8::Script> script = getScript(expr);
 
 	v8::Local<v8::Value> result;
 	if (!script.IsEmpty())
@@ -816,6 +837,33 @@ v8::Handle<v8::Value> V8DataModel::evalAsValue(const std::string& expr, bool don
 	return result;
 }
 
+v8::Local<v8::Script> V8DataModel::getScript(const std::string& expr) {
+	if (_cacheScripts) {
+		std::map<std::string, v8::Persistent<v8::Script> >::iterator scriptIter = _scriptCache.find(expr);
+		if (scriptIter != _scriptCache.end())
+			return v8::Local<v8::Script>::New(scriptIter->second);
+	}
+
+	// a context independent script will bind to the context it is run in
+	v8::Local<v8::String> source = v8::String::New(expr.c_str());
+	v8::Local<v8::Script> script = v8::Script::New(source);
+
+	if (!_cacheScripts || script.IsEmpty())
+		return script;
+
+	// all instances share the default isolate, guarded by its locker
+	if (_scriptCache.size() >= USCXML_V8_MAX_CACHED_SCRIPTS) {
+		std::map<std::string, v8::Persistent<v8::Script> >::iterator scriptIter = _scriptCache.begin();
+		while(scriptIter != _scriptCache.end()) {
+			scriptIter->second.Dispose();
+			scriptIter++;
+		}
+		_scriptCache.clear();
+	}
+	_scriptCache[expr] = v8::Persistent<v8::Script>::New(script);
+	return script;
+}
+
 void V8DataModel::throwExceptionEvent(const v8::TryCatch& tryCatch) {
 	assert(tryCatch.HasCaught());
 	ErrorEvent exceptionEvent;
@@ -24,6 +24,7 @@
 #include "uscxml/plugins/DataModelImpl.h"
 
 #include <list>
+#include <map>
 #include <set>
 #include <v8.h>
 #include <mutex>
@@ -32,6 +33,8 @@
 #include "uscxml/plugins/Plugins.h"
 #endif
 
+#define USCXML_V8_MAX_CACHED_SCRIPTS 4096
+
 namespace uscxml {
 class Event;
 class Data;
@@ -71,6 +74,9 @@ public:
 	                        uint32_t iteration);
 
 	virtual bool evalAsBool(const std::string& expr);
+	virtual void evalAsBoolBatch(const std::vector<std::string>& exprs,
+	                             std::vector<bool>& result,
+	                             std::vector<ErrorEvent>& errors);
 	virtual Data evalAsData(const std::string& expr);
 	virtual Data getAsData(const std::string& content);
 
@@ -103,6 +109,7 @@ protected:
 	static void setWithException(v8::Local<v8::String> property, v8::Local<v8::Value> value, const v8::AccessorInfo& info);
 
 	v8::Handle<v8::Value> evalAsValue(const std::string& expr, bool dontThrow = false);
+	v8::Local<v8::Script> getScript(const std::string& expr);
 	v8::Handle<v8::Value> getDataAsValue(const Data& data);
 	Data getValueAsData(const v8::Handle<v8::Value>& value);
 	v8::Handle<v8::Value> getNodeAsValue(const XERCESC_NS::DOMNode* node);
@@ -110,6 +117,10 @@ protected:
 
 	std::set<DataModelExtension*> _extensions;
 
+	/// context independent scripts per expression, shared by all instances
+	static std::map<std::string, v8::Persistent<v8::Script> > _scriptCache;
+	bool _cacheScripts;
+
 private:
 	Data getValueAsData(const v8::Handle<v8::Value>& value, std::set<v8::Value*>& alreadySeen);
 
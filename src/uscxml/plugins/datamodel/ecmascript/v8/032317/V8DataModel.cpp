@@ -27,6 +27,7 @@
 #include "uscxml/Common.h"
 #include "uscxml/util/URL.h"
 #include "uscxml/util/String.h"
+#include "uscxml/util/Convenience.h"
 
 #include "V8DataModel.h"
 
@@ -77,7 +78,7 @@ bool pluginConnect(pluma::Host& host) {
 }
 #endif
 
-V8DataModel::V8DataModel() {
+V8DataModel::V8DataModel() : _cacheScripts(true) {
 //  _contexts.push_back(v8::Context::New());
 }
 
@@ -156,6 +157,7 @@ void V8DataModel::jsExtension(const v8::FunctionCallbackInfo<v8::Value>& info) {
 }
 
 std::mutex V8DataModel::_initMutex;
+std::map<std::string, v8::Persistent<v8::Script, v8::CopyablePersistentTraits<v8::Script> > > V8DataModel::_scriptCache;
 
 v8::Isolate* V8DataModel::_isolate = NULL;
 
@@ -186,10 +188,16 @@ std::shared_ptr<DataModelImpl> V8DataModel::create(DataModelCallbacks* callbacks
 void V8DataModel::setup() {
 	// TODO: we cannot use one isolate per thread as swig's type will be unknown :(
 	// We could register them by hand and avoid the _export_ globals in swig?
-	if (_isolate == NULL) {
-		_isolate = v8::Isolate::New();
+	{
+		// all sessions get their own context on the one isolate, sessions are created from many threads
+		std::lock_guard<std::mutex> lock(_initMutex);
+		if (_isolate == NULL) {
+			_isolate = v8::Isolate::New();
+		}
 	}
 
+	_cacheScripts = !envVarIsTrue("USCXML_NOCACHE_V8_SCRIPTS");
+
 	v8::Locker locker(_isolate);
 	v8::Isolate::Scope isoScope(_isolate);
 
@@ -669,12 +677,7 @@ bool V8DataModel::isValidSyntax(const std::string& expr) {
 
 	v8::TryCatch tryCatch;
 
-	v8::Local<v8::String> source = v8::String::New(expr.c_str());
-	if (tryCatch.HasCaught() || source.IsEmpty()) {
-		return false;
-	}
-
-	v8::Local<v8::Script> script = v8::Script::Compile(source);
+	v8::Local<v8::Script> script = getScript(expr);
 	if (tryCatch.HasCaught() || script.IsEmpty()) {
 		return false;
 	}
@@ -739,8 +742,7 @@ bool V8DataModel::isDeclared(const std::string& expr) {
 	v8::Local<v8::Context> ctx = v8::Local<v8::Context>::New(_isolate, _context);
 	v8::Context::Scope contextScope(ctx); // segfaults at newinstance without!
 
-	v8::Local<v8::String> source = v8::String::New(expr.c_str());
-	v8::Local<v8::Script> script = v8::Script::Compile(source);
+	v8::Local<v8::Script> script = getScript(expr);
 
 	v8::Local<v8::Value> result;
 	if (!script.IsEmpty())
@@ -765,6 +767,29 @@ bool V8DataModel::evalAsBool(const std::string& expr) {
 }
 
 
+void V8DataModel::evalAsBoolBatch(const std::vector<std::string>& exprs,
+                                  std::vector<bool>& result,
+                                  std::vector<ErrorEvent>& errors) {
+	// enter the isolate and context once for all guards
+	v8::Locker locker(_isolate);
+	v8::Isolate::Scope isoScope(_isolate);
+
+	v8::HandleScope scope(_isolate);
+	v8::Local<v8::Context> ctx = v8::Local<v8::Context>::New(_isolate, _context);
+	v8::Context::Scope contextScope(ctx);
+
+	result.assign(exprs.size(), false);
+	errors.assign(exprs.size(), ErrorEvent());
+	for (size_t i = 0; i < exprs.size(); i++) {
+		try {
+			v8::Local<v8::Value> value = evalAsValue(exprs[i]);
+			result[i] = value->ToBoolean()->BooleanValue();
+		} catch (ErrorEvent e) {
+			errors[i] = e;
+		}
+	}
+}
+
 void V8DataModel::assign(const std::string& location, const Data& data, const std::map<std::string, std::string>& attr) {
 
 	v8::Locker locker(_isolate);
@@ -835,8 +860,7 @@ v8::Local<v8::Value> V8DataModel::evalAsValue(const std::string& expr, bool dont
 
 	v8::TryCatch tryCatch;
 
-	v8::Local<v8::String> source = v8::String::New(expr.c_str());
-	v8::Local<v8::Script> script = v8::Script::Compile(source);
+	v8::Local<v8::Script> script = getScript(expr);
 
 	v8::Local<v8::Value> result;
 	if (!script.IsEmpty())
@@ -851,6 +875,33 @@ v8::Local<v8::Value> V8DataModel::evalAsValue(const std::string& expr, bool dont
 	return result;
 }
 
+v8::Local<v8::Script> V8DataModel::getScript(const std::string& expr) {
+	if (_cacheScripts) {
+		std::map<std::string, v8::Persistent<v8::Script, v8::CopyablePersistentTraits<v8::Script> > >::iterator scriptIter = _scriptCache.find(expr);
+		if (scriptIter != _scriptCache.end())
+			return v8::Local<v8::Script>::New(_isolate, scriptIter->second);
+	}
+
+	// a context independent script will bind to the context it is run in
+	v8::Local<v8::String> source = v8::String::New(expr.c_str());
+	v8::Local<v8::Script> script = v8::Script::New(source);
+
+	if (!_cacheScripts || script.IsEmpty())
+		return script;
+
+	// all instances share the one isolate, guarded by its locker
+	if (_scriptCache.size() >= USCXML_V8_MAX_CACHED_SCRIPTS) {
+		std::map<std::string, v8::Persistent<v8::Script, v8::CopyablePersistentTraits<v8::Script> > >::iterator scriptIter = _scriptCache.begin();
+		while(scriptIter != _scriptCache.end()) {
+			scriptIter->second.Reset();
+			scriptIter++;
+		}
+		_scriptCache.clear();
+	}
+	_scriptCache[expr].Reset(_isolate, script);
+	return script;
+}
+
 void V8DataModel::throwExceptionEvent(const v8::TryCatch& tryCatch) {
 	assert(tryCatch.HasCaught());
 	ErrorEvent exceptionEvent;
@@ -24,6 +24,7 @@
 #include "uscxml/plugins/DataModelImpl.h"
 
 #include <list>
+#include <map>
 #include <set>
 #include <v8.h>
 
@@ -31,6 +32,8 @@
 #include "uscxml/plugins/Plugins.h"
 #endif
 
+#define USCXML_V8_MAX_CACHED_SCRIPTS 4096
+
 namespace uscxml {
 class Event;
 class Data;
@@ -70,6 +73,9 @@ public:
 	                        uint32_t iteration);
 
 	virtual bool evalAsBool(const std::string& expr);
+	virtual void evalAsBoolBatch(const std::vector<std::string>& exprs,
+	                             std::vector<bool>& result,
+	                             std::vector<ErrorEvent>& errors);
 	virtual Data evalAsData(const std::string& expr);
 	virtual Data getAsData(const std::string& content);
 
@@ -91,7 +97,7 @@ protected:
 
 	//v8::Local<v8::Object> _event; // Persistent events leak ..
 	v8::Persistent<v8::Context> _context;
-	static v8::Isolate* _isolate;
+	static v8::Isolate* _isolate; ///< shared by all instances, swig keeps its class templates in globals
 
 	v8::Persistent<v8::Object> _ioProcessors;
 	v8::Persistent<v8::Object> _invokers;
@@ -104,6 +110,7 @@ protected:
 	                             const v8::PropertyCallbackInfo<void>& info);
 
 	v8::Local<v8::Value> evalAsValue(const std::string& expr, bool dontThrow = false);
+	v8::Local<v8::Script> getScript(const std::string& expr);
 	v8::Local<v8::Value> getDataAsValue(const Data& data);
 	Data getValueAsData(const v8::Local<v8::Value>& value);
 	v8::Local<v8::Value> getNodeAsValue(const XERCESC_NS::DOMNode* node);
@@ -111,6 +118,10 @@ protected:
 
 	std::set<DataModelExtension*> _extensions;
 
+	/// context independent scripts per expression, shared by all instances
+	static std::map<std::string, v8::Persistent<v8::Script, v8::CopyablePersistentTraits<v8::Script> > > _scriptCache;
+	bool _cacheScripts;
+
 private:
 	Data getValueAsData(const v8::Local<v8::Value>& value, std::set<v8::Value*>& alreadySeen);
 
@@ -43,6 +43,8 @@
 
 #include "uscxml/interpreter/Logging.h"
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <sstream>
 
 //#include "LuaDOM.cpp.inc" // TODO: activate XercesC bindings for test 530
 
@@ -86,8 +88,382 @@ static int luaEval(lua_State* luaState, const std::string& expr) {
 	return postStack - preStack;
 }
 
+/**
+ * With USCXML_LUA_DATA_PROXIES set, compound and array Data is not converted
+ * into Lua tables but exposed via userdata proxies that index and iterate the
+ * Data tree in place. All proxies into a tree share its root. The tree of
+ * _event.data borrows the event's own data, the first write copies it and
+ * releaseEvent() takes it over before the event is replaced.
+ */
+#define LUA_DATA_PROXY_META "uscxml.DataProxy"
+
+struct LuaDataTree {
+	std::shared_ptr<Data> root;
+	bool borrowed = false; // root is owned by someone else, e.g. the current event
+	uint64_t generation = 0;
+	// std::list has no random access, cache item pointers for indexed reads
+	std::map<const Data*, std::vector<const Data*> > arrayIndex;
+};
+
+struct LuaDataProxy {
+	std::shared_ptr<LuaDataTree> tree;
+	std::vector<std::string> path; // keys from the root, array items by 1-based index
+	Data* node;
+	uint64_t generation;
+};
+
+static Data getLuaAsData(lua_State* _luaState, const luabridge::LuaRef& lua);
+static int luaDataPush(lua_State* luaState, const std::shared_ptr<LuaDataTree>& tree, const std::vector<std::string>& path, const Data& data);
+
+static LuaDataProxy* toDataProxy(lua_State* luaState, int index) {
+	if (index < 0 && index > LUA_REGISTRYINDEX)
+		index = lua_gettop(luaState) + index + 1;
+
+	void* ud = lua_touserdata(luaState, index);
+	if (ud == NULL || !lua_getmetatable(luaState, index))
+		return NULL;
+	luaL_getmetatable(luaState, LUA_DATA_PROXY_META);
+	bool isProxy = lua_rawequal(luaState, -1, -2);
+	lua_pop(luaState, 2);
+	return (isProxy ? (LuaDataProxy*)ud : NULL);
+}
+
+static LuaDataProxy* checkDataProxy(lua_State* luaState, int index) {
+	LuaDataProxy* proxy = toDataProxy(luaState, index);
+	if (proxy == NULL)
+		luaL_error(luaState, "Expected a data proxy");
+	return proxy;
+}
+
+static bool luaIsIndex(lua_State* luaState, int index, long& value) {
+	if (lua_type(luaState, index) != LUA_TNUMBER)
+		return false;
+	lua_Number number = lua_tonumber(luaState, index);
+	value = (long)number;
+	return ((lua_Number)value == number && value > 0);
+}
+
+static std::string luaKeyAsString(lua_State* luaState, int index) {
+	long value;
+	if (luaIsIndex(luaState, index, value))
+		return toStr(value);
+	if (lua_type(luaState, index) == LUA_TSTRING)
+		return lua_tostring(luaState, index);
+	if (lua_type(luaState, index) == LUA_TNUMBER)
+		return toStr(lua_tonumber(luaState, index));
+	luaL_error(luaState, "Unsupported key type %s for data proxy", luaL_typename(luaState, index));
+	return "";
+}
+
+static Data* resolveDataProxy(LuaDataProxy* proxy) {
+	if (proxy->generation == proxy->tree->generation)
+		return proxy->node;
+
+	// tree was copied or its structure changed, walk down from the root again
+	Data* node = proxy->tree->root.get();
+	for (auto key : proxy->path) {
+		if (!node->array.empty()) {
+			size_t index = strTo<size_t>(key);
+			if (index == 0 || index > node->array.size()) {
+				node = NULL;
+				break;
+			}
+			std::list<Data>::iterator arrayIter = node->array.begin();
+			std::advance(arrayIter, index - 1);
+			node = &(*arrayIter);
+		} else {
+			std::map<std::string, Data>::iterator compoundIter = node->compound.find(key);
+			if (compoundIter == node->compound.end()) {
+				node = NULL;
+				break;
+			}
+			node = &compoundIter->second;
+		}
+	}
+	proxy->node = node;
+	proxy->generation = proxy->tree->generation;
+	return node;
+}
+
+static const Data* dataProxyItem(LuaDataTree* tree, const Data* node, size_t index) {
+	if (index == 0 || index > node->array.size())
+		return NULL;
+
+	std::vector<const Data*>& items = tree->arrayIndex[node];
+	if (items.size() != node->array.size()) {
+		items.clear();
+		items.reserve(node->array.size());
+		for (auto& item : node->array) {
+			items.push_back(&item);
+		}
+	}
+	return items[index - 1];
+}
+
+static void touchDataTree(LuaDataTree* tree) {
+	tree->generation++;
+	tree->arrayIndex.clear();
+}
+
+static int luaDataProxyIndex(lua_State* luaState) {
+	LuaDataProxy* proxy = checkDataProxy(luaState, 1);
+	const Data* node = resolveDataProxy(proxy);
+	if (node == NULL) {
+		lua_pushnil(luaState);
+		return 1;
+	}
+
+	const Data* child = NULL;
+	std::string key;
+	if (!node->array.empty()) {
+		long index;
+		if (luaIsIndex(luaState, 2, index)) {
+			child = dataProxyItem(proxy->tree.get(), node, index);
+			key = toStr(index);
+		}
+	} else if (lua_type(luaState, 2) == LUA_TSTRING || lua_type(luaState, 2) == LUA_TNUMBER) {
+		key = luaKeyAsString(luaState, 2);
+		std::map<std::string, Data>::const_iterator compoundIter = node->compound.find(key);
+		if (compoundIter != node->compound.end())
+			child = &compoundIter->second;
+	}
+
+	if (child == NULL) {
+		lua_pushnil(luaState);
+		return 1;
+	}
+
+	std::vector<std::string> path(proxy->path);
+	path.push_back(key);
+	return luaDataPush(luaState, proxy->tree, path, *child);
+}
+
+static int luaDataProxyNewIndex(lua_State* luaState) {
+	LuaDataProxy* proxy = checkDataProxy(luaState, 1);
+	LuaDataTree* tree = proxy->tree.get();
+
+	if (tree->borrowed || tree->root.use_count() > 1) {
+		// copy on write, all proxies into this tree will see the copy
+		tree->root = std::make_shared<Data>(*tree->root);
+		tree->borrowed = false;
+		touchDataTree(tree);
+	}
+
+	Data* node = resolveDataProxy(proxy);
+	if (node == NULL)
+		return luaL_error(luaState, "Data proxy refers to a removed element");
+
+	bool isNil = lua_isnil(luaState, 3);
+	Data value;
+	if (!isNil) {
+		LuaDataProxy* other = toDataProxy(luaState, 3);
+		if (other != NULL) {
+			const Data* otherNode = resolveDataProxy(other);
+			if (otherNode != NULL)
+				value = *otherNode;
+		} else {
+			value = getLuaAsData(luaState, luabridge::LuaRef::fromStack(luaState, 3));
+		}
+	}
+
+	long index;
+	if (node->compound.empty() && luaIsIndex(luaState, 2, index)) {
+		// keep array semantics as long as all keys are indices
+		if ((size_t)index <= node->array.size()) {
+			std::list<Data>::iterator arrayIter = node->array.begin();
+			std::advance(arrayIter, index - 1);
+			if (isNil && (size_t)index == node->array.size()) {
+				node->array.pop_back();
+			} else if (isNil) {
+				*arrayIter = Data("nil", Data::INTERPRETED);
+			} else {
+				*arrayIter = value;
+			}
+		} else if (!isNil) {
+			while (node->array.size() + 1 < (size_t)index) {
+				node->array.push_back(Data("nil", Data::INTERPRETED));
+			}
+			node->array.push_back(value);
+		}
+	} else {
+		std::string key = luaKeyAsString(luaState, 2);
+		if (!node->array.empty()) {
+			// there are some non-numeric indices -> map
+			size_t arrayIndex = 1;
+			for (auto& item : node->array) {
+				node->compound[toStr(arrayIndex++)] = item;
+			}
+			node->array.clear();
+		}
+		if (isNil) {
+			node->compound.erase(key);
+		} else {
+			node->compound[key] = value;
+		}
+	}
+
+	touchDataTree(tree);
+	return 0;
+}
+
+static int luaDataProxyLength(lua_State* luaState) {
+	LuaDataProxy* proxy = checkDataProxy(luaState, 1);
+	const Data* node = resolveDataProxy(proxy);
+
+	size_t length = 0;
+	if (node != NULL) {
+		if (!node->array.empty()) {
+			length = node->array.size();
+		} else {
+			// border of the sequence part as with tables
+			while (node->compound.find(toStr(length + 1)) != node->compound.end())
+				length++;
+		}
+	}
+	lua_pushnumber(luaState, (lua_Number)length);
+	return 1;
+}
+
+static int luaDataProxyNext(lua_State* luaState) {
+	LuaDataProxy* proxy = checkDataProxy(luaState, 1);
+	const Data* node = resolveDataProxy(proxy);
+	if (node == NULL) {
+		lua_pushnil(luaState);
+		return 1;
+	}
+
+	std::vector<std::string> path(proxy->path);
+	if (!node->array.empty()) {
+		long index = 0;
+		if (!lua_isnil(luaState, 2) && !luaIsIndex(luaState, 2, index))
+			return luaL_error(luaState, "Invalid key to 'next'");
+		const Data* item = dataProxyItem(proxy->tree.get(), node, index + 1);
+		if (item == NULL) {
+			lua_pushnil(luaState);
+			return 1;
+		}
+		lua_pushnumber(luaState, (lua_Number)(index + 1));
+		path.push_back(toStr(index + 1));
+		return 1 + luaDataPush(luaState, proxy->tree, path, *item);
+	}
+
+	std::map<std::string, Data>::const_iterator compoundIter;
+	if (lua_isnil(luaState, 2)) {
+		compoundIter = node->compound.begin();
+	} else {
+		compoundIter = node->compound.upper_bound(luaKeyAsString(luaState, 2));
+	}
+	if (compoundIter == node->compound.end()) {
+		lua_pushnil(luaState);
+		return 1;
+	}
+
+	// it makes a difference whether we pass a numeric string or a proper number!
+	if (isInteger(compoundIter->first.c_str(), 10) && strTo<long>(compoundIter->first) > 0) {
+		lua_pushnumber(luaState, (lua_Number)strTo<long>(compoundIter->first));
+	} else {
+		lua_pushstring(luaState, compoundIter->first.c_str());
+	}
+	path.push_back(compoundIter->first);
+	return 1 + luaDataPush(luaState, proxy->tree, path, compoundIter->second);
+}
+
+static int luaDataProxyPairs(lua_State* luaState) {
+	checkDataProxy(luaState, 1);
+	lua_pushcfunction(luaState, luaDataProxyNext);
+	lua_pushvalue(luaState, 1);
+	lua_pushnil(luaState);
+	return 3;
+}
+
+static int luaDataProxyINext(lua_State* luaState) {
+	long index = (long)lua_tonumber(luaState, 2) + 1;
+	lua_pushnumber(luaState, (lua_Number)index);
+	lua_pushnumber(luaState, (lua_Number)index);
+	lua_gettable(luaState, 1);
+	if (lua_isnil(luaState, -1))
+		return 1;
+	return 2;
+}
+
+static int luaDataProxyIPairs(lua_State* luaState) {
+	checkDataProxy(luaState, 1);
+	lua_pushcfunction(luaState, luaDataProxyINext);
+	lua_pushvalue(luaState, 1);
+	lua_pushnumber(luaState, 0);
+	return 3;
+}
+
+static int luaDataProxyEquals(lua_State* luaState) {
+	LuaDataProxy* proxy1 = toDataProxy(luaState, 1);
+	LuaDataProxy* proxy2 = toDataProxy(luaState, 2);
+	lua_pushboolean(luaState, proxy1 != NULL && proxy2 != NULL &&
+	                proxy1->tree == proxy2->tree &&
+	                resolveDataProxy(proxy1) == resolveDataProxy(proxy2));
+	return 1;
+}
+
+static int luaDataProxyToString(lua_State* luaState) {
+	LuaDataProxy* proxy = checkDataProxy(luaState, 1);
+	const Data* node = resolveDataProxy(proxy);
+	lua_pushstring(luaState, (node != NULL ? Data::toJSON(*node).c_str() : "nil"));
+	return 1;
+}
+
+static int luaDataProxyGC(lua_State* luaState) {
+	LuaDataProxy* proxy = toDataProxy(luaState, 1);
+	if (proxy != NULL)
+		proxy->~LuaDataProxy();
+	return 0;
+}
+
+static void luaDataProxyRegister(lua_State* luaState) {
+	luaL_newmetatable(luaState, LUA_DATA_PROXY_META);
+
+	static const luaL_Reg metaMethods[] = {
+		{ "__index", luaDataProxyIndex },
+		{ "__newindex", luaDataProxyNewIndex },
+		{ "__len", luaDataProxyLength },
+		{ "__pairs", luaDataProxyPairs },
+		{ "__ipairs", luaDataProxyIPairs },
+		{ "__eq", luaDataProxyEquals },
+		{ "__tostring", luaDataProxyToString },
+		{ "__gc", luaDataProxyGC },
+		{ NULL, NULL }
+	};
+	for (const luaL_Reg* method = metaMethods; method->name != NULL; method++) {
+		lua_pushcfunction(luaState, method->func);
+		lua_setfield(luaState, -2, method->name);
+	}
+	lua_pop(luaState, 1);
+}
+
+static void luaDataProxyNew(lua_State* luaState, const std::shared_ptr<LuaDataTree>& tree, const std::vector<std::string>& path, const Data* node) {
+	void* ud = lua_newuserdata(luaState, sizeof(LuaDataProxy));
+	LuaDataProxy* proxy = new (ud) LuaDataProxy();
+	proxy->tree = tree;
+	proxy->path = path;
+	proxy->node = const_cast<Data*>(node);
+	proxy->generation = tree->generation;
+
+	luaL_getmetatable(luaState, LUA_DATA_PROXY_META);
+	lua_setmetatable(luaState, -2);
+}
+
 static Data getLuaAsData(lua_State* _luaState, const luabridge::LuaRef& lua) {
 	Data data;
+	if (lua.isUserdata()) {
+		lua.push(_luaState);
+		LuaDataProxy* proxy = toDataProxy(_luaState, -1);
+		lua_pop(_luaState, 1);
+		if (proxy != NULL) {
+			const Data* node = resolveDataProxy(proxy);
+			if (node != NULL)
+				data = *node;
+			return data;
+		}
+	}
+
 	if (lua.isFunction()) {
 		// we are creating __tmpFunc
 		// then it will be assigned to data variable
@@ -224,8 +600,47 @@ static luabridge::LuaRef getDataAsLua(lua_State* _luaState, const Data& data) {
 	return luabridge::LuaRef(_luaState);
 }
 
+static int luaDataPush(lua_State* luaState, const std::shared_ptr<LuaDataTree>& tree, const std::vector<std::string>& path, const Data& data) {
+	if (data.node || (data.compound.empty() && data.array.empty())) {
+		if (data.type == Data::INTERPRETED && data.node == NULL) {
+			// avoid the roundtrip through the interpreter for the common atoms
+			if (data.atom == "nil" || data.atom.empty()) {
+				lua_pushnil(luaState);
+				return 1;
+			}
+			if (data.atom == "true" || data.atom == "false") {
+				lua_pushboolean(luaState, data.atom == "true");
+				return 1;
+			}
+		}
+		getDataAsLua(luaState, data).push(luaState);
+		return 1;
+	}
+	luaDataProxyNew(luaState, tree, path, &data);
+	return 1;
+}
+
+/**
+ * Push compound and array data as a proxy, everything else as native values.
+ *
+ * Proxies are not tables for type(), table.* and, before Lua 5.2, pairs and
+ * ipairs. They are only used with USCXML_LUA_DATA_PROXIES set.
+ */
+static luabridge::LuaRef getDataAsLuaProxy(lua_State* luaState, const std::shared_ptr<LuaDataTree>& tree) {
+	const Data* data = tree->root.get();
+	if (data->node || (data->compound.empty() && data->array.empty()))
+		return getDataAsLua(luaState, *data);
+
+	luaDataProxyNew(luaState, tree, std::vector<std::string>(), data);
+
+	luabridge::LuaRef luaData = luabridge::LuaRef::fromStack(luaState, -1);
+	lua_pop(luaState, 1);
+	return luaData;
+}
+
 LuaDataModel::LuaDataModel() {
 	_luaState = NULL;
+	_dataProxies = false;
 }
 
 int LuaDataModel::luaInFunction(lua_State * l) {
@@ -258,6 +673,8 @@ void LuaDataModel::setup() {
 	luaL_openlibs(_luaState);
 
 	SWIG_init(_luaState);
+	luaDataProxyRegister(_luaState);
+	_dataProxies = envVarIsTrue("USCXML_LUA_DATA_PROXIES");
 
 #if 0
 	try {
@@ -318,6 +735,8 @@ void LuaDataModel::addExtension(DataModelExtension* ext) {
 }
 
 void LuaDataModel::setEvent(const Event& event) {
+	_eventTree.reset();
+
 	luabridge::LuaRef luaEvent(_luaState);
 	luaEvent = luabridge::newTable(_luaState);
 
@@ -358,25 +777,38 @@ void LuaDataModel::setEvent(const Event& event) {
 #endif
 	} else {
 		// _event.data is KVP
-		Data d = event.data;
+		std::shared_ptr<Data> d;
 
-		if (!event.params.empty()) {
+		if (!event.params.empty() || !event.namelist.empty()) {
+			d = std::make_shared<Data>(event.data);
 			Event::params_t::const_iterator paramIter = event.params.begin();
 			while(paramIter != event.params.end()) {
-				d.compound[paramIter->first] = paramIter->second;
+				d->compound[paramIter->first] = paramIter->second;
 				paramIter++;
 			}
-		}
-		if (!event.namelist.empty()) {
 			Event::namelist_t::const_iterator nameListIter = event.namelist.begin();
 			while(nameListIter != event.namelist.end()) {
-				d.compound[nameListIter->first] = nameListIter->second;
+				d->compound[nameListIter->first] = nameListIter->second;
 				nameListIter++;
 			}
 		}
 
-		if (!d.empty()) {
-			luabridge::LuaRef luaData = getDataAsLua(_luaState, d);
+		if (!(d ? d->empty() : event.data.empty())) {
+			luabridge::LuaRef luaData(_luaState);
+			if (_dataProxies) {
+				std::shared_ptr<LuaDataTree> tree(new LuaDataTree());
+				if (d) {
+					tree->root = d;
+				} else {
+					// no copy, the event stays with the interpreter until releaseEvent()
+					tree->root = std::shared_ptr<Data>(const_cast<Data*>(&event.data), [](Data*) {});
+					tree->borrowed = true;
+					_eventTree = tree;
+				}
+				luaData = getDataAsLuaProxy(_luaState, tree);
+			} else {
+				luaData = getDataAsLua(_luaState, (d ? *d : event.data));
+			}
 			assert(luaEvent.isTable());
 			// assert(luaData.isTable()); // not necessarily test179
 			luaEvent["data"] = luaData;
@@ -387,6 +819,25 @@ void LuaDataModel::setEvent(const Event& event) {
 
 }
 
+void LuaDataModel::releaseEvent(Event& event) {
+	if (!_eventTree)
+		return;
+
+	if (_eventTree->borrowed && _eventTree->root.get() == &event.data) {
+		// scripts might still refer to _event.data, take the containers over without copying their items
+		std::shared_ptr<Data> root = std::make_shared<Data>();
+		root->compound.swap(event.data.compound);
+		root->array.swap(event.data.array);
+		root->atom.swap(event.data.atom);
+		root->binary = event.data.binary;
+		root->type = event.data.type;
+		_eventTree->root = root;
+		_eventTree->borrowed = false;
+		touchDataTree(_eventTree.get());
+	}
+	_eventTree.reset();
+}
+
 Data LuaDataModel::evalAsData(const std::string& content) {
 	Data data;
 
@@ -471,7 +922,13 @@ void LuaDataModel::setForeach(const std::string& item,
 	iteration++; // test153: arrays start at 1
 
 	const luabridge::LuaRef& arrRef = luabridge::getGlobal(_luaState, array.c_str());
-	if (arrRef.isTable()) {
+	bool isProxy = false;
+	if (arrRef.isUserdata()) {
+		arrRef.push(_luaState);
+		isProxy = (toDataProxy(_luaState, -1) != NULL);
+		lua_pop(_luaState, 1);
+	}
+	if (arrRef.isTable() || isProxy) {
 
 		// triggers syntax error for invalid items, test 152
 		int retVals = luaEval(_luaState, item + " = " + array + "[" + toStr(iteration) + "]");
@@ -519,10 +976,19 @@ void LuaDataModel::assign(const std::string& location, const Data& data, const s
 	} else {
 
 
-		luabridge::LuaRef lua = getDataAsLua(_luaState, data);
+		luabridge::LuaRef lua(_luaState);
+		if (_dataProxies) {
+			// the value stays with the caller, keep a copy
+			std::shared_ptr<LuaDataTree> tree(new LuaDataTree());
+			tree->root = std::make_shared<Data>(data);
+			lua = getDataAsLuaProxy(_luaState, tree);
+		} else {
+			lua = getDataAsLua(_luaState, data);
+		}
 
 		luabridge::setGlobal(_luaState, lua, "__tmpAssign");
 		eval(location + "= __tmpAssign");
+		luabridge::setGlobal(_luaState, luabridge::Nil(), "__tmpAssign");
 
 
 //        LOG(_callbacks->getLogger(), USCXML_INFO) << Data::toJSON(evalAsData(location)) << std::endl;
@@ -550,6 +1016,57 @@ bool LuaDataModel::evalAsBool(const std::string& expr) {
 	return false;
 }
 
+void LuaDataModel::evalAsBoolBatch(const std::vector<std::string>& exprs,
+                                   std::vector<bool>& result,
+                                   std::vector<ErrorEvent>& errors) {
+	result.assign(exprs.size(), false);
+	errors.assign(exprs.size(), ErrorEvent());
+
+	for (size_t start = 0; start < exprs.size(); start += USCXML_LUA_MAX_BATCHED_GUARDS) {
+		size_t end = (std::min)(exprs.size(), start + USCXML_LUA_MAX_BATCHED_GUARDS);
+
+		// return all guards from a single chunk, evaluated left to right and each
+		// protected on its own, a guard that raised an error returns its message
+		std::stringstream ss;
+		ss << "local function __guard(f) local ok, v = pcall(f); if ok then return v and true or false end; return tostring(v) end\n";
+		std::string seperator = "return ";
+		for (size_t i = start; i < end; i++) {
+			ss << seperator << "__guard(function() return (" << boost::trim_copy(exprs[i]) << "\n) end)";
+			seperator = ",\n";
+		}
+
+		int retVals = 0;
+		try {
+			retVals = luaEval(_luaState, ss.str());
+		} catch (ErrorEvent e) {
+			// a syntax error in one of the guards, none of them was evaluated
+		}
+
+		if (retVals == (int)(end - start)) {
+			for (size_t i = start; i < end; i++) {
+				int index = (int)i - (int)end;
+				if (lua_type(_luaState, index) == LUA_TSTRING) {
+					ERROR_EXECUTION(error, lua_tostring(_luaState, index));
+					errors[i] = error;
+				} else {
+					result[i] = lua_toboolean(_luaState, index);
+				}
+			}
+			lua_pop(_luaState, retVals);
+			continue;
+		}
+		lua_pop(_luaState, retVals);
+
+		for (size_t i = start; i < end; i++) {
+			try {
+				result[i] = evalAsBool(exprs[i]);
+			} catch (ErrorEvent e) {
+				errors[i] = e;
+			}
+		}
+	}
+}
+
 Data LuaDataModel::getAsData(const std::string& content) {
 	Data data;
 	std::string trimmedExpr = boost::trim_copy(content);
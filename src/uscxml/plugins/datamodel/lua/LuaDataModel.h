@@ -23,6 +23,7 @@
 #include "uscxml/config.h"
 #include "uscxml/plugins/DataModelImpl.h"
 #include <list>
+#include <memory>
 
 extern "C" {
 #include "lua.h"
@@ -34,10 +35,13 @@ extern "C" {
 #include "uscxml/plugins/Plugins.h"
 #endif
 
+/// Guards returned from a single chunk, Lua functions are limited to ~250 registers
+#define USCXML_LUA_MAX_BATCHED_GUARDS 64
 
 namespace uscxml {
 class Event;
 class Data;
+struct LuaDataTree;
 }
 
 namespace uscxml {
@@ -65,6 +69,7 @@ public:
 	virtual bool isLegalDataValue(const std::string& expr);
 
 	virtual void setEvent(const Event& event);
+	virtual void releaseEvent(Event& event);
 
 	// foreach
 	virtual uint32_t getLength(const std::string& expr);
@@ -74,6 +79,9 @@ public:
 	                        uint32_t iteration);
 
 	virtual bool evalAsBool(const std::string& expr);
+	virtual void evalAsBoolBatch(const std::vector<std::string>& exprs,
+	                             std::vector<bool>& result,
+	                             std::vector<ErrorEvent>& errors);
 	virtual Data evalAsData(const std::string& expr);
 	virtual void eval(const std::string& content);
 	virtual Data getAsData(const std::string& content);
@@ -93,6 +101,8 @@ protected:
 	static int luaInFunction(lua_State * l);
 
 	lua_State* _luaState;
+	std::shared_ptr<LuaDataTree> _eventTree; // proxies borrowing the current event's data
+	bool _dataProxies; // compound and array data as userdata instead of tables
 };
 
 #ifdef BUILD_AS_PLUGINS
@@ -0,0 +1,1115 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#include "uscxml/Common.h"
+#include "uscxml/util/String.h"
+#include "uscxml/util/Convenience.h"
+#include "NativeDataModel.h"
+
+#include "uscxml/messages/Event.h"
+#ifndef NO_XERCESC
+#include "uscxml/util/DOM.h"
+#endif
+#include "uscxml/interpreter/Logging.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+
+#ifdef BUILD_AS_PLUGINS
+#include <Pluma/Connector.hpp>
+#endif
+
+#define INVALID_ASSIGNMENT(name) \
+name.compare("_sessionid") == 0 || \
+name.compare("_name") == 0 || \
+name.compare("_ioprocessors") == 0 || \
+name.compare("_event") == 0
+
+namespace uscxml {
+
+#ifdef BUILD_AS_PLUGINS
+PLUMA_CONNECTOR
+bool pluginConnect(pluma::Host& host) {
+	host.add( new NativeDataModelProvider() );
+	return true;
+}
+#endif
+
+static bool isIdentifier(const std::string& name) {
+	if (name.size() == 0 || !(isalpha((unsigned char)name[0]) || name[0] == '_'))
+		return false;
+	for (size_t i = 1; i < name.size(); i++) {
+		if (!(isalnum((unsigned char)name[i]) || name[i] == '_'))
+			return false;
+	}
+	return true;
+}
+
+static inline void setInt(NativeDataModel::Value& value, int64_t integer) {
+	value.type = NativeDataModel::TYPE_INT;
+	value.integer = integer;
+}
+
+static inline void setBool(NativeDataModel::Value& value, bool boolean) {
+	value.type = NativeDataModel::TYPE_BOOL;
+	value.integer = (boolean ? 1 : 0);
+}
+
+// signed overflow is undefined, check before we calculate
+static inline bool addOverflows(int64_t a, int64_t b) {
+	return (b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b);
+}
+
+static inline bool subOverflows(int64_t a, int64_t b) {
+	return (b < 0 && a > INT64_MAX + b) || (b > 0 && a < INT64_MIN + b);
+}
+
+static inline bool mulOverflows(int64_t a, int64_t b) {
+	if (a == 0 || b == 0)
+		return false;
+	if (a > 0)
+		return (b > 0 ? a > INT64_MAX / b : b < INT64_MIN / a);
+	return (b > 0 ? a < INT64_MIN / b : b < INT64_MAX / a);
+}
+
+static bool valueEquals(const NativeDataModel::Value& a, const NativeDataModel::Value& b) {
+	if (a.type != b.type)
+		return false;
+
+	switch (a.type) {
+	case NativeDataModel::TYPE_INT:
+	case NativeDataModel::TYPE_BOOL:
+		return a.integer == b.integer;
+	case NativeDataModel::TYPE_STRING:
+		return a.string == b.string;
+	case NativeDataModel::TYPE_RECORD: {
+		if (a.record == b.record)
+			return true;
+		if (a.record->size() != b.record->size())
+			return false;
+		std::map<std::string, NativeDataModel::Value>::const_iterator aIter = a.record->begin();
+		std::map<std::string, NativeDataModel::Value>::const_iterator bIter = b.record->begin();
+		while(aIter != a.record->end()) {
+			if (aIter->first != bIter->first || !valueEquals(aIter->second, bIter->second))
+				return false;
+			aIter++;
+			bIter++;
+		}
+		return true;
+	}
+	default:
+		break;
+	}
+	return true;
+}
+
+/**
+ * Recursive descent parser emitting register bytecode, every sub-expression
+ * is evaluated into the register given and type-checked on the way.
+ */
+class NativeDataModel::Compiler {
+public:
+	Compiler(NativeDataModel* dm, const std::string& source, bool syntaxOnly) :
+		_dm(dm), _source(source), _pos(0), _token(TOK_END), _syntaxOnly(syntaxOnly), _program(new Program()) {}
+
+	std::shared_ptr<Program> compile() {
+		next();
+		if (_token == TOK_END)
+			fail("Empty expression");
+
+		_program->type = parseOr(0);
+		if (_token != TOK_END)
+			fail("Unexpected '" + _text + "'");
+		return _program;
+	}
+
+protected:
+	enum Token {
+		TOK_END,
+		TOK_INT,
+		TOK_IDENT,
+		TOK_STRING,
+		TOK_OP
+	};
+
+	void fail(const std::string& cause) {
+		ERROR_EXECUTION_THROW(cause + " in '" + _source + "'");
+	}
+
+	void next() {
+		while (_pos < _source.size() && isspace((unsigned char)_source[_pos]))
+			_pos++;
+
+		_text.clear();
+		if (_pos >= _source.size()) {
+			_token = TOK_END;
+			return;
+		}
+
+		char c = _source[_pos];
+		size_t start = _pos;
+
+		if (isdigit((unsigned char)c)) {
+			while (_pos < _source.size() && isdigit((unsigned char)_source[_pos]))
+				_pos++;
+			_text = _source.substr(start, _pos - start);
+			_token = TOK_INT;
+			return;
+		}
+
+		if (isalpha((unsigned char)c) || c == '_') {
+			while (_pos < _source.size() && (isalnum((unsigned char)_source[_pos]) || _source[_pos] == '_'))
+				_pos++;
+			_text = _source.substr(start, _pos - start);
+			_token = TOK_IDENT;
+
+			// logical operators are a pain to write in XML attributes
+			if (_text == "and") {
+				_text = "&&";
+				_token = TOK_OP;
+			} else if (_text == "or") {
+				_text = "||";
+				_token = TOK_OP;
+			} else if (_text == "not") {
+				_text = "!";
+				_token = TOK_OP;
+			}
+			return;
+		}
+
+		if (c == '\'' || c == '"') {
+			_pos++;
+			while (_pos < _source.size() && _source[_pos] != c) {
+				if (_source[_pos] == '\\' && _pos + 1 < _source.size()) {
+					_pos++;
+					switch (_source[_pos]) {
+					case 'n':
+						_text += '\n';
+						break;
+					case 't':
+						_text += '\t';
+						break;
+					default:
+						_text += _source[_pos];
+						break;
+					}
+				} else {
+					_text += _source[_pos];
+				}
+				_pos++;
+			}
+			if (_pos >= _source.size())
+				fail("Unterminated string");
+			_pos++;
+			_token = TOK_STRING;
+			return;
+		}
+
+		static const char* binaryOps[] = { "&&", "||", "==", "!=", "<=", ">=", NULL };
+		for (size_t i = 0; binaryOps[i] != NULL; i++) {
+			if (_source.compare(_pos, 2, binaryOps[i]) == 0) {
+				_text = binaryOps[i];
+				_pos += 2;
+				_token = TOK_OP;
+				return;
+			}
+		}
+
+		if (strchr("!<>+-*/%().", c) != NULL) {
+			_text = std::string(1, c);
+			_pos++;
+			_token = TOK_OP;
+			return;
+		}
+
+		fail("Unexpected character '" + std::string(1, c) + "'");
+	}
+
+	bool isOp(const char* op) {
+		return _token == TOK_OP && _text == op;
+	}
+
+	void expect(const char* op) {
+		if (!isOp(op))
+			fail("Expected '" + std::string(op) + "'");
+		next();
+	}
+
+	uint16_t use(size_t reg) {
+		if (reg >= 0xFFFF)
+			fail("Expression too complex");
+		if (reg + 1 > _program->registers)
+			_program->registers = reg + 1;
+		return (uint16_t)reg;
+	}
+
+	uint16_t constant(const Value& value) {
+		if (_program->constants.size() >= 0xFFFF)
+			fail("Expression too complex");
+		_program->constants.push_back(value);
+		return (uint16_t)(_program->constants.size() - 1);
+	}
+
+	size_t emit(OpCode op, uint16_t dst, uint16_t a = 0, uint16_t b = 0) {
+		Instruction instr;
+		instr.op = op;
+		instr.dst = dst;
+		instr.a = a;
+		instr.b = b;
+		_program->code.push_back(instr);
+		return _program->code.size() - 1;
+	}
+
+	void patchJump(size_t jump) {
+		if (_program->code.size() >= 0xFFFF)
+			fail("Expression too complex");
+		_program->code[jump].b = (uint16_t)_program->code.size();
+	}
+
+	void check(Type type, Type expected, const std::string& op) {
+		if (type != TYPE_ANY && type != expected)
+			fail("'" + op + "' expects " + typeToName(expected) + ", not " + typeToName(type));
+	}
+
+	void checkOrdered(Type lhs, Type rhs, const std::string& op) {
+		if ((lhs != TYPE_ANY && lhs != TYPE_INT && lhs != TYPE_STRING) ||
+		        (rhs != TYPE_ANY && rhs != TYPE_INT && rhs != TYPE_STRING) ||
+		        (lhs != TYPE_ANY && rhs != TYPE_ANY && lhs != rhs))
+			fail("'" + op + "' cannot be applied to " + typeToName(lhs) + " and " + typeToName(rhs));
+	}
+
+	void requireBool(Type type, uint16_t dst, const std::string& op) {
+		check(type, TYPE_BOOL, op);
+		if (type == TYPE_ANY)
+			emit(OP_BOOL, dst);
+	}
+
+	Type parseOr(uint16_t dst) {
+		Type type = parseAnd(dst);
+		while (isOp("||")) {
+			next();
+			requireBool(type, dst, "||");
+			size_t jump = emit(OP_JUMP_TRUE, dst, dst);
+			requireBool(parseAnd(dst), dst, "||");
+			patchJump(jump);
+			type = TYPE_BOOL;
+		}
+		return type;
+	}
+
+	Type parseAnd(uint16_t dst) {
+		Type type = parseEquality(dst);
+		while (isOp("&&")) {
+			next();
+			requireBool(type, dst, "&&");
+			size_t jump = emit(OP_JUMP_FALSE, dst, dst);
+			requireBool(parseEquality(dst), dst, "&&");
+			patchJump(jump);
+			type = TYPE_BOOL;
+		}
+		return type;
+	}
+
+	Type parseEquality(uint16_t dst) {
+		Type type = parseRelational(dst);
+		while (isOp("==") || isOp("!=")) {
+			std::string op = _text;
+			next();
+			Type rhs = parseRelational(use(dst + 1));
+			if (type != TYPE_ANY && rhs != TYPE_ANY && type != rhs)
+				fail("Cannot compare " + typeToName(type) + " and " + typeToName(rhs));
+			emit(op == "==" ? OP_EQ : OP_NE, dst, dst, dst + 1);
+			type = TYPE_BOOL;
+		}
+		return type;
+	}
+
+	Type parseRelational(uint16_t dst) {
+		Type type = parseAdditive(dst);
+		while (isOp("<") || isOp("<=") || isOp(">") || isOp(">=")) {
+			std::string op = _text;
+			next();
+			Type rhs = parseAdditive(use(dst + 1));
+			checkOrdered(type, rhs, op);
+			emit(op == "<" ? OP_LT : op == "<=" ? OP_LE : op == ">" ? OP_GT : OP_GE, dst, dst, dst + 1);
+			type = TYPE_BOOL;
+		}
+		return type;
+	}
+
+	Type parseAdditive(uint16_t dst) {
+		Type type = parseMultiplicative(dst);
+		while (isOp("+") || isOp("-")) {
+			std::string op = _text;
+			next();
+			Type rhs = parseMultiplicative(use(dst + 1));
+			if (op == "+") {
+				// integer addition or string concatenation
+				checkOrdered(type, rhs, op);
+				type = (type == TYPE_ANY ? rhs : type);
+				emit(OP_ADD, dst, dst, dst + 1);
+			} else {
+				check(type, TYPE_INT, op);
+				check(rhs, TYPE_INT, op);
+				type = TYPE_INT;
+				emit(OP_SUB, dst, dst, dst + 1);
+			}
+		}
+		return type;
+	}
+
+	Type parseMultiplicative(uint16_t dst) {
+		Type type = parseUnary(dst);
+		while (isOp("*") || isOp("/") || isOp("%")) {
+			std::string op = _text;
+			next();
+			Type rhs = parseUnary(use(dst + 1));
+			check(type, TYPE_INT, op);
+			check(rhs, TYPE_INT, op);
+			emit(op == "*" ? OP_MUL : op == "/" ? OP_DIV : OP_MOD, dst, dst, dst + 1);
+			type = TYPE_INT;
+		}
+		return type;
+	}
+
+	Type parseUnary(uint16_t dst) {
+		if (isOp("!")) {
+			next();
+			check(parseUnary(dst), TYPE_BOOL, "!");
+			emit(OP_NOT, dst, dst);
+			return TYPE_BOOL;
+		}
+		if (isOp("-")) {
+			next();
+			check(parseUnary(dst), TYPE_INT, "-");
+			emit(OP_NEG, dst, dst);
+			return TYPE_INT;
+		}
+		return parsePostfix(dst);
+	}
+
+	Type parsePostfix(uint16_t dst) {
+		Type type = parsePrimary(dst);
+		while (isOp(".")) {
+			next();
+			if (_token != TOK_IDENT)
+				fail("Expected field name");
+			check(type, TYPE_RECORD, ".");
+
+			Value field;
+			field.type = TYPE_STRING;
+			field.string = _text;
+			emit(OP_FIELD, dst, dst, constant(field));
+			next();
+
+			// fields are not declared
+			type = TYPE_ANY;
+		}
+		return type;
+	}
+
+	Type parsePrimary(uint16_t dst) {
+		use(dst);
+
+		if (_token == TOK_INT) {
+			Value value;
+			errno = 0;
+			setInt(value, strtoll(_text.c_str(), NULL, 10));
+			if (errno == ERANGE)
+				fail("Integer literal '" + _text + "' out of range");
+			emit(OP_CONST, dst, constant(value));
+			next();
+			return TYPE_INT;
+		}
+
+		if (_token == TOK_STRING) {
+			Value value;
+			value.type = TYPE_STRING;
+			value.string = _text;
+			emit(OP_CONST, dst, constant(value));
+			next();
+			return TYPE_STRING;
+		}
+
+		if (isOp("(")) {
+			next();
+			Type type = parseOr(dst);
+			expect(")");
+			return type;
+		}
+
+		if (_token != TOK_IDENT)
+			fail(_token == TOK_END ? "Unexpected end" : "Unexpected '" + _text + "'");
+
+		std::string ident = _text;
+		next();
+
+		if (ident == "true" || ident == "false") {
+			Value value;
+			setBool(value, ident == "true");
+			emit(OP_CONST, dst, constant(value));
+			return TYPE_BOOL;
+		}
+
+		if (ident == "In") {
+			expect("(");
+			if (_token != TOK_STRING)
+				fail("In() expects a state name");
+			Value state;
+			state.type = TYPE_STRING;
+			state.string = _text;
+			emit(OP_IN, dst, constant(state));
+			next();
+			expect(")");
+			return TYPE_BOOL;
+		}
+
+		if ((ident == "_sessionid" || ident == "_name") && _dm->_callbacks != NULL) {
+			Value value;
+			value.type = TYPE_STRING;
+			value.string = (ident == "_name" ? _dm->_callbacks->getName() : _dm->_callbacks->getSessionId());
+			emit(OP_CONST, dst, constant(value));
+			return TYPE_STRING;
+		}
+
+		std::map<std::string, uint16_t>::iterator slotIter = _dm->_slotIndex.find(ident);
+		if (slotIter == _dm->_slotIndex.end()) {
+			if (!_syntaxOnly)
+				fail("'" + ident + "' is not declared");
+			emit(OP_CONST, dst, constant(Value()));
+			return TYPE_ANY;
+		}
+
+		emit(OP_LOAD, dst, slotIter->second);
+		return _dm->_slotTypes[slotIter->second];
+	}
+
+	NativeDataModel* _dm;
+	const std::string& _source;
+	size_t _pos;
+
+	Token _token;
+	std::string _text;
+
+	bool _syntaxOnly;
+	std::shared_ptr<Program> _program;
+};
+
+NativeDataModel::NativeDataModel() {
+}
+
+NativeDataModel::~NativeDataModel() {
+}
+
+std::shared_ptr<DataModelImpl> NativeDataModel::create(DataModelCallbacks* callbacks) {
+	std::shared_ptr<NativeDataModel> dm(new NativeDataModel());
+
+	dm->_callbacks = callbacks;
+	dm->setup();
+	return dm;
+}
+
+void NativeDataModel::setup() {
+	declare("_event", TYPE_RECORD);
+	precompile();
+}
+
+void NativeDataModel::precompile() {
+#ifndef NO_XERCESC
+	if (_callbacks == NULL || _callbacks->getDocument() == NULL)
+		return;
+
+	XERCESC_NS::DOMElement* scxml = _callbacks->getDocument()->getDocumentElement();
+	if (scxml == NULL)
+		return;
+
+	std::string prefix = XML_PREFIX(scxml).str();
+
+	// declare all variables with their types before any expression is checked
+	std::list<XERCESC_NS::DOMElement*> datas = DOMUtils::inDocumentOrder({ prefix + "data" }, scxml);
+	for (auto data : datas) {
+		if (!HAS_ATTR(data, kXMLCharId))
+			continue;
+
+		Type type = TYPE_ANY;
+		try {
+			if (HAS_ATTR(data, kXMLCharType)) {
+				type = typeFromName(ATTR(data, kXMLCharType));
+			} else if (HAS_ATTR(data, kXMLCharExpr)) {
+				type = getProgram(ATTR(data, kXMLCharExpr))->type;
+			}
+		} catch (ErrorEvent e) {
+			// refers to data declared later, the type is only known at runtime
+		}
+
+		try {
+			declare(ATTR(data, kXMLCharId), type);
+		} catch (ErrorEvent e) {
+			LOG(_callbacks->getLogger(), USCXML_WARN) << e << std::endl;
+		}
+	}
+
+	std::list<XERCESC_NS::DOMElement*> elements = DOMUtils::inDocumentOrder({
+		prefix + "transition",
+		prefix + "if",
+		prefix + "elseif",
+		prefix + "assign",
+		prefix + "log",
+		prefix + "param",
+		prefix + "content",
+		prefix + "send",
+		prefix + "foreach"
+	}, scxml);
+
+	const X* attributes[] = { &kXMLCharCond, &kXMLCharExpr, &kXMLCharEventExpr, &kXMLCharTargetExpr, &kXMLCharArray, NULL };
+	for (auto element : elements) {
+		for (size_t i = 0; attributes[i] != NULL; i++) {
+			if (!HAS_ATTR(element, *attributes[i]))
+				continue;
+			try {
+				getProgram(ATTR(element, *attributes[i]));
+			} catch (ErrorEvent e) {
+				// the expression will raise error.execution when evaluated
+				LOG(_callbacks->getLogger(), USCXML_WARN) << e << std::endl;
+			}
+		}
+	}
+#endif
+}
+
+NativeDataModel::Type NativeDataModel::typeFromName(const std::string& name) {
+	if (name == "int" || name == "integer")
+		return TYPE_INT;
+	if (name == "bool" || name == "boolean")
+		return TYPE_BOOL;
+	if (name == "string")
+		return TYPE_STRING;
+	if (name == "record")
+		return TYPE_RECORD;
+	if (name == "any" || name.size() == 0)
+		return TYPE_ANY;
+	ERROR_EXECUTION_THROW("Unknown type '" + name + "'");
+}
+
+std::string NativeDataModel::typeToName(Type type) {
+	switch (type) {
+	case TYPE_INT:
+		return "int";
+	case TYPE_BOOL:
+		return "bool";
+	case TYPE_STRING:
+		return "string";
+	case TYPE_RECORD:
+		return "record";
+	default:
+		break;
+	}
+	return "any";
+}
+
+uint16_t NativeDataModel::declare(const std::string& name, Type type) {
+	std::map<std::string, uint16_t>::iterator slotIter = _slotIndex.find(name);
+	if (slotIter != _slotIndex.end())
+		return slotIter->second;
+
+	if (!isIdentifier(name))
+		ERROR_EXECUTION_THROW("'" + name + "' is no valid identifier");
+	if (_slots.size() >= 0xFFFF)
+		ERROR_EXECUTION_THROW("Too many variables");
+
+	uint16_t slot = (uint16_t)_slots.size();
+	_slotIndex[name] = slot;
+	_slotNames.push_back(name);
+	_slotTypes.push_back(type);
+	_slots.push_back(Value());
+	return slot;
+}
+
+std::shared_ptr<NativeDataModel::Program> NativeDataModel::getProgram(const std::string& expr) {
+	std::map<std::string, std::shared_ptr<Program> >::iterator progIter = _programs.find(expr);
+	if (progIter != _programs.end())
+		return progIter->second;
+
+	// slots are never removed or retyped, compiled programs stay valid
+	std::shared_ptr<Program> program = Compiler(this, expr, false).compile();
+
+	if (_programs.size() >= USCXML_NATIVE_MAX_CACHED_PROGRAMS)
+		_programs.clear();
+	_programs[expr] = program;
+	return program;
+}
+
+NativeDataModel::Value NativeDataModel::execute(const Program& program) {
+	if (_registers.size() < program.registers)
+		_registers.resize(program.registers);
+
+	Value* r = &_registers[0];
+	const Instruction* code = &program.code[0];
+	size_t length = program.code.size();
+	size_t pc = 0;
+
+	while (pc < length) {
+		const Instruction& instr = code[pc++];
+
+		// operands are registers for all but the first few instructions
+#define lhs r[instr.a]
+#define rhs r[instr.b]
+
+		switch (instr.op) {
+		case OP_CONST:
+			r[instr.dst] = program.constants[instr.a];
+			break;
+
+		case OP_LOAD:
+			if (_slots[instr.a].type == TYPE_ANY)
+				ERROR_EXECUTION_THROW("'" + _slotNames[instr.a] + "' is undefined");
+			r[instr.dst] = _slots[instr.a];
+			break;
+
+		case OP_FIELD: {
+			const std::string& field = program.constants[instr.b].string;
+			if (lhs.type != TYPE_RECORD)
+				ERROR_EXECUTION_THROW("Cannot access field '" + field + "' of " + typeToName(lhs.type));
+
+			std::map<std::string, Value>::const_iterator fieldIter = lhs.record->find(field);
+			if (fieldIter == lhs.record->end())
+				ERROR_EXECUTION_THROW("No field '" + field + "' in record");
+
+			// destination and record may share a register
+			Value value = fieldIter->second;
+			r[instr.dst] = value;
+			break;
+		}
+
+		case OP_IN:
+			setBool(r[instr.dst], _callbacks->isInState(program.constants[instr.a].string));
+			break;
+
+		case OP_NOT:
+			if (lhs.type != TYPE_BOOL)
+				ERROR_EXECUTION_THROW("'!' expects bool, not " + typeToName(lhs.type));
+			setBool(r[instr.dst], lhs.integer == 0);
+			break;
+
+		case OP_NEG:
+			if (lhs.type != TYPE_INT)
+				ERROR_EXECUTION_THROW("'-' expects int, not " + typeToName(lhs.type));
+			if (lhs.integer == INT64_MIN)
+				ERROR_EXECUTION_THROW("Integer overflow");
+			setInt(r[instr.dst], -lhs.integer);
+			break;
+
+		case OP_ADD:
+			if (lhs.type == TYPE_INT && rhs.type == TYPE_INT) {
+				if (addOverflows(lhs.integer, rhs.integer))
+					ERROR_EXECUTION_THROW("Integer overflow");
+				setInt(r[instr.dst], lhs.integer + rhs.integer);
+			} else if (lhs.type == TYPE_STRING && rhs.type == TYPE_STRING) {
+				std::string concat = lhs.string + rhs.string;
+				r[instr.dst].type = TYPE_STRING;
+				r[instr.dst].string.swap(concat);
+			} else {
+				ERROR_EXECUTION_THROW("'+' cannot be applied to " + typeToName(lhs.type) + " and " + typeToName(rhs.type));
+			}
+			break;
+
+		case OP_SUB:
+		case OP_MUL:
+		case OP_DIV:
+		case OP_MOD:
+			if (lhs.type != TYPE_INT || rhs.type != TYPE_INT)
+				ERROR_EXECUTION_THROW("Arithmetic on " + typeToName(lhs.type) + " and " + typeToName(rhs.type));
+			switch (instr.op) {
+			case OP_SUB:
+				if (subOverflows(lhs.integer, rhs.integer))
+					ERROR_EXECUTION_THROW("Integer overflow");
+				setInt(r[instr.dst], lhs.integer - rhs.integer);
+				break;
+			case OP_MUL:
+				if (mulOverflows(lhs.integer, rhs.integer))
+					ERROR_EXECUTION_THROW("Integer overflow");
+				setInt(r[instr.dst], lhs.integer * rhs.integer);
+				break;
+			default:
+				if (rhs.integer == 0)
+					ERROR_EXECUTION_THROW("Division by zero");
+				if (rhs.integer == -1) {
+					// INT64_MIN / -1 traps, the remainder is always zero
+					if (instr.op == OP_DIV && lhs.integer == INT64_MIN)
+						ERROR_EXECUTION_THROW("Integer overflow");
+					setInt(r[instr.dst], instr.op == OP_DIV ? -lhs.integer : 0);
+					break;
+				}
+				setInt(r[instr.dst], instr.op == OP_DIV ? lhs.integer / rhs.integer : lhs.integer % rhs.integer);
+				break;
+			}
+			break;
+
+		case OP_EQ:
+			setBool(r[instr.dst], valueEquals(lhs, rhs));
+			break;
+		case OP_NE:
+			setBool(r[instr.dst], !valueEquals(lhs, rhs));
+			break;
+
+		case OP_LT:
+		case OP_LE:
+		case OP_GT:
+		case OP_GE: {
+			int cmp = 0;
+			if (lhs.type == TYPE_INT && rhs.type == TYPE_INT) {
+				cmp = (lhs.integer < rhs.integer ? -1 : lhs.integer > rhs.integer ? 1 : 0);
+			} else if (lhs.type == TYPE_STRING && rhs.type == TYPE_STRING) {
+				cmp = lhs.string.compare(rhs.string);
+			} else {
+				ERROR_EXECUTION_THROW("Cannot order " + typeToName(lhs.type) + " and " + typeToName(rhs.type));
+			}
+			setBool(r[instr.dst], (instr.op == OP_LT ? cmp < 0 :
+			                       instr.op == OP_LE ? cmp <= 0 :
+			                       instr.op == OP_GT ? cmp > 0 : cmp >= 0));
+			break;
+		}
+
+		case OP_BOOL:
+			if (r[instr.dst].type != TYPE_BOOL)
+				ERROR_EXECUTION_THROW("Expected bool, not " + typeToName(r[instr.dst].type));
+			break;
+
+		case OP_JUMP_FALSE:
+			if (lhs.integer == 0)
+				pc = instr.b;
+			break;
+		case OP_JUMP_TRUE:
+			if (lhs.integer != 0)
+				pc = instr.b;
+			break;
+
+		default:
+			ERROR_EXECUTION_THROW("Invalid instruction");
+		}
+#undef lhs
+#undef rhs
+	}
+
+	Value result = r[0];
+
+	// registers must not keep records alive, they are copied on write
+	for (size_t i = 0; i < program.registers; i++)
+		r[i].record.reset();
+
+	return result;
+}
+
+NativeDataModel::Value NativeDataModel::evaluate(const std::string& expr) {
+	return execute(*getProgram(expr));
+}
+
+void NativeDataModel::store(const std::string& location, const Value& value) {
+	std::list<std::string> path = tokenize(location, '.');
+	for (auto component : path) {
+		if (!isIdentifier(component))
+			ERROR_EXECUTION_THROW("'" + location + "' is no valid location");
+	}
+	if (path.size() == 0)
+		ERROR_EXECUTION_THROW("Empty location");
+
+	std::string name = path.front();
+	path.pop_front();
+
+	if (INVALID_ASSIGNMENT(name))
+		ERROR_EXECUTION_THROW("Cannot assign to '" + name + "'");
+
+	std::map<std::string, uint16_t>::iterator slotIter = _slotIndex.find(name);
+	if (slotIter == _slotIndex.end())
+		ERROR_EXECUTION_THROW("'" + name + "' is not declared");
+
+	uint16_t slot = slotIter->second;
+	Type type = _slotTypes[slot];
+
+	if (path.size() == 0) {
+		if (type != TYPE_ANY && value.type != TYPE_ANY && value.type != type)
+			ERROR_EXECUTION_THROW("Cannot assign " + typeToName(value.type) + " to " + typeToName(type) + " '" + name + "'");
+		_slots[slot] = value;
+		return;
+	}
+
+	if (type != TYPE_ANY && type != TYPE_RECORD)
+		ERROR_EXECUTION_THROW("'" + name + "' is no record");
+
+	Value* target = &_slots[slot];
+	while(true) {
+		if (target->type == TYPE_ANY) {
+			target->type = TYPE_RECORD;
+			target->record = std::make_shared<std::map<std::string, Value> >();
+		} else if (target->type != TYPE_RECORD) {
+			ERROR_EXECUTION_THROW("'" + location + "' is no field of a record");
+		} else if (target->record.use_count() > 1) {
+			target->record = std::make_shared<std::map<std::string, Value> >(*target->record);
+		}
+
+		Value& field = (*target->record)[path.front()];
+		path.pop_front();
+		if (path.size() == 0) {
+			field = value;
+			return;
+		}
+		target = &field;
+	}
+}
+
+NativeDataModel::Value NativeDataModel::dataToValue(const Data& data, bool evaluate) {
+	Value value;
+
+	if (data.node)
+		ERROR_EXECUTION_THROW("XML cannot be represented in the native datamodel");
+
+	if (data.compound.size() > 0) {
+		value.type = TYPE_RECORD;
+		value.record = std::make_shared<std::map<std::string, Value> >();
+		for (auto& entry : data.compound) {
+			(*value.record)[entry.first] = dataToValue(entry.second, false);
+		}
+		return value;
+	}
+
+	if (data.array.size() > 0) {
+		// there are no arrays, use records with the indices as field names
+		value.type = TYPE_RECORD;
+		value.record = std::make_shared<std::map<std::string, Value> >();
+		size_t index = 0;
+		for (auto& entry : data.array) {
+			(*value.record)[toStr(index++)] = dataToValue(entry, false);
+		}
+		return value;
+	}
+
+	if (data.type == Data::VERBATIM) {
+		value.type = TYPE_STRING;
+		value.string = data.atom;
+		return value;
+	}
+
+	if (data.atom.size() == 0)
+		return value;
+
+	if (evaluate)
+		return this->evaluate(data.atom);
+
+	// literals as they come with events or from JSON
+	if (data.atom == "true" || data.atom == "false") {
+		setBool(value, data.atom == "true");
+	} else if (isInteger(data.atom.c_str(), 10)) {
+		// integers beyond 64 bit stay strings
+		errno = 0;
+		setInt(value, strtoll(data.atom.c_str(), NULL, 10));
+		if (errno == ERANGE) {
+			value.type = TYPE_STRING;
+			value.string = data.atom;
+		}
+	} else {
+		value.type = TYPE_STRING;
+		value.string = data.atom;
+	}
+	return value;
+}
+
+Data NativeDataModel::valueToData(const Value& value) {
+	Data data;
+	switch (value.type) {
+	case TYPE_INT:
+		return Data(value.integer);
+	case TYPE_BOOL:
+		return Data(value.integer ? "true" : "false", Data::INTERPRETED);
+	case TYPE_STRING:
+		return Data(value.string, Data::VERBATIM);
+	case TYPE_RECORD:
+		for (auto& entry : *value.record) {
+			data.compound[entry.first] = valueToData(entry.second);
+		}
+		break;
+	default:
+		break;
+	}
+	return data;
+}
+
+void NativeDataModel::addExtension(DataModelExtension* ext) {
+	ERROR_EXECUTION_THROW("Extensions unimplemented in native datamodel");
+}
+
+bool NativeDataModel::isValidSyntax(const std::string& expr) {
+	try {
+		Compiler(this, expr, true).compile();
+	} catch (ErrorEvent e) {
+		return false;
+	}
+	return true;
+}
+
+void NativeDataModel::setEvent(const Event& event) {
+	Value eventValue;
+	eventValue.type = TYPE_RECORD;
+	eventValue.record = std::make_shared<std::map<std::string, Value> >();
+
+	std::map<std::string, Value>& fields = *eventValue.record;
+	fields["name"].type = TYPE_STRING;
+	fields["name"].string = event.name;
+	fields["origin"].type = TYPE_STRING;
+	fields["origin"].string = event.origin;
+	fields["origintype"].type = TYPE_STRING;
+	fields["origintype"].string = event.origintype;
+	fields["invokeid"].type = TYPE_STRING;
+	fields["invokeid"].string = event.invokeid;
+	fields["sendid"].type = TYPE_STRING;
+	fields["sendid"].string = (event.hideSendId ? "" : event.sendid);
+
+	fields["type"].type = TYPE_STRING;
+	switch (event.eventType) {
+	case Event::PLATFORM:
+		fields["type"].string = "platform";
+		break;
+	case Event::INTERNAL:
+		fields["type"].string = "internal";
+		break;
+	case Event::EXTERNAL:
+		fields["type"].string = "external";
+		break;
+	default:
+		fields["type"].string = "invalid";
+		break;
+	}
+
+	if (!event.data.empty()) {
+		try {
+			fields["data"] = dataToValue(event.data, false);
+		} catch (ErrorEvent e) {
+			// XML payloads are not available
+			fields.erase("data");
+		}
+	}
+
+	_slots[_slotIndex["_event"]] = eventValue;
+}
+
+uint32_t NativeDataModel::getLength(const std::string& expr) {
+	Value value = evaluate(expr);
+	if (value.type != TYPE_RECORD)
+		ERROR_EXECUTION_THROW("'" + expr + "' does not evaluate to a record");
+	return value.record->size();
+}
+
+void NativeDataModel::setForeach(const std::string& item,
+                                 const std::string& array,
+                                 const std::string& index,
+                                 uint32_t iteration) {
+	Value value = evaluate(array);
+	if (value.type != TYPE_RECORD || iteration >= value.record->size())
+		ERROR_EXECUTION_THROW("'" + array + "' has no item " + toStr(iteration));
+
+	// records from arrays are indexed by number, not in lexical order
+	std::map<std::string, Value>::iterator itemIter = value.record->find(toStr(iteration));
+	if (itemIter == value.record->end()) {
+		itemIter = value.record->begin();
+		std::advance(itemIter, iteration);
+	}
+
+	if (!isDeclared(item))
+		declare(item, TYPE_ANY);
+	store(item, itemIter->second);
+
+	if (index.length() > 0) {
+		if (!isDeclared(index))
+			declare(index, TYPE_INT);
+		Value indexValue;
+		setInt(indexValue, iteration);
+		store(index, indexValue);
+	}
+}
+
+bool NativeDataModel::evalAsBool(const std::string& expr) {
+	std::shared_ptr<Program> program = getProgram(expr);
+	if (program->type != TYPE_BOOL && program->type != TYPE_ANY)
+		ERROR_EXECUTION_THROW("'" + expr + "' is of type " + typeToName(program->type) + ", not bool");
+
+	Value value = execute(*program);
+	if (value.type != TYPE_BOOL)
+		ERROR_EXECUTION_THROW("'" + expr + "' evaluated to " + typeToName(value.type) + ", not bool");
+	return value.integer != 0;
+}
+
+Data NativeDataModel::evalAsData(const std::string& expr) {
+	return valueToData(evaluate(expr));
+}
+
+Data NativeDataModel::getAsData(const std::string& content) {
+	size_t start = content.find_first_not_of(" \t\r\n");
+	if (start == std::string::npos)
+		return Data();
+	size_t end = content.find_last_not_of(" \t\r\n");
+	std::string trimmed = content.substr(start, end - start + 1);
+
+	if (trimmed[0] == '{' || trimmed[0] == '[') {
+		Data json = Data::fromJSON(trimmed);
+		if (!json.empty())
+			return json;
+	}
+	return valueToData(evaluate(trimmed));
+}
+
+bool NativeDataModel::isDeclared(const std::string& expr) {
+	return _slotIndex.find(expr) != _slotIndex.end();
+}
+
+void NativeDataModel::assign(const std::string& location,
+                             const Data& data,
+                             const std::map<std::string, std::string>& attr) {
+	store(location, dataToValue(data, true));
+}
+
+void NativeDataModel::init(const std::string& location,
+                           const Data& data,
+                           const std::map<std::string, std::string>& attr) {
+	if (INVALID_ASSIGNMENT(location))
+		ERROR_EXECUTION_THROW("Cannot assign to '" + location + "'");
+
+	Value value = dataToValue(data, true);
+	if (!isDeclared(location)) {
+		Type type = value.type;
+		if (attr.find("type") != attr.end())
+			type = typeFromName(attr.at("type"));
+		declare(location, type);
+	}
+	store(location, value);
+}
+
+std::string NativeDataModel::andExpressions(std::list<std::string> exprs) {
+	std::stringstream ss;
+	std::string andOp;
+	for (auto expr : exprs) {
+		ss << andOp << "(" << expr << ")";
+		andOp = " && ";
+	}
+	return ss.str();
+}
+
+}
@@ -0,0 +1,180 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#ifndef NATIVEDATAMODEL_H_5B0F3E7A
+#define NATIVEDATAMODEL_H_5B0F3E7A
+
+#include "uscxml/config.h"
+#include "uscxml/plugins/DataModelImpl.h"
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+#ifdef BUILD_AS_PLUGINS
+#include "uscxml/plugins/Plugins.h"
+#endif
+
+#define USCXML_NATIVE_MAX_CACHED_PROGRAMS 4096
+
+namespace uscxml {
+
+/**
+ * @ingroup datamodel
+ * Typed expression data-model compiled to register bytecode.
+ *
+ * Values are integers, booleans, strings and records thereof. Variables keep
+ * the type they were declared with and live in a contiguous slot array. All
+ * expressions of a document are type-checked and compiled in setup().
+ *
+ * Documents select it with `datamodel="typed"`. The name `native` is taken by
+ * the ChartToC and ChartToCpp transformations, where it means that expressions
+ * and scripts are inlined verbatim into the generated C / C++ code.
+ */
+class NativeDataModel : public DataModelImpl {
+public:
+	NativeDataModel();
+	virtual ~NativeDataModel();
+	virtual std::shared_ptr<DataModelImpl> create(DataModelCallbacks* callbacks);
+
+	virtual std::list<std::string> getNames() {
+		std::list<std::string> names;
+		names.push_back("typed");
+		return names;
+	}
+
+	virtual void addExtension(DataModelExtension* ext);
+
+	virtual bool isValidSyntax(const std::string& expr);
+
+	virtual void setEvent(const Event& event);
+
+	// foreach
+	virtual uint32_t getLength(const std::string& expr);
+	virtual void setForeach(const std::string& item,
+	                        const std::string& array,
+	                        const std::string& index,
+	                        uint32_t iteration);
+
+	virtual bool evalAsBool(const std::string& expr);
+	virtual Data evalAsData(const std::string& expr);
+	virtual Data getAsData(const std::string& content);
+
+	virtual bool isDeclared(const std::string& expr);
+
+	virtual void assign(const std::string& location,
+	                    const Data& data,
+	                    const std::map<std::string, std::string>& attr = std::map<std::string, std::string>());
+	virtual void init(const std::string& location,
+	                  const Data& data,
+	                  const std::map<std::string, std::string>& attr = std::map<std::string, std::string>());
+
+	virtual std::string andExpressions(std::list<std::string>);
+
+	enum Type {
+		TYPE_ANY = 0, ///< only known at runtime, for values this is undefined
+		TYPE_INT,
+		TYPE_BOOL,
+		TYPE_STRING,
+		TYPE_RECORD
+	};
+
+	struct Value {
+		Value() : type(TYPE_ANY), integer(0) {}
+		Type type;
+		int64_t integer; ///< booleans are 0 / 1
+		std::string string;
+		std::shared_ptr<std::map<std::string, Value> > record;
+	};
+
+	enum OpCode {
+		OP_CONST, ///< r[dst] = constants[a]
+		OP_LOAD,  ///< r[dst] = slots[a]
+		OP_FIELD, ///< r[dst] = r[a].constants[b]
+		OP_IN,    ///< r[dst] = In(constants[a])
+		OP_NOT,
+		OP_NEG,
+		OP_ADD,
+		OP_SUB,
+		OP_MUL,
+		OP_DIV,
+		OP_MOD,
+		OP_EQ,
+		OP_NE,
+		OP_LT,
+		OP_LE,
+		OP_GT,
+		OP_GE,
+		OP_BOOL,       ///< fail unless r[dst] is a boolean
+		OP_JUMP_FALSE, ///< continue at b if r[a] is false
+		OP_JUMP_TRUE   ///< continue at b if r[a] is true
+	};
+
+	struct Instruction {
+		uint8_t op;
+		uint16_t dst;
+		uint16_t a;
+		uint16_t b;
+	};
+
+	/// A compiled expression, its value ends up in register 0
+	struct Program {
+		Program() : registers(1), type(TYPE_ANY) {}
+		std::vector<Instruction> code;
+		std::vector<Value> constants;
+		uint16_t registers;
+		Type type;
+	};
+
+	static Type typeFromName(const std::string& name);
+	static std::string typeToName(Type type);
+
+protected:
+	virtual void setup();
+
+	class Compiler;
+
+	std::shared_ptr<Program> getProgram(const std::string& expr);
+	Value execute(const Program& program);
+	Value evaluate(const std::string& expr);
+
+	uint16_t declare(const std::string& name, Type type);
+	void store(const std::string& location, const Value& value);
+	void precompile();
+
+	Value dataToValue(const Data& data, bool evaluate);
+	Data valueToData(const Value& value);
+
+	std::map<std::string, std::shared_ptr<Program> > _programs;
+
+	std::map<std::string, uint16_t> _slotIndex;
+	std::vector<std::string> _slotNames;
+	std::vector<Type> _slotTypes;
+	std::vector<Value> _slots;
+	std::vector<Value> _registers;
+};
+
+#ifdef BUILD_AS_PLUGINS
+PLUMA_INHERIT_PROVIDER(NativeDataModel, DataModelImpl);
+#endif
+
+}
+
+#endif /* end of include guard: NATIVEDATAMODEL_H_5B0F3E7A */
@@ -40,8 +40,35 @@ name.compare("_name") == 0 || \
 name.compare("_ioprocessors") == 0 || \
 name.compare("_event") == 0
 
+// parse type for expressions where we let the parser decide
+#define PROMELA_AUTO_TYPE -1
+// we cache every expression we see, start over if there are too many
+#define PROMELA_EXPR_CACHE_SIZE 4096
+
 namespace uscxml {
 
+// variables of these types get a slot, auto typed ones until they hold no integer
+static bool isScalarType(const std::string& type) {
+	return (type == "auto" ||
+	        type == "int" ||
+	        type == "short" ||
+	        type == "byte" ||
+	        type == "bit" ||
+	        type == "bool" ||
+	        type == "mtype" ||
+	        type == "unsigned");
+}
+
+// whether the data is an integer we can convert back and forth without loss
+static bool isNativeInt(const Data& data, int& value) {
+	if (data.type != Data::INTERPRETED || data.atom.size() == 0 || data.node != NULL)
+		return false;
+	if (!data.compound.empty() || !data.array.empty() || !isInteger(data.atom.c_str(), 10))
+		return false;
+	value = strTo<int>(data.atom);
+	return data.atom.compare(toStr(value)) == 0;
+}
+
 #ifdef BUILD_AS_PLUGINS
 PLUMA_CONNECTOR
 bool pluginConnect(pluma::Host& host) {
@@ -50,7 +77,7 @@ bool pluginConnect(pluma::Host& host) {
 }
 #endif
 
-PromelaDataModel::PromelaDataModel() {
+PromelaDataModel::PromelaDataModel() : _slotGeneration(0), _lastMType(0) {
 }
 
 PromelaDataModel::~PromelaDataModel() {
@@ -203,7 +230,7 @@ void PromelaDataModel::setEvent(const Event& event) {
 
 	bool PromelaDataModel::isValidSyntax(const std::string& expr) {
 		try {
-			PromelaParser parser(expr);
+			getCompiled(expr, PROMELA_AUTO_TYPE);
 		} catch (Event e) {
 			LOG(_callbacks->getLogger(), USCXML_ERROR) << e << std::endl;
 			return false;
@@ -261,9 +288,14 @@ void PromelaDataModel::setEvent(const Event& event) {
 	}
 
 	bool PromelaDataModel::evalAsBool(const std::string& expr) {
-		PromelaParser parser(expr, 1, PromelaParser::PROMELA_EXPR);
-//	parser.dump();
-		Data tmp = evaluateExpr(parser.ast);
+		CompiledExpr& compiled = getCompiled(expr, PromelaParser::PROMELA_EXPR);
+		int result;
+		if (evaluateCompiled(compiled, result))
+			return result != 0;
+
+		std::shared_ptr<PromelaParser> parser = compiled.parser;
+//	parser->dump();
+		Data tmp = evaluateExpr(parser->ast);
 
 		if (tmp.atom.compare("false") == 0)
 			return false;
@@ -273,8 +305,343 @@ void PromelaDataModel::setEvent(const Event& event) {
 	}
 
 	Data PromelaDataModel::evalAsData(const std::string& expr) {
-		PromelaParser parser(expr);
-		return evaluateExpr(parser.ast);
+		CompiledExpr& compiled = getCompiled(expr, PROMELA_AUTO_TYPE);
+		int result;
+		if (evaluateCompiled(compiled, result)) {
+			if (compiled.isPredicate)
+				return Data(result ? "true" : "false", Data::INTERPRETED);
+			return Data(result);
+		}
+
+		std::shared_ptr<PromelaParser> parser = compiled.parser;
+		return evaluateExpr(parser->ast);
+	}
+
+	PromelaDataModel::CompiledExpr& PromelaDataModel::getCompiled(const std::string& expr, int type) {
+		std::pair<int, std::string> key(type, expr);
+		std::map<std::pair<int, std::string>, CompiledExpr>::iterator cacheIter = _exprCache.find(key);
+		if (cacheIter != _exprCache.end())
+			return cacheIter->second;
+
+		// will throw for syntax errors, we do not cache those
+		std::shared_ptr<PromelaParser> parser;
+		if (type == PROMELA_AUTO_TYPE) {
+			parser = std::shared_ptr<PromelaParser>(new PromelaParser(expr));
+		} else {
+			parser = std::shared_ptr<PromelaParser>(new PromelaParser(expr, 1, type));
+		}
+
+		if (_exprCache.size() >= PROMELA_EXPR_CACHE_SIZE)
+			_exprCache.clear();
+
+		CompiledExpr& compiled = _exprCache[key];
+		compiled.parser = parser;
+		return compiled;
+	}
+
+	bool PromelaDataModel::compile(CompiledExpr& compiled) {
+		compiled.program.clear();
+		compiled.stateNames.clear();
+		compiled.slots.clear();
+		compiled.stackSize = 0;
+		compiled.slotGeneration = _slotGeneration;
+		compiled.isCompiled = (compiled.parser->type == PromelaParser::PROMELA_EXPR &&
+		                       compile(compiled, compiled.parser->ast, 0, compiled.isPredicate));
+		return compiled.isCompiled;
+	}
+
+	bool PromelaDataModel::compile(CompiledExpr& compiled, void* ast, size_t depth, bool& isPredicate) {
+		PromelaParserNode* node = (PromelaParserNode*)ast;
+		std::list<PromelaParserNode*>::iterator opIter = node->operands.begin();
+
+		if (compiled.stackSize < depth + 1)
+			compiled.stackSize = depth + 1;
+		isPredicate = false;
+
+		CompiledExpr::Instruction instr;
+		instr.arg = 0;
+
+		switch (node->type) {
+		case PML_CONST:
+			instr.op = CompiledExpr::OP_PUSH;
+			if (iequals(node->value, "false")) {
+				instr.arg = 0;
+			} else if (iequals(node->value, "true")) {
+				instr.arg = 1;
+			} else {
+				instr.arg = strTo<int>(node->value);
+			}
+			compiled.program.push_back(instr);
+			return true;
+
+		case PML_NAME: {
+			std::map<std::string, size_t>::iterator slotIter = _slotIndex.find(node->value);
+			if (slotIter == _slotIndex.end())
+				return false;
+			instr.op = CompiledExpr::OP_LOAD;
+			instr.arg = (int)slotIter->second;
+			compiled.program.push_back(instr);
+			compiled.slots.push_back(slotIter->second);
+			return true;
+		}
+
+		case PML_VAR_ARRAY: {
+			// the in predicate is called config with promela dm
+			if (node->operands.size() != 2 || node->operands.front()->value != "config")
+				return false;
+			instr.op = CompiledExpr::OP_IN;
+			instr.arg = (int)compiled.stateNames.size();
+			compiled.stateNames.push_back(node->operands.back()->value);
+			compiled.program.push_back(instr);
+			isPredicate = true;
+			return true;
+		}
+
+		case PML_CMPND: {
+			// _x.states["foo"] is the in predicate as well, but yields an integer
+			PromelaParserNode* name = *opIter++;
+			if (name->value != "_x" || node->operands.size() != 2)
+				return false;
+			PromelaParserNode* what = *opIter++;
+			if (what->type != PML_VAR_ARRAY || what->operands.size() != 2 || what->operands.front()->value != "states")
+				return false;
+
+			std::string stateName = what->operands.back()->value;
+			if (what->operands.back()->type == PML_STRING)
+				stateName = stateName.substr(1, stateName.size() - 2); // remove quotes
+
+			instr.op = CompiledExpr::OP_IN;
+			instr.arg = (int)compiled.stateNames.size();
+			compiled.stateNames.push_back(stateName);
+			compiled.program.push_back(instr);
+			return true;
+		}
+
+		case PML_NEG: {
+			bool operandIsPredicate;
+			if (!compile(compiled, *opIter++, depth, operandIsPredicate))
+				return false;
+			instr.op = CompiledExpr::OP_NEG;
+			compiled.program.push_back(instr);
+			return true;
+		}
+
+		case PML_PLUS:
+			instr.op = CompiledExpr::OP_PLUS;
+			break;
+		case PML_MINUS:
+			instr.op = CompiledExpr::OP_MINUS;
+			break;
+		case PML_TIMES:
+			instr.op = CompiledExpr::OP_TIMES;
+			break;
+		case PML_DIVIDE:
+			instr.op = CompiledExpr::OP_DIVIDE;
+			break;
+		case PML_MODULO:
+			instr.op = CompiledExpr::OP_MODULO;
+			break;
+		case PML_LSHIFT:
+			instr.op = CompiledExpr::OP_LSHIFT;
+			break;
+		case PML_RSHIFT:
+			instr.op = CompiledExpr::OP_RSHIFT;
+			break;
+		case PML_EQ:
+			instr.op = CompiledExpr::OP_EQ;
+			break;
+		case PML_LT:
+			instr.op = CompiledExpr::OP_LT;
+			break;
+		case PML_LE:
+			instr.op = CompiledExpr::OP_LE;
+			break;
+		case PML_GT:
+			instr.op = CompiledExpr::OP_GT;
+			break;
+		case PML_GE:
+			instr.op = CompiledExpr::OP_GE;
+			break;
+		case PML_AND:
+			instr.op = CompiledExpr::OP_AND;
+			break;
+		case PML_OR:
+			instr.op = CompiledExpr::OP_OR;
+			break;
+		default:
+			return false;
+		}
+
+		// binary operators
+		if (node->operands.size() != 2)
+			return false;
+
+		bool lhsIsPredicate, rhsIsPredicate;
+		if (!compile(compiled, *opIter++, depth, lhsIsPredicate))
+			return false;
+		if (!compile(compiled, *opIter++, depth + 1, rhsIsPredicate))
+			return false;
+
+		// "true" / "false" from In() are no integers, only logical operators take them
+		if ((lhsIsPredicate || rhsIsPredicate) && instr.op != CompiledExpr::OP_AND && instr.op != CompiledExpr::OP_OR)
+			return false;
+
+		compiled.program.push_back(instr);
+		return true;
+	}
+
+	bool PromelaDataModel::evaluateCompiled(CompiledExpr& compiled, int& result) {
+		if (!compiled.isCompiled && compiled.slotGeneration != _slotGeneration) {
+			// there are new scalar variables, try again
+			compile(compiled);
+		}
+		if (!compiled.isCompiled)
+			return false;
+
+		for (std::vector<size_t>::iterator slotIter = compiled.slots.begin(); slotIter != compiled.slots.end(); slotIter++) {
+			if (!_slots[*slotIter].isNative)
+				return false;
+		}
+
+		if (_evalStack.size() < compiled.stackSize)
+			_evalStack.resize(compiled.stackSize);
+		int* stack = &_evalStack[0];
+		size_t top = 0;
+
+		for (std::vector<CompiledExpr::Instruction>::iterator instrIter = compiled.program.begin(); instrIter != compiled.program.end(); instrIter++) {
+			switch (instrIter->op) {
+			case CompiledExpr::OP_PUSH:
+				stack[top++] = instrIter->arg;
+				continue;
+			case CompiledExpr::OP_LOAD:
+				stack[top++] = _slots[instrIter->arg].value;
+				continue;
+			case CompiledExpr::OP_IN:
+				stack[top++] = (_callbacks->isInState(compiled.stateNames[instrIter->arg]) ? 1 : 0);
+				continue;
+			case CompiledExpr::OP_NEG:
+				stack[top - 1] = (stack[top - 1] == 0 ? 1 : 0);
+				continue;
+			default:
+				break;
+			}
+
+			int rhs = stack[--top];
+			int& lhs = stack[top - 1];
+			switch (instrIter->op) {
+			case CompiledExpr::OP_PLUS:
+				lhs = lhs + rhs;
+				break;
+			case CompiledExpr::OP_MINUS:
+				lhs = lhs - rhs;
+				break;
+			case CompiledExpr::OP_TIMES:
+				lhs = lhs * rhs;
+				break;
+			case CompiledExpr::OP_DIVIDE:
+				if (rhs == 0)
+					ERROR_EXECUTION_THROW("Division by zero");
+				lhs = lhs / rhs;
+				break;
+			case CompiledExpr::OP_MODULO:
+				if (rhs == 0)
+					ERROR_EXECUTION_THROW("Division by zero");
+				lhs = lhs % rhs;
+				break;
+			case CompiledExpr::OP_LSHIFT:
+				lhs = lhs << rhs;
+				break;
+			case CompiledExpr::OP_RSHIFT:
+				lhs = lhs >> rhs;
+				break;
+			case CompiledExpr::OP_EQ:
+				lhs = (lhs == rhs);
+				break;
+			case CompiledExpr::OP_LT:
+				lhs = (lhs < rhs);
+				break;
+			case CompiledExpr::OP_LE:
+				lhs = (lhs <= rhs);
+				break;
+			case CompiledExpr::OP_GT:
+				lhs = (lhs > rhs);
+				break;
+			case CompiledExpr::OP_GE:
+				lhs = (lhs >= rhs);
+				break;
+			case CompiledExpr::OP_AND:
+				lhs = (lhs != 0 && rhs != 0);
+				break;
+			case CompiledExpr::OP_OR:
+				lhs = (lhs != 0 || rhs != 0);
+				break;
+			default:
+				break;
+			}
+		}
+
+		assert(top == 1);
+		result = stack[0];
+		return true;
+	}
+
+	void PromelaDataModel::declareVariable(const std::string& name, const Data& variable) {
+		_variables.compound[name] = variable;
+
+		std::map<std::string, size_t>::iterator slotIter = _slotIndex.find(name);
+		bool isScalar = !variable.hasKey("size") && isScalarType(variable.at("type").atom);
+
+		if (!isScalar) {
+			if (slotIter != _slotIndex.end()) {
+				// programs compiled against the old slot will evaluate the AST
+				_slots[slotIter->second].isNative = false;
+				_slotIndex.erase(slotIter);
+				_slotGeneration++;
+			}
+			return;
+		}
+
+		if (slotIter == _slotIndex.end()) {
+			Slot slot;
+			slot.value = 0;
+			slot.isNative = false;
+			slotIter = _slotIndex.insert(std::make_pair(name, _slots.size())).first;
+			_slots.push_back(slot);
+			_slotGeneration++;
+		}
+
+		_slots[slotIter->second].isNative = false;
+		if (variable.hasKey("value"))
+			setValue(name, variable.at("value"));
+	}
+
+	Data PromelaDataModel::getValue(const std::string& name) {
+		std::map<std::string, size_t>::iterator slotIter = _slotIndex.find(name);
+		if (slotIter != _slotIndex.end() && _slots[slotIter->second].isNative)
+			return Data(_slots[slotIter->second].value, Data::INTERPRETED);
+		return _variables.compound[name]["value"];
+	}
+
+	void PromelaDataModel::setValue(const std::string& name, const Data& value) {
+		std::map<std::string, size_t>::iterator slotIter = _slotIndex.find(name);
+		if (slotIter != _slotIndex.end()) {
+			Slot& slot = _slots[slotIter->second];
+			if (isNativeInt(value, slot.value)) {
+				slot.isNative = true;
+				_variables.compound[name].compound.erase("value");
+				return;
+			}
+			slot.isNative = false;
+		}
+		_variables.compound[name].compound["value"] = value;
+	}
+
+	void PromelaDataModel::demoteSlot(const std::string& name) {
+		std::map<std::string, size_t>::iterator slotIter = _slotIndex.find(name);
+		if (slotIter == _slotIndex.end() || !_slots[slotIter->second].isNative)
+			return;
+		_variables.compound[name].compound["value"] = Data(_slots[slotIter->second].value, Data::INTERPRETED);
+		_slots[slotIter->second].isNative = false;
 	}
 
 	Data PromelaDataModel::getAsData(const std::string& content) {
@@ -287,18 +654,26 @@ void PromelaDataModel::setEvent(const Event& event) {
 	}
 
 	void PromelaDataModel::evaluateDecl(const std::string& expr) {
-		PromelaParser parser(expr, 1, PromelaParser::PROMELA_DECL);
-		evaluateDecl(parser.ast);
+		std::shared_ptr<PromelaParser> parser = getCompiled(expr, PromelaParser::PROMELA_DECL).parser;
+		evaluateDecl(parser->ast);
 	}
 
 	Data PromelaDataModel::evaluateExpr(const std::string& expr) {
-		PromelaParser parser(expr, 1, PromelaParser::PROMELA_EXPR);
-		return evaluateExpr(parser.ast);
+		CompiledExpr& compiled = getCompiled(expr, PromelaParser::PROMELA_EXPR);
+		int result;
+		if (evaluateCompiled(compiled, result)) {
+			if (compiled.isPredicate)
+				return Data(result ? "true" : "false", Data::INTERPRETED);
+			return Data(result);
+		}
+
+		std::shared_ptr<PromelaParser> parser = compiled.parser;
+		return evaluateExpr(parser->ast);
 	}
 
 	void PromelaDataModel::evaluateStmnt(const std::string& expr) {
-		PromelaParser parser(expr, 1, PromelaParser::PROMELA_STMNT);
-		evaluateStmnt(parser.ast);
+		std::shared_ptr<PromelaParser> parser = getCompiled(expr, PromelaParser::PROMELA_STMNT).parser;
+		evaluateStmnt(parser->ast);
 	}
 
 	void PromelaDataModel::evaluateDecl(void* ast) {
@@ -327,7 +702,7 @@ void PromelaDataModel::setEvent(const Event& event) {
 					} else {
 						variable.compound["value"] = Data(0, Data::INTERPRETED);
 					}
-					_variables.compound[(*nameIter)->value] = variable;
+					declareVariable((*nameIter)->value, variable);
 
 				} else if ((*nameIter)->type == PML_ASGN) {
 					// initially assigned variables
@@ -340,12 +715,12 @@ void PromelaDataModel::setEvent(const Event& event) {
 						variable.compound["value"] = evaluateExpr(expr);
 					} catch(uscxml::Event e) {
 						// test277, declare and throw
-						_variables.compound[name->value] = variable;
+						declareVariable(name->value, variable);
 						throw e;
 					}
 
 					assert(opIterAsgn == (*nameIter)->operands.end());
-					_variables.compound[name->value] = variable;
+					declareVariable(name->value, variable);
 				} else if ((*nameIter)->type == PML_VAR_ARRAY) {
 					// variable arrays
 
@@ -359,7 +734,7 @@ void PromelaDataModel::setEvent(const Event& event) {
 					}
 
 					assert(opIterAsgn == (*nameIter)->operands.end());
-					_variables.compound[name->value] = variable;
+					declareVariable(name->value, variable);
 
 				} else {
 					ERROR_EXECUTION_THROW("Declaring variables via " + PromelaParserNode::typeToDesc((*nameIter)->type) + " not implemented");
@@ -593,7 +968,7 @@ void PromelaDataModel::setEvent(const Event& event) {
 					ERROR_EXECUTION_THROW("Array assigned to " + node->value + " is too large");
 			}
 
-			_variables.compound[node->value].compound["value"] = value;
+			setValue(node->value, value);
 			break;
 		}
 		case PML_CMPND: {
@@ -611,6 +986,7 @@ void PromelaDataModel::setEvent(const Event& event) {
 
 //		std::cout << Data::toJSON(_variables) << std::endl;;
 
+			demoteSlot(name->value);
 			Data* var = &_variables[name->value].compound["value"];
 			var->compound["type"] = Data("compound", Data::VERBATIM);
 			var->compound["vis"] = Data("", Data::VERBATIM);
@@ -648,7 +1024,7 @@ void PromelaDataModel::setEvent(const Event& event) {
 //		if (_variables[node->value].compound.find("size") != _variables[node->value].compound.end()) {
 //			ERROR_EXECUTION_THROW("Type error: Variable " + node->value + " is an array");
 //		}
-			return _variables[node->value]["value"];
+			return getValue(node->value);
 		case PML_VAR_ARRAY: {
 			PromelaParserNode* name = *opIter++;
 			PromelaParserNode* expr = *opIter++;
@@ -703,7 +1079,7 @@ void PromelaDataModel::setEvent(const Event& event) {
 				ERROR_EXECUTION_THROW("No variable " + name->value + " was declared");
 			}
 
-			Data currData = _variables.compound[name->value]["value"];
+			Data currData = getValue(name->value);
 			idPath << name->value;
 			while(opIter != node->operands.end()) {
 				std::string key = (*opIter)->value;
@@ -725,12 +1101,12 @@ void PromelaDataModel::setEvent(const Event& event) {
 	}
 
 	void PromelaDataModel::assign(const std::string& location, const Data& data, const std::map<std::string, std::string>& attr) {
-		PromelaParser parser(location);
+		std::shared_ptr<PromelaParser> parser = getCompiled(location, PROMELA_AUTO_TYPE).parser;
 		if (data.atom.size() > 0 && data.type == Data::INTERPRETED) {
 			// e.g. Var1 = Var1 + 1
-			setVariable(parser.ast, evalAsData(data.atom));
+			setVariable(parser->ast, evalAsData(data.atom));
 		} else {
-			setVariable(parser.ast, data);
+			setVariable(parser->ast, data);
 		}
 	}
 
@@ -746,34 +1122,33 @@ void PromelaDataModel::setEvent(const Event& event) {
 			}
 
 			std::string expr = type + " " + location + arrSize;
-			PromelaParser parser(expr, 1, PromelaParser::PROMELA_DECL);
-			evaluateDecl(parser.ast);
+			evaluateDecl(expr);
 		}
 
-		PromelaParser parser(location);
+		std::shared_ptr<PromelaParser> parser = getCompiled(location, PROMELA_AUTO_TYPE).parser;
 		if (data.atom.size() > 0 && data.type == Data::INTERPRETED) {
 			Data d = Data::fromJSON(data);
 			if (!d.empty())
-				setVariable(parser.ast, Data::fromJSON(data));
+				setVariable(parser->ast, Data::fromJSON(data));
 			// var1 = _sessionid
-			setVariable(parser.ast, evalAsData(data.atom));
+			setVariable(parser->ast, evalAsData(data.atom));
 		} else {
-			setVariable(parser.ast, data);
+			setVariable(parser->ast, data);
 		}
 	}
 
 	bool PromelaDataModel::isDeclared(const std::string& expr) {
-		PromelaParser parser(expr);
-//	parser.dump();
-		if (parser.ast->type == PML_VAR_ARRAY)
-			return _variables.compound.find(parser.ast->operands.front()->value) != _variables.compound.end();
+		std::shared_ptr<PromelaParser> parser = getCompiled(expr, PROMELA_AUTO_TYPE).parser;
+//	parser->dump();
+		if (parser->ast->type == PML_VAR_ARRAY)
+			return _variables.compound.find(parser->ast->operands.front()->value) != _variables.compound.end();
 
-		if (parser.ast->type == PML_CMPND) {
+		if (parser->ast->type == PML_CMPND) {
 			// JSON declaration
-			std::list<PromelaParserNode*>::iterator opIter = parser.ast->operands.begin();
+			std::list<PromelaParserNode*>::iterator opIter = parser->ast->operands.begin();
 			Data* var = &_variables;
 
-			while(opIter != parser.ast->operands.end()) {
+			while(opIter != parser->ast->operands.end()) {
 				std::string name = (*opIter)->value;
 				opIter++;
 				if (var->compound.find(name) != var->compound.end()) {
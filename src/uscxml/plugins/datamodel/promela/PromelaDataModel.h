@@ -23,6 +23,9 @@
 #include "uscxml/config.h"
 #include "uscxml/plugins/DataModelImpl.h"
 #include <list>
+#include <map>
+#include <memory>
+#include <vector>
 
 #ifdef BUILD_AS_PLUGINS
 #include "uscxml/plugins/Plugins.h"
@@ -30,6 +33,8 @@
 
 namespace uscxml {
 
+class PromelaParser;
+
 class PromelaDataModel : public DataModelImpl {
 public:
 	PromelaDataModel();
@@ -88,6 +93,57 @@ protected:
 
 	void adaptType(Data& data);
 
+	/**
+	 * Integer expressions over scalar variables compiled into a postfix program
+	 * that is evaluated with native ints. Expressions referring to strings,
+	 * compounds or arrays are evaluated by walking the AST.
+	 */
+	class CompiledExpr {
+	public:
+		enum OpCode {
+			OP_PUSH, OP_LOAD, OP_IN,
+			OP_PLUS, OP_MINUS, OP_TIMES, OP_DIVIDE, OP_MODULO, OP_LSHIFT, OP_RSHIFT,
+			OP_EQ, OP_LT, OP_LE, OP_GT, OP_GE, OP_NEG, OP_AND, OP_OR
+		};
+		struct Instruction {
+			OpCode op;
+			int arg;
+		};
+
+		CompiledExpr() : isCompiled(false), isPredicate(false), slotGeneration(-1), stackSize(0) {}
+
+		std::shared_ptr<PromelaParser> parser;
+		bool isCompiled;
+		bool isPredicate; // result is a truth value of In() as "true" / "false"
+		int slotGeneration; // generation of scalar slots we last tried to compile against
+		size_t stackSize;
+		std::vector<Instruction> program;
+		std::vector<std::string> stateNames; // operands of In() predicates
+		std::vector<size_t> slots; // slots to be native for the program to run
+	};
+
+	/// A scalar variable, held as a native int while its value is an integer
+	struct Slot {
+		int value;
+		bool isNative; // false after non-integer assignments, value is in _variables
+	};
+
+	CompiledExpr& getCompiled(const std::string& expr, int type);
+	bool compile(CompiledExpr& compiled);
+	bool compile(CompiledExpr& compiled, void* ast, size_t depth, bool& isPredicate);
+	bool evaluateCompiled(CompiledExpr& compiled, int& result);
+
+	void declareVariable(const std::string& name, const Data& variable);
+	Data getValue(const std::string& name);
+	void setValue(const std::string& name, const Data& value);
+	void demoteSlot(const std::string& name);
+
+	std::map<std::pair<int, std::string>, CompiledExpr> _exprCache;
+	std::map<std::string, size_t> _slotIndex;
+	std::vector<Slot> _slots;
+	std::vector<int> _evalStack;
+	int _slotGeneration;
+
 	int _lastMType;
 
 	Event _event;
@@ -23,6 +23,9 @@
 #include "uscxml/interpreter/LoggingImpl.h"
 #include "uscxml/plugins/ioprocessor/http/HTTPIOProcessor.h"
 
+#include <fstream>
+#include <sys/stat.h>
+
 #ifdef BUILD_AS_PLUGINS
 #include <Pluma/Connector.hpp>
 #endif
@@ -51,12 +54,11 @@ void RespondElement::enterElement(XERCESC_NS::DOMElement* node) {
 	HTTPIOProcessor* http = (HTTPIOProcessor*)(ioProc.getImpl().operator->());
 
 
-	if (http->getUnansweredRequests().find(requestId) == http->getUnansweredRequests().end()) {
+	HTTPServer::Request httpReq;
+	if (!http->getUnansweredRequest(requestId, httpReq)) {
 		ERROR_EXECUTION_THROW2("No unanswered HTTP request with given id", node);
 	}
 
-	HTTPServer::Request httpReq = http->getUnansweredRequests()[requestId].second;
-
 	assert(httpReq.evhttpReq != NULL);
 	HTTPServer::Reply httpReply(httpReq);
 
@@ -80,7 +82,8 @@ void RespondElement::enterElement(XERCESC_NS::DOMElement* node) {
 						httpReply.content = contentData.atom;
 						httpReply.headers["Content-Type"] = "text/plain";
 					} else if (contentData.binary) {
-						httpReply.content = std::string(contentData.binary.getData(), contentData.binary.getSize());
+						// sent by reference, no need to copy
+						httpReply.blob = contentData.binary;
 						httpReply.headers["Content-Type"] = contentData.binary.getMimeType();
 					} else if (contentData.node) {
 						std::stringstream ss;
@@ -112,7 +115,24 @@ void RespondElement::enterElement(XERCESC_NS::DOMElement* node) {
 				file = ATTR(contentElem, X("file"));
 			}
 			if (file) {
-				httpReply.content = file.getInContent();
+				if (!file.isAbsolute()) {
+					file = URL::resolve(file, _interpreter->getBaseURL());
+				}
+				// local files are sent by the server without reading them here
+				httpReply.file = file.localPath();
+				if (httpReply.file.size() == 0) {
+					httpReply.content = file.getInContent();
+				} else {
+					// but we still want to know now if they cannot be sent
+					struct stat st;
+					if (stat(httpReply.file.c_str(), &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG) {
+						ERROR_EXECUTION_THROW2("content element references a file that does not exist: " + httpReply.file, node);
+					}
+					std::ifstream fileStream(httpReply.file.c_str(), std::ios::binary);
+					if (!fileStream.good()) {
+						ERROR_EXECUTION_THROW2("content element references a file that cannot be read: " + httpReply.file, node);
+					}
+				}
 				size_t lastDot;
 				if ((lastDot = file.path().find_last_of(".")) != std::string::npos) {
 					std::string extension = file.path().substr(lastDot + 1);
@@ -172,8 +192,8 @@ void RespondElement::enterElement(XERCESC_NS::DOMElement* node) {
 	}
 
 	// send the reply
-	HTTPServer::reply(httpReply);
-	http->getUnansweredRequests().erase(requestId);
+	HTTPServer::reply(std::move(httpReply));
+	http->eraseUnansweredRequest(requestId);
 }
 
 }
@@ -83,7 +83,7 @@ std::shared_ptr<IOProcessorImpl> BasicHTTPIOProcessor::create(IOProcessorCallbac
 bool BasicHTTPIOProcessor::requestFromHTTP(const HTTPServer::Request& req) {
 	HTTPIOProcessor::requestFromHTTP(req);
 	evhttp_send_reply(req.evhttpReq, 200, "OK", NULL);
-	getUnansweredRequests().erase(req.getUUID());
+	eraseUnansweredRequest(req.getUUID());
 	return true;
 }
 
@@ -112,19 +112,28 @@ Data HTTPIOProcessor::getDataModelVariables() {
 }
 
 bool HTTPIOProcessor::requestFromHTTP(const HTTPServer::Request& req) {
+	// the request becomes an event and is kept for a reply, decode all of it
+	req.decode();
+
 	Event event = req;
 	event.eventType = Event::EXTERNAL;
 
 	time_t now = std::time(0);
-	_unansweredRequests[req.getUUID()] = std::make_pair(now, req);
-
-	// remove stale requests
-	for (auto reqIter = _unansweredRequests.begin(); reqIter != _unansweredRequests.end();) {
-		if (now > reqIter->second.first + _timeoutS) {
-			evhttp_send_reply(reqIter->second.second.evhttpReq, 504, "Event was not responded to in time", NULL);
-			_unansweredRequests.erase(reqIter++);
-		} else {
-			++reqIter;
+	{
+		std::lock_guard<std::recursive_mutex> lock(_mutex);
+		_unansweredRequests[req.getUUID()] = std::make_pair(now, req);
+
+		// remove stale requests
+		for (auto reqIter = _unansweredRequests.begin(); reqIter != _unansweredRequests.end();) {
+			if (now > reqIter->second.first + _timeoutS) {
+				// the request might belong to another event loop of the server
+				HTTPServer::Reply reply(reqIter->second.second);
+				reply.status = 504;
+				HTTPServer::reply(reply);
+				_unansweredRequests.erase(reqIter++);
+			} else {
+				++reqIter;
+			}
 		}
 	}
 
@@ -179,6 +188,20 @@ bool HTTPIOProcessor::requestFromHTTP(const HTTPServer::Request& req) {
 	return true;
 }
 
+bool HTTPIOProcessor::getUnansweredRequest(const std::string& requestId, HTTPServer::Request& request) {
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	auto reqIter = _unansweredRequests.find(requestId);
+	if (reqIter == _unansweredRequests.end())
+		return false;
+	request = reqIter->second.second;
+	return true;
+}
+
+bool HTTPIOProcessor::eraseUnansweredRequest(const std::string& requestId) {
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	return _unansweredRequests.erase(requestId) > 0;
+}
+
 bool HTTPIOProcessor::isValidTarget(const std::string& target) {
 	try {
 		URL url(target);
@@ -274,7 +297,11 @@ void HTTPIOProcessor::eventFromSCXML(const std::string& target, const Event& eve
 	targetURL.setRequestType(URLRequestType::POST);
 	targetURL.addMonitor(this);
 
-	_sendRequests[event.sendid] = std::make_pair(targetURL, event);
+	{
+		// not while downloading, a local request is answered by ourself
+		std::lock_guard<std::recursive_mutex> lock(_mutex);
+		_sendRequests[event.sendid] = std::make_pair(targetURL, event);
+	}
 	if (isLocal) {
 		// test201 use a blocking request with local communication
 		targetURL.download(true);
@@ -286,44 +313,50 @@ void HTTPIOProcessor::eventFromSCXML(const std::string& target, const Event& eve
 void HTTPIOProcessor::downloadStarted(const URL& url) {}
 
 void HTTPIOProcessor::downloadCompleted(const URL& url) {
-	std::map<std::string, std::pair<URL, Event> >::iterator reqIter = _sendRequests.begin();
-	while(reqIter != _sendRequests.end()) {
-		if (reqIter->second.first == url) {
-			// test513
-			std::string statusCode = url.getStatusCode();
-			if (statusCode.length() > 0) {
-				std::string statusPrefix = statusCode.substr(0,1);
-				std::string statusRest = statusCode.substr(1);
-				Event event;
-				event.data = url;
-				event.name = "HTTP." + statusPrefix + "." + statusRest;
-				eventToSCXML(event, USCXML_IOPROC_HTTP_TYPE, std::string(_url));
-			}
-			_sendRequests.erase(reqIter);
-			return;
+	{
+		std::lock_guard<std::recursive_mutex> lock(_mutex);
+		std::map<std::string, std::pair<URL, Event> >::iterator reqIter = _sendRequests.begin();
+		while(reqIter != _sendRequests.end()) {
+			if (reqIter->second.first == url)
+				break;
+			reqIter++;
 		}
-		reqIter++;
+		assert(reqIter != _sendRequests.end());
+		if (reqIter == _sendRequests.end())
+			return;
+		_sendRequests.erase(reqIter);
+	}
+
+	// test513
+	std::string statusCode = url.getStatusCode();
+	if (statusCode.length() > 0) {
+		std::string statusPrefix = statusCode.substr(0,1);
+		std::string statusRest = statusCode.substr(1);
+		Event event;
+		event.data = url;
+		event.name = "HTTP." + statusPrefix + "." + statusRest;
+		eventToSCXML(event, USCXML_IOPROC_HTTP_TYPE, std::string(_url));
 	}
-	assert(false);
 }
 
 void HTTPIOProcessor::downloadFailed(const URL& url, int errorCode) {
-
-	std::map<std::string, std::pair<URL, Event> >::iterator reqIter = _sendRequests.begin();
-	while(reqIter != _sendRequests.end()) {
-		if (reqIter->second.first == url) {
-			Event failEvent;
-			failEvent.name = "error.communication";
-			eventToSCXML(failEvent, USCXML_IOPROC_HTTP_TYPE, std::string(_url));
-
-			_sendRequests.erase(reqIter);
-			return;
+	{
+		std::lock_guard<std::recursive_mutex> lock(_mutex);
+		std::map<std::string, std::pair<URL, Event> >::iterator reqIter = _sendRequests.begin();
+		while(reqIter != _sendRequests.end()) {
+			if (reqIter->second.first == url)
+				break;
+			reqIter++;
 		}
-		reqIter++;
+		assert(reqIter != _sendRequests.end());
+		if (reqIter == _sendRequests.end())
+			return;
+		_sendRequests.erase(reqIter);
 	}
-	assert(false);
 
+	Event failEvent;
+	failEvent.name = "error.communication";
+	eventToSCXML(failEvent, USCXML_IOPROC_HTTP_TYPE, std::string(_url));
 }
 
-
 }
@@ -29,6 +29,7 @@ extern "C" {
 
 #include <chrono>
 #include <ctime>
+#include <mutex>
 
 // why is it duplicated from Common.h here?
 
@@ -95,15 +96,18 @@ public:
 	void downloadCompleted(const URL& url);
 	void downloadFailed(const URL& url, int errorCode);
 
-	std::map<std::string, std::pair<std::time_t, HTTPServer::Request> >& getUnansweredRequests() {
-		return _unansweredRequests;
-	}
+	/// Copy the request with the given id that still waits for a reply, false if there is none
+	bool getUnansweredRequest(const std::string& requestId, HTTPServer::Request& request);
+	/// Forget a request once it was answered, false if there was none
+	bool eraseUnansweredRequest(const std::string& requestId);
 
 protected:
 	std::string _url;
 	size_t _timeoutS = WITH_IOPROC_HTTP_TIMEOUT;
 	std::map<std::string, std::pair<URL, Event> > _sendRequests;
 	std::map<std::string, std::pair<std::time_t, HTTPServer::Request> > _unansweredRequests;
+	// requests arrive on the server's event loops, sends and their downloads on other threads
+	std::recursive_mutex _mutex;
 
 };
 
@@ -29,6 +29,7 @@
 #include "uscxml/util/DOM.h"
 
 #include <string>
+#include <utility>
 
 extern "C" {
 #include <event2/dns.h>
@@ -37,6 +38,7 @@ extern "C" {
 #include <event2/keyvalq_struct.h>
 #include <event2/http_struct.h>
 #include <event2/thread.h>
+#include <event2/listener.h>
 }
 
 #include "uscxml/interpreter/Logging.h"
@@ -46,10 +48,16 @@ extern "C" {
 #include <netinet/in.h>                 // for INADDR_ANY
 #include <stdint.h>                     // for uint16_t
 #include <stdlib.h>                     // for NULL, free
+#include <string.h>                     // for memset
+#include <fcntl.h>                      // for open
+#include <sys/stat.h>                   // for fstat
 #include <unistd.h>                     // for gethostname
 //#include <netdb.h>
 //#include <arpa/inet.h>
 #else
+#include <io.h>                         // for _open
+#include <fcntl.h>                      // for _O_RDONLY
+#include <sys/stat.h>                   // for fstat
 #ifdef HTTPS_ENABLED
 #define EVENT__HAVE_OPENSSL
 #endif
@@ -71,28 +79,56 @@ extern "C" {
 
 namespace uscxml {
 
-static void dummyCallback(evutil_socket_t fd, short what, void *arg) {
-	// see comments in BasicDelayedEventQueue::run
-	timeval tv;
-	tv.tv_sec = 365 * 24 * 3600;
+static void wakeCallback(evutil_socket_t fd, short what, void *arg) {
+	// nothing to do, the event loop returns and sees whether we are still running
+}
+
+#ifdef EVLOOP_NO_EXIT_ON_EMPTY
+#	define HTTP_LOOP_FLAGS (EVLOOP_ONCE | EVLOOP_NO_EXIT_ON_EMPTY)
+#else
+#	define HTTP_LOOP_FLAGS EVLOOP_ONCE
+#endif
+
+/**
+ * An event activated by hand to wake the loop up when stopping.
+ */
+static struct event* newWakeEvent(struct event_base* base) {
+	struct event* wakeEvent = event_new(base, -1, EV_PERSIST, wakeCallback, NULL);
+#ifdef EVLOOP_NO_EXIT_ON_EMPTY
+	event_add(wakeEvent, NULL);
+#else
+	// before libevent 2.1, a loop without pending events returns right away
+	struct timeval tv;
+	tv.tv_sec = 3600;
 	tv.tv_usec = 0;
-	event *ev = *(event **)arg;
-	evtimer_add(ev, &tv);
+	event_add(wakeEvent, &tv);
+#endif
+	return wakeEvent;
 }
 
-HTTPServer::HTTPServer(unsigned short port, unsigned short wsPort, SSLConfig* sslConf) {
+HTTPServer::HTTPServer(unsigned short port, unsigned short wsPort, SSLConfig* sslConf, size_t workers) {
 	_port = port;
 	_base = event_base_new();
 	_http = evhttp_new(_base);
 	_evws = evws_new(_base);
 	_thread = NULL;
 	_httpHandle = NULL;
+	_isRunning = false;
 
-	timeval tv;
-	tv.tv_sec = 365 * 24 * 3600;
-	tv.tv_usec = 0;
-	_dummyEvent = evtimer_new(_base, dummyCallback, &_dummyEvent);
-	evtimer_add(_dummyEvent, &tv);
+	_wsQueueLimit = 4 * 1024 * 1024;
+	_wsQueuePolicy = WS_DISCONNECT;
+	const char* envQueueLimit = getenv("USCXML_WS_QUEUE_LIMIT");
+	if (envQueueLimit != NULL)
+		_wsQueueLimit = strTo<size_t>(envQueueLimit);
+	const char* envQueuePolicy = getenv("USCXML_WS_QUEUE_POLICY");
+	if (envQueuePolicy != NULL && iequals(envQueuePolicy, "drop"))
+		_wsQueuePolicy = WS_DROP_FRAMES;
+	_wsFramesSent = 0;
+	_wsBytesSent = 0;
+	_wsFramesDropped = 0;
+	_wsConnectionsClosed = 0;
+
+	_wakeEvent = newWakeEvent(_base);
 
 #ifdef _WIN32
 	_wsHandle = NULL;
@@ -102,26 +138,49 @@ HTTPServer::HTTPServer(unsigned short port, unsigned short wsPort, SSLConfig* ss
 
 	determineAddress();
 
-	unsigned int allowedMethods =
-	    EVHTTP_REQ_GET |
-	    EVHTTP_REQ_POST |
-	    EVHTTP_REQ_HEAD |
-	    EVHTTP_REQ_PUT |
-	    EVHTTP_REQ_DELETE |
-	    EVHTTP_REQ_OPTIONS |
-	    EVHTTP_REQ_TRACE |
-	    EVHTTP_REQ_CONNECT |
-	    EVHTTP_REQ_PATCH;
+	setupHTTP(_http);
 
-	evhttp_set_allowed_methods(_http, allowedMethods); // allow all methods
+#if !defined(LEV_OPT_REUSEABLE_PORT) || defined(_WIN32)
+	if (workers > 1) {
+		LOGD(USCXML_WARN) << "No SO_REUSEPORT on this platform, using a single HTTP event loop" << std::endl;
+		workers = 1;
+	}
+#endif
 
 	if (_port > 0) {
-		_httpHandle = evhttp_bind_socket_with_handle(_http, NULL, _port);
+		if (workers > 1) {
+			// every event loop accepts on the port, the kernel distributes the connections
+			_httpHandle = bindReusePort(_base, _http);
+		} else {
+			_httpHandle = evhttp_bind_socket_with_handle(_http, NULL, _port);
+		}
 		if (_httpHandle) {
 			LOGD(USCXML_INFO) << "HTTP server listening on tcp/" << _port << std::endl;;
 		} else {
 			LOGD(USCXML_ERROR) << "HTTP server cannot bind to tcp/" << _port << std::endl;
 		}
+
+		for (size_t i = 1; _httpHandle && i < workers; i++) {
+			Worker* worker = new Worker();
+			worker->base = event_base_new();
+			worker->http = evhttp_new(worker->base);
+			worker->thread = NULL;
+			worker->wakeEvent = newWakeEvent(worker->base);
+
+			setupHTTP(worker->http);
+			if (!bindReusePort(worker->base, worker->http)) {
+				LOGD(USCXML_ERROR) << "HTTP worker cannot bind to tcp/" << _port << std::endl;
+				evhttp_free(worker->http);
+				event_free(worker->wakeEvent);
+				event_base_free(worker->base);
+				delete worker;
+				break;
+			}
+			_workers.push_back(worker);
+		}
+		if (_workers.size() > 0) {
+			LOGD(USCXML_INFO) << "HTTP server accepting with " << _workers.size() + 1 << " event loops" << std::endl;
+		}
 	}
 
 	_wsPort = wsPort;
@@ -207,23 +266,80 @@ FAIL_SSL_SETUP:
 	;
 #endif
 
-//	evhttp_set_timeout(_http, 5);
-
-	// generic http callbacks
-	evhttp_set_gencb(_http, HTTPServer::httpRecvReqCallback, NULL);
+	// generic websocket callback, the one for http is set per event loop
 	evws_set_gencb(_evws, HTTPServer::wsRecvReqCallback, NULL);
 }
 
 HTTPServer::~HTTPServer() {
 	_isRunning = false;
-	_thread->join();
-	delete _thread;
+
+	// the event loops might wait for their next event otherwise, an active
+	// event is not lost if a loop was not entered yet
+	event_active(_wakeEvent, 0, 0);
+	for (auto worker : _workers) {
+		event_active(worker->wakeEvent, 0, 0);
+	}
+
+	if (_thread) {
+		_thread->join();
+		delete _thread;
+	}
+	for (auto worker : _workers) {
+		if (worker->thread) {
+			worker->thread->join();
+			delete worker->thread;
+		}
+		evhttp_free(worker->http);
+		event_free(worker->wakeEvent);
+		event_base_free(worker->base);
+		delete worker;
+	}
+	event_free(_wakeEvent);
+}
+
+void HTTPServer::setupHTTP(struct evhttp* http) {
+	unsigned int allowedMethods =
+	    EVHTTP_REQ_GET |
+	    EVHTTP_REQ_POST |
+	    EVHTTP_REQ_HEAD |
+	    EVHTTP_REQ_PUT |
+	    EVHTTP_REQ_DELETE |
+	    EVHTTP_REQ_OPTIONS |
+	    EVHTTP_REQ_TRACE |
+	    EVHTTP_REQ_CONNECT |
+	    EVHTTP_REQ_PATCH;
+
+	evhttp_set_allowed_methods(http, allowedMethods); // allow all methods
+
+//	evhttp_set_timeout(http, 5);
+
+	// generic http callbacks
+	evhttp_set_gencb(http, HTTPServer::httpRecvReqCallback, NULL);
+}
+
+struct evhttp_bound_socket* HTTPServer::bindReusePort(struct event_base* base, struct evhttp* http) {
+#if defined(LEV_OPT_REUSEABLE_PORT) && !defined(_WIN32)
+	struct sockaddr_in sin;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_ANY);
+	sin.sin_port = htons(_port);
+
+	struct evconnlistener* listener = evconnlistener_new_bind(base, NULL, NULL,
+	                                  LEV_OPT_REUSEABLE | LEV_OPT_REUSEABLE_PORT | LEV_OPT_CLOSE_ON_FREE | LEV_OPT_CLOSE_ON_EXEC,
+	                                  -1, (struct sockaddr*)&sin, sizeof(sin));
+	if (listener == NULL)
+		return NULL;
+	return evhttp_bind_listener(http, listener);
+#else
+	return NULL;
+#endif
 }
 
 HTTPServer* HTTPServer::_instance = NULL;
 std::recursive_mutex HTTPServer::_instanceMutex;
 
-HTTPServer* HTTPServer::getInstance(unsigned short port, unsigned short wsPort, SSLConfig* sslConf) {
+HTTPServer* HTTPServer::getInstance(unsigned short port, unsigned short wsPort, SSLConfig* sslConf, size_t workers) {
 //	std::lock_guard<std::recursive_mutex> lock(_instanceMutex);
 	if (_instance == NULL) {
 #ifdef _WIN32
@@ -235,7 +351,11 @@ HTTPServer* HTTPServer::getInstance(unsigned short port, unsigned short wsPort,
 #else
 		evthread_use_windows_threads();
 #endif
-		_instance = new HTTPServer(port, wsPort, sslConf);
+		if (workers == 0) {
+			const char* envWorkers = getenv("USCXML_HTTP_WORKERS");
+			workers = (envWorkers != NULL ? strTo<size_t>(envWorkers) : 1);
+		}
+		_instance = new HTTPServer(port, wsPort, sslConf, workers);
 
 		// only start if we have something to do!
 #ifdef HTTPS_ENABLED
@@ -301,10 +421,6 @@ void HTTPServer::wsRecvReqCallback(struct evws_connection *conn, struct evws_fra
  * This callback is registered for all HTTP requests
  */
 void HTTPServer::httpRecvReqCallback(struct evhttp_request *req, void *callbackData) {
-	std::stringstream raw;
-
-	struct evkeyvalq *headers;
-	headers = evhttp_request_get_input_headers(req);
 
 #if 0
 	// first of all, see whether this is a websocket request
@@ -320,6 +436,8 @@ void HTTPServer::httpRecvReqCallback(struct evhttp_request *req, void *callbackD
 	evhttp_request_own(req);
 	Request request;
 	request.evhttpReq = req;
+	// only safe to ask on this loop, the connection might be gone when replying from another thread
+	request.evBase = evhttp_connection_get_base(evhttp_request_get_connection(req));
 
 	switch (evhttp_request_get_command(req)) {
 	case EVHTTP_REQ_GET:
@@ -353,79 +471,88 @@ void HTTPServer::httpRecvReqCallback(struct evhttp_request *req, void *callbackD
 		request.data.compound["type"] = Data("unknown", Data::VERBATIM);
 		break;
 	}
-	raw << boost::to_upper_copy(request.data.compound["type"].atom);
-
-	request.data.compound["remoteHost"] = Data(req->remote_host, Data::VERBATIM);
-	request.data.compound["remotePort"] = Data(toStr(req->remote_port), Data::VERBATIM);
-	request.data.compound["httpMajor"] = Data(toStr((unsigned short)req->major), Data::VERBATIM);
-	request.data.compound["httpMinor"] = Data(toStr((unsigned short)req->minor), Data::VERBATIM);
-	request.data.compound["uri"] = Data(HTTPServer::getBaseURL() + req->uri, Data::VERBATIM);
 
+	// the path is all we need for routing, everything else is decoded when a servlet asks for it
 	char* pathCStr = evhttp_decode_uri(evhttp_uri_get_path(evhttp_request_get_evhttp_uri(req)));
 	request.data.compound["path"] = Data(pathCStr, Data::VERBATIM);
 	free(pathCStr);
 
-	raw << " " << request.data.compound["path"].atom;
-	const char* query = evhttp_uri_get_query(evhttp_request_get_evhttp_uri(req));
-	if (query)
-		raw << "?" << std::string(query);
+	// servlets are called concurrently from all event loops without a lock, they
+	// protect their own state and the routes snapshot keeps them registered meanwhile
 
-	raw << " HTTP/" << request.data.compound["httpMajor"].atom << "." << request.data.compound["httpMinor"].atom;
-	raw << std::endl;
+	// try with the handler registered for path first
+	bool answered = false;
+	if (callbackData != NULL)
+		answered = ((HTTPServlet*)callbackData)->requestFromHTTP(request);
 
-	struct evkeyval *header;
-	struct evbuffer *buf;
+	if (!answered)
+		HTTPServer::getInstance()->processByMatchingServlet(request);
+}
 
-	// insert headers to event data
-	for (header = headers->tqh_first; header; header = header->next.tqe_next) {
-		request.data.compound["header"].compound[header->key] = Data(header->value, Data::VERBATIM);
-		raw << header->key << ": " << header->value << std::endl;
-	}
-	raw << std::endl;
+const Data& HTTPServer::Request::getHeaders() const {
+	if (!(_decoded & HEADERS)) {
+		Data& headers = self().data.compound["header"];
 
-	// seperate path into components
-	{
-		std::stringstream ss(request.data.compound["path"].atom);
-		std::string item;
-		while(std::getline(ss, item, '/')) {
-			if (item.length() == 0)
-				continue;
-			request.data.compound["pathComponent"].array.push_back(Data(item, Data::VERBATIM));
+		struct evkeyvalq *inHeaders = evhttp_request_get_input_headers(evhttpReq);
+		for (struct evkeyval* header = inHeaders->tqh_first; header; header = header->next.tqe_next) {
+			headers.compound[header->key] = Data(header->value, Data::VERBATIM);
 		}
+		_decoded |= HEADERS;
 	}
-	// parse query string
-	struct evkeyvalq params;
-	struct evkeyval *param;
-
-	evhttp_parse_query_str(query, &params);
-	for (param = params.tqh_first; param; param = param->next.tqe_next) {
-		request.data.compound["query"].compound[param->key] = Data(param->value, Data::VERBATIM);
-	}
-	evhttp_clear_headers(&params);
-
-	// get content
-	buf = evhttp_request_get_input_buffer(req);
-	if (evbuffer_get_length(buf))
-		request.data.compound["content"] = Data("", Data::VERBATIM);
-	while (evbuffer_get_length(buf)) {
-		int n;
-		char cbuf[1024];
-		n = evbuffer_remove(buf, cbuf, sizeof(buf)-1);
-		if (n > 0) {
-			request.data.compound["content"].atom.append(cbuf, n);
+	return data.compound.at("header");
+}
+
+const Data& HTTPServer::Request::getQuery() const {
+	static const Data noQuery;
+
+	if (!(_decoded & QUERY)) {
+		const char* query = evhttp_uri_get_query(evhttp_request_get_evhttp_uri(evhttpReq));
+		if (query) {
+			struct evkeyvalq params;
+			struct evkeyval *param;
+
+			evhttp_parse_query_str(query, &params);
+			for (param = params.tqh_first; param; param = param->next.tqe_next) {
+				self().data.compound["query"].compound[param->key] = Data(param->value, Data::VERBATIM);
+			}
+			evhttp_clear_headers(&params);
 		}
+		_decoded |= QUERY;
 	}
 
-	raw << request.data.compound["content"].atom;
+	if (data.compound.find("query") == data.compound.end())
+		return noQuery;
+	return data.compound.at("query");
+}
+
+const Data& HTTPServer::Request::getContent() const {
+	static const Data noContent;
+
+	if (!(_decoded & CONTENT)) {
+		_decoded |= CONTENT;
+
+		struct evbuffer *buf = evhttp_request_get_input_buffer(evhttpReq);
+		size_t length = evbuffer_get_length(buf);
+		if (length == 0)
+			return noContent;
+
+		_body.resize(length);
+		evbuffer_remove(buf, &_body[0], length);
 
-	// decode content
-	if (request.data.compound.find("content") != request.data.compound.end() &&
-	        request.data.compound["header"].compound.find("Content-Type") != request.data.compound["header"].compound.end()) {
-		std::string contentType = request.data.compound["header"].compound["Content-Type"].atom;
-		if (false) {
-		} else if (iequals(contentType.substr(0, 33), "application/x-www-form-urlencoded")) {
+		Data& content = self().data.compound["content"];
+		content = Data("", Data::VERBATIM);
+
+		// decode content
+		const Data& headers = getHeaders();
+		if (headers.compound.find("Content-Type") == headers.compound.end()) {
+			content.atom = _body;
+			return content;
+		}
+
+		std::string contentType = headers.compound.at("Content-Type").atom;
+		if (iequals(contentType.substr(0, 33), "application/x-www-form-urlencoded")) {
 			// this is a form submit
-			std::stringstream ss(request.data.compound["content"].atom);
+			std::stringstream ss(_body);
 			std::string item;
 			std::string key;
 			std::string value;
@@ -445,16 +572,17 @@ void HTTPServer::httpRecvReqCallback(struct evhttp_request *req, void *callbackD
 				std::string decKey = std::string(keyCStr, keyCStrLen);
 				std::string decValue = std::string(valueCStr, valueCStrLen);
 
-				request.data.compound["content"].compound[decKey] = Data(decValue, Data::VERBATIM);
+				content.compound[decKey] = Data(decValue, Data::VERBATIM);
 				free(keyCStr);
 				free(valueCStr);
 				key.clear();
 			}
-			request.data.compound["content"].atom.clear();
 		} else if (iequals(contentType.substr(0, 16), "application/json")) {
-			Data json = Data::fromJSON(request.data.compound["content"].atom);
+			Data json = Data::fromJSON(_body);
 			if (!json.empty()) {
-				request.data.compound["content"] = json;
+				content = json;
+			} else {
+				content.atom = _body;
 			}
 		} else if (iequals(contentType.substr(0, 15), "application/xml")) {
 			assert(0);
@@ -464,53 +592,99 @@ void HTTPServer::httpRecvReqCallback(struct evhttp_request *req, void *callbackD
 //			} else {
 //				request.data.compound["content"].node = parser.getDocument().getDocumentElement();
 //			}
+		} else {
+			content.atom = _body;
 		}
 	}
 
-	request.raw = raw.str();
+	if (data.compound.find("content") == data.compound.end())
+		return noContent;
+	return data.compound.at("content");
+}
 
-#if 0
-	std::cout << "====" << std::endl;
-	std::cout << request.raw << std::endl;
-	std::cout << "====" << std::endl;
-#endif
+void HTTPServer::Request::decode() const {
+	if (_decoded & EVERYTHING)
+		return;
 
-	// try with the handler registered for path first
-	bool answered = false;
-	if (callbackData != NULL)
-		answered = ((HTTPServlet*)callbackData)->requestFromHTTP(request);
+	getHeaders();
+	getQuery();
+	getContent();
 
-	if (!answered)
-		HTTPServer::getInstance()->processByMatchingServlet(request);
-}
+	Request& request = self();
+	struct evhttp_request* req = evhttpReq;
 
-void HTTPServer::processByMatchingServlet(const Request& request) {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	request.data.compound["remoteHost"] = Data(req->remote_host, Data::VERBATIM);
+	request.data.compound["remotePort"] = Data(toStr(req->remote_port), Data::VERBATIM);
+	request.data.compound["httpMajor"] = Data(toStr((unsigned short)req->major), Data::VERBATIM);
+	request.data.compound["httpMinor"] = Data(toStr((unsigned short)req->minor), Data::VERBATIM);
+	request.data.compound["uri"] = Data(HTTPServer::getBaseURL() + req->uri, Data::VERBATIM);
 
-	http_servlet_iter_t servletIter = _httpServlets.begin();
+	// seperate path into components
+	{
+		std::stringstream ss(getPath());
+		std::string item;
+		while(std::getline(ss, item, '/')) {
+			if (item.length() == 0)
+				continue;
+			request.data.compound["pathComponent"].array.push_back(Data(item, Data::VERBATIM));
+		}
+	}
 
-	std::string actualPath = request.data.compound.at("path").atom;
-	std::map<std::string, HTTPServlet*, comp_strsize_less> matches;
+	std::stringstream raw;
+	raw << boost::to_upper_copy(getType());
+	raw << " " << getPath();
+	const char* query = evhttp_uri_get_query(evhttp_request_get_evhttp_uri(req));
+	if (query)
+		raw << "?" << std::string(query);
 
-	while(servletIter != _httpServlets.end()) {
-		// is the servlet path a prefix of the actual path?
-		std::string servletPath = "/" + servletIter->first;
-		if (servletIter->first.length() == 0) {
-			matches.insert(std::make_pair(servletPath, servletIter->second)); // single servlet at root
-		} else if (iequals(actualPath.substr(0, servletPath.length()), servletPath) && // servlet path is a prefix
-		           iequals(actualPath.substr(servletPath.length(), 1), "/")) {     // and next character is a '/'
-			matches.insert(std::make_pair(servletPath, servletIter->second));
-		}
-		servletIter++;
+	raw << " HTTP/" << request.data.compound["httpMajor"].atom << "." << request.data.compound["httpMinor"].atom;
+	raw << std::endl;
+
+	struct evkeyvalq *headers = evhttp_request_get_input_headers(req);
+	for (struct evkeyval* header = headers->tqh_first; header; header = header->next.tqe_next) {
+		raw << header->key << ": " << header->value << std::endl;
 	}
+	raw << std::endl;
+	raw << _body;
+
+	request.raw = raw.str();
+
+	_body.clear();
+	_decoded |= EVERYTHING;
+}
+
+/**
+ * The lowercase path without the leading slash as we keep it in the routes
+ */
+static std::string routeKey(const std::string& path) {
+	if (!boost::starts_with(path, "/"))
+		return "";
+	return boost::to_lower_copy(path.substr(1));
+}
+
+/**
+ * Whether a servlet registered at a prefix of the given length is responsible for path
+ */
+static bool isServletPrefix(const std::string& path, size_t prefixLength) {
+	// next character after the servlet path is a '/'
+	return path.size() > prefixLength + 1 && path[prefixLength + 1] == '/';
+}
+
+void HTTPServer::processByMatchingServlet(const Request& request) {
+	const std::string& actualPath = request.data.compound.at("path").atom;
+
+	// the snapshot keeps the matched servlets registered until we are done
+	RadixTree<HTTPServlet*>::Snapshot routes = _httpRoutes.snapshot();
+	std::vector<std::pair<size_t, HTTPServlet*> > matches = RadixTree<HTTPServlet*>::getPrefixesOf(routes, routeKey(actualPath));
 
 	// process by best matching servlet until someone feels responsible
-	std::map<std::string, HTTPServlet*, comp_strsize_less>::iterator matchesIter = matches.begin();
-	while(matchesIter != matches.end()) {
-		if (matchesIter->second->requestFromHTTP(request)) {
+	for (auto matchIter = matches.rbegin(); matchIter != matches.rend(); matchIter++) {
+		// a single servlet at root gets everything, the servlet's own path is an exact match
+		if (matchIter->first > 0 && matchIter->first + 1 != actualPath.size() && !isServletPrefix(actualPath, matchIter->first))
+			continue;
+		if (matchIter->second->requestFromHTTP(request)) {
 			return;
 		}
-		matchesIter++;
 	}
 
 	LOGD(USCXML_INFO) << "Got an HTTP request at " << actualPath << " but no servlet is registered there or at a prefix"  << std::endl;
@@ -518,44 +692,93 @@ void HTTPServer::processByMatchingServlet(const Request& request) {
 }
 
 void HTTPServer::processByMatchingServlet(evws_connection* conn, const WSFrame& frame) {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
-
-	ws_servlet_iter_t servletIter = _wsServlets.begin();
+	const std::string& actualPath = frame.data.compound.at("path").atom;
 
-	std::string actualPath = frame.data.compound.at("path").atom;
-	std::map<std::string, WebSocketServlet*, comp_strsize_less> matches;
-
-	while(servletIter != _wsServlets.end()) {
-		// is the servlet path a prefix of the actual path?
-		std::string servletPath = "/" + servletIter->first;
-		if (iequals(actualPath.substr(0, servletPath.length()), servletPath) && // servlet path is a prefix
-		        iequals(actualPath.substr(servletPath.length(), 1), "/")) {     // and next character is a '/'
-			matches.insert(std::make_pair(servletPath, servletIter->second));
-		}
-		servletIter++;
-	}
+	RadixTree<WebSocketServlet*>::Snapshot routes = _wsRoutes.snapshot();
+	std::vector<std::pair<size_t, WebSocketServlet*> > matches = RadixTree<WebSocketServlet*>::getPrefixesOf(routes, routeKey(actualPath));
 
 	// process by best matching servlet until someone feels responsible
-	std::map<std::string, WebSocketServlet*, comp_strsize_less>::iterator matchesIter = matches.begin();
-	while(matchesIter != matches.end()) {
-		if (matchesIter->second->requestFromWS(conn, frame)) {
+	for (auto matchIter = matches.rbegin(); matchIter != matches.rend(); matchIter++) {
+		if (!isServletPrefix(actualPath, matchIter->first))
+			continue;
+		if (matchIter->second->requestFromWS(conn, frame)) {
 			return;
 		}
-		matchesIter++;
 	}
 }
 
+bool HTTPServer::isServerThread() {
+	if (_thread != NULL && _thread->get_id() == std::this_thread::get_id())
+		return true;
+	for (auto worker : _workers) {
+		if (worker->thread != NULL && worker->thread->get_id() == std::this_thread::get_id())
+			return true;
+	}
+	return false;
+}
+
 void HTTPServer::reply(const Reply& reply) {
-	// we need to reply from the thread calling event_base_dispatch, just add to its base queue!
-	Reply* replyCB = new Reply(reply);
+	HTTPServer::reply(Reply(reply));
+}
+
+void HTTPServer::reply(Reply&& reply) {
+	// we need to reply from the thread dispatching the request's event loop, just add to its base queue!
 	HTTPServer* INSTANCE = getInstance();
-	event_base_once(INSTANCE->_base, -1, EV_TIMEOUT, HTTPServer::replyCallback, replyCB, NULL);
+
+	struct event_base* base = (reply.evBase != NULL ? reply.evBase : INSTANCE->_base);
+
+	Reply* replyCB = new Reply(std::move(reply));
+	event_base_once(base, -1, EV_TIMEOUT, HTTPServer::replyCallback, replyCB, NULL);
+}
+
+void HTTPServer::releaseContent(const void *data, size_t length, void *arg) {
+	delete (std::string*)arg;
+}
+
+void HTTPServer::releaseBlob(const void *data, size_t length, void *arg) {
+	delete (Blob*)arg;
+}
+
+/**
+ * Append a local file to the buffer, it is sent via sendfile or mmap where available
+ */
+static bool addFile(struct evbuffer* evb, const std::string& path) {
+#ifdef _WIN32
+	int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+#endif
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG) {
+#ifdef _WIN32
+		_close(fd);
+#else
+		close(fd);
+#endif
+		return false;
+	}
+
+	if (st.st_size == 0) {
+#ifdef _WIN32
+		_close(fd);
+#else
+		close(fd);
+#endif
+		return true;
+	}
+
+	// the buffer owns and closes the descriptor
+	return evbuffer_add_file(evb, fd, 0, st.st_size) == 0;
 }
 
 void HTTPServer::replyCallback(evutil_socket_t fd, short what, void *arg) {
 	Reply* reply = (Reply*)arg;
 
-	if (reply->content.size() > 0 && reply->headers.find("Content-Type") == reply->headers.end()) {
+	bool hasContent = reply->content.size() > 0 || reply->blob || reply->file.size() > 0;
+	if (hasContent && reply->headers.find("Content-Type") == reply->headers.end()) {
 		LOGD(USCXML_INFO) << "Sending content without Content-Type header" << std::endl;
 	}
 
@@ -567,14 +790,31 @@ void HTTPServer::replyCallback(evutil_socket_t fd, short what, void *arg) {
 
 	if (reply->status >= 400) {
 		evhttp_send_error(reply->evhttpReq, reply->status, NULL);
+		delete(reply);
 		return;
 	}
 
 	struct evbuffer *evb = NULL;
 
-	if (!iequals(reply->type, "HEAD") && reply->content.size() > 0) {
+	if (!iequals(reply->type, "HEAD") && hasContent) {
 		evb = evbuffer_new();
-		evbuffer_add(evb, reply->content.data(), reply->content.size());
+
+		// content is referenced by the buffer until it was written to the connection
+		if (reply->file.size() > 0) {
+			if (!addFile(evb, reply->file)) {
+				LOGD(USCXML_ERROR) << "Cannot send file " << reply->file << std::endl;
+				evbuffer_free(evb);
+				evhttp_send_error(reply->evhttpReq, 404, NULL);
+				delete(reply);
+				return;
+			}
+		} else if (reply->blob) {
+			evbuffer_add_reference(evb, reply->blob.getData(), reply->blob.getSize(), HTTPServer::releaseBlob, new Blob(reply->blob));
+		} else {
+			std::string* content = new std::string();
+			content->swap(reply->content);
+			evbuffer_add_reference(evb, content->data(), content->size(), HTTPServer::releaseContent, content);
+		}
 	}
 
 	evhttp_send_reply(reply->evhttpReq, reply->status, NULL, evb);
@@ -586,26 +826,102 @@ void HTTPServer::replyCallback(evutil_socket_t fd, short what, void *arg) {
 }
 
 
+HTTPServer::WSBuffer::WSBuffer(enum evws_opcode opcode, const char *data, uint64_t length) : refs(1) {
+	char header[EVWS_MAX_HEADER_SIZE];
+	size_t headerSize = evws_frame_header(header, opcode, length);
+	bytes.reserve(headerSize + length);
+	bytes.append(header, headerSize);
+	bytes.append(data, length);
+}
+
 void HTTPServer::wsSend(struct evws_connection *conn, enum evws_opcode opcode, const char *data, uint64_t length) {
 	HTTPServer* INSTANCE = getInstance();
-	WSData* sendCB = new WSData(conn, NULL, opcode, data, length);
+	WSData* sendCB = new WSData(conn, NULL, new WSBuffer(opcode, data, length));
 	event_base_once(INSTANCE->_base, -1, EV_TIMEOUT, HTTPServer::wsSendCallback, sendCB, NULL);
 }
 
 void HTTPServer::wsBroadcast(const char *uri, enum evws_opcode opcode, const char *data, uint64_t length) {
 	HTTPServer* INSTANCE = getInstance();
-	WSData* sendCB = new WSData(NULL, uri, opcode, data, length);
+	WSData* sendCB = new WSData(NULL, uri, new WSBuffer(opcode, data, length));
 	event_base_once(INSTANCE->_base, -1, EV_TIMEOUT, HTTPServer::wsSendCallback, sendCB, NULL);
 
 }
 
+void HTTPServer::setWSQueueLimit(size_t bytes, WSQueuePolicy policy) {
+	HTTPServer* INSTANCE = getInstance();
+	// applied on the websocket loop, in order with the frames sent before and after
+	WSQueueLimit* limitCB = new WSQueueLimit();
+	limitCB->bytes = bytes;
+	limitCB->policy = policy;
+	event_base_once(INSTANCE->_base, -1, EV_TIMEOUT, HTTPServer::wsQueueLimitCallback, limitCB, NULL);
+}
+
+void HTTPServer::wsQueueLimitCallback(evutil_socket_t fd, short what, void *arg) {
+	WSQueueLimit* limit = (WSQueueLimit*)arg;
+	HTTPServer* INSTANCE = getInstance();
+	INSTANCE->_wsQueueLimit = limit->bytes;
+	INSTANCE->_wsQueuePolicy = limit->policy;
+	delete limit;
+}
+
+Data HTTPServer::getWSStats() {
+	HTTPServer* INSTANCE = getInstance();
+	Data stats;
+	stats.compound["framesSent"] = Data(INSTANCE->_wsFramesSent.load(), Data::INTERPRETED);
+	stats.compound["bytesSent"] = Data(INSTANCE->_wsBytesSent.load(), Data::INTERPRETED);
+	stats.compound["framesDropped"] = Data(INSTANCE->_wsFramesDropped.load(), Data::INTERPRETED);
+	stats.compound["connectionsClosed"] = Data(INSTANCE->_wsConnectionsClosed.load(), Data::INTERPRETED);
+	return stats;
+}
+
+void HTTPServer::releaseWSBuffer(const void *data, size_t length, void *arg) {
+	((WSBuffer*)arg)->release();
+}
+
+/**
+ * Queue a reference to the frame unless the connection is too far behind
+ */
+void HTTPServer::wsSendFrame(struct evws_connection* conn, WSBuffer* frame) {
+	struct evbuffer* output = bufferevent_get_output(conn->bufev);
+	size_t queued = evbuffer_get_length(output);
+	size_t limit = _wsQueueLimit;
+
+	if (limit > 0 && queued > 0 && queued + frame->bytes.size() > limit) {
+		if (_wsQueuePolicy == WS_DROP_FRAMES) {
+			_wsFramesDropped++;
+		} else {
+			LOGD(USCXML_WARN) << "Closing websocket on " << conn->uri << " with " << queued << " bytes queued" << std::endl;
+			_wsConnectionsClosed++;
+			evws_connection_close(conn);
+		}
+		return;
+	}
+
+	frame->retain();
+	if (evbuffer_add_reference(output, frame->bytes.data(), frame->bytes.size(), HTTPServer::releaseWSBuffer, frame) != 0) {
+		frame->release();
+		return;
+	}
+	_wsFramesSent++;
+	_wsBytesSent += frame->bytes.size();
+}
+
 void HTTPServer::wsSendCallback(evutil_socket_t fd, short what, void *arg) {
 	WSData* wsSend = (WSData*)arg;
+	HTTPServer* INSTANCE = getInstance();
+
 	if (wsSend->uri.size() > 0) {
-		evws_broadcast(getInstance()->_evws, wsSend->uri.c_str(), wsSend->opcode, wsSend->data.data(), wsSend->data.length());
+		struct evws_connection* conn = INSTANCE->_evws->connections.tqh_first;
+		while(conn) {
+			// the connection might be closed
+			struct evws_connection* next = conn->next.tqe_next;
+			if (strcmp(conn->uri, wsSend->uri.c_str()) == 0)
+				INSTANCE->wsSendFrame(conn, wsSend->frame);
+			conn = next;
+		}
 	} else {
-		if (evws_is_valid_connection(getInstance()->_evws, wsSend->conn) > 0) {
-			evws_send_data(wsSend->conn, wsSend->opcode, wsSend->data.data(), wsSend->data.length());
+		if (evws_is_valid_connection(INSTANCE->_evws, wsSend->conn) > 0) {
+			INSTANCE->wsSendFrame(wsSend->conn, wsSend->frame);
 		}
 	}
 
@@ -632,7 +948,7 @@ bool HTTPServer::registerServlet(const std::string& path, HTTPServlet* servlet)
 
 	// if this servlet allows to adapt the path, do so
 	int i = 2;
-	while(INSTANCE->_httpServlets.find(suffixedPath) != INSTANCE->_httpServlets.end()) {
+	while(INSTANCE->_httpRoutes.contains(boost::to_lower_copy(suffixedPath))) {
 		if (!servlet->canAdaptPath())
 			return false;
 		std::stringstream ss;
@@ -645,25 +961,34 @@ bool HTTPServer::registerServlet(const std::string& path, HTTPServlet* servlet)
 	servlet->setURL(servletURL.str());
 
 	INSTANCE->_httpServlets[suffixedPath] = servlet;
+	INSTANCE->_httpRoutes.insert(boost::to_lower_copy(suffixedPath), servlet);
 //	LOG(USCXML_INFO) << "HTTP Servlet listening at: " << servletURL.str();
 
-	// register callback
-	evhttp_set_cb(INSTANCE->_http, ("/" + suffixedPath).c_str(), HTTPServer::httpRecvReqCallback, servlet);
+	// no callback with evhttp, it would compare the path of every request with every servlet
 
 	return true;
 }
 
 void HTTPServer::unregisterServlet(HTTPServlet* servlet) {
 	HTTPServer* INSTANCE = getInstance();
-	std::lock_guard<std::recursive_mutex> lock(INSTANCE->_mutex);
-	http_servlet_iter_t servletIter = INSTANCE->_httpServlets.begin();
-	while(servletIter != INSTANCE->_httpServlets.end()) {
-		if (servletIter->second == servlet) {
-			evhttp_del_cb(INSTANCE->_http, std::string("/" + servletIter->first).c_str());
-			INSTANCE->_httpServlets.erase(servletIter);
-			break;
+	{
+		std::lock_guard<std::recursive_mutex> lock(INSTANCE->_mutex);
+		http_servlet_iter_t servletIter = INSTANCE->_httpServlets.begin();
+		while(servletIter != INSTANCE->_httpServlets.end()) {
+			if (servletIter->second == servlet) {
+				INSTANCE->_httpRoutes.erase(boost::to_lower_copy(servletIter->first));
+				INSTANCE->_httpServlets.erase(servletIter);
+				break;
+			}
+			servletIter++;
+		}
+	}
+
+	// wait for requests still dispatched to the servlet, unless it is our own
+	if (!INSTANCE->isServerThread()) {
+		while(!INSTANCE->_httpRoutes.synchronize(std::chrono::seconds(5))) {
+			LOGD(USCXML_WARN) << "Unregistering HTTP servlet " << servlet << " still waits for requests dispatched before" << std::endl;
 		}
-		servletIter++;
 	}
 }
 
@@ -685,7 +1010,7 @@ bool HTTPServer::registerServlet(const std::string& path, WebSocketServlet* serv
 
 	// if this servlet allows to adapt the path, do so
 	int i = 2;
-	while(INSTANCE->_wsServlets.find(suffixedPath) != INSTANCE->_wsServlets.end()) {
+	while(INSTANCE->_wsRoutes.contains(boost::to_lower_copy(suffixedPath))) {
 		if (!servlet->canAdaptPath())
 			return false;
 		std::stringstream ss;
@@ -698,6 +1023,7 @@ bool HTTPServer::registerServlet(const std::string& path, WebSocketServlet* serv
 	servlet->setURL(servletURL.str());
 
 	INSTANCE->_wsServlets[suffixedPath] = servlet;
+	INSTANCE->_wsRoutes.insert(boost::to_lower_copy(suffixedPath), servlet);
 
 	//	LOG(USCXML_INFO) << "HTTP Servlet listening at: " << servletURL.str() << std::endl;
 
@@ -709,15 +1035,24 @@ bool HTTPServer::registerServlet(const std::string& path, WebSocketServlet* serv
 
 void HTTPServer::unregisterServlet(WebSocketServlet* servlet) {
 	HTTPServer* INSTANCE = getInstance();
-	std::lock_guard<std::recursive_mutex> lock(INSTANCE->_mutex);
-	ws_servlet_iter_t servletIter = INSTANCE->_wsServlets.begin();
-	while(servletIter != INSTANCE->_wsServlets.end()) {
-		if (servletIter->second == servlet) {
-			evhttp_del_cb(INSTANCE->_http, std::string("/" + servletIter->first).c_str());
-			INSTANCE->_wsServlets.erase(servletIter);
-			break;
+	{
+		std::lock_guard<std::recursive_mutex> lock(INSTANCE->_mutex);
+		ws_servlet_iter_t servletIter = INSTANCE->_wsServlets.begin();
+		while(servletIter != INSTANCE->_wsServlets.end()) {
+			if (servletIter->second == servlet) {
+				evhttp_del_cb(INSTANCE->_http, std::string("/" + servletIter->first).c_str());
+				INSTANCE->_wsRoutes.erase(boost::to_lower_copy(servletIter->first));
+				INSTANCE->_wsServlets.erase(servletIter);
+				break;
+			}
+			servletIter++;
+		}
+	}
+
+	if (!INSTANCE->isServerThread()) {
+		while(!INSTANCE->_wsRoutes.synchronize(std::chrono::seconds(5))) {
+			LOGD(USCXML_WARN) << "Unregistering WebSocket servlet " << servlet << " still waits for requests dispatched before" << std::endl;
 		}
-		servletIter++;
 	}
 }
 
@@ -746,22 +1081,27 @@ std::string HTTPServer::getBaseURL(ServerType type) {
 void HTTPServer::start() {
 	_isRunning = true;
 	_thread = new std::thread(HTTPServer::run, this);
+	for (auto worker : _workers) {
+		worker->thread = new std::thread(HTTPServer::runWorker, this, worker);
+	}
 }
 
 void HTTPServer::run(void* instance) {
 	HTTPServer* INSTANCE = (HTTPServer*)instance;
 	while(INSTANCE->_isRunning) {
-		// getting this to be non-polling is somewhat tricky and changes among versions
-//		event_base_loop(INSTANCE->_base, EVLOOP_ONCE | EVLOOP_NO_EXIT_ON_EMPTY);
-//		event_base_dispatch(INSTANCE->_base);
-
-		// BasicDelayedEventQueue::run
-		event_base_loop(INSTANCE->_base, EVLOOP_ONCE);
-
+		// blocks until there is something to do, the destructor activates the wake event
+		event_base_loop(INSTANCE->_base, HTTP_LOOP_FLAGS);
 	}
 	LOGD(USCXML_INFO) << "HTTP Server stopped" << std::endl;
 }
 
+void HTTPServer::runWorker(HTTPServer* server, Worker* worker) {
+	while(server->_isRunning) {
+		// see run above
+		event_base_loop(worker->base, HTTP_LOOP_FLAGS);
+	}
+}
+
 void HTTPServer::determineAddress() {
 	char hostname[1024];
 	gethostname(hostname, 1024);
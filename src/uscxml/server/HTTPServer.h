@@ -23,9 +23,11 @@
 #include <stddef.h>                     // for NULL
 
 #include <map>                          // for map, map<>::iterator, etc
+#include <vector>                       // for vector
 #include <string>                       // for string, operator<
 #include <thread>
 #include <mutex>
+#include <atomic>
 
 extern "C" {
 #include "event2/util.h"                // for evutil_socket_t
@@ -36,6 +38,7 @@ extern "C" {
 #include "uscxml/Common.h"              // for USCXML_API
 #include "uscxml/messages/Event.h"      // for Data, Event
 #include "uscxml/config.h"              // for OPENSSL_FOUND
+#include "uscxml/util/RadixTree.h"      // for RadixTree
 
 namespace uscxml {
 
@@ -44,15 +47,55 @@ class WebSocketServlet;
 
 class USCXML_API HTTPServer {
 public:
-	class Request : public Event {
+	/**
+	 * An HTTP request as an event.
+	 *
+	 * Only the type and path are in data when the request is dispatched to a
+	 * servlet. Headers, query parameters and content are decoded on first
+	 * access from the evhttp_request and everything else with decode(). This
+	 * has to happen while the request is dispatched, a copy kept beyond has
+	 * to be decoded before.
+	 */
+	class USCXML_API Request : public Event {
 	public:
-		Request() : evhttpReq(NULL) {}
+		Request() : evhttpReq(NULL), evBase(NULL), _decoded(0) {}
 		std::string content;
 		struct evhttp_request* evhttpReq;
+		struct event_base* evBase; ///< The event loop owning evhttpReq, replies are sent from there
 
 		operator bool() {
 			return evhttpReq != NULL;
 		}
+
+		const std::string& getType() const {
+			return data.compound.at("type").atom;
+		}
+		const std::string& getPath() const {
+			return data.compound.at("path").atom;
+		}
+
+		const Data& getHeaders() const;
+		const Data& getQuery() const;
+		const Data& getContent() const;
+
+		/// Decode the complete request into data and raw, e.g. before it becomes an event
+		void decode() const;
+
+	protected:
+		enum Decoded {
+			HEADERS    = 1 << 0,
+			QUERY      = 1 << 1,
+			CONTENT    = 1 << 2,
+			EVERYTHING = 1 << 3
+		};
+
+		Request& self() const {
+			// only the cached views of evhttpReq in data are changed
+			return const_cast<Request&>(*this);
+		}
+
+		mutable unsigned char _decoded;
+		mutable std::string _body; // undecoded content for raw
 	};
 
 	class USCXML_API SSLConfig {
@@ -72,19 +115,23 @@ public:
 
 	class USCXML_API Reply {
 	public:
-		Reply() : status(200), type("get"), evhttpReq(NULL) {}
-		Reply(Request req) : status(200), type(req.data.compound["type"].atom), evhttpReq(req.evhttpReq) {}
+		Reply() : status(200), type("get"), evhttpReq(NULL), evBase(NULL) {}
+		Reply(Request req) : status(200), type(req.data.compound["type"].atom), evhttpReq(req.evhttpReq), evBase(req.evBase) {}
 
 		void setRequest(Request req) {
 			type = req.data.compound["type"].atom;
 			evhttpReq = req.evhttpReq;
+			evBase = req.evBase;
 		}
 
 		int status;
 		std::string type;
 		std::map<std::string, std::string> headers;
 		std::string content;
+		Blob blob; ///< Sent by reference instead of content
+		std::string file; ///< Path of a local file sent instead of content, via sendfile where available
 		struct evhttp_request* evhttpReq;
+		struct event_base* evBase;
 	};
 
 	struct CallbackData {
@@ -98,7 +145,12 @@ public:
 		WebSockets
 	};
 
-	static HTTPServer* getInstance(unsigned short port, unsigned short wsPort, SSLConfig* sslConf = NULL);
+	/**
+	 * Get the server, it is created with the given ports on first call.
+	 * @param workers Number of event loops accepting HTTP requests on port, 0 to take
+	 *                USCXML_HTTP_WORKERS from the environment or a single one.
+	 */
+	static HTTPServer* getInstance(unsigned short port, unsigned short wsPort, SSLConfig* sslConf = NULL, size_t workers = 0);
 	static HTTPServer* getInstance() {
 		return getInstance(0, 0, NULL);
 	}
@@ -106,8 +158,27 @@ public:
 	static std::string getBaseURL(ServerType type = HTTP);
 
 	static void reply(const Reply& reply);
+	static void reply(Reply&& reply); ///< Take over the reply's content without a copy
 	static void wsSend(struct evws_connection *conn, enum evws_opcode opcode, const char *data, uint64_t length);
-	static void wsBroadcast(const char *uri, enum evws_opcode opcode, const char *data, uint64_t length);
+	static void wsBroadcast(const char *uri, enum evws_opcode opcode, const char *data, uint64_t length); ///< All recipients share a single copy of the frame
+
+	/// What to do with a websocket connection that does not keep up with the frames sent
+	enum WSQueuePolicy {
+		WS_DROP_FRAMES, ///< Skip frames for the connection until its queue drained
+		WS_DISCONNECT ///< Close the connection
+	};
+
+	/**
+	 * Limit the bytes queued for sending per websocket connection, 0 for no limit.
+	 *
+	 * The defaults are taken from USCXML_WS_QUEUE_LIMIT and USCXML_WS_QUEUE_POLICY
+	 * ("drop" or "disconnect") in the environment or 4MB and disconnect. A frame
+	 * is always queued for a connection with an empty queue. The new limit applies
+	 * to all frames sent after the call.
+	 */
+	static void setWSQueueLimit(size_t bytes, WSQueuePolicy policy = WS_DISCONNECT);
+	/// Frames and bytes queued, frames dropped and connections closed for the queue limit
+	static Data getWSStats();
 
 	static bool registerServlet(const std::string& path, HTTPServlet* servlet); ///< Register a servlet, returns false if path is already taken
 	static void unregisterServlet(HTTPServlet* servlet);
@@ -117,47 +188,78 @@ public:
 
 private:
 
+	/// An encoded frame, referenced by the output buffers of all its recipients
+	class WSBuffer {
+	public:
+		WSBuffer(enum evws_opcode opcode, const char *data, uint64_t length);
+		void retain() {
+			refs++;
+		}
+		void release() {
+			if (--refs == 0)
+				delete this;
+		}
+		std::string bytes;
+	protected:
+		std::atomic<size_t> refs;
+	};
+
 	class WSData {
 	public:
-		WSData(struct evws_connection *conn_, const char *uri_, enum evws_opcode opcode_, const char *data_, uint64_t length_) {
+		WSData(struct evws_connection *conn_, const char *uri_, WSBuffer* frame_) {
 			conn = conn_;
 			if (uri_)
 				uri = uri_;
-			opcode = opcode_;
-			data = std::string(data_, length_);
+			frame = frame_;
+		}
+		~WSData() {
+			frame->release();
 		}
 		struct evws_connection *conn;
-		std::string data;
 		std::string uri;
-		evws_opcode opcode;
+		WSBuffer* frame;
 	};
 
-	struct comp_strsize_less {
-		bool operator()(std::string const& l, std::string const& r) const {
-			if (l.size() < r.size())
-				return false;
-			return true;
-//			return l < r;
-		};
+	struct WSQueueLimit {
+		size_t bytes;
+		WSQueuePolicy policy;
+	};
+
+	/// An additional event loop for HTTP requests
+	struct Worker {
+		struct event_base* base;
+		struct evhttp* http;
+		struct event* wakeEvent;
+		std::thread* thread;
 	};
 
-	HTTPServer(unsigned short port, unsigned short wsPort, SSLConfig* sslConf);
+	HTTPServer(unsigned short port, unsigned short wsPort, SSLConfig* sslConf, size_t workers);
 	virtual ~HTTPServer();
 
 	void start();
 	void stop();
 	static void run(void* instance);
+	static void runWorker(HTTPServer* server, Worker* worker);
+
+	void setupHTTP(struct evhttp* http);
+	struct evhttp_bound_socket* bindReusePort(struct event_base* base, struct evhttp* http);
 
 	void determineAddress();
 
 	static void replyCallback(evutil_socket_t fd, short what, void *arg);
+	static void releaseContent(const void *data, size_t length, void *arg);
+	static void releaseBlob(const void *data, size_t length, void *arg);
 	static void wsSendCallback(evutil_socket_t fd, short what, void *arg);
+	static void releaseWSBuffer(const void *data, size_t length, void *arg);
+	static void wsQueueLimitCallback(evutil_socket_t fd, short what, void *arg);
+	void wsSendFrame(struct evws_connection* conn, WSBuffer* frame);
 
 	static void httpRecvReqCallback(struct evhttp_request *req, void *callbackData);
 	static void wsRecvReqCallback(struct evws_connection *conn, struct evws_frame *, void *callbackData);
 
 	void processByMatchingServlet(const Request& request);
 	void processByMatchingServlet(evws_connection* conn, const WSFrame& frame);
+	bool isServerThread();
 
 	static std::map<std::string, std::string> mimeTypes;
 	std::map<std::string, HTTPServlet*> _httpServlets;
@@ -166,14 +268,27 @@ private:
 	std::map<std::string, WebSocketServlet*> _wsServlets;
 	typedef std::map<std::string, WebSocketServlet*>::iterator ws_servlet_iter_t;
 
+	// lowercase servlet paths for lookups without locking _mutex
+	RadixTree<HTTPServlet*> _httpRoutes;
+	RadixTree<WebSocketServlet*> _wsRoutes;
+
 	struct event_base* _base;
 	struct evhttp* _http;
 	struct evws* _evws;
-	struct event* _dummyEvent;
+	struct event* _wakeEvent;
 
 	struct evhttp_bound_socket* _httpHandle;
 	evutil_socket_t _wsHandle;
 
+	// only read and changed on the thread of _base, so limit and policy always match
+	size_t _wsQueueLimit;
+	WSQueuePolicy _wsQueuePolicy;
+	// only changed on the thread of _base, atomic to be read from others
+	std::atomic<uint64_t> _wsFramesSent;
+	std::atomic<uint64_t> _wsBytesSent;
+	std::atomic<uint64_t> _wsFramesDropped;
+	std::atomic<uint64_t> _wsConnectionsClosed;
+
 	unsigned short _port;
 	unsigned short _wsPort;
 	std::string _address;
@@ -182,8 +297,9 @@ private:
 
 	static std::recursive_mutex _instanceMutex;
 	std::thread* _thread;
+	std::vector<Worker*> _workers;
 	std::recursive_mutex _mutex;
-	bool _isRunning;
+	std::atomic<bool> _isRunning; // checked by the event loops whenever they return
 
 	friend class HTTPServlet;
 	friend class WebSocketServlet;
@@ -26,8 +26,11 @@
 #include <math.h>
 #include <boost/algorithm/string.hpp>
 #include "uscxml/interpreter/Logging.h"
+#include "uscxml/debug/ProfileMonitor.h"
 
 #include <algorithm>
+#include <fstream>
+#include <sstream>
 #include <iomanip>
 
 namespace uscxml {
@@ -43,7 +46,7 @@ Transformer ChartToC::transform(const Interpreter& other) {
 	return std::shared_ptr<TransformerImpl>(c2c);
 }
 
-ChartToC::ChartToC(const Interpreter& other) : TransformerImpl(other), _topMostMachine(NULL), _parentMachine(NULL) {
+ChartToC::ChartToC(const Interpreter& other) : TransformerImpl(other), _topMostMachine(NULL), _parentMachine(NULL), _profileMaxEntered(0), _profileMaxTaken(0) {
 
 	std::stringstream ss;
 	ss << _document;
@@ -110,12 +113,11 @@ void ChartToC::setHistoryCompletion() {
 		}
 		perParentcovered.insert(perParentcovered.end(), completion.begin(), completion.end());
 
-		std::string completionBools;
+		std::set<DOMElement*> completionSet(completion.begin(), completion.end());
+		std::string completionBools(_states.size(), '0');
 		for (size_t j = 0; j < _states.size(); j++) {
-			if (DOMUtils::isMember(_states[j], completion)) {
-				completionBools += "1";
-			} else {
-				completionBools += "0";
+			if (completionSet.find(_states[j]) != completionSet.end()) {
+				completionBools[j] = '1';
 			}
 		}
 		history->setAttribute(X("completionBools"), X(completionBools));
@@ -205,7 +207,7 @@ void ChartToC::setStateCompletion() {
 			completion = getChildStates(state);
 
 		} else if (HAS_ATTR(state, kXMLCharInitial)) {
-			completion = getStates(tokenize(ATTR(state, kXMLCharInitial)), _scxml);
+			completion = _stateIndex->getStates(tokenize(ATTR(state, kXMLCharInitial)));
 
 		} else {
 			std::list<DOMElement*> initElems = DOMUtils::filterChildElements(XML_PREFIX(state).str() + "initial", state);
@@ -228,12 +230,11 @@ void ChartToC::setStateCompletion() {
 			}
 		}
 
-		std::string completionBools;
+		std::set<DOMElement*> completionSet(completion.begin(), completion.end());
+		std::string completionBools(_states.size(), '0');
 		for (size_t j = 0; j < _states.size(); j++) {
-			if (DOMUtils::isMember(_states[j], completion)) {
-				completionBools += "1";
-			} else {
-				completionBools += "0";
+			if (completionSet.find(_states[j]) != completionSet.end()) {
+				completionBools[j] = '1';
 			}
 		}
 		state->setAttribute(X("completionBools"), X(completionBools));
@@ -242,6 +243,20 @@ void ChartToC::setStateCompletion() {
 
 void ChartToC::prepare() {
 
+	// profiles identify elements per XPath in the original document
+	std::list<XERCESC_NS::DOMElement*> profiled = DOMUtils::inDocumentOrder({
+		XML_PREFIX(_scxml).str() + "scxml",
+		XML_PREFIX(_scxml).str() + "state",
+		XML_PREFIX(_scxml).str() + "final",
+		XML_PREFIX(_scxml).str() + "history",
+		XML_PREFIX(_scxml).str() + "initial",
+		XML_PREFIX(_scxml).str() + "parallel",
+		XML_PREFIX(_scxml).str() + "transition"
+	}, _scxml);
+	for (auto elem : profiled) {
+		_profileKeys[elem] = DOMUtils::xPathForNode(elem);
+	}
+
 	// make sure initial and history elements always precede propoer states
 	resortStates(_scxml);
 
@@ -255,6 +270,13 @@ void ChartToC::prepare() {
 	}, _scxml);
 	_states.insert(_states.end(), tmp.begin(), tmp.end());
 
+	// index the state tree for ancestry, exit sets and conflicts
+	_stateIndex = std::make_shared<StateIndex>(_scxml);
+	std::vector<size_t> stateIndex(_states.size());
+	for (size_t i = 0; i < _states.size(); i++) {
+		stateIndex[i] = _stateIndex->indexOf(_states[i]);
+	}
+
 	// set states' document order and parent attribute
 	for (size_t i = 0; i < _states.size(); i++) {
 		DOMElement* state(_states[i]);
@@ -283,12 +305,10 @@ void ChartToC::prepare() {
 		}
 
 		// ancestors
-		std::string ancBools;
+		std::string ancBools(_states.size(), '0');
 		for (size_t j = 0; j < _states.size(); j++) {
-			if (DOMUtils::isDescendant(state, _states[j])) {
-				ancBools += "1";
-			} else {
-				ancBools += "0";
+			if (_stateIndex->isDescendant(stateIndex[i], stateIndex[j])) {
+				ancBools[j] = '1';
 			}
 		}
 		state->setAttribute(X("ancBools"), X(ancBools));
@@ -323,34 +343,33 @@ void ChartToC::prepare() {
 
 	_transitions.insert(_transitions.end(), tmp.begin(), tmp.end());
 
+	std::vector<size_t> transIndex(_transitions.size());
+	for (size_t i = 0; i < _transitions.size(); i++) {
+		transIndex[i] = _stateIndex->transitionIndexOf(_transitions[i]);
+	}
+
 	for (size_t i = 0; i < _transitions.size(); i++) {
 		DOMElement* transition(_transitions[i]);
 		transition->setAttribute(X("postFixOrder"), X(toStr(i)));
 
+		if (transIndex[i] == StateIndex::npos) {
+			ERROR_PLATFORM_THROW("Transition " + DOMUtils::xPathForNode(transition) + " is not within a state");
+		}
+
 		// and exit set
-		std::string exitSetBools;
-		std::list<DOMElement*> exitSet = getExitSet(transition, _scxml);
+		std::string exitSetBools(_states.size(), '0');
 		for (unsigned int j = 0; j < _states.size(); j++) {
-			DOMElement* state(_states[j]);
-			if (DOMUtils::isMember(state, exitSet)) {
-				exitSetBools += "1";
-			} else {
-				exitSetBools += "0";
+			if (_stateIndex->isInExitSet(stateIndex[j], transIndex[i])) {
+				exitSetBools[j] = '1';
 			}
 		}
 		transition->setAttribute(X("exitSetBools"), X(exitSetBools));
 
 		// and conflicts
-		std::string conflictBools;
+		std::string conflictBools(_transitions.size(), '0');
 		for (unsigned int j = 0; j < _transitions.size(); j++) {
-			DOMElement* t2(_transitions[j]);
-			if (DOMUtils::hasIntersection(getExitSet(transition, _scxml), getExitSet(t2, _scxml)) ||
-			        (getSourceState(transition) == getSourceState(t2)) ||
-			        (DOMUtils::isDescendant(getSourceState(transition), getSourceState(t2))) ||
-			        (DOMUtils::isDescendant(getSourceState(t2), getSourceState(transition)))) {
-				conflictBools += "1";
-			} else {
-				conflictBools += "0";
+			if (_stateIndex->conflicts(transIndex[i], transIndex[j])) {
+				conflictBools[j] = '1';
 			}
 		}
 		transition->setAttribute(X("conflictBools"), X(conflictBools));
@@ -432,10 +451,15 @@ void ChartToC::prepare() {
 }
 
 void ChartToC::writeTo(std::ostream& stream) {
+	loadProfile();
 
 	stream << "/**" << std::endl;
 	stream << "  Generated from source:" << std::endl;
 	stream << "  " << (std::string)_baseURL << std::endl;
+	if (!_profile.empty()) {
+		stream << "  Annotated with profile over " << _profile["events"].atom << " events:" << std::endl;
+		stream << "  " << _extensions.find("profile")->second << std::endl;
+	}
 	stream << "*/" << std::endl;
 	stream << std::endl;
 
@@ -451,6 +475,7 @@ void ChartToC::writeTo(std::ostream& stream) {
 		(*machIter)->writeExecContent(stream);
 		(*machIter)->writeStates(stream);
 		(*machIter)->writeTransitions(stream);
+		(*machIter)->writeEventInfo(stream);
 		(*machIter)->writeMachineInfo(stream);
 	}
 	writeHelpers(stream);
@@ -460,6 +485,101 @@ void ChartToC::writeTo(std::ostream& stream) {
 
 }
 
+void ChartToC::loadProfile() {
+	if (_extensions.find("profile") == _extensions.end())
+		return;
+
+	std::string profileFile = _extensions.find("profile")->second;
+	std::ifstream profileStream(profileFile);
+	if (!profileStream) {
+		ERROR_PLATFORM_THROW("Cannot read profile from " + profileFile);
+	}
+	std::stringstream ss;
+	ss << profileStream.rdbuf();
+	_profile = Data::fromJSON(ss.str());
+	if (_profile.empty()) {
+		ERROR_PLATFORM_THROW("Cannot parse profile from " + profileFile);
+	}
+
+	// a profile is only meaningful for the document it was recorded for
+	if (!_profile.hasKey("document") || _profile["document"]["md5"].atom != ProfileMonitor::documentId(interpreter)) {
+		ERROR_PLATFORM_THROW("Profile " + profileFile + " was not recorded for this document");
+	}
+	for (auto& key : _profileKeys) {
+		if (_profile["states"].hasKey(key.second) && _profile["states"][key.second].hasKey("entered")) {
+			size_t entered = strTo<size_t>(_profile["states"][key.second]["entered"].atom);
+			_profileMaxEntered = (entered > _profileMaxEntered ? entered : _profileMaxEntered);
+		}
+		if (_profile["transitions"].hasKey(key.second) && _profile["transitions"][key.second].hasKey("taken")) {
+			size_t taken = strTo<size_t>(_profile["transitions"][key.second]["taken"].atom);
+			_profileMaxTaken = (taken > _profileMaxTaken ? taken : _profileMaxTaken);
+		}
+	}
+}
+
+/**
+ * Executable content is hot if it ran at least a tenth as often as the
+ * hottest of its kind and cold if it never ran.
+ */
+std::string ChartToC::profileAttributes(const XERCESC_NS::DOMElement* element) {
+	ChartToC* topMostMachine = (_topMostMachine == NULL ? this : _topMostMachine);
+	if (topMostMachine != this || _profile.empty() || _profileKeys.find(element) == _profileKeys.end())
+		return "";
+
+	const std::string& key = _profileKeys[element];
+	size_t count = 0;
+	size_t max = 0;
+	if (TAGNAME(element) == XML_PREFIX(element).str() + "transition") {
+		max = _profileMaxTaken;
+		if (_profile["transitions"].hasKey(key) && _profile["transitions"][key].hasKey("taken"))
+			count = strTo<size_t>(_profile["transitions"][key]["taken"].atom);
+	} else {
+		max = _profileMaxEntered;
+		if (_profile["states"].hasKey(key) && _profile["states"][key].hasKey("entered"))
+			count = strTo<size_t>(_profile["states"][key]["entered"].atom);
+	}
+
+	if (max == 0)
+		return "";
+	if (count == 0)
+		return "USCXML_COLD ";
+	if (count * 10 >= max)
+		return "USCXML_HOT ";
+	return "";
+}
+
+/**
+ * Guards of transitions taken in more than 90% of the events processed
+ * with their source active are likely, those taken in less than 10% unlikely.
+ */
+std::string ChartToC::profileCondition(const XERCESC_NS::DOMElement* transition, const std::string& cond) {
+	ChartToC* topMostMachine = (_topMostMachine == NULL ? this : _topMostMachine);
+	if (topMostMachine != this || _profile.empty() || _profileKeys.find(transition) == _profileKeys.end())
+		return "(" + cond + ")";
+
+	const DOMElement* source = static_cast<const DOMElement*>(transition->getParentNode());
+	if (_profileKeys.find(source) == _profileKeys.end())
+		return "(" + cond + ")";
+
+	const std::string& transKey = _profileKeys[transition];
+	const std::string& sourceKey = _profileKeys[source];
+
+	size_t taken = 0;
+	size_t dwell = 0;
+	if (_profile["transitions"].hasKey(transKey) && _profile["transitions"][transKey].hasKey("taken"))
+		taken = strTo<size_t>(_profile["transitions"][transKey]["taken"].atom);
+	if (_profile["states"].hasKey(sourceKey) && _profile["states"][sourceKey].hasKey("dwell"))
+		dwell = strTo<size_t>(_profile["states"][sourceKey]["dwell"].atom);
+
+	if (dwell == 0)
+		return "(" + cond + ")";
+	if (taken * 10 > dwell * 9)
+		return "likely(" + cond + ")";
+	if (taken * 10 < dwell)
+		return "unlikely(" + cond + ")";
+	return "(" + cond + ")";
+}
+
 void ChartToC::writeForwardDeclarations(std::ostream& stream) {
 	stream << "/* forward declare machines to allow references */" << std::endl;
 	for (std::list<ChartToC*>::iterator machIter = _allMachines.begin(); machIter != _allMachines.end(); machIter++) {
@@ -524,6 +644,70 @@ void ChartToC::writeIncludes(std::ostream& stream) {
 }
 
 void ChartToC::writeMacros(std::ostream& stream) {
+	if (_extensions.find("bitops") != _extensions.end()) {
+		std::string bitOps = _extensions.find("bitops")->second;
+		if (bitOps == "words" || bitOps == "simd") {
+			stream << "/* requested per -X bitops=" << bitOps << " */" << std::endl;
+			stream << "#ifndef USCXML_BIT_WORDS" << std::endl;
+			stream << "#  define USCXML_BIT_WORDS" << std::endl;
+			stream << "#endif" << std::endl;
+		}
+		if (bitOps == "simd") {
+			stream << "#ifndef USCXML_BIT_SIMD" << std::endl;
+			stream << "#  define USCXML_BIT_SIMD" << std::endl;
+			stream << "#endif" << std::endl;
+		}
+		stream << std::endl;
+	}
+
+	if (_extensions.find("batch") != _extensions.end() && _extensions.find("batch")->second == "on") {
+		stream << "/* requested per -X batch=on */" << std::endl;
+		stream << "#ifndef USCXML_BATCH" << std::endl;
+		stream << "#  define USCXML_BATCH" << std::endl;
+		stream << "#endif" << std::endl;
+		stream << std::endl;
+	}
+
+	stream << "#ifndef USCXML_BIT_ALIGN" << std::endl;
+	stream << std::endl;
+	stream << "/**" << std::endl;
+	stream << " * Width of the bit operations" << std::endl;
+	stream << " * " << std::endl;
+	stream << " *    USCXML_BIT_WORDS" << std::endl;
+	stream << " *      operate on the bit arrays in 64bit words rather than bytes." << std::endl;
+	stream << " *    USCXML_BIT_SIMD" << std::endl;
+	stream << " *      additionally use SSE2 / AVX2 if the compiler targets them." << std::endl;
+	stream << " * " << std::endl;
+	stream << " * All bit arrays are then padded (and, as a hint, aligned) to USCXML_BIT_WORD_BYTES, make" << std::endl;
+	stream << " * sure USCXML_MAX_NR_STATES_BYTES and USCXML_MAX_NR_TRANS_BYTES are multiples" << std::endl;
+	stream << " * thereof if you provide them yourself." << std::endl;
+	stream << " */" << std::endl;
+	stream << std::endl;
+
+	stream << "#ifdef USCXML_BIT_WORDS" << std::endl;
+	stream << "#  if defined(USCXML_BIT_SIMD) && defined(__AVX2__)" << std::endl;
+	stream << "#    include <immintrin.h>" << std::endl;
+	stream << "#    define USCXML_BIT_WORD_BYTES 32" << std::endl;
+	stream << "#  elif defined(USCXML_BIT_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))" << std::endl;
+	stream << "#    include <emmintrin.h>" << std::endl;
+	stream << "#    define USCXML_BIT_WORD_BYTES 16" << std::endl;
+	stream << "#  else" << std::endl;
+	stream << "#    define USCXML_BIT_WORD_BYTES 8" << std::endl;
+	stream << "#  endif" << std::endl;
+	stream << "#  define USCXML_BIT_PAD(bytes) ((((bytes) + USCXML_BIT_WORD_BYTES - 1) / USCXML_BIT_WORD_BYTES) * USCXML_BIT_WORD_BYTES)" << std::endl;
+	stream << "#  ifdef _MSC_VER" << std::endl;
+	stream << "#    define USCXML_BIT_ALIGN __declspec(align(USCXML_BIT_WORD_BYTES))" << std::endl;
+	stream << "#  else" << std::endl;
+	stream << "#    define USCXML_BIT_ALIGN __attribute__((aligned(USCXML_BIT_WORD_BYTES)))" << std::endl;
+	stream << "#  endif" << std::endl;
+	stream << "#else" << std::endl;
+	stream << "#  define USCXML_BIT_PAD(bytes) (bytes)" << std::endl;
+	stream << "#  define USCXML_BIT_ALIGN" << std::endl;
+	stream << "#endif" << std::endl;
+	stream << std::endl;
+	stream << "#endif" << std::endl;
+	stream << std::endl;
+
 	stream << "#ifndef USCXML_NO_GEN_C_MACROS" << std::endl;
 	stream << std::endl;
 	stream << "/**" << std::endl;
@@ -572,7 +756,7 @@ void ChartToC::writeMacros(std::ostream& stream) {
 	stream << std::endl;
 
 	stream << "#ifndef USCXML_MAX_NR_STATES_BYTES " << std::endl;
-	stream << "#  define USCXML_MAX_NR_STATES_BYTES " << (std::max)((size_t)1, _stateCharArraySize) << std::endl;
+	stream << "#  define USCXML_MAX_NR_STATES_BYTES USCXML_BIT_PAD(" << (std::max)((size_t)1, _stateCharArraySize) << ")" << std::endl;
 	stream << "#endif " << std::endl;
 	stream << std::endl;
 
@@ -583,7 +767,7 @@ void ChartToC::writeMacros(std::ostream& stream) {
 	stream << std::endl;
 
 	stream << "#ifndef USCXML_MAX_NR_TRANS_BYTES " << std::endl;
-	stream << "#  define USCXML_MAX_NR_TRANS_BYTES " << (std::max)((size_t)1, _transCharArraySize) << std::endl;
+	stream << "#  define USCXML_MAX_NR_TRANS_BYTES USCXML_BIT_PAD(" << (std::max)((size_t)1, _transCharArraySize) << ")" << std::endl;
 	stream << "#endif " << std::endl;
 	stream << std::endl;
 
@@ -638,6 +822,21 @@ void ChartToC::writeMacros(std::ostream& stream) {
 	stream << "#endif" << std::endl;
 	stream << std::endl;
 
+	stream << "/* executable content per profile, cold functions are placed apart */" << std::endl;
+	stream << "#ifndef USCXML_HOT" << std::endl;
+	stream << "#  if defined(__clang__)" << std::endl;
+	stream << "#    define USCXML_HOT" << std::endl;
+	stream << "#    define USCXML_COLD     __attribute__((cold))" << std::endl;
+	stream << "#  elif defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 3))" << std::endl;
+	stream << "#    define USCXML_HOT      __attribute__((hot))" << std::endl;
+	stream << "#    define USCXML_COLD     __attribute__((cold))" << std::endl;
+	stream << "#  else" << std::endl;
+	stream << "#    define USCXML_HOT" << std::endl;
+	stream << "#    define USCXML_COLD" << std::endl;
+	stream << "#  endif" << std::endl;
+	stream << "#endif" << std::endl;
+	stream << std::endl;
+
 	stream << "/* error return codes */" << std::endl;
 	stream << "#define USCXML_ERR_OK                0" << std::endl;
 	stream << "#define USCXML_ERR_IDLE              1" << std::endl;
@@ -710,12 +909,17 @@ void ChartToC::writeTypes(std::ostream& stream) {
 	stream << "typedef struct uscxml_elem_assign uscxml_elem_assign;" << std::endl;
 	stream << "typedef struct uscxml_elem_donedata uscxml_elem_donedata;" << std::endl;
 	stream << "typedef struct uscxml_elem_foreach uscxml_elem_foreach;" << std::endl;
+	stream << "#ifdef USCXML_BATCH" << std::endl;
+	stream << "typedef struct uscxml_batch uscxml_batch;" << std::endl;
+	stream << "#endif" << std::endl;
 	stream << std::endl;
 
 	stream << "typedef void* (*dequeue_internal_t)(const uscxml_ctx* ctx);" << std::endl;
 	stream << "typedef void* (*dequeue_external_t)(const uscxml_ctx* ctx);" << std::endl;
 	stream << "typedef int (*is_enabled_t)(const uscxml_ctx* ctx, const uscxml_transition* transition);" << std::endl;
 	stream << "typedef int (*is_matched_t)(const uscxml_ctx* ctx, const uscxml_transition* transition, const void* event);" << std::endl;
+	stream << "typedef int (*event_id_t)(const uscxml_ctx* ctx, const void* event);" << std::endl;
+	stream << "#define USCXML_HAS_EVENT_ID" << std::endl;
 	stream << "typedef int (*is_true_t)(const uscxml_ctx* ctx, const char* expr);" << std::endl;
 	stream << "typedef int (*exec_content_t)(const uscxml_ctx* ctx, const uscxml_state* state, const void* event);" << std::endl;
 	stream << "typedef int (*raise_done_event_t)(const uscxml_ctx* ctx, const uscxml_state* state, const uscxml_elem_donedata* donedata);" << std::endl;
@@ -750,6 +954,12 @@ void ChartToC::writeTypes(std::ostream& stream) {
 	stream << "    const uscxml_machine*       parent;" << std::endl;
 	stream << "    const uscxml_elem_donedata* donedata;" << std::endl;
 	stream << "    const exec_content_t        script;          /* Global script elements */" << std::endl;
+	stream << "    const int                   nr_events;       /* Number of event descriptors */" << std::endl;
+	stream << "    const char* const*          event_names;     /* Event descriptors by id, see uscxml_event_id() */" << std::endl;
+	stream << "    const int*                  event_slots;     /* Perfect hash table from event names to ids */" << std::endl;
+	stream << "    const uint32_t              event_hash_size; /* Number of slots, a power of two */" << std::endl;
+	stream << "    const uint32_t              event_hash_seed;" << std::endl;
+	stream << "    const unsigned char*        event_transitions; /* Per event id the transitions matching, USCXML_MAX_NR_TRANS_BYTES each */" << std::endl;
 	stream << "};" << std::endl;
 	stream << std::endl;
 
@@ -785,9 +995,9 @@ void ChartToC::writeTypes(std::ostream& stream) {
 	stream << "    const exec_content_t on_entry;                     /* on entry handlers      */" << std::endl;
 	stream << "    const exec_content_t on_exit;                      /* on exit handlers       */" << std::endl;
 	stream << "    const invoke_t invoke;                             /* invocations            */" << std::endl;
-	stream << "    const unsigned char children[USCXML_MAX_NR_STATES_BYTES];   /* all children           */" << std::endl;
-	stream << "    const unsigned char completion[USCXML_MAX_NR_STATES_BYTES]; /* default completion     */" << std::endl;
-	stream << "    const unsigned char ancestors[USCXML_MAX_NR_STATES_BYTES];  /* all ancestors          */" << std::endl;
+	stream << "    USCXML_BIT_ALIGN const unsigned char children[USCXML_MAX_NR_STATES_BYTES];   /* all children           */" << std::endl;
+	stream << "    USCXML_BIT_ALIGN const unsigned char completion[USCXML_MAX_NR_STATES_BYTES]; /* default completion     */" << std::endl;
+	stream << "    USCXML_BIT_ALIGN const unsigned char ancestors[USCXML_MAX_NR_STATES_BYTES];  /* all ancestors          */" << std::endl;
 	stream << "    const uscxml_elem_data* data;                      /* data with late binding */" << std::endl;
 	stream << "    const unsigned char type;                          /* One of USCXML_STATE_*  */" << std::endl;
 	stream << "};" << std::endl;
@@ -798,14 +1008,14 @@ void ChartToC::writeTypes(std::ostream& stream) {
 	stream << " */" << std::endl;
 	stream << "struct uscxml_transition {" << std::endl;
 	stream << "    const USCXML_NR_STATES_TYPE source;" << std::endl;
-	stream << "    const unsigned char target[USCXML_MAX_NR_STATES_BYTES];" << std::endl;
+	stream << "    USCXML_BIT_ALIGN const unsigned char target[USCXML_MAX_NR_STATES_BYTES];" << std::endl;
 	stream << "    const char* event;" << std::endl;
 	stream << "    const char* condition;" << std::endl;
 	stream << "    const is_enabled_t is_enabled;" << std::endl;
 	stream << "    const exec_content_t on_transition;" << std::endl;
 	stream << "    const unsigned char type;" << std::endl;
-	stream << "    const unsigned char conflicts[USCXML_MAX_NR_TRANS_BYTES];" << std::endl;
-	stream << "    const unsigned char exit_set[USCXML_MAX_NR_STATES_BYTES];" << std::endl;
+	stream << "    USCXML_BIT_ALIGN const unsigned char conflicts[USCXML_MAX_NR_TRANS_BYTES];" << std::endl;
+	stream << "    USCXML_BIT_ALIGN const unsigned char exit_set[USCXML_MAX_NR_STATES_BYTES];" << std::endl;
 	stream << "};" << std::endl;
 	stream << std::endl;
 
@@ -891,10 +1101,10 @@ void ChartToC::writeTypes(std::ostream& stream) {
 	stream << "    unsigned char         flags;" << std::endl;
 	stream << "    const uscxml_machine* machine;" << std::endl;
 	stream << std::endl;
-	stream << "    unsigned char config[USCXML_MAX_NR_STATES_BYTES]; /* Make sure these macros specify a sufficient size */" << std::endl;
-	stream << "    unsigned char history[USCXML_MAX_NR_STATES_BYTES];" << std::endl;
-	stream << "    unsigned char invocations[USCXML_MAX_NR_STATES_BYTES];" << std::endl;
-	stream << "    unsigned char initialized_data[USCXML_MAX_NR_STATES_BYTES];" << std::endl;
+	stream << "    USCXML_BIT_ALIGN unsigned char config[USCXML_MAX_NR_STATES_BYTES]; /* Make sure these macros specify a sufficient size */" << std::endl;
+	stream << "    USCXML_BIT_ALIGN unsigned char history[USCXML_MAX_NR_STATES_BYTES];" << std::endl;
+	stream << "    USCXML_BIT_ALIGN unsigned char invocations[USCXML_MAX_NR_STATES_BYTES];" << std::endl;
+	stream << "    USCXML_BIT_ALIGN unsigned char initialized_data[USCXML_MAX_NR_STATES_BYTES];" << std::endl;
 	stream << std::endl;
 	stream << "    void* user_data;" << std::endl;
 	stream << "    void* event;" << std::endl;
@@ -902,6 +1112,7 @@ void ChartToC::writeTypes(std::ostream& stream) {
 	stream << "    dequeue_internal_t dequeue_internal;" << std::endl;
 	stream << "    dequeue_external_t dequeue_external;" << std::endl;
 	stream << "    is_matched_t       is_matched;" << std::endl;
+	stream << "    event_id_t         event_id;         /* Optional, the event id per uscxml_event_id() saves is_matched calls */" << std::endl;
 	stream << "    is_true_t          is_true;" << std::endl;
 	stream << "    raise_done_event_t raise_done_event;" << std::endl;
 	stream << std::endl;
@@ -919,6 +1130,26 @@ void ChartToC::writeTypes(std::ostream& stream) {
 	stream << "    invoke_t invoke;" << std::endl;
 	stream << "};" << std::endl;
 	stream << std::endl;
+
+	stream << "#ifdef USCXML_BATCH" << std::endl;
+	stream << "/**" << std::endl;
+	stream << " * Many instances of the same machine, stepped with uscxml_step_batch()." << std::endl;
+	stream << " * The configurations are kept as one plane per state with a bit per instance." << std::endl;
+	stream << " */" << std::endl;
+	stream << "struct uscxml_batch {" << std::endl;
+	stream << "    uscxml_ctx**   ctxs;" << std::endl;
+	stream << "    size_t         nr_ctxs;" << std::endl;
+	stream << "    size_t         lane_bytes; /* bytes per plane */" << std::endl;
+	stream << "    unsigned char* planes;     /* USCXML_BATCH_BYTES(nr_ctxs), aligned as USCXML_BIT_ALIGN */" << std::endl;
+	stream << "    int*           results;    /* optional, result of the last step per instance */" << std::endl;
+	stream << "};" << std::endl;
+	stream << std::endl;
+	stream << "#define USCXML_BATCH_LANE_BYTES(nr_ctxs) USCXML_BIT_PAD(((nr_ctxs) + 7) >> 3)" << std::endl;
+	stream << "#define USCXML_BATCH_BYTES(nr_ctxs) \\" << std::endl;
+	stream << "    ((USCXML_MAX_NR_STATES_BYTES * 8 + USCXML_MAX_NR_TRANS_BYTES * 16 + 1) * USCXML_BATCH_LANE_BYTES(nr_ctxs))" << std::endl;
+	stream << "#endif" << std::endl;
+	stream << std::endl;
+
 	stream << "#define USCXML_NO_GEN_C_TYPES" << std::endl;
 	stream << "#endif" << std::endl;
 	stream << std::endl;
@@ -961,6 +1192,98 @@ void ChartToC::writeHelpers(std::ostream& stream) {
 	stream << std::endl;
 
 	stream << "#ifndef USCXML_NO_BIT_OPERATIONS" << std::endl;
+	stream << "#ifdef USCXML_BIT_WORDS" << std::endl;
+	stream << "/**" << std::endl;
+	stream << " * Word-wide bit operations, all arrays are padded to USCXML_BIT_WORD_BYTES" << std::endl;
+	stream << " * and i is always a multiple thereof. Loads and stores are unaligned, so" << std::endl;
+	stream << " * contexts need not respect USCXML_BIT_ALIGN when allocated by the caller." << std::endl;
+	stream << " */" << std::endl;
+	stream << "#if USCXML_BIT_WORD_BYTES == 32" << std::endl;
+	stream << "#  define USCXML_BIT_LOAD(p)      _mm256_loadu_si256((const __m256i*)(p))" << std::endl;
+	stream << "#  define USCXML_BIT_STORE(p, v)  _mm256_storeu_si256((__m256i*)(p), v)" << std::endl;
+	stream << "#  define USCXML_BIT_OR(a, b)     _mm256_or_si256(a, b)" << std::endl;
+	stream << "#  define USCXML_BIT_AND(a, b)    _mm256_and_si256(a, b)" << std::endl;
+	stream << "#  define USCXML_BIT_AND_NOT(a, b) _mm256_andnot_si256(b, a)" << std::endl;
+	stream << "#  define USCXML_BIT_ZERO         _mm256_setzero_si256()" << std::endl;
+	stream << "#  define USCXML_BIT_IS_ZERO(v)   _mm256_testz_si256(v, v)" << std::endl;
+	stream << "#elif USCXML_BIT_WORD_BYTES == 16" << std::endl;
+	stream << "#  define USCXML_BIT_LOAD(p)      _mm_loadu_si128((const __m128i*)(p))" << std::endl;
+	stream << "#  define USCXML_BIT_STORE(p, v)  _mm_storeu_si128((__m128i*)(p), v)" << std::endl;
+	stream << "#  define USCXML_BIT_OR(a, b)     _mm_or_si128(a, b)" << std::endl;
+	stream << "#  define USCXML_BIT_AND(a, b)    _mm_and_si128(a, b)" << std::endl;
+	stream << "#  define USCXML_BIT_AND_NOT(a, b) _mm_andnot_si128(b, a)" << std::endl;
+	stream << "#  define USCXML_BIT_ZERO         _mm_setzero_si128()" << std::endl;
+	stream << "#  define USCXML_BIT_IS_ZERO(v)   (_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xFFFF)" << std::endl;
+	stream << "#else" << std::endl;
+	stream << "#  ifdef __GNUC__" << std::endl;
+	stream << "typedef uint64_t __attribute__((__may_alias__)) uscxml_bit_word;" << std::endl;
+	stream << "#  else" << std::endl;
+	stream << "typedef uint64_t uscxml_bit_word;" << std::endl;
+	stream << "#  endif" << std::endl;
+	stream << "#  define USCXML_BIT_LOAD(p)      (*(const uscxml_bit_word*)(p))" << std::endl;
+	stream << "#  define USCXML_BIT_STORE(p, v)  (*(uscxml_bit_word*)(p) = (v))" << std::endl;
+	stream << "#  define USCXML_BIT_OR(a, b)     ((a) | (b))" << std::endl;
+	stream << "#  define USCXML_BIT_AND(a, b)    ((a) & (b))" << std::endl;
+	stream << "#  define USCXML_BIT_AND_NOT(a, b) ((a) & ~(b))" << std::endl;
+	stream << "#  define USCXML_BIT_ZERO         ((uscxml_bit_word)0)" << std::endl;
+	stream << "#  define USCXML_BIT_IS_ZERO(v)   ((v) == 0)" << std::endl;
+	stream << "#endif" << std::endl;
+	stream << std::endl;
+	stream << "static int bit_has_and(const unsigned char* a, const unsigned char* b, size_t i) {" << std::endl;
+	stream << "    size_t j;" << std::endl;
+	stream << "    for (j = 0; j < i; j += USCXML_BIT_WORD_BYTES) {" << std::endl;
+	stream << "        if (!USCXML_BIT_IS_ZERO(USCXML_BIT_AND(USCXML_BIT_LOAD(a + j), USCXML_BIT_LOAD(b + j))))" << std::endl;
+	stream << "            return 1;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    return 0;" << std::endl;
+	stream << "}" << std::endl;
+	stream << std::endl;
+	stream << "static void bit_clear_all(unsigned char* a, size_t i) {" << std::endl;
+	stream << "    size_t j;" << std::endl;
+	stream << "    for (j = 0; j < i; j += USCXML_BIT_WORD_BYTES) {" << std::endl;
+	stream << "        USCXML_BIT_STORE(a + j, USCXML_BIT_ZERO);" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "}" << std::endl;
+	stream << std::endl;
+	stream << "static int bit_has_any(unsigned const char* a, size_t i) {" << std::endl;
+	stream << "    size_t j;" << std::endl;
+	stream << "    for (j = 0; j < i; j += USCXML_BIT_WORD_BYTES) {" << std::endl;
+	stream << "        if (!USCXML_BIT_IS_ZERO(USCXML_BIT_LOAD(a + j)))" << std::endl;
+	stream << "            return 1;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    return 0;" << std::endl;
+	stream << "}" << std::endl;
+	stream << std::endl;
+	stream << "static void bit_or(unsigned char* dest, const unsigned char* mask, size_t i) {" << std::endl;
+	stream << "    size_t j;" << std::endl;
+	stream << "    for (j = 0; j < i; j += USCXML_BIT_WORD_BYTES) {" << std::endl;
+	stream << "        USCXML_BIT_STORE(dest + j, USCXML_BIT_OR(USCXML_BIT_LOAD(dest + j), USCXML_BIT_LOAD(mask + j)));" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "}" << std::endl;
+	stream << std::endl;
+	stream << "static void bit_copy(unsigned char* dest, const unsigned char* source, size_t i) {" << std::endl;
+	stream << "    size_t j;" << std::endl;
+	stream << "    for (j = 0; j < i; j += USCXML_BIT_WORD_BYTES) {" << std::endl;
+	stream << "        USCXML_BIT_STORE(dest + j, USCXML_BIT_LOAD(source + j));" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "}" << std::endl;
+	stream << std::endl;
+	stream << "static void bit_and_not(unsigned char* dest, const unsigned char* mask, size_t i) {" << std::endl;
+	stream << "    size_t j;" << std::endl;
+	stream << "    for (j = 0; j < i; j += USCXML_BIT_WORD_BYTES) {" << std::endl;
+	stream << "        USCXML_BIT_STORE(dest + j, USCXML_BIT_AND_NOT(USCXML_BIT_LOAD(dest + j), USCXML_BIT_LOAD(mask + j)));" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "}" << std::endl;
+	stream << std::endl;
+	stream << "static void bit_and(unsigned char* dest, const unsigned char* mask, size_t i) {" << std::endl;
+	stream << "    size_t j;" << std::endl;
+	stream << "    for (j = 0; j < i; j += USCXML_BIT_WORD_BYTES) {" << std::endl;
+	stream << "        USCXML_BIT_STORE(dest + j, USCXML_BIT_AND(USCXML_BIT_LOAD(dest + j), USCXML_BIT_LOAD(mask + j)));" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "}" << std::endl;
+	stream << std::endl;
+	stream << "#else" << std::endl;
+	stream << std::endl;
 	stream << "/**" << std::endl;
 	stream << " * Return true if there is a common bit in a and b." << std::endl;
 	stream << " */" << std::endl;
@@ -1036,6 +1359,7 @@ void ChartToC::writeHelpers(std::ostream& stream) {
 	stream << "    };" << std::endl;
 	stream << "}" << std::endl;
 	stream << std::endl;
+	stream << "#endif" << std::endl;
 	stream << "#define USCXML_NO_BIT_OPERATIONS" << std::endl;
 	stream << "#endif" << std::endl;
 	stream << std::endl;
@@ -1111,7 +1435,7 @@ void ChartToC::writeExecContent(std::ostream& stream) {
 			size_t j = 0;
 			for (auto iter = onexits.begin(); iter != onexits.end(); iter++, j++) {
 				DOMElement* onexit = *iter;
-				stream << "static int " << _prefix << "_" << DOMUtils::idForNode(state) << "_on_exit_" << toStr(j) << "(const uscxml_ctx* ctx, const uscxml_state* state, const void* event) {" << std::endl;
+				stream << "static " << profileAttributes(state) << "int " << _prefix << "_" << DOMUtils::idForNode(state) << "_on_exit_" << toStr(j) << "(const uscxml_ctx* ctx, const uscxml_state* state, const void* event) {" << std::endl;
 				stream << "    int err = USCXML_ERR_OK;" << std::endl;
 				writeExecContent(stream, onexit, 1);
 				stream << "    return USCXML_ERR_OK;" << std::endl;
@@ -1120,7 +1444,7 @@ void ChartToC::writeExecContent(std::ostream& stream) {
 			}
 
 			if (onexits.size() > 0) {
-				stream << "static int " << _prefix << "_" << DOMUtils::idForNode(state) << "_on_exit(const uscxml_ctx* ctx, const uscxml_state* state, const void* event) {" << std::endl;
+				stream << "static " << profileAttributes(state) << "int " << _prefix << "_" << DOMUtils::idForNode(state) << "_on_exit(const uscxml_ctx* ctx, const uscxml_state* state, const void* event) {" << std::endl;
 				for (size_t j = 0; j < onexits.size(); j++) {
 					stream << "    " << _prefix << "_" << DOMUtils::idForNode(state) << "_on_exit_" << toStr(j) << "(ctx, state, event);" << std::endl;
 				}
@@ -1136,7 +1460,7 @@ void ChartToC::writeExecContent(std::ostream& stream) {
 			size_t j = 0;
 			for (auto iter = onentrys.begin(); iter != onentrys.end(); iter++, j++) {
 				DOMElement* onentry = *iter;
-				stream << "static int " << _prefix << "_" << DOMUtils::idForNode(state) << "_on_entry_" << toStr(j) << "(const uscxml_ctx* ctx, const uscxml_state* state, const void* event) {" << std::endl;
+				stream << "static " << profileAttributes(state) << "int " << _prefix << "_" << DOMUtils::idForNode(state) << "_on_entry_" << toStr(j) << "(const uscxml_ctx* ctx, const uscxml_state* state, const void* event) {" << std::endl;
 				stream << "    int err = USCXML_ERR_OK;" << std::endl;
 				writeExecContent(stream, onentry, 1);
 				stream << "    return USCXML_ERR_OK;" << std::endl;
@@ -1145,7 +1469,7 @@ void ChartToC::writeExecContent(std::ostream& stream) {
 			}
 
 			if (onentrys.size() > 0) {
-				stream << "static int " << _prefix << "_" << DOMUtils::idForNode(state) << "_on_entry(const uscxml_ctx* ctx, const uscxml_state* state, const void* event) {" << std::endl;
+				stream << "static " << profileAttributes(state) << "int " << _prefix << "_" << DOMUtils::idForNode(state) << "_on_entry(const uscxml_ctx* ctx, const uscxml_state* state, const void* event) {" << std::endl;
 				for (size_t j = 0; j < onentrys.size(); j++) {
 					stream << "    " << _prefix << "_" << DOMUtils::idForNode(state) << "_on_entry_" << toStr(j) << "(ctx, state, event);" << std::endl;
 				}
@@ -1159,7 +1483,7 @@ void ChartToC::writeExecContent(std::ostream& stream) {
 		{
 			std::list<DOMElement*> invokes = DOMUtils::filterChildElements(XML_PREFIX(state).str() + "invoke", state);
 			if (invokes.size() > 0) {
-				stream << "static int " << _prefix << "_" << DOMUtils::idForNode(state) << "_invoke(const uscxml_ctx* ctx, const uscxml_state* s, const uscxml_elem_invoke* invocation, unsigned char uninvoke) {" << std::endl;
+				stream << "static " << profileAttributes(state) << "int " << _prefix << "_" << DOMUtils::idForNode(state) << "_invoke(const uscxml_ctx* ctx, const uscxml_state* s, const uscxml_elem_invoke* invocation, unsigned char uninvoke) {" << std::endl;
 
 				size_t j = 0;
 				for (auto iter = invokes.begin(); iter != invokes.end(); iter++, j++) {
@@ -1178,9 +1502,9 @@ void ChartToC::writeExecContent(std::ostream& stream) {
 		std::list<DOMNode*> execContent = DOMUtils::filterChildType(DOMNode::ELEMENT_NODE, transition);
 
 		if (HAS_ATTR(transition, kXMLCharCond)) {
-			stream << "static int " << _prefix << "_" << DOMUtils::idForNode(transition) << "_is_enabled(const uscxml_ctx* ctx, const uscxml_transition* transition) {" << std::endl;
+			stream << "static " << profileAttributes(transition) << "int " << _prefix << "_" << DOMUtils::idForNode(transition) << "_is_enabled(const uscxml_ctx* ctx, const uscxml_transition* transition) {" << std::endl;
 			if (_hasNativeDataModel) {
-				stream << "    return (" << ATTR(transition, kXMLCharCond) << ");" << std::endl;
+				stream << "    return " << profileCondition(transition, ATTR(transition, kXMLCharCond)) << ";" << std::endl;
 			} else {
 				stream << "    if likely(ctx->is_true != NULL) {" << std::endl;
 				stream << "        return (ctx->is_true(ctx, \"" << escape(ATTR(transition, kXMLCharCond)) << "\"));" << std::endl;
@@ -1191,7 +1515,7 @@ void ChartToC::writeExecContent(std::ostream& stream) {
 		}
 
 		if (execContent.size() > 0) {
-			stream << "static int " << _prefix << "_" << DOMUtils::idForNode(transition) << "_on_trans(const uscxml_ctx* ctx, const uscxml_state* state, const void* event) {" << std::endl;
+			stream << "static " << profileAttributes(transition) << "int " << _prefix << "_" << DOMUtils::idForNode(transition) << "_on_trans(const uscxml_ctx* ctx, const uscxml_state* state, const void* event) {" << std::endl;
 			stream << "    int err = USCXML_ERR_OK;" << std::endl;
 			for (auto iter = execContent.begin(); iter != execContent.end(); iter++) {
 //                LOGD(USCXML_VERBATIM) << LOCALNAME(static_cast<DOMElement*>(*iter));
@@ -1873,11 +2197,18 @@ void ChartToC::writeMachineInfo(std::ostream& stream) {
 	stream << "        /* donedata       */ " << "&" << _prefix << "_elem_donedatas[0], " << std::endl;
 	stream << "        /* script         */ ";
 	if (DOMUtils::filterChildElements(XML_PREFIX(_scxml).str() + "script", _scxml).size() > 0) {
-		stream << _prefix << "_global_script" << std::endl;
+		stream << _prefix << "_global_script";
 	} else {
 		stream << "NULL";
 	}
-	stream << std::endl;
+	stream << "," << std::endl;
+
+	stream << "        /* nr_events      */ " << (_events.size() - 1) << "," << std::endl;
+	stream << "        /* event_names    */ &" << _prefix << "_event_names[0]," << std::endl;
+	stream << "        /* event_slots    */ &" << _prefix << "_event_slots[0]," << std::endl;
+	stream << "        /* event_hash_size */ " << _eventSlots.size() << "," << std::endl;
+	stream << "        /* event_hash_seed */ " << _eventHashSeed << "u," << std::endl;
+	stream << "        /* event_transitions */ &" << _prefix << "_event_transitions[0][0]" << std::endl;
 
 	stream << "};" << std::endl;
 	stream << std::endl;
@@ -2140,6 +2471,143 @@ void ChartToC::writeTransitions(std::ostream& stream) {
 
 }
 
+static uint32_t eventHash(const std::string& name, uint32_t seed) {
+	// FNV-1a with the offset basis as seed, has to match uscxml_event_id()
+	uint32_t hash = seed;
+	for (size_t i = 0; i < name.size(); i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static std::string normalizeEventDesc(std::string eventDesc) {
+	// remove optional trailing .* as in nameMatch
+	if (eventDesc.size() > 0 && eventDesc[eventDesc.size() - 1] == '*')
+		eventDesc = eventDesc.substr(0, eventDesc.size() - 1);
+	if (eventDesc.size() > 0 && eventDesc[eventDesc.size() - 1] == '.')
+		eventDesc = eventDesc.substr(0, eventDesc.size() - 1);
+	return eventDesc;
+}
+
+void ChartToC::writeEventInfo(std::ostream& stream) {
+
+	// every distinct event descriptor gets an id
+	std::set<std::string> eventDescs;
+	for (auto transition : _transitions) {
+		if (!HAS_ATTR(transition, kXMLCharEvent))
+			continue;
+		std::list<std::string> descs = tokenize(ATTR(transition, kXMLCharEvent));
+		for (auto desc : descs) {
+			desc = normalizeEventDesc(desc);
+			if (desc.size() > 0)
+				eventDescs.insert(desc);
+		}
+	}
+
+	_events.clear();
+	_events.push_back("");
+	_events.insert(_events.end(), eventDescs.begin(), eventDescs.end());
+
+	// find a seed for a collision free table with at least twice as many slots as events
+	size_t hashSize = 1;
+	while (hashSize < 2 * (_events.size() - 1))
+		hashSize <<= 1;
+
+	while(true) {
+		for (_eventHashSeed = 2166136261u; _eventHashSeed < 2166136261u + 4096; _eventHashSeed++) {
+			_eventSlots.assign(hashSize, 0);
+			size_t i = 1;
+			for (; i < _events.size(); i++) {
+				size_t slot = eventHash(_events[i], _eventHashSeed) & (hashSize - 1);
+				if (_eventSlots[slot] != 0)
+					break;
+				_eventSlots[slot] = i;
+			}
+			if (i == _events.size())
+				goto FOUND_SEED;
+		}
+		hashSize <<= 1;
+	}
+FOUND_SEED:
+
+	stream << "#ifndef USCXML_NO_ELEM_INFO" << std::endl;
+	stream << std::endl;
+
+	// identifiers for the enum
+	std::set<std::string> enumNames;
+	stream << "enum {" << std::endl;
+	stream << "    " << _prefix << "_EVENT_NONE = 0";
+	for (size_t i = 1; i < _events.size(); i++) {
+		std::string enumName = boost::to_upper_copy(_events[i]);
+		for (size_t j = 0; j < enumName.size(); j++) {
+			if (!isalnum((unsigned char)enumName[j]))
+				enumName[j] = '_';
+		}
+		if (enumNames.find(enumName) != enumNames.end())
+			enumName += "_" + toStr(i);
+		enumNames.insert(enumName);
+
+		stream << "," << std::endl;
+		stream << "    " << _prefix << "_EVENT_" << enumName << " = " << i << " /* " << escape(_events[i]) << " */";
+	}
+	stream << std::endl;
+	stream << "};" << std::endl;
+	stream << std::endl;
+
+	stream << "static const char* const " << _prefix << "_event_names[" << _events.size() << "] = {" << std::endl;
+	stream << "    NULL";
+	for (size_t i = 1; i < _events.size(); i++) {
+		stream << "," << std::endl << "    \"" << escape(_events[i]) << "\"";
+	}
+	stream << std::endl;
+	stream << "};" << std::endl;
+	stream << std::endl;
+
+	stream << "static const int " << _prefix << "_event_slots[" << _eventSlots.size() << "] = {" << std::endl;
+	stream << "    ";
+	for (size_t i = 0; i < _eventSlots.size(); i++) {
+		stream << (i > 0 ? ", " : "") << _eventSlots[i];
+	}
+	stream << std::endl;
+	stream << "};" << std::endl;
+	stream << std::endl;
+
+	// transitions enabled per event id, the wildcard and all prefixes of a descriptor
+	stream << "static const unsigned char " << _prefix << "_event_transitions[" << _events.size() << "][USCXML_MAX_NR_TRANS_BYTES] = {" << std::endl;
+	for (size_t i = 0; i < _events.size(); i++) {
+		std::string transBools;
+		for (auto transition : _transitions) {
+			bool matches = false;
+			if (HAS_ATTR(transition, kXMLCharEvent)) {
+				std::list<std::string> descs = tokenize(ATTR(transition, kXMLCharEvent));
+				for (auto desc : descs) {
+					desc = normalizeEventDesc(desc);
+					if (desc.size() == 0 ||
+					        (i > 0 && (_events[i] == desc || boost::starts_with(_events[i], desc + ".")))) {
+						matches = true;
+						break;
+					}
+				}
+			}
+			transBools += (matches ? "1" : "0");
+		}
+
+		stream << "    { ";
+		if (transBools.size() > 0) {
+			writeCharArrayInitList(stream, transBools);
+		} else {
+			stream << "0x00";
+		}
+		stream << " /* " << (i > 0 ? escape(_events[i]) : "*") << " */ }" << (i + 1 < _events.size() ? "," : "") << std::endl;
+	}
+	stream << "};" << std::endl;
+	stream << std::endl;
+
+	stream << "#endif" << std::endl;
+	stream << std::endl;
+}
+
 void ChartToC::writeCharArrayInitList(std::ostream& stream, const std::string& boolString) {
 	/**
 	 * 0111 -> 0x08
@@ -2184,20 +2652,68 @@ void ChartToC::writeCharArrayInitList(std::ostream& stream, const std::string& b
 
 void ChartToC::writeFSM(std::ostream& stream) {
 	stream << "#ifndef USCXML_NO_STEP_FUNCTION" << std::endl;
-	stream << "int uscxml_step(uscxml_ctx* ctx) {" << std::endl;
+	stream << "/**" << std::endl;
+	stream << " * Return the id of the longest event descriptor of the machine that matches" << std::endl;
+	stream << " * the given event name or 0 if there is none. Resolve the id once when creating" << std::endl;
+	stream << " * an event and return it from the event_id callback to avoid is_matched calls." << std::endl;
+	stream << " */" << std::endl;
+	stream << "int uscxml_event_id(const uscxml_machine* machine, const char* name) {" << std::endl;
+	stream << "    const char* desc;" << std::endl;
+	stream << "    size_t length, i;" << std::endl;
+	stream << "    uint32_t hash;" << std::endl;
+	stream << "    int id;" << std::endl;
+	stream << std::endl;
+	stream << "    if (name == NULL || machine->event_slots == NULL)" << std::endl;
+	stream << "        return 0;" << std::endl;
+	stream << std::endl;
+	stream << "    for (length = 0; name[length] != '\\0'; length++);" << std::endl;
+	stream << std::endl;
+	stream << "    while (length > 0) {" << std::endl;
+	stream << "        hash = machine->event_hash_seed;" << std::endl;
+	stream << "        for (i = 0; i < length; i++) {" << std::endl;
+	stream << "            hash ^= (unsigned char)name[i];" << std::endl;
+	stream << "            hash *= 16777619u;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "        id = machine->event_slots[hash & (machine->event_hash_size - 1)];" << std::endl;
+	stream << "        if (id > 0) {" << std::endl;
+	stream << "            desc = machine->event_names[id];" << std::endl;
+	stream << "            for (i = 0; i < length && desc[i] == name[i]; i++);" << std::endl;
+	stream << "            if (i == length && desc[i] == '\\0')" << std::endl;
+	stream << "                return id;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "        /* retry with the name up to its last dot */" << std::endl;
+	stream << "        while (length > 0 && name[--length] != '.');" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    return 0;" << std::endl;
+	stream << "}" << std::endl;
+	stream << std::endl;
+
+	stream << "/**" << std::endl;
+	stream << " * Perform a microstep, if selected is not NULL it holds the eventless" << std::endl;
+	stream << " * transitions already selected for a context with USCXML_CTX_SPONTANEOUS." << std::endl;
+	stream << " */" << std::endl;
+	stream << "static int uscxml_step_selected(uscxml_ctx* ctx, const unsigned char* selected) {" << std::endl;
 	stream << std::endl;
 
 	stream << "    " << (_states.size() > _transitions.size() ? "USCXML_NR_STATES_TYPE" : "USCXML_NR_TRANS_TYPE") << " i, j, k;" << std::endl;
+	stream << "#ifdef USCXML_BIT_WORDS" << std::endl;
+	stream << "    /* known at compile time, bits past the number of states are never set */" << std::endl;
+	stream << "    const size_t nr_states_bytes = USCXML_MAX_NR_STATES_BYTES;" << std::endl;
+	stream << "    const size_t nr_trans_bytes  = USCXML_MAX_NR_TRANS_BYTES;" << std::endl;
+	stream << "#else" << std::endl;
 	stream << "    USCXML_NR_STATES_TYPE nr_states_bytes = ((USCXML_NUMBER_STATES + 7) & ~7) >> 3;" << std::endl;
 	stream << "    USCXML_NR_TRANS_TYPE  nr_trans_bytes  = ((USCXML_NUMBER_TRANS + 7) & ~7) >> 3;" << std::endl;
+	stream << "#endif" << std::endl;
 	stream << "    int err = USCXML_ERR_OK;" << std::endl;
+	stream << "    int event_id;" << std::endl;
+	stream << "    const unsigned char* event_transitions;" << std::endl;
 
-	stream << "    unsigned char conflicts  [USCXML_MAX_NR_TRANS_BYTES];" << std::endl;
-	stream << "    unsigned char trans_set  [USCXML_MAX_NR_TRANS_BYTES];" << std::endl;
-	stream << "    unsigned char target_set [USCXML_MAX_NR_STATES_BYTES];" << std::endl;
-	stream << "    unsigned char exit_set   [USCXML_MAX_NR_STATES_BYTES];" << std::endl;
-	stream << "    unsigned char entry_set  [USCXML_MAX_NR_STATES_BYTES];" << std::endl;
-	stream << "    unsigned char tmp_states [USCXML_MAX_NR_STATES_BYTES];" << std::endl;
+	stream << "    USCXML_BIT_ALIGN unsigned char conflicts  [USCXML_MAX_NR_TRANS_BYTES];" << std::endl;
+	stream << "    USCXML_BIT_ALIGN unsigned char trans_set  [USCXML_MAX_NR_TRANS_BYTES];" << std::endl;
+	stream << "    USCXML_BIT_ALIGN unsigned char target_set [USCXML_MAX_NR_STATES_BYTES];" << std::endl;
+	stream << "    USCXML_BIT_ALIGN unsigned char exit_set   [USCXML_MAX_NR_STATES_BYTES];" << std::endl;
+	stream << "    USCXML_BIT_ALIGN unsigned char entry_set  [USCXML_MAX_NR_STATES_BYTES];" << std::endl;
+	stream << "    USCXML_BIT_ALIGN unsigned char tmp_states [USCXML_MAX_NR_STATES_BYTES];" << std::endl;
 	stream << std::endl;
 
 	stream << "#ifdef USCXML_VERBOSE" << std::endl;
@@ -2284,6 +2800,30 @@ void ChartToC::writeFSM(std::ostream& stream) {
 	stream << "SELECT_TRANSITIONS:" << std::endl;
 	stream << "    bit_clear_all(conflicts, nr_trans_bytes);" << std::endl;
 	stream << "    bit_clear_all(exit_set, nr_states_bytes);" << std::endl;
+	stream << std::endl;
+	stream << "    if (selected != NULL) {" << std::endl;
+	stream << "        /* transitions were selected per uscxml_step_batch() */" << std::endl;
+	stream << "        for (i = 0; i < USCXML_NUMBER_TRANS; i++) {" << std::endl;
+	stream << "            if (BIT_HAS(i, selected)) {" << std::endl;
+	stream << "                ctx->flags |= USCXML_CTX_TRANSITION_FOUND;" << std::endl;
+	stream << "                bit_or(target_set, USCXML_GET_TRANS(i).target, nr_states_bytes);" << std::endl;
+	stream << "                bit_or(exit_set, USCXML_GET_TRANS(i).exit_set, nr_states_bytes);" << std::endl;
+	stream << "                BIT_SET_AT(i, trans_set);" << std::endl;
+	stream << "            }" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "        /* select as usual once we dequeued an event */" << std::endl;
+	stream << "        selected = NULL;" << std::endl;
+	stream << "        goto ESTABLISH_EXIT_SET;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "    /* with an event id, the transitions matching the event are known */" << std::endl;
+	stream << "    event_transitions = NULL;" << std::endl;
+	stream << "    if (ctx->event != NULL && ctx->event_id != NULL && ctx->machine->event_transitions != NULL) {" << std::endl;
+	stream << "        event_id = ctx->event_id(ctx, ctx->event);" << std::endl;
+	stream << "        if (event_id >= 0 && event_id <= ctx->machine->nr_events)" << std::endl;
+	stream << "            event_transitions = ctx->machine->event_transitions + event_id * USCXML_MAX_NR_TRANS_BYTES;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
 	stream << "    for (i = 0; i < USCXML_NUMBER_TRANS; i++) {" << std::endl;
 	stream << "        /* never select history or initial transitions automatically */" << std::endl;
 	stream << "        if unlikely(USCXML_GET_TRANS(i).type & (USCXML_TRANS_HISTORY | USCXML_TRANS_INITIAL))" << std::endl;
@@ -2297,7 +2837,8 @@ void ChartToC::writeFSM(std::ostream& stream) {
 	stream << "                if ((USCXML_GET_TRANS(i).event == NULL && ctx->event == NULL) || " << std::endl;
 	stream << "                    (USCXML_GET_TRANS(i).event != NULL && ctx->event != NULL)) {" << std::endl;
 	stream << "                    /* is it enabled? */" << std::endl;
-	stream << "                    if ((ctx->event == NULL || ctx->is_matched(ctx, &USCXML_GET_TRANS(i), ctx->event) > 0) &&" << std::endl;
+	stream << "                    if ((ctx->event == NULL ||" << std::endl;
+	stream << "                         (event_transitions != NULL ? BIT_HAS(i, event_transitions) : ctx->is_matched(ctx, &USCXML_GET_TRANS(i), ctx->event) > 0)) &&" << std::endl;
 	stream << "                        (USCXML_GET_TRANS(i).condition == NULL || " << std::endl;
 	stream << "                         USCXML_GET_TRANS(i).is_enabled(ctx, &USCXML_GET_TRANS(i)) > 0)) {" << std::endl;
 	stream << "                        /* remember that we found a transition */" << std::endl;
@@ -2319,6 +2860,8 @@ void ChartToC::writeFSM(std::ostream& stream) {
 	stream << "            }" << std::endl;
 	stream << "        }" << std::endl;
 	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "ESTABLISH_EXIT_SET:" << std::endl;
 	stream << "    bit_and(exit_set, ctx->config, nr_states_bytes);" << std::endl;
 	stream << std::endl;
 
@@ -2615,11 +3158,160 @@ void ChartToC::writeFSM(std::ostream& stream) {
 	stream << "}" << std::endl;
 	stream << std::endl;
 
+	stream << "int uscxml_step(uscxml_ctx* ctx) {" << std::endl;
+	stream << "    return uscxml_step_selected(ctx, NULL);" << std::endl;
+	stream << "}" << std::endl;
+	stream << std::endl;
+
+	writeBatchFSM(stream);
+
 	stream << "#define USCXML_NO_STEP_FUNCTION" << std::endl;
 	stream << "#endif" << std::endl;
 	stream << std::endl;
 }
 
+void ChartToC::writeBatchFSM(std::ostream& stream) {
+	stream << "#ifdef USCXML_BATCH" << std::endl;
+	stream << "/**" << std::endl;
+	stream << " * Copy the configuration of an instance into its column of the state planes." << std::endl;
+	stream << " */" << std::endl;
+	stream << "static void uscxml_batch_load(uscxml_batch* batch, size_t lane) {" << std::endl;
+	stream << "    const uscxml_ctx* ctx = batch->ctxs[lane];" << std::endl;
+	stream << "    unsigned char* plane = batch->planes + (lane >> 3);" << std::endl;
+	stream << "    unsigned char mask = (unsigned char)(1 << (lane & 7));" << std::endl;
+	stream << "    size_t i;" << std::endl;
+	stream << std::endl;
+	stream << "    for (i = 0; i < USCXML_NUMBER_STATES; i++, plane += batch->lane_bytes) {" << std::endl;
+	stream << "        if (BIT_HAS(i, ctx->config)) {" << std::endl;
+	stream << "            *plane |= mask;" << std::endl;
+	stream << "        } else {" << std::endl;
+	stream << "            *plane &= (unsigned char)~mask;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "}" << std::endl;
+	stream << std::endl;
+
+	stream << "/**" << std::endl;
+	stream << " * Prepare a batch of contexts for the same machine, planes has to provide" << std::endl;
+	stream << " * USCXML_BATCH_BYTES(nr_ctxs) bytes and stays in use by the batch." << std::endl;
+	stream << " */" << std::endl;
+	stream << "void uscxml_batch_init(uscxml_batch* batch, uscxml_ctx** ctxs, size_t nr_ctxs, unsigned char* planes) {" << std::endl;
+	stream << "    size_t lane;" << std::endl;
+	stream << std::endl;
+	stream << "    batch->ctxs = ctxs;" << std::endl;
+	stream << "    batch->nr_ctxs = nr_ctxs;" << std::endl;
+	stream << "    batch->lane_bytes = USCXML_BATCH_LANE_BYTES(nr_ctxs);" << std::endl;
+	stream << "    batch->planes = planes;" << std::endl;
+	stream << "    batch->results = NULL;" << std::endl;
+	stream << std::endl;
+	stream << "    bit_clear_all(planes, USCXML_BATCH_BYTES(nr_ctxs));" << std::endl;
+	stream << "    for (lane = 0; lane < nr_ctxs; lane++) {" << std::endl;
+	stream << "        uscxml_batch_load(batch, lane);" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "}" << std::endl;
+	stream << std::endl;
+
+	stream << "/**" << std::endl;
+	stream << " * Perform one step per instance as uscxml_step() would. Eventless transitions" << std::endl;
+	stream << " * are selected for all instances at once with bit operations over the planes," << std::endl;
+	stream << " * everything else is done per instance. Returns USCXML_ERR_OK if any instance" << std::endl;
+	stream << " * performed a microstep, USCXML_ERR_IDLE if any is waiting for events and" << std::endl;
+	stream << " * USCXML_ERR_DONE otherwise, see results for the individual outcomes." << std::endl;
+	stream << " */" << std::endl;
+	stream << "int uscxml_step_batch(uscxml_batch* batch) {" << std::endl;
+	stream << "    const size_t lane_bytes = batch->lane_bytes;" << std::endl;
+	stream << "    unsigned char* config    = batch->planes;" << std::endl;
+	stream << "    unsigned char* selected  = config + USCXML_MAX_NR_STATES_BYTES * 8 * lane_bytes;" << std::endl;
+	stream << "    unsigned char* conflicts = selected + USCXML_MAX_NR_TRANS_BYTES * 8 * lane_bytes;" << std::endl;
+	stream << "    unsigned char* lanes     = conflicts + USCXML_MAX_NR_TRANS_BYTES * 8 * lane_bytes;" << std::endl;
+	stream << "    unsigned char* enabled;" << std::endl;
+	stream << "    USCXML_BIT_ALIGN unsigned char trans_set[USCXML_MAX_NR_TRANS_BYTES];" << std::endl;
+	stream << "    uscxml_ctx* ctx;" << std::endl;
+	stream << "    size_t i, j, lane;" << std::endl;
+	stream << "    int err, result = USCXML_ERR_DONE;" << std::endl;
+	stream << std::endl;
+	stream << "    if (batch->nr_ctxs == 0)" << std::endl;
+	stream << "        return USCXML_ERR_DONE;" << std::endl;
+	stream << "    ctx = batch->ctxs[0];" << std::endl;
+	stream << std::endl;
+	stream << "    /* instances that are about to select eventless transitions */" << std::endl;
+	stream << "    bit_clear_all(lanes, lane_bytes);" << std::endl;
+	stream << "    for (lane = 0; lane < batch->nr_ctxs; lane++) {" << std::endl;
+	stream << "        if ((batch->ctxs[lane]->flags & (USCXML_CTX_SPONTANEOUS | USCXML_CTX_TOP_LEVEL_FINAL | USCXML_CTX_FINISHED)) == USCXML_CTX_SPONTANEOUS) {" << std::endl;
+	stream << "            /* as in DEQUEUE_EVENT, guards must not see the previous event */" << std::endl;
+	stream << "            batch->ctxs[lane]->event = NULL;" << std::endl;
+	stream << "            BIT_SET_AT(lane, lanes);" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "    if (bit_has_any(lanes, lane_bytes)) {" << std::endl;
+	stream << "        bit_clear_all(conflicts, USCXML_NUMBER_TRANS * lane_bytes);" << std::endl;
+	stream << "        for (i = 0; i < USCXML_NUMBER_TRANS; i++) {" << std::endl;
+	stream << "            enabled = selected + i * lane_bytes;" << std::endl;
+	stream << "            bit_clear_all(enabled, lane_bytes);" << std::endl;
+	stream << std::endl;
+	stream << "            if unlikely(USCXML_GET_TRANS(i).type & (USCXML_TRANS_HISTORY | USCXML_TRANS_INITIAL))" << std::endl;
+	stream << "                continue;" << std::endl;
+	stream << "            if (USCXML_GET_TRANS(i).event != NULL)" << std::endl;
+	stream << "                continue;" << std::endl;
+	stream << std::endl;
+	stream << "            /* instances with the transition active and not pre-empted */" << std::endl;
+	stream << "            bit_copy(enabled, config + USCXML_GET_TRANS(i).source * lane_bytes, lane_bytes);" << std::endl;
+	stream << "            bit_and(enabled, lanes, lane_bytes);" << std::endl;
+	stream << "            bit_and_not(enabled, conflicts + i * lane_bytes, lane_bytes);" << std::endl;
+	stream << "            if (!bit_has_any(enabled, lane_bytes))" << std::endl;
+	stream << "                continue;" << std::endl;
+	stream << std::endl;
+	stream << "            /* conditions depend on the data of every instance */" << std::endl;
+	stream << "            if (USCXML_GET_TRANS(i).condition != NULL) {" << std::endl;
+	stream << "                for (lane = 0; lane < batch->nr_ctxs; lane++) {" << std::endl;
+	stream << "                    if (BIT_HAS(lane, enabled) &&" << std::endl;
+	stream << "                        USCXML_GET_TRANS(i).is_enabled(batch->ctxs[lane], &USCXML_GET_TRANS(i)) <= 0) {" << std::endl;
+	stream << "                        BIT_CLEAR(lane, enabled);" << std::endl;
+	stream << "                    }" << std::endl;
+	stream << "                }" << std::endl;
+	stream << "                if (!bit_has_any(enabled, lane_bytes))" << std::endl;
+	stream << "                    continue;" << std::endl;
+	stream << "            }" << std::endl;
+	stream << std::endl;
+	stream << "            /* transitions that are pre-empted in these instances */" << std::endl;
+	stream << "            for (j = i + 1; j < USCXML_NUMBER_TRANS; j++) {" << std::endl;
+	stream << "                if (BIT_HAS(j, USCXML_GET_TRANS(i).conflicts))" << std::endl;
+	stream << "                    bit_or(conflicts + j * lane_bytes, enabled, lane_bytes);" << std::endl;
+	stream << "            }" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "    for (lane = 0; lane < batch->nr_ctxs; lane++) {" << std::endl;
+	stream << "        if (BIT_HAS(lane, lanes)) {" << std::endl;
+	stream << "            /* gather the selected transitions of the instance, might be none */" << std::endl;
+	stream << "            bit_clear_all(trans_set, USCXML_MAX_NR_TRANS_BYTES);" << std::endl;
+	stream << "            for (i = 0, enabled = selected; i < USCXML_NUMBER_TRANS; i++, enabled += lane_bytes) {" << std::endl;
+	stream << "                if (BIT_HAS(lane, enabled)) {" << std::endl;
+	stream << "                    BIT_SET_AT(i, trans_set);" << std::endl;
+	stream << "                }" << std::endl;
+	stream << "            }" << std::endl;
+	stream << "            err = uscxml_step_selected(batch->ctxs[lane], trans_set);" << std::endl;
+	stream << "        } else {" << std::endl;
+	stream << "            /* divergent instances take the scalar path */" << std::endl;
+	stream << "            err = uscxml_step_selected(batch->ctxs[lane], NULL);" << std::endl;
+	stream << "        }" << std::endl;
+	stream << std::endl;
+	stream << "        if (err == USCXML_ERR_OK) {" << std::endl;
+	stream << "            uscxml_batch_load(batch, lane);" << std::endl;
+	stream << "            result = USCXML_ERR_OK;" << std::endl;
+	stream << "        } else if (err == USCXML_ERR_IDLE && result == USCXML_ERR_DONE) {" << std::endl;
+	stream << "            result = USCXML_ERR_IDLE;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "        if (batch->results != NULL)" << std::endl;
+	stream << "            batch->results[lane] = err;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    return result;" << std::endl;
+	stream << "}" << std::endl;
+	stream << "#endif" << std::endl;
+	stream << std::endl;
+}
+
 ChartToC::~ChartToC() {
 }
 
@@ -21,12 +21,14 @@
 #define FSMTOCPP_H_201672B0
 
 #include "uscxml/util/DOM.h"
+#include "uscxml/util/StateIndex.h"
 #include "uscxml/transform/Trie.h"
 #include "Transformer.h"
 
 #include <xercesc/dom/DOM.hpp>
 #include <ostream>
 #include <set>
+#include <map>
 
 namespace uscxml {
 
@@ -45,7 +47,7 @@ protected:
 	void writeMacros(std::ostream& stream);
 	void writeTypes(std::ostream& stream);
 	void writeHelpers(std::ostream& stream);
-	void writeExecContent(std::ostream& stream);
+	virtual void writeExecContent(std::ostream& stream);
 	void writeExecContentFinalize(std::ostream& stream);
 	void writeElementInfoInvocation(std::ostream& stream);
 	void writeForwardDeclarations(std::ostream& stream);
@@ -53,9 +55,11 @@ protected:
 	void writeElementInfo(std::ostream& stream);
 
 	void writeMachineInfo(std::ostream& stream);
+	void writeEventInfo(std::ostream& stream);
 	void writeStates(std::ostream& stream);
 	void writeTransitions(std::ostream& stream);
 	void writeFSM(std::ostream& stream);
+	void writeBatchFSM(std::ostream& stream);
 	void writeCharArrayInitList(std::ostream& stream, const std::string& boolString);
 
 	void writeExecContent(std::ostream& stream, const XERCESC_NS::DOMNode* node, size_t indent = 0);
@@ -67,10 +71,15 @@ protected:
 
 	void findNestedMachines();
 
+	void loadProfile();
+	std::string profileAttributes(const XERCESC_NS::DOMElement* element);
+	std::string profileCondition(const XERCESC_NS::DOMElement* transition, const std::string& cond);
+
 	Interpreter interpreter;
 
 	std::vector<XERCESC_NS::DOMElement*> _states;
 	std::vector<XERCESC_NS::DOMElement*> _transitions;
+	std::shared_ptr<StateIndex> _stateIndex;
 
 	std::string _md5;
 	std::string _prefix;
@@ -91,6 +100,17 @@ protected:
 
 	std::list<std::string>* _prefixes;
 	bool _hasNativeDataModel;
+
+	// event descriptors by id, 0 is for events matching no descriptor
+	std::vector<std::string> _events;
+	std::vector<size_t> _eventSlots;
+	uint32_t _eventHashSeed;
+
+	// counts from a ProfileMonitor, keyed per XPath prior to resorting
+	std::map<const XERCESC_NS::DOMElement*, std::string> _profileKeys;
+	Data _profile;
+	size_t _profileMaxEntered;
+	size_t _profileMaxTaken;
 };
 
 }
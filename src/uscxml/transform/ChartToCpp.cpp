@@ -0,0 +1,1159 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#include "uscxml/transform/ChartToCpp.h"
+#include "uscxml/util/Predicates.h"
+#include "uscxml/util/String.h"
+#include "uscxml/util/Convenience.h"
+
+#include <boost/algorithm/string.hpp>
+#include "uscxml/interpreter/Logging.h"
+#include <algorithm>
+
+namespace uscxml {
+
+using namespace XERCESC_NS;
+
+Transformer ChartToCpp::transform(const Interpreter& other) {
+	return std::shared_ptr<TransformerImpl>(new ChartToCpp(other));
+}
+
+ChartToCpp::ChartToCpp(const Interpreter& other) : ChartToC(other) {
+}
+
+ChartToCpp::~ChartToCpp() {
+}
+
+std::string ChartToCpp::strOrNull(const DOMElement* elem, const X& attr) {
+	return (HAS_ATTR(elem, attr) ? "\"" + escape(ATTR(elem, attr)) + "\"" : "NULL");
+}
+
+std::string ChartToCpp::contentOrNull(const DOMElement* elem) {
+	std::list<DOMElement*> contents = DOMUtils::filterChildElements(XML_PREFIX(elem).str() + "content", elem);
+	if (contents.size() == 0 || HAS_ATTR(contents.front(), kXMLCharExpr))
+		return "NULL";
+	return "\"" + escape(X(contents.front()->getTextContent()).str()) + "\"";
+}
+
+/// Whether expr is a single string literal in the given quotes
+static bool isQuoted(const std::string& expr, char quote) {
+	return expr.size() >= 2 && expr[0] == quote && expr[expr.size() - 1] == quote && expr.find(quote, 1) == expr.size() - 1;
+}
+
+std::string ChartToCpp::nativeExpr(const std::string& expr) {
+	// 'foo' is a string as in the other datamodels, C++ would read a multi-character literal
+	std::string trimmed = boost::trim_copy(expr);
+	if (isQuoted(trimmed, '\''))
+		return "std::string(\"" + escape(trimmed.substr(1, trimmed.size() - 2)) + "\")";
+	return expr;
+}
+
+std::string ChartToCpp::nativeType(const DOMElement* data) {
+	if (HAS_ATTR(data, kXMLCharType)) {
+		std::string type = ATTR(data, kXMLCharType);
+		if (type == "int")
+			return "int64_t";
+		if (type == "bool")
+			return "bool";
+		if (type == "string")
+			return "std::string";
+		return type; // any other C++ type
+	}
+
+	std::string expr = boost::trim_copy(ATTR(data, kXMLCharExpr));
+	if (expr == "true" || expr == "false")
+		return "bool";
+	if ((expr.size() > 0 && expr[0] == '"') || isQuoted(expr, '\''))
+		return "std::string";
+	return "int64_t";
+}
+
+void ChartToCpp::writeTo(std::ostream& stream) {
+	if (_extensions.find("className") != _extensions.end()) {
+		_className = _extensions.equal_range("className").first->second;
+	} else if (_extensions.find("outputFile") != _extensions.end()) {
+		URL outputFileURL(_extensions.equal_range("outputFile").first->second);
+		_className = outputFileURL.pathComponents().back();
+	} else if (_baseURL.pathComponents().size() > 0) {
+		_className = _baseURL.pathComponents().back();
+	} else {
+		_className = "StateChart";
+	}
+
+	size_t dotPos = std::string::npos;
+	if ((dotPos = _className.find(".")) != std::string::npos) {
+		_className = _className.substr(0, dotPos);
+	}
+	for (size_t i = 0; i < _className.size(); i++) {
+		if (!isalnum((unsigned char)_className[i]))
+			_className[i] = '_';
+	}
+	if (_className.size() == 0 || isdigit((unsigned char)_className[0]))
+		_className = "StateChart" + _className;
+
+	std::string guard = boost::to_upper_copy(_className) + "_" + _md5.substr(0, 8);
+
+	stream << "/**" << std::endl;
+	stream << "  Generated from source:" << std::endl;
+	stream << "  " << (std::string)_baseURL << std::endl;
+	stream << "*/" << std::endl;
+	stream << std::endl;
+
+	stream << "#ifndef " << guard << std::endl;
+	stream << "#define " << guard << std::endl;
+	stream << std::endl;
+
+	stream << "#include <cstddef>" << std::endl;
+	stream << "#include <cstdint>" << std::endl;
+	if (_hasNativeDataModel)
+		stream << "#include <string>" << std::endl;
+	stream << std::endl;
+
+	stream << "/**" << std::endl;
+	stream << " * The state-chart as a class template, Host has to provide:" << std::endl;
+	stream << " *" << std::endl;
+	stream << " *   typedef ... Event;" << std::endl;
+	stream << " *   const char* eventName(const Event& event);" << std::endl;
+	stream << " *   const Event* dequeueInternal();   // NULL if there is none" << std::endl;
+	stream << " *   const Event* dequeueExternal();   // NULL to remain idle" << std::endl;
+	stream << " *   void raiseDoneEvent(const char* state, const DoneData* doneData);" << std::endl;
+	stream << " *   void raise(const char* event);" << std::endl;
+	stream << " *   void send(const Send& send);" << std::endl;
+	stream << " *   void cancel(const char* sendId, const char* sendIdExpr);" << std::endl;
+	stream << " *   void invoke(const Invoke& invoke, bool uninvoke);" << std::endl;
+	if (_hasNativeDataModel) {
+		stream << " *   template <typename T> void log(const char* label, const T& value);" << std::endl;
+	} else {
+		stream << " *   void log(const char* label, const char* expr);" << std::endl;
+		stream << " *   bool isTrue(const char* expr);" << std::endl;
+		stream << " *   void assign(const char* location, const char* expr, const char* content);" << std::endl;
+		stream << " *   void script(const char* src, const char* content);" << std::endl;
+		stream << " *   void initData(const char* id, const char* src, const char* expr, const char* content);" << std::endl;
+		stream << " *   bool foreachInit(const char* array, const char* item, const char* index);" << std::endl;
+		stream << " *   bool foreachNext(const char* array, const char* item, const char* index);" << std::endl;
+	}
+	stream << " *" << std::endl;
+	stream << " * All of these are resolved at compile time and can be inlined." << std::endl;
+	stream << " */" << std::endl;
+	stream << "template <class Host>" << std::endl;
+	stream << "class " << _className << " {" << std::endl;
+	stream << "public:" << std::endl;
+	stream << "    typedef typename Host::Event Event;" << std::endl;
+	stream << std::endl;
+
+	writeTables(stream);
+
+	stream << "    explicit " << _className << "(Host& host) : _host(host), _flags(CTX_PRISTINE), _event(NULL) {" << std::endl;
+	stream << "        bitClearAll(_config, STATES_BYTES);" << std::endl;
+	stream << "        bitClearAll(_history, STATES_BYTES);" << std::endl;
+	stream << "        bitClearAll(_invocations, STATES_BYTES);" << std::endl;
+	stream << "        bitClearAll(_initializedData, STATES_BYTES);" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+
+	stream << "    /// Perform a single microstep, returns one of the ERR_* constants" << std::endl;
+	stream << "    int step();" << std::endl;
+	stream << std::endl;
+
+	stream << "    bool isInState(size_t state) const {" << std::endl;
+	stream << "        return bitHas(state, _config);" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+
+	stream << "    bool isInState(const char* name) const {" << std::endl;
+	stream << "        for (size_t i = 0; i < NR_STATES; i++) {" << std::endl;
+	stream << "            if (states[i].name != NULL && strEquals(states[i].name, name))" << std::endl;
+	stream << "                return bitHas(i, _config);" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "        return false;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+
+	stream << "    bool isFinished() const {" << std::endl;
+	stream << "        return (_flags & CTX_FINISHED) != 0;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+
+	writeMembers(stream);
+
+	stream << "};" << std::endl;
+	stream << std::endl;
+
+	stream << "template <class Host>" << std::endl;
+	stream << "constexpr typename " << _className << "<Host>::State " << _className << "<Host>::states[];" << std::endl;
+	stream << "template <class Host>" << std::endl;
+	stream << "constexpr typename " << _className << "<Host>::Transition " << _className << "<Host>::transitions[];" << std::endl;
+	stream << std::endl;
+
+	writeStep(stream);
+
+	stream << "#endif /* " << guard << " */" << std::endl;
+}
+
+void ChartToCpp::writeTables(std::ostream& stream) {
+	stream << "    enum {" << std::endl;
+	stream << "        NR_STATES    = " << _states.size() << "," << std::endl;
+	stream << "        NR_TRANS     = " << _transitions.size() << "," << std::endl;
+	stream << "        STATES_BYTES = " << (std::max)((size_t)1, _stateCharArraySize) << "," << std::endl;
+	stream << "        TRANS_BYTES  = " << (std::max)((size_t)1, _transCharArraySize) << std::endl;
+	stream << "    };" << std::endl;
+	stream << std::endl;
+
+	stream << "    enum {" << std::endl;
+	stream << "        ERR_OK   = 0," << std::endl;
+	stream << "        ERR_IDLE = 1," << std::endl;
+	stream << "        ERR_DONE = 2" << std::endl;
+	stream << "    };" << std::endl;
+	stream << std::endl;
+
+	stream << "    enum {" << std::endl;
+	stream << "        TRANS_SPONTANEOUS     = 0x01," << std::endl;
+	stream << "        TRANS_TARGETLESS      = 0x02," << std::endl;
+	stream << "        TRANS_INTERNAL        = 0x04," << std::endl;
+	stream << "        TRANS_HISTORY         = 0x08," << std::endl;
+	stream << "        TRANS_INITIAL         = 0x10," << std::endl;
+	stream << std::endl;
+	stream << "        STATE_ATOMIC          = 0x01," << std::endl;
+	stream << "        STATE_PARALLEL        = 0x02," << std::endl;
+	stream << "        STATE_COMPOUND        = 0x03," << std::endl;
+	stream << "        STATE_FINAL           = 0x04," << std::endl;
+	stream << "        STATE_HISTORY_DEEP    = 0x05," << std::endl;
+	stream << "        STATE_HISTORY_SHALLOW = 0x06," << std::endl;
+	stream << "        STATE_INITIAL         = 0x07," << std::endl;
+	stream << "        STATE_HAS_HISTORY     = 0x80," << std::endl;
+	stream << std::endl;
+	stream << "        CTX_PRISTINE          = 0x00," << std::endl;
+	stream << "        CTX_SPONTANEOUS       = 0x01," << std::endl;
+	stream << "        CTX_INITIALIZED       = 0x02," << std::endl;
+	stream << "        CTX_TOP_LEVEL_FINAL   = 0x04," << std::endl;
+	stream << "        CTX_TRANSITION_FOUND  = 0x08," << std::endl;
+	stream << "        CTX_FINISHED          = 0x10" << std::endl;
+	stream << "    };" << std::endl;
+	stream << std::endl;
+
+	stream << "    struct State {" << std::endl;
+	stream << "        const char* name;" << std::endl;
+	stream << "        size_t parent;" << std::endl;
+	stream << "        unsigned char children[STATES_BYTES];" << std::endl;
+	stream << "        unsigned char completion[STATES_BYTES];" << std::endl;
+	stream << "        unsigned char ancestors[STATES_BYTES];" << std::endl;
+	stream << "        unsigned char type;" << std::endl;
+	stream << "    };" << std::endl;
+	stream << std::endl;
+
+	stream << "    struct Transition {" << std::endl;
+	stream << "        size_t source;" << std::endl;
+	stream << "        unsigned char target[STATES_BYTES];" << std::endl;
+	stream << "        const char* event;" << std::endl;
+	stream << "        const char* condition;" << std::endl;
+	stream << "        unsigned char type;" << std::endl;
+	stream << "        unsigned char conflicts[TRANS_BYTES];" << std::endl;
+	stream << "        unsigned char exitSet[STATES_BYTES];" << std::endl;
+	stream << "    };" << std::endl;
+	stream << std::endl;
+
+	stream << "    struct Param {" << std::endl;
+	stream << "        const char* name;" << std::endl;
+	stream << "        const char* expr;" << std::endl;
+	stream << "        const char* location;" << std::endl;
+	stream << "    };" << std::endl;
+	stream << std::endl;
+
+	stream << "    struct Send {" << std::endl;
+	stream << "        const char* event;" << std::endl;
+	stream << "        const char* eventexpr;" << std::endl;
+	stream << "        const char* target;" << std::endl;
+	stream << "        const char* targetexpr;" << std::endl;
+	stream << "        const char* type;" << std::endl;
+	stream << "        const char* typeexpr;" << std::endl;
+	stream << "        const char* id;" << std::endl;
+	stream << "        const char* idlocation;" << std::endl;
+	stream << "        unsigned long delay;" << std::endl;
+	stream << "        const char* delayexpr;" << std::endl;
+	stream << "        const char* namelist;" << std::endl;
+	stream << "        const char* content;" << std::endl;
+	stream << "        const char* contentexpr;" << std::endl;
+	stream << "        const Param* params;" << std::endl;
+	stream << "        size_t nrParams;" << std::endl;
+	stream << "    };" << std::endl;
+	stream << std::endl;
+
+	stream << "    struct Invoke {" << std::endl;
+	stream << "        const char* type;" << std::endl;
+	stream << "        const char* typeexpr;" << std::endl;
+	stream << "        const char* src;" << std::endl;
+	stream << "        const char* srcexpr;" << std::endl;
+	stream << "        const char* id;" << std::endl;
+	stream << "        const char* idlocation;" << std::endl;
+	stream << "        const char* sourcename;" << std::endl;
+	stream << "        const char* namelist;" << std::endl;
+	stream << "        bool autoforward;" << std::endl;
+	stream << "        const char* content;" << std::endl;
+	stream << "        const char* contentexpr;" << std::endl;
+	stream << "        const Param* params;" << std::endl;
+	stream << "        size_t nrParams;" << std::endl;
+	stream << "    };" << std::endl;
+	stream << std::endl;
+
+	stream << "    struct DoneData {" << std::endl;
+	stream << "        const char* content;" << std::endl;
+	stream << "        const char* contentexpr;" << std::endl;
+	stream << "        const Param* params;" << std::endl;
+	stream << "        size_t nrParams;" << std::endl;
+	stream << "    };" << std::endl;
+	stream << std::endl;
+
+	stream << "    static constexpr State states[NR_STATES] = {" << std::endl;
+	for (size_t i = 0; i < _states.size(); i++) {
+		DOMElement* state(_states[i]);
+
+		stream << "        { ";
+		stream << (HAS_ATTR(state, kXMLCharId) ? "\"" + escape(ATTR(state, kXMLCharId)) + "\"" : "NULL") << ", ";
+		stream << (i == 0 ? "0" : ATTR_CAST(state->getParentNode(), X("documentOrder"))) << ", ";
+		stream << "{ ";
+		writeCharArrayInitList(stream, ATTR(state, X("childBools")));
+		stream << " }, { ";
+		writeCharArrayInitList(stream, ATTR(state, X("completionBools")));
+		stream << " }, { ";
+		writeCharArrayInitList(stream, ATTR(state, X("ancBools")));
+		stream << " }, ";
+
+		if (false) {
+		} else if (iequals(TAGNAME(state), "initial")) {
+			stream << "STATE_INITIAL";
+		} else if (isFinal(state)) {
+			stream << "STATE_FINAL";
+		} else if (isHistory(state)) {
+			if (HAS_ATTR(state, kXMLCharType) && iequals(ATTR(state, kXMLCharType), "deep")) {
+				stream << "STATE_HISTORY_DEEP";
+			} else {
+				stream << "STATE_HISTORY_SHALLOW";
+			}
+		} else if (isAtomic(state)) {
+			stream << "STATE_ATOMIC";
+		} else if (isParallel(state)) {
+			stream << "STATE_PARALLEL";
+		} else { // compound and <scxml>
+			stream << "STATE_COMPOUND";
+		}
+		if (HAS_ATTR(state, X("hasHistoryChild"))) {
+			stream << " | STATE_HAS_HISTORY";
+		}
+		stream << " }" << (i + 1 < _states.size() ? "," : "") << std::endl;
+	}
+	stream << "    };" << std::endl;
+	stream << std::endl;
+
+	stream << "    static constexpr Transition transitions[NR_TRANS > 0 ? NR_TRANS : 1] = {" << std::endl;
+	for (size_t i = 0; i < _transitions.size(); i++) {
+		DOMElement* transition(_transitions[i]);
+
+		stream << "        { ";
+		stream << ATTR_CAST(transition->getParentNode(), X("documentOrder")) << ", ";
+		stream << "{ ";
+		if (HAS_ATTR(transition, X("targetBools"))) {
+			writeCharArrayInitList(stream, ATTR(transition, X("targetBools")));
+		} else {
+			stream << "0x00";
+		}
+		stream << " }, ";
+		stream << strOrNull(transition, kXMLCharEvent) << ", ";
+		stream << strOrNull(transition, kXMLCharCond) << ", ";
+
+		std::string seperator = "";
+		if (!HAS_ATTR(transition, kXMLCharTarget)) {
+			stream << seperator << "TRANS_TARGETLESS";
+			seperator = " | ";
+		}
+		if (HAS_ATTR(transition, kXMLCharType) && iequals(ATTR(transition, kXMLCharType), "internal")) {
+			stream << seperator << "TRANS_INTERNAL";
+			seperator = " | ";
+		}
+		if (!HAS_ATTR(transition, kXMLCharEvent)) {
+			stream << seperator << "TRANS_SPONTANEOUS";
+			seperator = " | ";
+		}
+		if (iequals(TAGNAME_CAST(transition->getParentNode()), "history")) {
+			stream << seperator << "TRANS_HISTORY";
+			seperator = " | ";
+		}
+		if (iequals(TAGNAME_CAST(transition->getParentNode()), "initial")) {
+			stream << seperator << "TRANS_INITIAL";
+			seperator = " | ";
+		}
+		if (seperator.size() == 0) {
+			stream << "0";
+		}
+		stream << ", { ";
+		writeCharArrayInitList(stream, ATTR(transition, X("conflictBools")));
+		stream << " }, { ";
+		writeCharArrayInitList(stream, ATTR(transition, X("exitSetBools")));
+		stream << " } }" << (i + 1 < _transitions.size() ? "," : "") << std::endl;
+	}
+	if (_transitions.size() == 0) {
+		stream << "        { 0, { 0x00 }, NULL, NULL, 0, { 0x00 }, { 0x00 } }" << std::endl;
+	}
+	stream << "    };" << std::endl;
+	stream << std::endl;
+}
+
+void ChartToCpp::writeMembers(std::ostream& stream) {
+	stream << "protected:" << std::endl;
+
+	stream << "    static bool bitHas(size_t i, const unsigned char* a) {" << std::endl;
+	stream << "        return (a[i >> 3] & (1 << (i & 7))) != 0;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    static void bitSet(size_t i, unsigned char* a) {" << std::endl;
+	stream << "        a[i >> 3] |= (unsigned char)(1 << (i & 7));" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    static void bitClear(size_t i, unsigned char* a) {" << std::endl;
+	stream << "        a[i >> 3] &= (unsigned char)~(1 << (i & 7));" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    static bool bitHasAnd(const unsigned char* a, const unsigned char* b, size_t n) {" << std::endl;
+	stream << "        for (size_t i = 0; i < n; i++) {" << std::endl;
+	stream << "            if (a[i] & b[i])" << std::endl;
+	stream << "                return true;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "        return false;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    static bool bitHasAny(const unsigned char* a, size_t n) {" << std::endl;
+	stream << "        for (size_t i = 0; i < n; i++) {" << std::endl;
+	stream << "            if (a[i])" << std::endl;
+	stream << "                return true;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "        return false;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    static void bitClearAll(unsigned char* a, size_t n) {" << std::endl;
+	stream << "        for (size_t i = 0; i < n; i++)" << std::endl;
+	stream << "            a[i] = 0;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    static void bitCopy(unsigned char* dest, const unsigned char* src, size_t n) {" << std::endl;
+	stream << "        for (size_t i = 0; i < n; i++)" << std::endl;
+	stream << "            dest[i] = src[i];" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    static void bitOr(unsigned char* dest, const unsigned char* mask, size_t n) {" << std::endl;
+	stream << "        for (size_t i = 0; i < n; i++)" << std::endl;
+	stream << "            dest[i] |= mask[i];" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    static void bitAnd(unsigned char* dest, const unsigned char* mask, size_t n) {" << std::endl;
+	stream << "        for (size_t i = 0; i < n; i++)" << std::endl;
+	stream << "            dest[i] &= mask[i];" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    static void bitAndNot(unsigned char* dest, const unsigned char* mask, size_t n) {" << std::endl;
+	stream << "        for (size_t i = 0; i < n; i++)" << std::endl;
+	stream << "            dest[i] &= (unsigned char)~mask[i];" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+
+	stream << "    static bool strEquals(const char* a, const char* b) {" << std::endl;
+	stream << "        while (*a != '\\0' && *a == *b) {" << std::endl;
+	stream << "            a++;" << std::endl;
+	stream << "            b++;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "        return *a == *b;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+
+	stream << "    /// Whether desc is the event name or a prefix ending at a dot" << std::endl;
+	stream << "    static bool descMatch(const char* name, const char* desc, size_t length) {" << std::endl;
+	stream << "        for (size_t i = 0; i < length; i++) {" << std::endl;
+	stream << "            if (name[i] != desc[i])" << std::endl;
+	stream << "                return false;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "        return name[length] == '\\0' || name[length] == '.';" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+
+	if (_hasNativeDataModel) {
+		stream << "    bool In(const char* state) const {" << std::endl;
+		stream << "        return isInState(state);" << std::endl;
+		stream << "    }" << std::endl;
+		stream << std::endl;
+	}
+
+	writeDispatch(stream);
+
+	stream << "    Host& _host;" << std::endl;
+	stream << "    unsigned char _flags;" << std::endl;
+	stream << "    const Event* _event;" << std::endl;
+	stream << "    unsigned char _config[STATES_BYTES];" << std::endl;
+	stream << "    unsigned char _history[STATES_BYTES];" << std::endl;
+	stream << "    unsigned char _invocations[STATES_BYTES];" << std::endl;
+	stream << "    unsigned char _initializedData[STATES_BYTES];" << std::endl;
+
+	if (_hasNativeDataModel) {
+		std::list<DOMElement*> datas = DOMUtils::inDocumentOrder({ XML_PREFIX(_scxml).str() + "data" }, _scxml);
+		if (datas.size() > 0)
+			stream << std::endl;
+		for (auto data : datas) {
+			if (!HAS_ATTR(data, kXMLCharId))
+				continue;
+			std::string type = nativeType(data);
+			stream << "    " << type << " " << ATTR(data, kXMLCharId) << " = " << type << "();" << std::endl;
+		}
+	}
+}
+
+void ChartToCpp::writeDispatch(std::ostream& stream) {
+
+	// executable content per state
+	for (size_t i = 0; i < _states.size(); i++) {
+		DOMElement* state(_states[i]);
+
+		std::list<DOMElement*> onexits = DOMUtils::filterChildElements(XML_PREFIX(_scxml).str() + "onexit", state);
+		if (onexits.size() > 0) {
+			stream << "    void " << DOMUtils::idForNode(state) << "_on_exit() {" << std::endl;
+			for (auto onexit : onexits)
+				writeCppExecContent(stream, onexit, 2);
+			stream << "    }" << std::endl;
+			stream << std::endl;
+		}
+
+		std::list<DOMElement*> onentrys = DOMUtils::filterChildElements(XML_PREFIX(_scxml).str() + "onentry", state);
+		if (onentrys.size() > 0) {
+			stream << "    void " << DOMUtils::idForNode(state) << "_on_entry() {" << std::endl;
+			for (auto onentry : onentrys)
+				writeCppExecContent(stream, onentry, 2);
+			stream << "    }" << std::endl;
+			stream << std::endl;
+		}
+	}
+
+	for (size_t i = 0; i < _transitions.size(); i++) {
+		DOMElement* transition(_transitions[i]);
+		if (DOMUtils::filterChildType(DOMNode::ELEMENT_NODE, transition).size() > 0) {
+			stream << "    void " << DOMUtils::idForNode(transition) << "_on_trans() {" << std::endl;
+			writeCppExecContent(stream, transition, 2);
+			stream << "    }" << std::endl;
+			stream << std::endl;
+		}
+	}
+
+	stream << "    void onEntry(size_t state) {" << std::endl;
+	stream << "        switch (state) {" << std::endl;
+	for (size_t i = 0; i < _states.size(); i++) {
+		if (DOMUtils::filterChildElements(XML_PREFIX(_scxml).str() + "onentry", _states[i]).size() > 0)
+			stream << "        case " << i << ": " << DOMUtils::idForNode(_states[i]) << "_on_entry(); break;" << std::endl;
+	}
+	stream << "        default: break;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+
+	stream << "    void onExit(size_t state) {" << std::endl;
+	stream << "        switch (state) {" << std::endl;
+	for (size_t i = 0; i < _states.size(); i++) {
+		if (DOMUtils::filterChildElements(XML_PREFIX(_scxml).str() + "onexit", _states[i]).size() > 0)
+			stream << "        case " << i << ": " << DOMUtils::idForNode(_states[i]) << "_on_exit(); break;" << std::endl;
+	}
+	stream << "        default: break;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+
+	stream << "    void onTransition(size_t transition) {" << std::endl;
+	stream << "        switch (transition) {" << std::endl;
+	for (size_t i = 0; i < _transitions.size(); i++) {
+		if (DOMUtils::filterChildType(DOMNode::ELEMENT_NODE, _transitions[i]).size() > 0)
+			stream << "        case " << i << ": " << DOMUtils::idForNode(_transitions[i]) << "_on_trans(); break;" << std::endl;
+	}
+	stream << "        default: break;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+
+	stream << "    bool isEnabled(size_t transition) {" << std::endl;
+	stream << "        switch (transition) {" << std::endl;
+	for (size_t i = 0; i < _transitions.size(); i++) {
+		if (!HAS_ATTR(_transitions[i], kXMLCharCond))
+			continue;
+		if (_hasNativeDataModel) {
+			stream << "        case " << i << ": return (" << ATTR(_transitions[i], kXMLCharCond) << ");" << std::endl;
+		} else {
+			stream << "        case " << i << ": return _host.isTrue(" << strOrNull(_transitions[i], kXMLCharCond) << ");" << std::endl;
+		}
+	}
+	stream << "        default: return true;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+
+	stream << "    bool isMatched(size_t transition, const char* name) {" << std::endl;
+	stream << "        switch (transition) {" << std::endl;
+	for (size_t i = 0; i < _transitions.size(); i++) {
+		if (!HAS_ATTR(_transitions[i], kXMLCharEvent))
+			continue;
+		std::list<std::string> descs = tokenize(ATTR(_transitions[i], kXMLCharEvent));
+		std::string seperator;
+		stream << "        case " << i << ": return ";
+		for (auto desc : descs) {
+			// remove optional trailing .* as in nameMatch
+			if (desc.size() > 0 && desc[desc.size() - 1] == '*')
+				desc = desc.substr(0, desc.size() - 1);
+			if (desc.size() > 0 && desc[desc.size() - 1] == '.')
+				desc = desc.substr(0, desc.size() - 1);
+			if (desc.size() == 0) {
+				stream << seperator << "true";
+			} else {
+				stream << seperator << "descMatch(name, \"" << escape(desc) << "\", " << desc.size() << ")";
+			}
+			seperator = " || ";
+		}
+		if (seperator.size() == 0)
+			stream << "false";
+		stream << ";" << std::endl;
+	}
+	stream << "        default: return false;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+
+	stream << "    void initData(size_t state) {" << std::endl;
+	stream << "        switch (state) {" << std::endl;
+	for (size_t i = 0; i < _states.size(); i++) {
+		std::list<DOMElement*> dataModels = DOMUtils::filterChildElements(XML_PREFIX(_scxml).str() + "datamodel", _states[i]);
+		std::list<DOMElement*> datas;
+		for (auto dataModel : dataModels) {
+			std::list<DOMElement*> children = DOMUtils::filterChildElements(XML_PREFIX(_scxml).str() + "data", dataModel);
+			datas.insert(datas.end(), children.begin(), children.end());
+		}
+		if (datas.size() == 0)
+			continue;
+
+		stream << "        case " << i << ":" << std::endl;
+		for (auto data : datas) {
+			if (_hasNativeDataModel) {
+				if (HAS_ATTR(data, kXMLCharId) && HAS_ATTR(data, kXMLCharExpr))
+					stream << "            " << ATTR(data, kXMLCharId) << " = (" << nativeExpr(ATTR(data, kXMLCharExpr)) << ");" << std::endl;
+			} else {
+				stream << "            _host.initData(" << strOrNull(data, kXMLCharId) << ", " << strOrNull(data, kXMLCharSource) << ", " << strOrNull(data, kXMLCharExpr) << ", ";
+				std::string content = X(data->getTextContent()).str();
+				stream << (boost::trim_copy(content).size() > 0 ? "\"" + escape(content) + "\"" : "NULL") << ");" << std::endl;
+			}
+		}
+		stream << "            break;" << std::endl;
+	}
+	stream << "        default: break;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+
+	stream << "    void invoke(size_t state, bool uninvoke) {" << std::endl;
+	stream << "        switch (state) {" << std::endl;
+	for (size_t i = 0; i < _states.size(); i++) {
+		std::list<DOMElement*> invokes = DOMUtils::filterChildElements(XML_PREFIX(_scxml).str() + "invoke", _states[i]);
+		if (invokes.size() == 0)
+			continue;
+
+		stream << "        case " << i << ": {" << std::endl;
+		size_t j = 0;
+		for (auto invoke : invokes) {
+			writeParams(stream, invoke, "            ");
+			stream << "            static constexpr Invoke invoke" << j << " = { ";
+			stream << strOrNull(invoke, kXMLCharType) << ", ";
+			stream << strOrNull(invoke, kXMLCharTypeExpr) << ", ";
+			stream << strOrNull(invoke, kXMLCharSource) << ", ";
+			stream << strOrNull(invoke, kXMLCharSourceExpr) << ", ";
+			stream << strOrNull(invoke, kXMLCharId) << ", ";
+			stream << strOrNull(invoke, kXMLCharIdLocation) << ", ";
+			stream << strOrNull(_states[i], kXMLCharId) << ", ";
+			stream << strOrNull(invoke, kXMLCharNameList) << ", ";
+			stream << (HAS_ATTR(invoke, kXMLCharAutoForward) && stringIsTrue(ATTR(invoke, kXMLCharAutoForward)) ? "true" : "false") << ", ";
+			stream << contentOrNull(invoke) << ", ";
+			std::list<DOMElement*> contents = DOMUtils::filterChildElements(XML_PREFIX(invoke).str() + "content", invoke);
+			stream << (contents.size() > 0 ? strOrNull(contents.front(), kXMLCharExpr) : "NULL") << ", ";
+			size_t nrParams = DOMUtils::filterChildElements(XML_PREFIX(invoke).str() + "param", invoke).size();
+			stream << (nrParams > 0 ? "params" : "NULL") << ", " << nrParams << " };" << std::endl;
+			stream << "            _host.invoke(invoke" << j << ", uninvoke);" << std::endl;
+			j++;
+		}
+		stream << "            break;" << std::endl;
+		stream << "        }" << std::endl;
+	}
+	stream << "        default: break;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+
+	stream << "    void raiseDoneEvent(size_t state, size_t parent) {" << std::endl;
+	stream << "        switch (state) {" << std::endl;
+	for (size_t i = 0; i < _states.size(); i++) {
+		std::list<DOMElement*> doneDatas = DOMUtils::filterChildElements(XML_PREFIX(_scxml).str() + "donedata", _states[i]);
+		if (doneDatas.size() == 0)
+			continue;
+		DOMElement* doneData = doneDatas.front();
+		stream << "        case " << i << ": {" << std::endl;
+		writeParams(stream, doneData, "            ");
+		std::list<DOMElement*> contents = DOMUtils::filterChildElements(XML_PREFIX(doneData).str() + "content", doneData);
+		size_t nrParams = DOMUtils::filterChildElements(XML_PREFIX(doneData).str() + "param", doneData).size();
+		stream << "            static constexpr DoneData doneData = { ";
+		stream << contentOrNull(doneData) << ", ";
+		stream << (contents.size() > 0 ? strOrNull(contents.front(), kXMLCharExpr) : "NULL") << ", ";
+		stream << (nrParams > 0 ? "params" : "NULL") << ", " << nrParams << " };" << std::endl;
+		stream << "            _host.raiseDoneEvent(states[parent].name, &doneData);" << std::endl;
+		stream << "            return;" << std::endl;
+		stream << "        }" << std::endl;
+	}
+	stream << "        default:" << std::endl;
+	stream << "            _host.raiseDoneEvent(states[parent].name, (const DoneData*)NULL);" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+}
+
+void ChartToCpp::writeParams(std::ostream& stream, const DOMElement* elem, const std::string& padding) {
+	std::list<DOMElement*> params = DOMUtils::filterChildElements(XML_PREFIX(elem).str() + "param", elem);
+	if (params.size() == 0)
+		return;
+
+	stream << padding << "static constexpr Param params[" << params.size() << "] = {" << std::endl;
+	for (auto iter = params.begin(); iter != params.end(); iter++) {
+		stream << padding << "    { " << strOrNull(*iter, kXMLCharName) << ", " << strOrNull(*iter, kXMLCharExpr) << ", " << strOrNull(*iter, kXMLCharLocation) << " }";
+		stream << (std::next(iter) != params.end() ? "," : "") << std::endl;
+	}
+	stream << padding << "};" << std::endl;
+}
+
+void ChartToCpp::writeCppExecContent(std::ostream& stream, const DOMNode* node, size_t indent) {
+	if (!node || node->getNodeType() != DOMNode::ELEMENT_NODE)
+		return;
+
+	std::string padding;
+	for (size_t i = 0; i < indent; i++) {
+		padding += "    ";
+	}
+
+	const DOMElement* elem = static_cast<const DOMElement*>(node);
+	std::string prefix = XML_PREFIX(elem).str();
+
+	if (false) {
+	} else if(TAGNAME(elem) == prefix + "onentry" ||
+	          TAGNAME(elem) == prefix + "onexit" ||
+	          TAGNAME(elem) == prefix + "transition") {
+		for (DOMNode* child = elem->getFirstChild(); child; child = child->getNextSibling()) {
+			writeCppExecContent(stream, child, indent);
+		}
+
+	} else if(TAGNAME(elem) == prefix + "raise") {
+		stream << padding << "_host.raise(" << strOrNull(elem, kXMLCharEvent) << ");" << std::endl;
+
+	} else if(TAGNAME(elem) == prefix + "log") {
+		if (_hasNativeDataModel && HAS_ATTR(elem, kXMLCharExpr)) {
+			stream << padding << "_host.log(" << strOrNull(elem, kXMLCharLabel) << ", (" << nativeExpr(ATTR(elem, kXMLCharExpr)) << "));" << std::endl;
+		} else {
+			// a typed NULL, hosts may overload log() for the values of native expressions
+			std::string expr = strOrNull(elem, kXMLCharExpr);
+			stream << padding << "_host.log(" << strOrNull(elem, kXMLCharLabel) << ", " << (expr == "NULL" ? "(const char*)NULL" : expr) << ");" << std::endl;
+		}
+
+	} else if(TAGNAME(elem) == prefix + "script") {
+		std::string content = X(elem->getTextContent()).str();
+		if (_hasNativeDataModel) {
+			stream << padding << "{" << std::endl;
+			stream << padding << "    " << boost::trim_copy(content) << std::endl;
+			stream << padding << "}" << std::endl;
+		} else {
+			stream << padding << "_host.script(" << strOrNull(elem, kXMLCharSource) << ", ";
+			stream << (boost::trim_copy(content).size() > 0 ? "\"" + escape(content) + "\"" : "NULL") << ");" << std::endl;
+		}
+
+	} else if(TAGNAME(elem) == prefix + "assign") {
+		if (_hasNativeDataModel) {
+			stream << padding << ATTR(elem, kXMLCharLocation) << " = (" << nativeExpr(ATTR(elem, kXMLCharExpr)) << ");" << std::endl;
+		} else {
+			std::string content = X(elem->getTextContent()).str();
+			stream << padding << "_host.assign(" << strOrNull(elem, kXMLCharLocation) << ", " << strOrNull(elem, kXMLCharExpr) << ", ";
+			stream << (boost::trim_copy(content).size() > 0 ? "\"" + escape(content) + "\"" : "NULL") << ");" << std::endl;
+		}
+
+	} else if(TAGNAME(elem) == prefix + "if") {
+		std::string cond = (_hasNativeDataModel ? ATTR(elem, kXMLCharCond) : "_host.isTrue(" + strOrNull(elem, kXMLCharCond) + ")");
+		stream << padding << "if (" << cond << ") {" << std::endl;
+		for (DOMNode* child = elem->getFirstChild(); child; child = child->getNextSibling()) {
+			if (child->getNodeType() == DOMNode::ELEMENT_NODE && TAGNAME_CAST(child) == prefix + "elseif") {
+				const DOMElement* elseIf = static_cast<const DOMElement*>(child);
+				cond = (_hasNativeDataModel ? ATTR(elseIf, kXMLCharCond) : "_host.isTrue(" + strOrNull(elseIf, kXMLCharCond) + ")");
+				stream << padding << "} else if (" << cond << ") {" << std::endl;
+			} else if (child->getNodeType() == DOMNode::ELEMENT_NODE && TAGNAME_CAST(child) == prefix + "else") {
+				stream << padding << "} else {" << std::endl;
+			} else {
+				writeCppExecContent(stream, child, indent + 1);
+			}
+		}
+		stream << padding << "}" << std::endl;
+
+	} else if(TAGNAME(elem) == prefix + "foreach") {
+		if (_hasNativeDataModel) {
+			stream << padding << "{" << std::endl;
+			if (HAS_ATTR(elem, kXMLCharIndex))
+				stream << padding << "    " << ATTR(elem, kXMLCharIndex) << " = 0;" << std::endl;
+			stream << padding << "    for (auto& " << ATTR(elem, kXMLCharItem) << " : " << ATTR(elem, kXMLCharArray) << ") {" << std::endl;
+			for (DOMNode* child = elem->getFirstChild(); child; child = child->getNextSibling()) {
+				writeCppExecContent(stream, child, indent + 2);
+			}
+			if (HAS_ATTR(elem, kXMLCharIndex))
+				stream << padding << "        " << ATTR(elem, kXMLCharIndex) << "++;" << std::endl;
+			stream << padding << "    }" << std::endl;
+			stream << padding << "}" << std::endl;
+		} else {
+			std::string args = strOrNull(elem, kXMLCharArray) + ", " + strOrNull(elem, kXMLCharItem) + ", " + strOrNull(elem, kXMLCharIndex);
+			stream << padding << "if (_host.foreachInit(" << args << ")) {" << std::endl;
+			stream << padding << "    while (_host.foreachNext(" << args << ")) {" << std::endl;
+			for (DOMNode* child = elem->getFirstChild(); child; child = child->getNextSibling()) {
+				writeCppExecContent(stream, child, indent + 2);
+			}
+			stream << padding << "    }" << std::endl;
+			stream << padding << "}" << std::endl;
+		}
+
+	} else if(TAGNAME(elem) == prefix + "send") {
+		std::list<DOMElement*> contents = DOMUtils::filterChildElements(prefix + "content", elem);
+		size_t nrParams = DOMUtils::filterChildElements(prefix + "param", elem).size();
+
+		stream << padding << "{" << std::endl;
+		writeParams(stream, elem, padding + "    ");
+		stream << padding << "    static constexpr Send send = { ";
+		stream << strOrNull(elem, kXMLCharEvent) << ", ";
+		stream << strOrNull(elem, kXMLCharEventExpr) << ", ";
+		stream << strOrNull(elem, kXMLCharTarget) << ", ";
+		stream << strOrNull(elem, kXMLCharTargetExpr) << ", ";
+		stream << strOrNull(elem, kXMLCharType) << ", ";
+		stream << strOrNull(elem, kXMLCharTypeExpr) << ", ";
+		stream << strOrNull(elem, kXMLCharId) << ", ";
+		stream << strOrNull(elem, kXMLCharIdLocation) << ", ";
+		if (HAS_ATTR(elem, kXMLCharDelay)) {
+			NumAttr delay(ATTR(elem, kXMLCharDelay));
+			if (iequals(delay.unit, "s")) {
+				stream << (unsigned long)(strTo<double>(delay.value) * 1000);
+			} else {
+				// ms or no unit given
+				stream << strTo<unsigned long>(delay.value);
+			}
+		} else {
+			stream << "0";
+		}
+		stream << "ul, ";
+		stream << strOrNull(elem, kXMLCharDelayExpr) << ", ";
+		stream << strOrNull(elem, kXMLCharNameList) << ", ";
+		stream << contentOrNull(elem) << ", ";
+		stream << (contents.size() > 0 ? strOrNull(contents.front(), kXMLCharExpr) : "NULL") << ", ";
+		stream << (nrParams > 0 ? "params" : "NULL") << ", " << nrParams << " };" << std::endl;
+		stream << padding << "    _host.send(send);" << std::endl;
+		stream << padding << "}" << std::endl;
+
+	} else if(TAGNAME(elem) == prefix + "cancel") {
+		stream << padding << "_host.cancel(" << strOrNull(elem, kXMLCharSendId) << ", " << strOrNull(elem, kXMLCharSendIdExpr) << ");" << std::endl;
+
+	} else {
+		LOGD(USCXML_WARN) << "'" << TAGNAME(elem) << "' is not supported when transforming to C++" << std::endl;
+	}
+}
+
+void ChartToCpp::writeStep(std::ostream& stream) {
+	std::string cls = _className + "<Host>";
+
+	stream << "template <class Host>" << std::endl;
+	stream << "int " << cls << "::step() {" << std::endl;
+	stream << "    size_t i, j, k;" << std::endl;
+	stream << "    unsigned char conflicts[TRANS_BYTES];" << std::endl;
+	stream << "    unsigned char transSet[TRANS_BYTES];" << std::endl;
+	stream << "    unsigned char targetSet[STATES_BYTES];" << std::endl;
+	stream << "    unsigned char exitSet[STATES_BYTES];" << std::endl;
+	stream << "    unsigned char entrySet[STATES_BYTES];" << std::endl;
+	stream << "    unsigned char tmpStates[STATES_BYTES];" << std::endl;
+	stream << "    const char* eventName = NULL;" << std::endl;
+	stream << std::endl;
+	stream << "    if (_flags & CTX_FINISHED)" << std::endl;
+	stream << "        return ERR_DONE;" << std::endl;
+	stream << std::endl;
+	stream << "    if (_flags & CTX_TOP_LEVEL_FINAL) {" << std::endl;
+	stream << "        /* exit all remaining states */" << std::endl;
+	stream << "        i = NR_STATES;" << std::endl;
+	stream << "        while(i-- > 0) {" << std::endl;
+	stream << "            if (bitHas(i, _config)) {" << std::endl;
+	stream << "                onExit(i);" << std::endl;
+	stream << "            }" << std::endl;
+	stream << "            if (bitHas(i, _invocations)) {" << std::endl;
+	stream << "                invoke(i, true);" << std::endl;
+	stream << "                bitClear(i, _invocations);" << std::endl;
+	stream << "            }" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "        _flags |= CTX_FINISHED;" << std::endl;
+	stream << "        return ERR_DONE;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "    bitClearAll(targetSet, STATES_BYTES);" << std::endl;
+	stream << "    bitClearAll(transSet, TRANS_BYTES);" << std::endl;
+	stream << "    bitClearAll(exitSet, STATES_BYTES);" << std::endl;
+	stream << "    if (_flags == CTX_PRISTINE) {" << std::endl;
+	stream << "        bitOr(targetSet, states[0].completion, STATES_BYTES);" << std::endl;
+	stream << "        _flags |= CTX_SPONTANEOUS | CTX_INITIALIZED;" << std::endl;
+	stream << "        goto ESTABLISH_ENTRY_SET;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "DEQUEUE_EVENT:" << std::endl;
+	stream << "    if (_flags & CTX_SPONTANEOUS) {" << std::endl;
+	stream << "        _event = NULL;" << std::endl;
+	stream << "        goto SELECT_TRANSITIONS;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    if ((_event = _host.dequeueInternal()) != NULL) {" << std::endl;
+	stream << "        goto SELECT_TRANSITIONS;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "    /* manage invocations */" << std::endl;
+	stream << "    for (i = 0; i < NR_STATES; i++) {" << std::endl;
+	stream << "        if (!bitHas(i, _config) && bitHas(i, _invocations)) {" << std::endl;
+	stream << "            invoke(i, true);" << std::endl;
+	stream << "            bitClear(i, _invocations);" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "        if (bitHas(i, _config) && !bitHas(i, _invocations)) {" << std::endl;
+	stream << "            invoke(i, false);" << std::endl;
+	stream << "            bitSet(i, _invocations);" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "    if ((_event = _host.dequeueExternal()) != NULL) {" << std::endl;
+	stream << "        goto SELECT_TRANSITIONS;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    return ERR_IDLE;" << std::endl;
+	stream << std::endl;
+	stream << "SELECT_TRANSITIONS:" << std::endl;
+	stream << "    bitClearAll(conflicts, TRANS_BYTES);" << std::endl;
+	stream << "    bitClearAll(exitSet, STATES_BYTES);" << std::endl;
+	stream << "    eventName = (_event != NULL ? _host.eventName(*_event) : NULL);" << std::endl;
+	stream << std::endl;
+	stream << "    for (i = 0; i < NR_TRANS; i++) {" << std::endl;
+	stream << "        /* never select history or initial transitions automatically */" << std::endl;
+	stream << "        if (transitions[i].type & (TRANS_HISTORY | TRANS_INITIAL))" << std::endl;
+	stream << "            continue;" << std::endl;
+	stream << std::endl;
+	stream << "        /* active, non-conflicting, matching and enabled */" << std::endl;
+	stream << "        if (bitHas(transitions[i].source, _config) &&" << std::endl;
+	stream << "            !bitHas(i, conflicts) &&" << std::endl;
+	stream << "            (transitions[i].event == NULL) == (_event == NULL) &&" << std::endl;
+	stream << "            (_event == NULL || isMatched(i, eventName)) &&" << std::endl;
+	stream << "            (transitions[i].condition == NULL || isEnabled(i))) {" << std::endl;
+	stream << "            _flags |= CTX_TRANSITION_FOUND;" << std::endl;
+	stream << std::endl;
+	stream << "            bitOr(conflicts, transitions[i].conflicts, TRANS_BYTES);" << std::endl;
+	stream << "            bitOr(targetSet, transitions[i].target, STATES_BYTES);" << std::endl;
+	stream << "            bitOr(exitSet, transitions[i].exitSet, STATES_BYTES);" << std::endl;
+	stream << "            bitSet(i, transSet);" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << "    bitAnd(exitSet, _config, STATES_BYTES);" << std::endl;
+	stream << std::endl;
+	stream << "    if (_flags & CTX_TRANSITION_FOUND) {" << std::endl;
+	stream << "        _flags |= CTX_SPONTANEOUS;" << std::endl;
+	stream << "        _flags &= ~CTX_TRANSITION_FOUND;" << std::endl;
+	stream << "    } else {" << std::endl;
+	stream << "        _flags &= ~CTX_SPONTANEOUS;" << std::endl;
+	stream << "        goto DEQUEUE_EVENT;" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "    /* remember history */" << std::endl;
+	stream << "    for (i = 0; i < NR_STATES; i++) {" << std::endl;
+	stream << "        if ((states[i].type & 0x7F) == STATE_HISTORY_SHALLOW ||" << std::endl;
+	stream << "            (states[i].type & 0x7F) == STATE_HISTORY_DEEP) {" << std::endl;
+	stream << "            if (bitHas(states[i].parent, exitSet)) {" << std::endl;
+	stream << "                bitCopy(tmpStates, states[i].completion, STATES_BYTES);" << std::endl;
+	stream << "                bitAnd(tmpStates, _config, STATES_BYTES);" << std::endl;
+	stream << "                bitAndNot(_history, states[i].completion, STATES_BYTES);" << std::endl;
+	stream << "                bitOr(_history, tmpStates, STATES_BYTES);" << std::endl;
+	stream << "            }" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "ESTABLISH_ENTRY_SET:" << std::endl;
+	stream << "    bitCopy(entrySet, targetSet, STATES_BYTES);" << std::endl;
+	stream << std::endl;
+	stream << "    /* iterate for ancestors */" << std::endl;
+	stream << "    for (i = 0; i < NR_STATES; i++) {" << std::endl;
+	stream << "        if (bitHas(i, entrySet)) {" << std::endl;
+	stream << "            bitOr(entrySet, states[i].ancestors, STATES_BYTES);" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "    /* iterate for descendants */" << std::endl;
+	stream << "    for (i = 0; i < NR_STATES; i++) {" << std::endl;
+	stream << "        if (!bitHas(i, entrySet))" << std::endl;
+	stream << "            continue;" << std::endl;
+	stream << "        switch (states[i].type & 0x7F) {" << std::endl;
+	stream << "        case STATE_PARALLEL:" << std::endl;
+	stream << "            bitOr(entrySet, states[i].completion, STATES_BYTES);" << std::endl;
+	stream << "            break;" << std::endl;
+	stream << "        case STATE_HISTORY_SHALLOW:" << std::endl;
+	stream << "        case STATE_HISTORY_DEEP:" << std::endl;
+	stream << "            if (!bitHasAnd(states[i].completion, _history, STATES_BYTES) &&" << std::endl;
+	stream << "                !bitHas(states[i].parent, _config)) {" << std::endl;
+	stream << "                /* nothing set for history, look for a default transition */" << std::endl;
+	stream << "                for (j = 0; j < NR_TRANS; j++) {" << std::endl;
+	stream << "                    if (transitions[j].source == i) {" << std::endl;
+	stream << "                        bitOr(entrySet, transitions[j].target, STATES_BYTES);" << std::endl;
+	stream << "                        if ((states[i].type & 0x7F) == STATE_HISTORY_DEEP &&" << std::endl;
+	stream << "                            !bitHasAnd(transitions[j].target, states[i].children, STATES_BYTES)) {" << std::endl;
+	stream << "                            for (k = i + 1; k < NR_STATES; k++) {" << std::endl;
+	stream << "                                if (bitHas(k, transitions[j].target)) {" << std::endl;
+	stream << "                                    bitOr(entrySet, states[k].ancestors, STATES_BYTES);" << std::endl;
+	stream << "                                    break;" << std::endl;
+	stream << "                                }" << std::endl;
+	stream << "                            }" << std::endl;
+	stream << "                        }" << std::endl;
+	stream << "                        bitSet(j, transSet);" << std::endl;
+	stream << "                        break;" << std::endl;
+	stream << "                    }" << std::endl;
+	stream << "                }" << std::endl;
+	stream << "            } else {" << std::endl;
+	stream << "                bitCopy(tmpStates, states[i].completion, STATES_BYTES);" << std::endl;
+	stream << "                bitAnd(tmpStates, _history, STATES_BYTES);" << std::endl;
+	stream << "                bitOr(entrySet, tmpStates, STATES_BYTES);" << std::endl;
+	stream << "                if (states[i].type == (STATE_HAS_HISTORY | STATE_HISTORY_DEEP)) {" << std::endl;
+	stream << "                    /* a deep history state with nested histories -> more completion */" << std::endl;
+	stream << "                    for (j = i + 1; j < NR_STATES; j++) {" << std::endl;
+	stream << "                        if (bitHas(j, states[i].completion) &&" << std::endl;
+	stream << "                            bitHas(j, entrySet) &&" << std::endl;
+	stream << "                            (states[j].type & STATE_HAS_HISTORY)) {" << std::endl;
+	stream << "                            for (k = j + 1; k < NR_STATES; k++) {" << std::endl;
+	stream << "                                if (((states[k].type & 0x7F) == STATE_HISTORY_DEEP ||" << std::endl;
+	stream << "                                     (states[k].type & 0x7F) == STATE_HISTORY_SHALLOW) &&" << std::endl;
+	stream << "                                    bitHas(k, states[j].children)) {" << std::endl;
+	stream << "                                    bitSet(k, entrySet);" << std::endl;
+	stream << "                                }" << std::endl;
+	stream << "                            }" << std::endl;
+	stream << "                        }" << std::endl;
+	stream << "                    }" << std::endl;
+	stream << "                }" << std::endl;
+	stream << "            }" << std::endl;
+	stream << "            break;" << std::endl;
+	stream << "        case STATE_INITIAL:" << std::endl;
+	stream << "            for (j = 0; j < NR_TRANS; j++) {" << std::endl;
+	stream << "                if (transitions[j].source == i) {" << std::endl;
+	stream << "                    bitSet(j, transSet);" << std::endl;
+	stream << "                    bitClear(i, entrySet);" << std::endl;
+	stream << "                    bitOr(entrySet, transitions[j].target, STATES_BYTES);" << std::endl;
+	stream << "                    for (k = i + 1; k < NR_STATES; k++) {" << std::endl;
+	stream << "                        if (bitHas(k, transitions[j].target)) {" << std::endl;
+	stream << "                            bitOr(entrySet, states[k].ancestors, STATES_BYTES);" << std::endl;
+	stream << "                        }" << std::endl;
+	stream << "                    }" << std::endl;
+	stream << "                }" << std::endl;
+	stream << "            }" << std::endl;
+	stream << "            break;" << std::endl;
+	stream << "        case STATE_COMPOUND:" << std::endl;
+	stream << "            /* we need to check whether one child is already in entry set */" << std::endl;
+	stream << "            if (!bitHasAnd(entrySet, states[i].children, STATES_BYTES) &&" << std::endl;
+	stream << "                (!bitHasAnd(_config, states[i].children, STATES_BYTES) ||" << std::endl;
+	stream << "                 bitHasAnd(exitSet, states[i].children, STATES_BYTES))) {" << std::endl;
+	stream << "                bitOr(entrySet, states[i].completion, STATES_BYTES);" << std::endl;
+	stream << "                if (!bitHasAnd(states[i].completion, states[i].children, STATES_BYTES)) {" << std::endl;
+	stream << "                    /* deep completion */" << std::endl;
+	stream << "                    for (j = i + 1; j < NR_STATES; j++) {" << std::endl;
+	stream << "                        if (bitHas(j, states[i].completion)) {" << std::endl;
+	stream << "                            bitOr(entrySet, states[j].ancestors, STATES_BYTES);" << std::endl;
+	stream << "                            break;" << std::endl;
+	stream << "                        }" << std::endl;
+	stream << "                    }" << std::endl;
+	stream << "                }" << std::endl;
+	stream << "            }" << std::endl;
+	stream << "            break;" << std::endl;
+	stream << "        default:" << std::endl;
+	stream << "            break;" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "    /* exit states */" << std::endl;
+	stream << "    i = NR_STATES;" << std::endl;
+	stream << "    while(i-- > 0) {" << std::endl;
+	stream << "        if (bitHas(i, exitSet) && bitHas(i, _config)) {" << std::endl;
+	stream << "            onExit(i);" << std::endl;
+	stream << "            bitClear(i, _config);" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "    /* take transitions */" << std::endl;
+	stream << "    for (i = 0; i < NR_TRANS; i++) {" << std::endl;
+	stream << "        if (bitHas(i, transSet) && (transitions[i].type & (TRANS_HISTORY | TRANS_INITIAL)) == 0) {" << std::endl;
+	stream << "            onTransition(i);" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "    /* enter states */" << std::endl;
+	stream << "    for (i = 0; i < NR_STATES; i++) {" << std::endl;
+	stream << "        if (!bitHas(i, entrySet) || bitHas(i, _config))" << std::endl;
+	stream << "            continue;" << std::endl;
+	stream << std::endl;
+	stream << "        /* these are no proper states */" << std::endl;
+	stream << "        if ((states[i].type & 0x7F) == STATE_HISTORY_DEEP ||" << std::endl;
+	stream << "            (states[i].type & 0x7F) == STATE_HISTORY_SHALLOW ||" << std::endl;
+	stream << "            (states[i].type & 0x7F) == STATE_INITIAL)" << std::endl;
+	stream << "            continue;" << std::endl;
+	stream << std::endl;
+	stream << "        bitSet(i, _config);" << std::endl;
+	stream << std::endl;
+	stream << "        if (!bitHas(i, _initializedData)) {" << std::endl;
+	stream << "            initData(i);" << std::endl;
+	stream << "            bitSet(i, _initializedData);" << std::endl;
+	stream << "        }" << std::endl;
+	stream << std::endl;
+	stream << "        onEntry(i);" << std::endl;
+	stream << std::endl;
+	stream << "        /* take history and initial transitions */" << std::endl;
+	stream << "        for (j = 0; j < NR_TRANS; j++) {" << std::endl;
+	stream << "            if (bitHas(j, transSet) &&" << std::endl;
+	stream << "                (transitions[j].type & (TRANS_HISTORY | TRANS_INITIAL)) &&" << std::endl;
+	stream << "                states[transitions[j].source].parent == i) {" << std::endl;
+	stream << "                onTransition(j);" << std::endl;
+	stream << "            }" << std::endl;
+	stream << "        }" << std::endl;
+	stream << std::endl;
+	stream << "        /* handle final states */" << std::endl;
+	stream << "        if ((states[i].type & 0x7F) == STATE_FINAL) {" << std::endl;
+	stream << "            if (states[i].ancestors[0] == 0x01) {" << std::endl;
+	stream << "                _flags |= CTX_TOP_LEVEL_FINAL;" << std::endl;
+	stream << "            } else {" << std::endl;
+	stream << "                raiseDoneEvent(i, states[i].parent);" << std::endl;
+	stream << "            }" << std::endl;
+	stream << std::endl;
+	stream << "            /* are we the last final state to leave a parallel state? */" << std::endl;
+	stream << "            for (j = 0; j < NR_STATES; j++) {" << std::endl;
+	stream << "                if ((states[j].type & 0x7F) == STATE_PARALLEL && bitHas(j, states[i].ancestors)) {" << std::endl;
+	stream << "                    bitClearAll(tmpStates, STATES_BYTES);" << std::endl;
+	stream << "                    for (k = 0; k < NR_STATES; k++) {" << std::endl;
+	stream << "                        if (bitHas(j, states[k].ancestors) && bitHas(k, _config)) {" << std::endl;
+	stream << "                            if ((states[k].type & 0x7F) == STATE_FINAL) {" << std::endl;
+	stream << "                                bitAndNot(tmpStates, states[k].ancestors, STATES_BYTES);" << std::endl;
+	stream << "                            } else {" << std::endl;
+	stream << "                                bitSet(k, tmpStates);" << std::endl;
+	stream << "                            }" << std::endl;
+	stream << "                        }" << std::endl;
+	stream << "                    }" << std::endl;
+	stream << "                    if (!bitHasAny(tmpStates, STATES_BYTES)) {" << std::endl;
+	stream << "                        _host.raiseDoneEvent(states[j].name, (const DoneData*)NULL);" << std::endl;
+	stream << "                    }" << std::endl;
+	stream << "                }" << std::endl;
+	stream << "            }" << std::endl;
+	stream << "        }" << std::endl;
+	stream << "    }" << std::endl;
+	stream << std::endl;
+	stream << "    return ERR_OK;" << std::endl;
+	stream << "}" << std::endl;
+	stream << std::endl;
+}
+
+}
@@ -0,0 +1,67 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#ifndef CHARTTOCPP_H_2C1E8A4D
+#define CHARTTOCPP_H_2C1E8A4D
+
+#include "Transformer.h"
+#include "ChartToC.h"
+#include "uscxml/util/DOM.h"
+
+#include <ostream>
+
+namespace uscxml {
+
+/**
+ * Generate a header-only C++ class template for a state-chart.
+ *
+ * Other than with ChartToC, the executable content is written as member
+ * functions and the runtime services are provided by the template parameter,
+ * so the compiler can inline everything into the step function. With the
+ * native datamodel, conditions, scripts and data are C++ code, only a value
+ * that is a single quoted literal as a whole becomes a std::string.
+ */
+class USCXML_API ChartToCpp : public ChartToC {
+public:
+	virtual ~ChartToCpp();
+	static Transformer transform(const Interpreter& other);
+
+	void writeTo(std::ostream& stream);
+
+protected:
+	ChartToCpp(const Interpreter& other);
+
+	void writeTables(std::ostream& stream);
+	void writeDispatch(std::ostream& stream);
+	void writeMembers(std::ostream& stream);
+	void writeStep(std::ostream& stream);
+
+	void writeCppExecContent(std::ostream& stream, const XERCESC_NS::DOMNode* node, size_t indent);
+	void writeParams(std::ostream& stream, const XERCESC_NS::DOMElement* elem, const std::string& padding);
+	std::string strOrNull(const XERCESC_NS::DOMElement* elem, const X& attr);
+	std::string contentOrNull(const XERCESC_NS::DOMElement* elem);
+	std::string nativeType(const XERCESC_NS::DOMElement* data);
+	std::string nativeExpr(const std::string& expr);
+
+	std::string _className;
+};
+
+}
+
+#endif /* end of include guard: CHARTTOCPP_H_2C1E8A4D */
@@ -0,0 +1,840 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#include "uscxml/config.h"
+#include "uscxml/transform/CompiledMicroStep.h"
+#include "uscxml/transform/ChartToC.h"
+#include "uscxml/interpreter/FastMicroStep.h"
+#include "uscxml/interpreter/InterpreterImpl.h"
+#include "uscxml/interpreter/InterpreterMonitor.h"
+#include "uscxml/interpreter/Logging.h"
+#include "uscxml/util/Predicates.h"
+#include "uscxml/util/String.h"
+#include "uscxml/util/Convenience.h"
+#include "uscxml/util/Base64.hpp"
+#include "uscxml/util/UUID.h"
+#include "uscxml/util/URL.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <errno.h>
+#include <stdint.h> // uintptr_t
+#include <stdio.h> // remove, rename
+#include <stdlib.h> // system, getenv
+#include <string.h> // memcpy
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// bump whenever the emitted shim changes to invalidate cached objects
+#define USCXML_COMPILED_ABI "2"
+
+#define USCXML_COMPILED_ON_ENTRY      0
+#define USCXML_COMPILED_ON_EXIT       1
+#define USCXML_COMPILED_ON_TRANSITION 2
+#define USCXML_COMPILED_INIT_DATA     3
+#define USCXML_COMPILED_GLOBAL_SCRIPT 4
+
+// as in the generated C
+#define USCXML_ERR_OK                 0
+#define USCXML_ERR_IDLE               1
+#define USCXML_ERR_DONE               2
+
+#define USCXML_CTX_TOP_LEVEL_FINAL    0x04
+#define USCXML_CTX_FINISHED           0x10
+
+namespace uscxml {
+
+using namespace XERCESC_NS;
+
+namespace {
+
+/**
+ * ChartToC, but with all executable content delegated to the host.
+ */
+class ChartToCompiledC : public ChartToC {
+public:
+	ChartToCompiledC(const Interpreter& other) : ChartToC(other) {
+		// guards are evaluated by the interpreter's datamodel
+		_hasNativeDataModel = false;
+	}
+
+	const std::string& getMD5() {
+		return _md5;
+	}
+	const std::vector<DOMElement*>& getStates() {
+		return _states;
+	}
+	const std::vector<DOMElement*>& getTransitions() {
+		return _transitions;
+	}
+
+	void writeTo(std::ostream& stream) {
+		ChartToC::writeTo(stream);
+		writeShim(stream);
+	}
+
+protected:
+	void writeExecContent(std::ostream& stream) {
+		stream << "#ifndef USCXML_NO_EXEC_CONTENT" << std::endl;
+		stream << std::endl;
+
+		stream << "struct uscxml_compiled_host {" << std::endl;
+		stream << "    void* instance;" << std::endl;
+		stream << "    const void* (*dequeue_internal)(void* instance);" << std::endl;
+		stream << "    const void* (*dequeue_external)(void* instance);" << std::endl;
+		stream << "    int (*is_matched)(void* instance, size_t transition, const void* event);" << std::endl;
+		stream << "    int (*is_enabled)(void* instance, size_t transition);" << std::endl;
+		stream << "    int (*exec)(void* instance, int kind, size_t index);" << std::endl;
+		stream << "    int (*invoke)(void* instance, size_t state, int uninvoke);" << std::endl;
+		stream << "    int (*raise_done_event)(void* instance, size_t state, size_t final_state);" << std::endl;
+		stream << "};" << std::endl;
+		stream << std::endl;
+		stream << "#define USCXML_COMPILED_HOST(ctx) ((const struct uscxml_compiled_host*)(ctx)->user_data)" << std::endl;
+		stream << std::endl;
+
+		if (DOMUtils::filterChildElements(XML_PREFIX(_scxml).str() + "script", _scxml).size() > 0) {
+			stream << "static int " << _prefix << "_global_script(const uscxml_ctx* ctx, const uscxml_state* state, const void* event) {" << std::endl;
+			stream << "    return USCXML_COMPILED_HOST(ctx)->exec(USCXML_COMPILED_HOST(ctx)->instance, " << USCXML_COMPILED_GLOBAL_SCRIPT << ", 0);" << std::endl;
+			stream << "}" << std::endl;
+			stream << std::endl;
+		}
+
+		for (size_t i = 0; i < _states.size(); i++) {
+			DOMElement* state(_states[i]);
+
+			if (DOMUtils::filterChildElements(XML_PREFIX(state).str() + "onexit", state).size() > 0) {
+				stream << "static int " << _prefix << "_" << DOMUtils::idForNode(state) << "_on_exit(const uscxml_ctx* ctx, const uscxml_state* state, const void* event) {" << std::endl;
+				stream << "    return USCXML_COMPILED_HOST(ctx)->exec(USCXML_COMPILED_HOST(ctx)->instance, " << USCXML_COMPILED_ON_EXIT << ", " << i << ");" << std::endl;
+				stream << "}" << std::endl;
+				stream << std::endl;
+			}
+
+			if (DOMUtils::filterChildElements(XML_PREFIX(state).str() + "onentry", state).size() > 0) {
+				stream << "static int " << _prefix << "_" << DOMUtils::idForNode(state) << "_on_entry(const uscxml_ctx* ctx, const uscxml_state* state, const void* event) {" << std::endl;
+				stream << "    return USCXML_COMPILED_HOST(ctx)->exec(USCXML_COMPILED_HOST(ctx)->instance, " << USCXML_COMPILED_ON_ENTRY << ", " << i << ");" << std::endl;
+				stream << "}" << std::endl;
+				stream << std::endl;
+			}
+
+			if (DOMUtils::filterChildElements(XML_PREFIX(state).str() + "invoke", state).size() > 0) {
+				stream << "static int " << _prefix << "_" << DOMUtils::idForNode(state) << "_invoke(const uscxml_ctx* ctx, const uscxml_state* s, const uscxml_elem_invoke* invocation, unsigned char uninvoke) {" << std::endl;
+				stream << "    return USCXML_COMPILED_HOST(ctx)->invoke(USCXML_COMPILED_HOST(ctx)->instance, " << i << ", uninvoke);" << std::endl;
+				stream << "}" << std::endl;
+				stream << std::endl;
+			}
+		}
+
+		for (size_t i = 0; i < _transitions.size(); i++) {
+			DOMElement* transition(_transitions[i]);
+
+			if (HAS_ATTR(transition, kXMLCharCond)) {
+				stream << "static int " << _prefix << "_" << DOMUtils::idForNode(transition) << "_is_enabled(const uscxml_ctx* ctx, const uscxml_transition* transition) {" << std::endl;
+				stream << "    return USCXML_COMPILED_HOST(ctx)->is_enabled(USCXML_COMPILED_HOST(ctx)->instance, " << i << ");" << std::endl;
+				stream << "}" << std::endl;
+				stream << std::endl;
+			}
+
+			if (DOMUtils::filterChildType(DOMNode::ELEMENT_NODE, transition).size() > 0) {
+				stream << "static int " << _prefix << "_" << DOMUtils::idForNode(transition) << "_on_trans(const uscxml_ctx* ctx, const uscxml_state* state, const void* event) {" << std::endl;
+				stream << "    return USCXML_COMPILED_HOST(ctx)->exec(USCXML_COMPILED_HOST(ctx)->instance, " << USCXML_COMPILED_ON_TRANSITION << ", " << i << ");" << std::endl;
+				stream << "}" << std::endl;
+				stream << std::endl;
+			}
+		}
+
+		stream << "#endif" << std::endl;
+		stream << std::endl;
+	}
+
+	void writeShim(std::ostream& stream) {
+		stream << "#include <string.h> /* memset */" << std::endl;
+		stream << "#include <stddef.h> /* offsetof */" << std::endl;
+		stream << std::endl;
+
+		stream << "static void* uscxml_compiled_dequeue_internal(const uscxml_ctx* ctx) {" << std::endl;
+		stream << "    return (void*)USCXML_COMPILED_HOST(ctx)->dequeue_internal(USCXML_COMPILED_HOST(ctx)->instance);" << std::endl;
+		stream << "}" << std::endl;
+		stream << std::endl;
+
+		stream << "static void* uscxml_compiled_dequeue_external(const uscxml_ctx* ctx) {" << std::endl;
+		stream << "    return (void*)USCXML_COMPILED_HOST(ctx)->dequeue_external(USCXML_COMPILED_HOST(ctx)->instance);" << std::endl;
+		stream << "}" << std::endl;
+		stream << std::endl;
+
+		stream << "static int uscxml_compiled_is_matched(const uscxml_ctx* ctx, const uscxml_transition* transition, const void* event) {" << std::endl;
+		stream << "    return USCXML_COMPILED_HOST(ctx)->is_matched(USCXML_COMPILED_HOST(ctx)->instance, transition - ctx->machine->transitions, event);" << std::endl;
+		stream << "}" << std::endl;
+		stream << std::endl;
+
+		stream << "static int uscxml_compiled_raise_done_event(const uscxml_ctx* ctx, const uscxml_state* state, const uscxml_elem_donedata* donedata) {" << std::endl;
+		stream << "    return USCXML_COMPILED_HOST(ctx)->raise_done_event(USCXML_COMPILED_HOST(ctx)->instance," << std::endl;
+		stream << "                                                        state - ctx->machine->states," << std::endl;
+		stream << "                                                        (donedata != NULL ? (size_t)donedata->source : (size_t)-1));" << std::endl;
+		stream << "}" << std::endl;
+		stream << std::endl;
+
+		stream << "static int uscxml_compiled_init_data(const uscxml_ctx* ctx, const uscxml_elem_data* data) {" << std::endl;
+		stream << "    size_t i;" << std::endl;
+		stream << "    for (i = 0; i < ctx->machine->nr_states; i++) {" << std::endl;
+		stream << "        if (ctx->machine->states[i].data == data)" << std::endl;
+		stream << "            return USCXML_COMPILED_HOST(ctx)->exec(USCXML_COMPILED_HOST(ctx)->instance, " << USCXML_COMPILED_INIT_DATA << ", i);" << std::endl;
+		stream << "    }" << std::endl;
+		stream << "    return USCXML_ERR_OK;" << std::endl;
+		stream << "}" << std::endl;
+		stream << std::endl;
+
+		stream << "size_t uscxml_compiled_ctx_size(void) {" << std::endl;
+		stream << "    return sizeof(uscxml_ctx);" << std::endl;
+		stream << "}" << std::endl;
+		stream << std::endl;
+
+		stream << "size_t uscxml_compiled_ctx_align(void) {" << std::endl;
+		stream << "    struct uscxml_compiled_align { char c; uscxml_ctx ctx; };" << std::endl;
+		stream << "    return offsetof(struct uscxml_compiled_align, ctx);" << std::endl;
+		stream << "}" << std::endl;
+		stream << std::endl;
+
+		stream << "size_t uscxml_compiled_state_bytes(void) {" << std::endl;
+		stream << "    return USCXML_MAX_NR_STATES_BYTES;" << std::endl;
+		stream << "}" << std::endl;
+		stream << std::endl;
+
+		stream << "void uscxml_compiled_init(void* mem, const struct uscxml_compiled_host* host) {" << std::endl;
+		stream << "    uscxml_ctx* ctx = (uscxml_ctx*)mem;" << std::endl;
+		stream << "    memset(ctx, 0, sizeof(uscxml_ctx));" << std::endl;
+		stream << "    ctx->machine = &" << _prefix << "_machine;" << std::endl;
+		stream << "    ctx->user_data = (void*)host;" << std::endl;
+		stream << "    ctx->dequeue_internal = uscxml_compiled_dequeue_internal;" << std::endl;
+		stream << "    ctx->dequeue_external = uscxml_compiled_dequeue_external;" << std::endl;
+		stream << "    ctx->is_matched = uscxml_compiled_is_matched;" << std::endl;
+		stream << "    ctx->raise_done_event = uscxml_compiled_raise_done_event;" << std::endl;
+		stream << "    ctx->exec_content_init = uscxml_compiled_init_data;" << std::endl;
+		stream << "}" << std::endl;
+		stream << std::endl;
+
+		stream << "int uscxml_compiled_step(void* mem) {" << std::endl;
+		stream << "    return uscxml_step((uscxml_ctx*)mem);" << std::endl;
+		stream << "}" << std::endl;
+		stream << std::endl;
+
+		stream << "unsigned char* uscxml_compiled_flags(void* mem) {" << std::endl;
+		stream << "    return &((uscxml_ctx*)mem)->flags;" << std::endl;
+		stream << "}" << std::endl;
+		stream << std::endl;
+
+		stream << "unsigned char* uscxml_compiled_bits(void* mem, int which) {" << std::endl;
+		stream << "    uscxml_ctx* ctx = (uscxml_ctx*)mem;" << std::endl;
+		stream << "    switch (which) {" << std::endl;
+		stream << "    case 0: return ctx->config;" << std::endl;
+		stream << "    case 1: return ctx->history;" << std::endl;
+		stream << "    case 2: return ctx->invocations;" << std::endl;
+		stream << "    default: return ctx->initialized_data;" << std::endl;
+		stream << "    }" << std::endl;
+		stream << "}" << std::endl;
+		stream << std::endl;
+	}
+};
+
+}
+
+class CompiledMicroStep::Library {
+public:
+	~Library() {
+#ifndef _WIN32
+		if (handle != NULL)
+			dlclose(handle);
+#endif
+	}
+
+	void* handle = NULL;
+	size_t (*ctxSize)() = NULL;
+	size_t (*ctxAlign)() = NULL;
+	size_t (*stateBytes)() = NULL;
+	void (*init)(void* ctx, const Host* host) = NULL;
+	int (*step)(void* ctx) = NULL;
+	unsigned char* (*flags)(void* ctx) = NULL;
+	unsigned char* (*bits)(void* ctx, int which) = NULL;
+};
+
+enum BitArray {
+	CONFIGURATION = 0,
+	HISTORY = 1,
+	INVOCATIONS = 2,
+	INITIALIZED_DATA = 3
+};
+
+static std::mutex _librariesMutex;
+static std::condition_variable _librariesCond;
+static std::map<std::string, std::weak_ptr<CompiledMicroStep::Library> > _libraries;
+static std::set<std::string> _librariesInFlight; ///< keys currently loaded or compiled without the lock
+
+/// Clears the in-flight marker of a key and wakes everyone waiting for it, even if we threw
+struct InFlightLibrary {
+	InFlightLibrary(const std::string& key) : key(key) {}
+	~InFlightLibrary() {
+		std::lock_guard<std::mutex> lock(_librariesMutex);
+		if (library)
+			_libraries[key] = library;
+		_librariesInFlight.erase(key);
+		_librariesCond.notify_all();
+	}
+	std::string key;
+	std::shared_ptr<CompiledMicroStep::Library> library;
+};
+
+#ifndef _WIN32
+/// Whether the path is no symlink, owned by us and not writable by anyone else
+static bool isPrivate(const std::string& path, bool isDir) {
+	struct stat st;
+	if (lstat(path.c_str(), &st) != 0)
+		return false;
+	if (isDir ? !S_ISDIR(st.st_mode) : !S_ISREG(st.st_mode))
+		return false;
+	return st.st_uid == getuid() && (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+#endif
+
+/// The per-user directory for shared objects, empty if there is no private one
+static std::string getCacheDir() {
+#ifdef _WIN32
+	return "";
+#else
+	std::string base;
+	const char* xdgCacheHome = getenv("XDG_CACHE_HOME");
+	const char* home = getenv("HOME");
+	if (xdgCacheHome != NULL && xdgCacheHome[0] == '/') {
+		base = xdgCacheHome;
+	} else if (home != NULL && home[0] == '/') {
+		base = std::string(home) + "/.cache";
+		mkdir(base.c_str(), 0700); // might exist already
+	} else {
+		return "";
+	}
+
+	std::string dir = base + "/uscxml";
+	if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST)
+		return "";
+	if (!isPrivate(dir, true))
+		return "";
+
+	// paths end up quoted in the compiler's command line
+	if (dir.find_first_of("\"`$\\") != std::string::npos)
+		return "";
+	return dir;
+#endif
+}
+
+static std::shared_ptr<CompiledMicroStep::Library> loadLibrary(const std::string& path) {
+	std::shared_ptr<CompiledMicroStep::Library> library;
+#ifndef _WIN32
+	// never load what someone else could have put or changed there
+	if (!isPrivate(path, false))
+		return library;
+
+	void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (handle == NULL)
+		return library;
+
+	library = std::shared_ptr<CompiledMicroStep::Library>(new CompiledMicroStep::Library());
+	library->handle = handle;
+	library->ctxSize = (size_t (*)())dlsym(handle, "uscxml_compiled_ctx_size");
+	library->ctxAlign = (size_t (*)())dlsym(handle, "uscxml_compiled_ctx_align");
+	library->stateBytes = (size_t (*)())dlsym(handle, "uscxml_compiled_state_bytes");
+	library->init = (void (*)(void*, const CompiledMicroStep::Host*))dlsym(handle, "uscxml_compiled_init");
+	library->step = (int (*)(void*))dlsym(handle, "uscxml_compiled_step");
+	library->flags = (unsigned char* (*)(void*))dlsym(handle, "uscxml_compiled_flags");
+	library->bits = (unsigned char* (*)(void*, int))dlsym(handle, "uscxml_compiled_bits");
+
+	if (library->ctxSize == NULL ||
+	        library->ctxAlign == NULL ||
+	        library->stateBytes == NULL ||
+	        library->init == NULL ||
+	        library->step == NULL ||
+	        library->flags == NULL ||
+	        library->bits == NULL) {
+		library.reset();
+	}
+#endif
+	return library;
+}
+
+static bool compileLibrary(ChartToCompiledC& c2c, const std::string& objPath) {
+#ifdef _WIN32
+	return false;
+#else
+	// build next to the final path in our private directory and rename, other processes may race us
+	std::string tmpPath = objPath + "." + UUID::getUUID();
+
+	std::ofstream srcStream;
+	srcStream.open((tmpPath + ".c").c_str());
+	if (!srcStream)
+		return false;
+	c2c.writeTo(srcStream);
+	srcStream.close();
+
+	std::string cc = (getenv("USCXML_CC") != NULL ? getenv("USCXML_CC") : "cc");
+	std::string cflags = (getenv("USCXML_CFLAGS") != NULL ? getenv("USCXML_CFLAGS") : "-O2");
+	std::string cmd = cc + " " + cflags + " -shared -fPIC -o \"" + tmpPath + ".so\" \"" + tmpPath + ".c\"";
+
+	int err = system(cmd.c_str());
+	remove((tmpPath + ".c").c_str());
+	if (err != 0) {
+		remove((tmpPath + ".so").c_str());
+		return false;
+	}
+	// the compiler honours the umask, which might leave the object group writable
+	if (chmod((tmpPath + ".so").c_str(), 0700) != 0 ||
+	        rename((tmpPath + ".so").c_str(), objPath.c_str()) != 0) {
+		remove((tmpPath + ".so").c_str());
+		return false;
+	}
+	return true;
+#endif
+}
+
+CompiledMicroStep::CompiledMicroStep(MicroStepCallbacks* callbacks)
+	: MicroStepImpl(callbacks), _ctx(NULL), _scxml(NULL), _binding(EARLY), _isInitialized(false), _isCancelled(false), _blockMs(0) {
+	_host.instance = this;
+	_host.dequeueInternal = hostDequeueInternal;
+	_host.dequeueExternal = hostDequeueExternal;
+	_host.isMatched = hostIsMatched;
+	_host.isEnabled = hostIsEnabled;
+	_host.exec = hostExec;
+	_host.invoke = hostInvoke;
+	_host.raiseDoneEvent = hostRaiseDoneEvent;
+}
+
+CompiledMicroStep::~CompiledMicroStep() {
+}
+
+std::shared_ptr<MicroStepImpl> CompiledMicroStep::create(MicroStepCallbacks* callbacks) {
+	return std::shared_ptr<MicroStepImpl>(new CompiledMicroStep(callbacks));
+}
+
+void CompiledMicroStep::init(XERCESC_NS::DOMElement* scxml) {
+	_scxml = scxml;
+	_binding = (HAS_ATTR(_scxml, kXMLCharBinding) && iequals(ATTR(_scxml, kXMLCharBinding), "late") ? LATE : EARLY);
+
+	X xmlPrefix = _scxml->getPrefix();
+	if (xmlPrefix) {
+		xmlPrefix = std::string(xmlPrefix) + ":";
+	}
+
+	try {
+		std::set<std::string> elementNames = {
+			xmlPrefix.str() + "state",
+			xmlPrefix.str() + "parallel",
+			xmlPrefix.str() + "scxml",
+			xmlPrefix.str() + "initial",
+			xmlPrefix.str() + "final",
+			xmlPrefix.str() + "history",
+			xmlPrefix.str() + "transition"
+		};
+		std::list<DOMElement*> elements = DOMUtils::inDocumentOrder(elementNames, _scxml);
+		std::vector<DOMElement*> tagged(elements.begin(), elements.end());
+
+		// tag a copy to find our elements again in the transformer's, the document might be shared
+		DOMImplementation* implementation = DOMImplementationRegistry::getDOMImplementation(X("core"));
+		DOMDocument* tagDocument = implementation->createDocument();
+		DOMElement* tagScxml = static_cast<DOMElement*>(tagDocument->importNode(_scxml, true));
+		tagDocument->appendChild(tagScxml);
+
+		std::list<DOMElement*> tagElements = DOMUtils::inDocumentOrder(elementNames, tagScxml);
+		size_t index = 0;
+		for (auto tagIter = tagElements.begin(); tagIter != tagElements.end(); tagIter++) {
+			(*tagIter)->setAttribute(X("compiledIndex"), X(toStr(index++)));
+		}
+
+		InterpreterImpl* interpreterImpl = dynamic_cast<InterpreterImpl*>(_callbacks);
+		Interpreter copy = Interpreter::fromElement(tagScxml, (interpreterImpl != NULL ? interpreterImpl->getBaseURL() : ""));
+		tagDocument->release();
+
+		ChartToCompiledC c2c(copy);
+
+		std::string key = c2c.getMD5() + "-" + USCXML_COMPILED_ABI;
+		bool compile = false;
+		{
+			// only charts with the same key wait for each other
+			std::unique_lock<std::mutex> lock(_librariesMutex);
+			_librariesCond.wait(lock, [&key] {
+				return _librariesInFlight.find(key) == _librariesInFlight.end();
+			});
+			_library = _libraries[key].lock();
+			if (!_library) {
+				_librariesInFlight.insert(key);
+				compile = true;
+			}
+		}
+
+		if (compile) {
+			InFlightLibrary inFlight(key);
+			std::string cacheDir = getCacheDir();
+			if (cacheDir.length() == 0) {
+				LOG(_callbacks->getLogger(), USCXML_WARN) << "No private cache directory for compiled state-charts" << std::endl;
+			} else {
+				std::string objPath = cacheDir + PATH_SEPERATOR + "compiled-" + key + ".so";
+
+				_library = loadLibrary(objPath);
+				if (!_library && compileLibrary(c2c, objPath)) {
+					_library = loadLibrary(objPath);
+				}
+				inFlight.library = _library;
+			}
+		}
+
+		if (_library) {
+			const std::vector<DOMElement*>& states = c2c.getStates();
+			const std::vector<DOMElement*>& transitions = c2c.getTransitions();
+
+			_states.resize(states.size());
+			for (size_t i = 0; i < states.size(); i++) {
+				State& state = _states[i];
+				state.element = tagged[strTo<size_t>(ATTR(states[i], X("compiledIndex")))];
+
+				if (HAS_ATTR(state.element, kXMLCharId)) {
+					_stateIds[ATTR(state.element, kXMLCharId)] = i;
+				}
+
+				state.onEntry = DOMUtils::filterChildElements(xmlPrefix.str() + "onentry", state.element);
+				state.onExit = DOMUtils::filterChildElements(xmlPrefix.str() + "onexit", state.element);
+				state.invoke = DOMUtils::filterChildElements(xmlPrefix.str() + "invoke", state.element);
+
+				std::list<DOMElement*> doneDatas = DOMUtils::filterChildElements(xmlPrefix.str() + "donedata", state.element);
+				if (doneDatas.size() > 0) {
+					state.doneData = doneDatas.front();
+				}
+
+				if (_binding == LATE) {
+					std::list<DOMElement*> dataModels = DOMUtils::filterChildElements(xmlPrefix.str() + "datamodel", state.element);
+					if (dataModels.size() > 0) {
+						state.data = DOMUtils::filterChildElements(xmlPrefix.str() + "data", dataModels, false);
+					}
+				}
+			}
+
+			if (_states.size() > 0) {
+				_globalScripts = DOMUtils::filterChildElements(xmlPrefix.str() + "script", _states[0].element, false);
+
+				if (_binding == EARLY) {
+					// all data elements are initialized with the root state
+					std::list<DOMElement*> dataModels = DOMUtils::filterChildElements(xmlPrefix.str() + "datamodel", _states[0].element, true);
+					dataModels.erase(std::remove_if(dataModels.begin(),
+					                                dataModels.end(),
+					[this](DOMElement* elem) {
+						return !areFromSameMachine(elem, _scxml);
+					}),
+					dataModels.end());
+
+					_states[0].data = DOMUtils::filterChildElements(xmlPrefix.str() + "data", dataModels, false);
+				}
+			}
+
+			_transitions.resize(transitions.size());
+			for (size_t i = 0; i < transitions.size(); i++) {
+				Transition& transition = _transitions[i];
+				transition.element = tagged[strTo<size_t>(ATTR(transitions[i], X("compiledIndex")))];
+				transition.event = ATTR(transition.element, kXMLCharEvent);
+				transition.cond = ATTR(transition.element, kXMLCharCond);
+			}
+
+			// bit arrays in the context might be accessed with aligned SIMD instructions
+			size_t align = _library->ctxAlign();
+			_ctxMem.resize(_library->ctxSize() + align);
+			_ctx = &_ctxMem[0] + (align - (uintptr_t)&_ctxMem[0] % align) % align;
+			_library->init(_ctx, &_host);
+		}
+
+	} catch (ErrorEvent e) {
+		LOG(_callbacks->getLogger(), USCXML_WARN) << e;
+		_library.reset();
+	} catch (...) {
+		_library.reset();
+	}
+
+	if (!_library) {
+		if (envVarIsTrue("USCXML_COMPILED_NOFALLBACK")) {
+			ERROR_PLATFORM_THROW("Could not compile state-chart");
+		}
+		LOG(_callbacks->getLogger(), USCXML_WARN) << "Could not compile state-chart, falling back to FastMicroStep" << std::endl;
+		_states.clear();
+		_transitions.clear();
+		_stateIds.clear();
+		_fallback = std::shared_ptr<MicroStepImpl>(new FastMicroStep(_callbacks));
+		_fallback->init(_scxml);
+	}
+
+	_isInitialized = true;
+}
+
+const void* CompiledMicroStep::hostDequeueInternal(void* instance) {
+	CompiledMicroStep* self = static_cast<CompiledMicroStep*>(instance);
+	if ((self->_event = self->_callbacks->dequeueInternal())) {
+		std::set<InterpreterMonitor*> monitors = self->_callbacks->getMonitors();
+		MicroStepCallbacks* _callbacks = self->_callbacks;
+		USCXML_MONITOR_CALLBACK1(monitors, beforeProcessingEvent, self->_event);
+		return &self->_event;
+	}
+	return NULL;
+}
+
+const void* CompiledMicroStep::hostDequeueExternal(void* instance) {
+	CompiledMicroStep* self = static_cast<CompiledMicroStep*>(instance);
+	if ((self->_event = self->_callbacks->dequeueExternal(self->_blockMs))) {
+		std::set<InterpreterMonitor*> monitors = self->_callbacks->getMonitors();
+		MicroStepCallbacks* _callbacks = self->_callbacks;
+		USCXML_MONITOR_CALLBACK1(monitors, beforeProcessingEvent, self->_event);
+		return &self->_event;
+	}
+	return NULL;
+}
+
+int CompiledMicroStep::hostIsMatched(void* instance, size_t transition, const void* event) {
+	CompiledMicroStep* self = static_cast<CompiledMicroStep*>(instance);
+	return self->_callbacks->isMatched(*static_cast<const Event*>(event), self->_transitions[transition].event);
+}
+
+int CompiledMicroStep::hostIsEnabled(void* instance, size_t transition) {
+	CompiledMicroStep* self = static_cast<CompiledMicroStep*>(instance);
+	return self->_callbacks->isTrue(self->_transitions[transition].cond);
+}
+
+int CompiledMicroStep::hostExec(void* instance, int kind, size_t index) {
+	CompiledMicroStep* self = static_cast<CompiledMicroStep*>(instance);
+
+	switch (kind) {
+	case USCXML_COMPILED_ON_ENTRY:
+		self->processAll(self->_states[index].onEntry);
+		break;
+	case USCXML_COMPILED_ON_EXIT:
+		self->processAll(self->_states[index].onExit);
+		break;
+	case USCXML_COMPILED_ON_TRANSITION:
+		self->processAll(std::list<DOMElement*>({ self->_transitions[index].element }));
+		break;
+	case USCXML_COMPILED_INIT_DATA:
+		self->initData(index);
+		break;
+	case USCXML_COMPILED_GLOBAL_SCRIPT:
+		// the compiled step runs global scripts before entering the root, but they may depend on its data
+		self->initData(0);
+		self->_library->bits(self->_ctx, INITIALIZED_DATA)[0] |= 0x01;
+		self->processAll(self->_globalScripts);
+		break;
+	default:
+		break;
+	}
+	return USCXML_ERR_OK;
+}
+
+int CompiledMicroStep::hostInvoke(void* instance, size_t state, int uninvoke) {
+	CompiledMicroStep* self = static_cast<CompiledMicroStep*>(instance);
+	const std::list<DOMElement*>& invokes = self->_states[state].invoke;
+
+	for (auto invIter = invokes.begin(); invIter != invokes.end(); invIter++) {
+		if (uninvoke) {
+			self->_callbacks->uninvoke(*invIter);
+		} else {
+			try {
+				self->_callbacks->invoke(*invIter);
+			} catch (ErrorEvent e) {
+				LOG(self->_callbacks->getLogger(), USCXML_WARN) << e;
+			} catch (...) {
+			}
+		}
+	}
+	return USCXML_ERR_OK;
+}
+
+int CompiledMicroStep::hostRaiseDoneEvent(void* instance, size_t state, size_t finalState) {
+	CompiledMicroStep* self = static_cast<CompiledMicroStep*>(instance);
+	self->_callbacks->raiseDoneEvent(self->_states[state].element,
+	                                     (finalState < self->_states.size() ? self->_states[finalState].doneData : NULL));
+	return USCXML_ERR_OK;
+}
+
+void CompiledMicroStep::processAll(const std::list<XERCESC_NS::DOMElement*>& blocks) {
+	for (auto blockIter = blocks.begin(); blockIter != blocks.end(); blockIter++) {
+		try {
+			_callbacks->process(*blockIter);
+		} catch (...) {
+			// do nothing and continue with next block
+		}
+	}
+}
+
+void CompiledMicroStep::initData(size_t state) {
+	for (auto dataIter = _states[state].data.begin(); dataIter != _states[state].data.end(); dataIter++) {
+		_callbacks->initData(*dataIter);
+	}
+}
+
+void CompiledMicroStep::markAsCancelled() {
+	if (_fallback) {
+		_fallback->markAsCancelled();
+		return;
+	}
+	_isCancelled = true;
+}
+
+InterpreterState CompiledMicroStep::step(size_t blockMs) {
+	if (!_isInitialized) {
+		init(_scxml);
+		return USCXML_INITIALIZED;
+	}
+
+	if (_fallback)
+		return _fallback->step(blockMs);
+
+	std::set<InterpreterMonitor*> monitors = _callbacks->getMonitors();
+	unsigned char* flags = _library->flags(_ctx);
+
+	if (*flags & USCXML_CTX_FINISHED)
+		return USCXML_FINISHED;
+
+	bool completing = (*flags & USCXML_CTX_TOP_LEVEL_FINAL) != 0;
+	if (completing) {
+		USCXML_MONITOR_CALLBACK(monitors, beforeCompletion);
+	}
+
+	_blockMs = blockMs;
+	int err = _library->step(_ctx);
+
+	switch (err) {
+	case USCXML_ERR_OK:
+		return USCXML_MICROSTEPPED;
+	case USCXML_ERR_DONE:
+		if (completing) {
+			USCXML_MONITOR_CALLBACK(monitors, afterCompletion);
+		}
+		return USCXML_FINISHED;
+	case USCXML_ERR_IDLE:
+		if (_isCancelled) {
+			// finalize and exit
+			*flags |= USCXML_CTX_TOP_LEVEL_FINAL;
+			return USCXML_CANCELLED;
+		}
+		return USCXML_IDLE;
+	default:
+		LOG(_callbacks->getLogger(), USCXML_ERROR) << "Compiled state-chart returned error " << err << std::endl;
+		return USCXML_IDLE;
+	}
+}
+
+void CompiledMicroStep::reset() {
+	if (_fallback) {
+		_fallback->reset();
+		return;
+	}
+	_isCancelled = false;
+	if (_library)
+		_library->init(_ctx, &_host);
+}
+
+bool CompiledMicroStep::isInState(const std::string& stateId) {
+	if (_fallback)
+		return _fallback->isInState(stateId);
+
+	if (!_library || _stateIds.find(stateId) == _stateIds.end())
+		return false;
+
+	size_t i = _stateIds[stateId];
+	return (_library->bits(_ctx, CONFIGURATION)[i >> 3] & (1 << (i & 7))) != 0;
+}
+
+std::list<XERCESC_NS::DOMElement*> CompiledMicroStep::getConfiguration() {
+	if (_fallback)
+		return _fallback->getConfiguration();
+
+	std::list<XERCESC_NS::DOMElement*> config;
+	if (!_library)
+		return config;
+
+	unsigned char* bits = _library->bits(_ctx, CONFIGURATION);
+	for (size_t i = 0; i < _states.size(); i++) {
+		if (bits[i >> 3] & (1 << (i & 7)))
+			config.push_back(_states[i].element);
+	}
+	return config;
+}
+
+Data CompiledMicroStep::serialize() {
+	if (_fallback)
+		return _fallback->serialize();
+
+	Data encodedState;
+	if (!_library)
+		return encodedState;
+
+	size_t nrBytes = _library->stateBytes();
+	encodedState["configuration"] = Data(base64Encode((const char*)_library->bits(_ctx, CONFIGURATION), nrBytes, true));
+	encodedState["invocations"] = Data(base64Encode((const char*)_library->bits(_ctx, INVOCATIONS), nrBytes, true));
+	encodedState["histories"] = Data(base64Encode((const char*)_library->bits(_ctx, HISTORY), nrBytes, true));
+	encodedState["intializedData"] = Data(base64Encode((const char*)_library->bits(_ctx, INITIALIZED_DATA), nrBytes, true));
+	encodedState["flags"] = Data((int)*_library->flags(_ctx));
+	return encodedState;
+}
+
+void CompiledMicroStep::deserialize(const Data& encodedState) {
+	if (_fallback) {
+		_fallback->deserialize(encodedState);
+		return;
+	}
+
+	if (!encodedState.hasKey("configuration") ||
+	        !encodedState.hasKey("invocations") ||
+	        !encodedState.hasKey("histories") ||
+	        !encodedState.hasKey("intializedData")) {
+		ERROR_PLATFORM_THROW("Data does not contain required fields for deserialization ");
+	}
+	if (!_library) {
+		ERROR_PLATFORM_THROW("Cannot deserialize into an uninitialized microstepper");
+	}
+
+	size_t nrBytes = _library->stateBytes();
+	const char* keys[] = { "configuration", "histories", "invocations", "intializedData" };
+	int arrays[] = { CONFIGURATION, HISTORY, INVOCATIONS, INITIALIZED_DATA };
+
+	for (size_t i = 0; i < 4; i++) {
+		std::string decoded = base64Decode(encodedState[keys[i]].atom);
+		if (decoded.size() != nrBytes) {
+			ERROR_PLATFORM_THROW(std::string("Serialized '") + keys[i] + "' does not match the compiled state-chart");
+		}
+		memcpy(_library->bits(_ctx, arrays[i]), decoded.data(), nrBytes);
+	}
+
+	// the compiled step invokes for active states without invocations
+	unsigned char* invocations = _library->bits(_ctx, INVOCATIONS);
+	for (size_t i = 0; i < _states.size(); i++) {
+		if (invocations[i >> 3] & (1 << (i & 7))) {
+			hostInvoke(this, i, 0);
+		}
+	}
+
+	unsigned char* flags = _library->flags(_ctx);
+	*flags = (encodedState.hasKey("flags") ? strTo<int>(encodedState["flags"].atom) : 0x02 /* INITIALIZED */);
+}
+
+}
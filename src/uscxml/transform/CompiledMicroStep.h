@@ -0,0 +1,156 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#ifndef COMPILEDMICROSTEP_H_5E0B7A21
+#define COMPILEDMICROSTEP_H_5E0B7A21
+
+#include "uscxml/Common.h"
+#include "uscxml/util/DOM.h" // X
+#include "uscxml/interpreter/MicroStepImpl.h"
+
+#include <vector>
+#include <list>
+#include <map>
+#include <string>
+
+namespace uscxml {
+
+/**
+ * @ingroup microstep
+ * @ingroup impl
+ *
+ * MicroStep implementation running the document as compiled C.
+ *
+ * The document is transformed with ChartToC, built into a shared object by
+ * the system's C compiler and loaded. Shared objects are cached per document
+ * md5 in the shared temporary directory and within the process. Executable
+ * content, guards, data and invokers are still delegated to the
+ * MicroStepCallbacks. If the document cannot be compiled or loaded, we fall
+ * back to a FastMicroStep, unless USCXML_COMPILED_NOFALLBACK is set.
+ *
+ * Shared objects are built into and loaded from $XDG_CACHE_HOME/uscxml (or
+ * ~/.cache/uscxml) only if that directory and the object are owned by the
+ * current user and not writable by anyone else.
+ *
+ * The compiler is taken from USCXML_CC (default "cc"), additional flags from
+ * USCXML_CFLAGS (default "-O2"). As ChartToC is part of the transformer
+ * library, this microstepper has to be registered explicitly and is then
+ * selected by setting USCXML_MICROSTEPPER=compiled:
+ *
+ *     Factory::getInstance()->registerMicrostepper(new CompiledMicroStep());
+ */
+class USCXML_API CompiledMicroStep : public MicroStepImpl {
+public:
+	CompiledMicroStep() {}; // only for registering with the factory
+	CompiledMicroStep(MicroStepCallbacks* callbacks);
+	virtual ~CompiledMicroStep();
+	virtual std::shared_ptr<MicroStepImpl> create(MicroStepCallbacks* callbacks);
+
+	std::string getName() {
+		return "compiled";
+	}
+
+	virtual InterpreterState step(size_t blockMs);
+	virtual void reset();
+	virtual bool isInState(const std::string& stateId);
+	virtual std::list<XERCESC_NS::DOMElement*> getConfiguration();
+	void markAsCancelled();
+
+	virtual void deserialize(const Data& encodedState);
+	virtual Data serialize();
+
+	/// Whether we are running compiled code or fell back to FastMicroStep
+	bool isCompiled() {
+		return (bool)_library;
+	}
+
+	/**
+	 * The callbacks from the compiled code, the layout has to match the
+	 * struct uscxml_compiled_host emitted into the C source.
+	 */
+	struct Host {
+		void* instance;
+		const void* (*dequeueInternal)(void* instance);
+		const void* (*dequeueExternal)(void* instance);
+		int (*isMatched)(void* instance, size_t transition, const void* event);
+		int (*isEnabled)(void* instance, size_t transition);
+		int (*exec)(void* instance, int kind, size_t index);
+		int (*invoke)(void* instance, size_t state, int uninvoke);
+		int (*raiseDoneEvent)(void* instance, size_t state, size_t finalState);
+	};
+
+	class Library;
+
+protected:
+	class State {
+	public:
+		XERCESC_NS::DOMElement* element = NULL;
+		std::list<XERCESC_NS::DOMElement*> data;
+		std::list<XERCESC_NS::DOMElement*> invoke;
+		std::list<XERCESC_NS::DOMElement*> onEntry;
+		std::list<XERCESC_NS::DOMElement*> onExit;
+		XERCESC_NS::DOMElement* doneData = NULL;
+	};
+
+	class Transition {
+	public:
+		XERCESC_NS::DOMElement* element = NULL;
+		std::string event;
+		std::string cond;
+	};
+
+	virtual void init(XERCESC_NS::DOMElement* scxml);
+
+	static const void* hostDequeueInternal(void* instance);
+	static const void* hostDequeueExternal(void* instance);
+	static int hostIsMatched(void* instance, size_t transition, const void* event);
+	static int hostIsEnabled(void* instance, size_t transition);
+	static int hostExec(void* instance, int kind, size_t index);
+	static int hostInvoke(void* instance, size_t state, int uninvoke);
+	static int hostRaiseDoneEvent(void* instance, size_t state, size_t finalState);
+
+	void processAll(const std::list<XERCESC_NS::DOMElement*>& blocks);
+	void initData(size_t state);
+
+	std::shared_ptr<Library> _library;
+	std::shared_ptr<MicroStepImpl> _fallback;
+
+	Host _host;
+	std::vector<char> _ctxMem;
+	void* _ctx; // uscxml_ctx of the compiled machine, aligned within _ctxMem
+
+	std::vector<State> _states;
+	std::vector<Transition> _transitions;
+	std::list<XERCESC_NS::DOMElement*> _globalScripts;
+	std::map<std::string, size_t> _stateIds;
+
+	XERCESC_NS::DOMElement* _scxml;
+	Binding _binding;
+
+	bool _isInitialized;
+	bool _isCancelled;
+	size_t _blockMs;
+	Event _event;
+
+	friend class Factory;
+};
+
+}
+
+#endif /* end of include guard: COMPILEDMICROSTEP_H_5E0B7A21 */
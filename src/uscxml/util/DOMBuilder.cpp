@@ -0,0 +1,192 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#include "DOMBuilder.h"
+#include "uscxml/util/DOM.h"
+
+#include <xercesc/sax2/SAX2XMLReader.hpp>
+#include <xercesc/sax2/XMLReaderFactory.hpp>
+#include <xercesc/sax2/Attributes.hpp>
+#include <xercesc/sax/SAXParseException.hpp>
+#include <xercesc/framework/MemBufInputSource.hpp>
+#include <xercesc/util/XMLUni.hpp>
+
+#include <memory>
+
+using namespace XERCESC_NS;
+
+namespace uscxml {
+
+static const X kXMLCharScxmlNS("http://www.w3.org/2005/07/scxml");
+static const X kXMLCharSpace("space");
+static const X kXMLCharPreserve("preserve");
+
+DOMBuilder::DOMBuilder() : _verbatim(0) {
+	DOMImplementation* implementation = DOMImplementationRegistry::getDOMImplementation(X("core"));
+	_document = implementation->createDocument();
+	_current = _document;
+}
+
+DOMBuilder::~DOMBuilder() {
+	if (_document)
+		_document->release();
+}
+
+DOMDocument* DOMBuilder::adoptDocument() {
+	DOMDocument* document = _document;
+	_document = NULL;
+	_current = NULL;
+	return document;
+}
+
+DOMDocument* DOMBuilder::parse(const std::string& xml) {
+	return parse(xml.data(), xml.size());
+}
+
+DOMDocument* DOMBuilder::parse(const char* data, size_t length) {
+	DOMBuilder builder;
+	std::unique_ptr<SAX2XMLReader> reader(XMLReaderFactory::createXMLReader());
+
+	reader->setFeature(XMLUni::fgSAX2CoreNameSpaces, true);
+	// report xmlns attributes as well, the DOM parser kept them
+	reader->setFeature(XMLUni::fgSAX2CoreNameSpacePrefixes, true);
+	reader->setFeature(XMLUni::fgSAX2CoreValidation, false);
+	// we do not have a real schema anyway
+	reader->setProperty(XMLUni::fgXercesScannerName, (void*)XMLUni::fgWFXMLScanner);
+
+	reader->setContentHandler(&builder);
+	reader->setLexicalHandler(&builder);
+	reader->setErrorHandler(&builder);
+
+	MemBufInputSource is((const XMLByte*)data, length, X("fake"));
+	reader->parse(is);
+
+	return builder.adoptDocument();
+}
+
+bool DOMBuilder::isVerbatim(const XMLCh* const uri, const XMLCh* const localname, const Attributes& attrs) {
+	if (_verbatim > 0)
+		return true;
+
+	// elements in other namespaces are custom executable content or data
+	if (uri != NULL && XMLString::stringLen(uri) > 0 && !XMLString::equals(uri, kXMLCharScxmlNS))
+		return true;
+
+	if (XMLString::equals(localname, kXMLCharContent) ||
+	        XMLString::equals(localname, kXMLCharData) ||
+	        XMLString::equals(localname, kXMLCharAssign) ||
+	        XMLString::equals(localname, kXMLCharScript))
+		return true;
+
+	const XMLCh* space = attrs.getValue(XMLUni::fgXMLURIName, kXMLCharSpace);
+	if (space != NULL && XMLString::equals(space, kXMLCharPreserve))
+		return true;
+
+	return false;
+}
+
+void DOMBuilder::flushText() {
+	if (_text.size() == 0)
+		return;
+
+	_text.push_back(0);
+	if (_verbatim > 0 || !XMLString::isAllWhiteSpace(&_text[0])) {
+		if (_current != _document)
+			_current->appendChild(_document->createTextNode(&_text[0]));
+	}
+	_text.clear();
+}
+
+void DOMBuilder::startElement(const XMLCh* const uri,
+                              const XMLCh* const localname,
+                              const XMLCh* const qname,
+                              const Attributes& attrs) {
+	flushText();
+
+	if (isVerbatim(uri, localname, attrs))
+		_verbatim++;
+
+	DOMElement* element = _document->createElementNS((uri != NULL && XMLString::stringLen(uri) > 0 ? uri : NULL), qname);
+	for (XMLSize_t i = 0; i < attrs.getLength(); i++) {
+		const XMLCh* attrURI = attrs.getURI(i);
+		const XMLCh* attrQName = attrs.getQName(i);
+
+		if (XMLString::equals(attrQName, XMLUni::fgXMLNSString) || XMLString::startsWith(attrQName, XMLUni::fgXMLNSColonString)) {
+			attrURI = XMLUni::fgXMLNSURIName;
+		}
+		element->setAttributeNS((attrURI != NULL && XMLString::stringLen(attrURI) > 0 ? attrURI : NULL), attrQName, attrs.getValue(i));
+	}
+
+	_current->appendChild(element);
+	_current = element;
+}
+
+void DOMBuilder::endElement(const XMLCh* const uri,
+                            const XMLCh* const localname,
+                            const XMLCh* const qname) {
+	flushText();
+
+	if (_verbatim > 0)
+		_verbatim--;
+	_current = _current->getParentNode();
+}
+
+void DOMBuilder::characters(const XMLCh* const chars, const XMLSize_t length) {
+	_text.insert(_text.end(), chars, chars + length);
+}
+
+void DOMBuilder::ignorableWhitespace(const XMLCh* const chars, const XMLSize_t length) {
+	if (_verbatim > 0)
+		characters(chars, length);
+}
+
+void DOMBuilder::processingInstruction(const XMLCh* const target, const XMLCh* const data) {
+	if (_verbatim == 0)
+		return;
+	flushText();
+	_current->appendChild(_document->createProcessingInstruction(target, data));
+}
+
+void DOMBuilder::comment(const XMLCh* const chars, const XMLSize_t length) {
+	if (_verbatim == 0)
+		return;
+	flushText();
+	std::vector<XMLCh> comment(chars, chars + length);
+	comment.push_back(0);
+	_current->appendChild(_document->createComment(&comment[0]));
+}
+
+void DOMBuilder::startCDATA() {
+	flushText();
+}
+
+void DOMBuilder::endCDATA() {
+	// CDATA sections are kept even when whitespace only
+	if (_text.size() > 0 && _current != _document) {
+		_text.push_back(0);
+		_current->appendChild(_document->createCDATASection(&_text[0]));
+		_text.clear();
+	}
+}
+
+void DOMBuilder::fatalError(const SAXParseException& exc) {
+	throw exc;
+}
+
+}
@@ -0,0 +1,84 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#ifndef DOMBUILDER_H_2B8E5C0D
+#define DOMBUILDER_H_2B8E5C0D
+
+#include "uscxml/Common.h"
+
+#include <string>
+#include <vector>
+
+#include <xercesc/dom/DOM.hpp>
+#include <xercesc/sax2/DefaultHandler.hpp>
+
+namespace uscxml {
+
+/**
+ * Build a compact DOM for an SCXML document from SAX2 events.
+ *
+ * Only the nodes read after the document was loaded are created: comments,
+ * processing instructions and whitespace-only text between SCXML elements
+ * are dropped. The subtrees of `<content>`, `<data>`, `<assign>` and
+ * `<script>`, of elements in foreign namespaces and of elements with
+ * `xml:space="preserve"` are kept verbatim, as they are interpreted as data
+ * or code at runtime.
+ */
+class USCXML_API DOMBuilder : public XERCESC_NS::DefaultHandler {
+public:
+	DOMBuilder();
+	virtual ~DOMBuilder();
+
+	/// Parse the document, the caller owns the returned document
+	static XERCESC_NS::DOMDocument* parse(const std::string& xml);
+	/// Parse the document from memory that is not copied, e.g. a MappedFile
+	static XERCESC_NS::DOMDocument* parse(const char* data, size_t length);
+
+	/// Transfer ownership of the built document to the caller
+	XERCESC_NS::DOMDocument* adoptDocument();
+
+	virtual void startElement(const XMLCh* const uri,
+	                          const XMLCh* const localname,
+	                          const XMLCh* const qname,
+	                          const XERCESC_NS::Attributes& attrs);
+	virtual void endElement(const XMLCh* const uri,
+	                        const XMLCh* const localname,
+	                        const XMLCh* const qname);
+	virtual void characters(const XMLCh* const chars, const XMLSize_t length);
+	virtual void ignorableWhitespace(const XMLCh* const chars, const XMLSize_t length);
+	virtual void processingInstruction(const XMLCh* const target, const XMLCh* const data);
+	virtual void comment(const XMLCh* const chars, const XMLSize_t length);
+	virtual void startCDATA();
+	virtual void endCDATA();
+
+	virtual void fatalError(const XERCESC_NS::SAXParseException& exc);
+
+protected:
+	bool isVerbatim(const XMLCh* const uri, const XMLCh* const localname, const XERCESC_NS::Attributes& attrs);
+	void flushText();
+
+	XERCESC_NS::DOMDocument* _document;
+	XERCESC_NS::DOMNode* _current;
+	size_t _verbatim; // depth within a subtree we keep as is
+	std::vector<XMLCh> _text;
+};
+
+}
+
+#endif /* end of include guard: DOMBUILDER_H_2B8E5C0D */
@@ -0,0 +1,125 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#include "MappedFile.h"
+#include "uscxml/messages/Event.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#endif
+
+namespace uscxml {
+
+// empty files cannot be mapped
+static const char* emptyContent = "";
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) : _data(emptyContent), _size(0), _file(INVALID_HANDLE_VALUE), _mapping(NULL) {
+	_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (_file == INVALID_HANDLE_VALUE) {
+		ERROR_COMMUNICATION_THROW("Cannot open '" + path + "'");
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_file, &size)) {
+		CloseHandle(_file);
+		ERROR_COMMUNICATION_THROW("Cannot stat '" + path + "'");
+	}
+	if (size.QuadPart == 0)
+		return;
+
+	_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_mapping != NULL)
+		_data = (const char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (_mapping == NULL || _data == NULL) {
+		if (_mapping != NULL)
+			CloseHandle(_mapping);
+		CloseHandle(_file);
+		ERROR_COMMUNICATION_THROW("Cannot map '" + path + "'");
+	}
+	_size = (size_t)size.QuadPart;
+}
+
+MappedFile::~MappedFile() {
+	if (_size > 0) {
+		UnmapViewOfFile(_data);
+		CloseHandle(_mapping);
+	}
+	if (_file != INVALID_HANDLE_VALUE)
+		CloseHandle(_file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) : _data(emptyContent), _size(0) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		ERROR_COMMUNICATION_THROW("Cannot open '" + path + "': " + strerror(errno));
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		int err = errno;
+		close(fd);
+		ERROR_COMMUNICATION_THROW("Cannot stat '" + path + "': " + strerror(err));
+	}
+	if (!S_ISREG(st.st_mode)) {
+		close(fd);
+		ERROR_COMMUNICATION_THROW("Cannot map '" + path + "': not a regular file");
+	}
+	if (st.st_size == 0) {
+		close(fd);
+		return;
+	}
+
+	void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	int err = errno;
+	// the mapping stays valid without the descriptor
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		ERROR_COMMUNICATION_THROW("Cannot map '" + path + "': " + strerror(err));
+	}
+#ifdef MADV_SEQUENTIAL
+	// we will read it once from the front
+	madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+
+	_data = (const char*)data;
+	_size = (size_t)st.st_size;
+}
+
+MappedFile::~MappedFile() {
+	if (_size > 0)
+		munmap((void*)_data, _size);
+}
+
+#endif
+
+}
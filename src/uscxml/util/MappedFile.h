@@ -0,0 +1,62 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#ifndef MAPPEDFILE_H_7C1E94A2
+#define MAPPEDFILE_H_7C1E94A2
+
+#include "uscxml/Common.h"
+
+#include <string>
+
+namespace uscxml {
+
+/**
+ * A local file mapped read-only into memory.
+ *
+ * The content is not copied and not null-terminated, it is valid as long as
+ * the MappedFile exists.
+ */
+class USCXML_API MappedFile {
+public:
+	/// Map the file at the given path, throws a communication error on failure
+	MappedFile(const std::string& path);
+	~MappedFile();
+
+	const char* data() const {
+		return _data;
+	}
+	size_t size() const {
+		return _size;
+	}
+
+protected:
+	MappedFile(const MappedFile& other) = delete;
+	MappedFile& operator=(const MappedFile& other) = delete;
+
+	const char* _data;
+	size_t _size;
+#ifdef _WIN32
+	void* _file;
+	void* _mapping;
+#endif
+};
+
+}
+
+#endif /* end of include guard: MAPPEDFILE_H_7C1E94A2 */
@@ -0,0 +1,306 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#ifndef RADIXTREE_H_E51B0A7D
+#define RADIXTREE_H_E51B0A7D
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <utility>
+#include <algorithm>
+
+namespace uscxml {
+
+/**
+ * A radix tree mapping strings to values for lookups by prefix.
+ *
+ * Nodes are immutable once published: writers copy the path to a changed
+ * node and swap in a new root, so readers take a snapshot without locking
+ * and keep using it while the tree is changed. Writers are serialized
+ * among each other.
+ */
+template <typename T>
+class RadixTree {
+public:
+	struct Node {
+		std::string label; // edge from the parent
+		bool hasValue = false;
+		T value = T();
+		std::vector<std::shared_ptr<const Node> > children; // ordered by the first character of their label
+	};
+	typedef std::shared_ptr<const Node> Snapshot;
+
+	RadixTree() : _sync(std::make_shared<Sync>()) {
+		_root = track(std::make_shared<Node>());
+	}
+
+	/// The current version of the tree, stays valid and unchanged as long as it is held
+	Snapshot snapshot() const {
+		return std::atomic_load(&_root);
+	}
+
+	/// Insert or replace the value for the key
+	void insert(const std::string& key, const T& value) {
+		std::lock_guard<std::mutex> lock(_writeMutex);
+		publish(insert(snapshot(), key, 0, value));
+	}
+
+	/// Remove the key, returns false if it was not in the tree
+	bool erase(const std::string& key) {
+		std::lock_guard<std::mutex> lock(_writeMutex);
+		Snapshot root = snapshot();
+		Snapshot newRoot = erase(root, key, 0);
+		if (newRoot == root)
+			return false;
+		publish(newRoot);
+		return true;
+	}
+
+	bool contains(const std::string& key) const {
+		Snapshot node = snapshot();
+		size_t pos = 0;
+		while(node && pos < key.size()) {
+			node = descend(node, key, pos);
+		}
+		return node && node->hasValue;
+	}
+
+	/**
+	 * All values with a key that is a prefix of the given key, as pairs of
+	 * the length of their key and the value, shortest first.
+	 */
+	static std::vector<std::pair<size_t, T> > getPrefixesOf(const Snapshot& root, const std::string& key) {
+		std::vector<std::pair<size_t, T> > prefixes;
+		Snapshot node = root;
+		size_t pos = 0;
+		while(node) {
+			if (node->hasValue)
+				prefixes.push_back(std::make_pair(pos, node->value));
+			if (pos == key.size())
+				break;
+			node = descend(node, key, pos);
+		}
+		return prefixes;
+	}
+
+	std::vector<std::pair<size_t, T> > getPrefixesOf(const std::string& key) const {
+		return getPrefixesOf(snapshot(), key);
+	}
+
+	/**
+	 * Wait until readers released all versions retired before the call.
+	 *
+	 * Call after erasing a value to be sure no reader will still use it.
+	 * Do not call while holding a snapshot yourself.
+	 */
+	void synchronize() {
+		std::list<std::weak_ptr<const Node> > retired = getRetired();
+		std::unique_lock<std::mutex> lock(_sync->mutex);
+		_sync->released.wait(lock, [&retired] {
+			return allExpired(retired);
+		});
+	}
+
+	/// As above but give up after the timeout, returns whether the versions were released
+	bool synchronize(std::chrono::milliseconds timeout) {
+		std::list<std::weak_ptr<const Node> > retired = getRetired();
+		std::unique_lock<std::mutex> lock(_sync->mutex);
+		return _sync->released.wait_for(lock, timeout, [&retired] {
+			return allExpired(retired);
+		});
+	}
+
+protected:
+	typedef std::shared_ptr<Node> MutableNode;
+
+	/// Wakes synchronize() whenever a reader released a version
+	struct Sync {
+		std::mutex mutex;
+		std::condition_variable released;
+	};
+
+	/// Releases a published root and notifies the waiting writers
+	struct Release {
+		void operator()(const Node*) const {
+			// right away, weak pointers to the version keep the deleter around
+			root.reset();
+			std::lock_guard<std::mutex> lock(sync->mutex);
+			sync->released.notify_all();
+		}
+		mutable Snapshot root;
+		std::shared_ptr<Sync> sync;
+	};
+
+	/// The root as published, notifies the waiting writers once the last reader released it
+	Snapshot track(const Snapshot& root) {
+		Release release = { root, _sync };
+		return Snapshot(root.get(), release);
+	}
+
+	void publish(const Snapshot& root) {
+		Snapshot previous = std::atomic_exchange(&_root, track(root));
+		// only versions no reader holds anymore are forgotten
+		_retired.remove_if([](const std::weak_ptr<const Node>& version) {
+			return version.expired();
+		});
+		_retired.push_back(previous);
+	}
+
+	std::list<std::weak_ptr<const Node> > getRetired() {
+		// copy, concurrent callers might wait for the same versions
+		std::lock_guard<std::mutex> lock(_writeMutex);
+		return _retired;
+	}
+
+	static bool allExpired(const std::list<std::weak_ptr<const Node> >& versions) {
+		for (auto& version : versions) {
+			if (!version.expired())
+				return false;
+		}
+		return true;
+	}
+
+	/// Follow the child matching key at pos, NULL if there is none
+	static Snapshot descend(const Snapshot& node, const std::string& key, size_t& pos) {
+		auto child = findChild(*node, key[pos]);
+		if (child == node->children.end())
+			return Snapshot();
+		const std::string& label = (*child)->label;
+		if (key.compare(pos, label.size(), label) != 0)
+			return Snapshot();
+		pos += label.size();
+		return *child;
+	}
+
+	static typename std::vector<Snapshot>::const_iterator findChild(const Node& node, char c) {
+		auto child = std::lower_bound(node.children.begin(), node.children.end(), c, [](const Snapshot& other, char first) {
+			return other->label[0] < first;
+		});
+		if (child != node.children.end() && (*child)->label[0] == c)
+			return child;
+		return node.children.end();
+	}
+
+	static void addChild(const MutableNode& node, const Snapshot& child) {
+		auto pos = std::lower_bound(node->children.begin(), node->children.end(), child->label[0], [](const Snapshot& other, char first) {
+			return other->label[0] < first;
+		});
+		node->children.insert(pos, child);
+	}
+
+	static Snapshot insert(const Snapshot& node, const std::string& key, size_t pos, const T& value) {
+		MutableNode copy = std::make_shared<Node>(*node);
+		if (pos == key.size()) {
+			copy->hasValue = true;
+			copy->value = value;
+			return copy;
+		}
+
+		auto child = findChild(*node, key[pos]);
+		if (child == node->children.end()) {
+			MutableNode leaf = std::make_shared<Node>();
+			leaf->label = key.substr(pos);
+			leaf->hasValue = true;
+			leaf->value = value;
+			addChild(copy, leaf);
+			return copy;
+		}
+
+		const std::string& label = (*child)->label;
+		size_t common = 0;
+		while(common < label.size() && pos + common < key.size() && label[common] == key[pos + common])
+			common++;
+
+		size_t index = child - node->children.begin();
+		if (common == label.size()) {
+			copy->children[index] = insert(*child, key, pos + common, value);
+			return copy;
+		}
+
+		// split the edge at the first differing character
+		MutableNode split = std::make_shared<Node>();
+		split->label = label.substr(0, common);
+		MutableNode rest = std::make_shared<Node>(**child);
+		rest->label = label.substr(common);
+		addChild(split, rest);
+
+		if (pos + common == key.size()) {
+			split->hasValue = true;
+			split->value = value;
+		} else {
+			MutableNode leaf = std::make_shared<Node>();
+			leaf->label = key.substr(pos + common);
+			leaf->hasValue = true;
+			leaf->value = value;
+			addChild(split, leaf);
+		}
+		copy->children[index] = split;
+		return copy;
+	}
+
+	static Snapshot erase(const Snapshot& node, const std::string& key, size_t pos) {
+		if (pos == key.size()) {
+			if (!node->hasValue)
+				return node;
+			MutableNode copy = std::make_shared<Node>(*node);
+			copy->hasValue = false;
+			copy->value = T();
+			return copy;
+		}
+
+		auto child = findChild(*node, key[pos]);
+		if (child == node->children.end())
+			return node;
+		const std::string& label = (*child)->label;
+		if (key.compare(pos, label.size(), label) != 0)
+			return node;
+
+		Snapshot newChild = erase(*child, key, pos + label.size());
+		if (newChild == *child)
+			return node;
+
+		MutableNode copy = std::make_shared<Node>(*node);
+		size_t index = child - node->children.begin();
+		if (!newChild->hasValue && newChild->children.size() == 0) {
+			copy->children.erase(copy->children.begin() + index);
+		} else if (!newChild->hasValue && newChild->children.size() == 1) {
+			// merge with the only remaining grandchild
+			MutableNode merged = std::make_shared<Node>(*newChild->children.front());
+			merged->label = newChild->label + merged->label;
+			copy->children[index] = merged;
+		} else {
+			copy->children[index] = newChild;
+		}
+		return copy;
+	}
+
+	std::shared_ptr<Sync> _sync;
+	Snapshot _root;
+	std::mutex _writeMutex;
+	std::list<std::weak_ptr<const Node> > _retired;
+};
+
+}
+
+#endif /* end of include guard: RADIXTREE_H_E51B0A7D */
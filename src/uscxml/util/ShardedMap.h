@@ -0,0 +1,151 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#ifndef SHARDEDMAP_H_94C2D6F1
+#define SHARDEDMAP_H_94C2D6F1
+
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+
+namespace uscxml {
+
+/**
+ * A hash map from strings to values for concurrent lookups.
+ *
+ * Keys are distributed over shards by their hash. Every shard is an immutable
+ * map that writers copy and swap in under the shard's lock. Readers never wait
+ * for writers, they only take the shard's current map via std::atomic_load.
+ * That is not lock-free either: libstdc++ guards it with a spinlock from a
+ * small table hashed by address, held for the duration of a pointer copy.
+ *
+ * As every insert or erase copies its whole shard, writing costs O(size / nrShards).
+ * Choose nrShards so that shards keep a few dozen entries at the expected size.
+ *
+ * Entries for which the optional expiry predicate holds are treated as
+ * absent. They are removed lazily, when found by a lookup or when their shard
+ * is written to.
+ */
+template <typename T>
+class ShardedMap {
+public:
+	typedef std::function<bool(const T&)> IsExpired;
+
+	ShardedMap(size_t nrShards = 64, IsExpired isExpired = IsExpired()) : _shards(nrShards), _isExpired(isExpired) {
+		for (auto& shard : _shards) {
+			shard.entries = std::make_shared<Entries>();
+		}
+	}
+
+	/// Insert or replace the value for the key
+	void insert(const std::string& key, const T& value) {
+		Shard& shard = shardFor(key);
+		std::lock_guard<std::mutex> lock(shard.writeMutex);
+		std::shared_ptr<Entries> entries = copyLive(shard);
+		(*entries)[key] = value;
+		std::atomic_store(&shard.entries, std::shared_ptr<const Entries>(entries));
+	}
+
+	/// Remove the key, returns false if it was not in the map
+	bool erase(const std::string& key) {
+		Shard& shard = shardFor(key);
+		std::lock_guard<std::mutex> lock(shard.writeMutex);
+		if (shard.entries->find(key) == shard.entries->end())
+			return false;
+		std::shared_ptr<Entries> entries = copyLive(shard);
+		entries->erase(key);
+		std::atomic_store(&shard.entries, std::shared_ptr<const Entries>(entries));
+		return true;
+	}
+
+	/// Find the value for the key, returns false if it is not in the map or expired
+	bool find(const std::string& key, T& value) {
+		Shard& shard = shardFor(key);
+		std::shared_ptr<const Entries> entries = std::atomic_load(&shard.entries);
+		typename Entries::const_iterator entry = entries->find(key);
+		if (entry == entries->end())
+			return false;
+		if (_isExpired && _isExpired(entry->second)) {
+			expire(shard, key);
+			return false;
+		}
+		value = entry->second;
+		return true;
+	}
+
+	/// A copy of all entries that are not expired, ordered by key
+	std::map<std::string, T> toMap() const {
+		std::map<std::string, T> all;
+		for (auto& shard : _shards) {
+			std::shared_ptr<const Entries> entries = std::atomic_load(&shard.entries);
+			for (auto& entry : *entries) {
+				if (!_isExpired || !_isExpired(entry.second))
+					all.insert(entry);
+			}
+		}
+		return all;
+	}
+
+protected:
+	typedef std::unordered_map<std::string, T> Entries;
+
+	struct Shard {
+		std::shared_ptr<const Entries> entries;
+		std::mutex writeMutex;
+	};
+
+	Shard& shardFor(const std::string& key) {
+		return _shards[std::hash<std::string>()(key) % _shards.size()];
+	}
+
+	/// Copy the entries of a shard without the expired ones, hold its writeMutex
+	std::shared_ptr<Entries> copyLive(const Shard& shard) {
+		std::shared_ptr<Entries> entries = std::make_shared<Entries>(*shard.entries);
+		if (_isExpired) {
+			for (typename Entries::iterator entry = entries->begin(); entry != entries->end();) {
+				if (_isExpired(entry->second)) {
+					entry = entries->erase(entry);
+				} else {
+					entry++;
+				}
+			}
+		}
+		return entries;
+	}
+
+	void expire(Shard& shard, const std::string& key) {
+		std::lock_guard<std::mutex> lock(shard.writeMutex);
+		// it might have been replaced in the meantime
+		typename Entries::const_iterator entry = shard.entries->find(key);
+		if (entry == shard.entries->end() || !_isExpired(entry->second))
+			return;
+		std::atomic_store(&shard.entries, std::shared_ptr<const Entries>(copyLive(shard)));
+	}
+
+	std::vector<Shard> _shards;
+	IsExpired _isExpired;
+};
+
+}
+
+#endif /* end of include guard: SHARDEDMAP_H_94C2D6F1 */
@@ -0,0 +1,542 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#include "StateIndex.h"
+#include "uscxml/util/Predicates.h"
+#include "uscxml/util/DOM.h"
+#include "uscxml/util/String.h"
+
+namespace uscxml {
+
+using namespace XERCESC_NS;
+
+const size_t StateIndex::npos;
+
+StateIndex::StateIndex(const DOMElement* root) {
+	if (root == NULL)
+		return;
+
+	addState(const_cast<DOMElement*>(root), npos, 0);
+
+	_exitables.resize(_elements.size() + 1);
+	_exitables[0] = 0;
+	for (size_t i = 0; i < _elements.size(); i++) {
+		bool exitable = (_kind[i] == STATE || _kind[i] == PARALLEL || _kind[i] == FINAL);
+		_exitables[i + 1] = _exitables[i] + (exitable ? 1 : 0);
+	}
+
+	buildLCA();
+	resolveTransitions();
+}
+
+void StateIndex::addState(DOMElement* state, size_t parent, size_t depth) {
+	size_t index = _elements.size();
+
+	const XMLCh* localName = state->getLocalName();
+	Kind kind = STATE;
+	if (kXMLCharScxml.iequals(localName) == 0) {
+		kind = SCXML;
+	} else if (kXMLCharParallel.iequals(localName) == 0) {
+		kind = PARALLEL;
+	} else if (kXMLCharFinal.iequals(localName) == 0) {
+		kind = FINAL;
+	} else if (kXMLCharHistory.iequals(localName) == 0) {
+		kind = HISTORY;
+	} else if (kXMLCharInitial.iequals(localName) == 0) {
+		kind = INITIAL;
+	}
+
+	_elements.push_back(state);
+	_kind.push_back(kind);
+	_parent.push_back(parent);
+	_firstChild.push_back(npos);
+	_nextSibling.push_back(npos);
+	_depth.push_back(depth);
+	_last.push_back(index);
+	_properChildren.push_back(0);
+	_childTransitions.push_back(std::vector<size_t>());
+
+	_stateIndex[state] = index;
+	if (HAS_ATTR(state, kXMLCharId)) {
+		// first in document order wins with duplicate ids
+		_stateIds.insert(std::make_pair(ATTR(state, kXMLCharId), index));
+	}
+
+	size_t previous = npos;
+	for (auto childElem = state->getFirstElementChild(); childElem; childElem = childElem->getNextElementSibling()) {
+		if (uscxml::isState(childElem, false)) {
+			size_t child = _elements.size();
+			if (previous == npos) {
+				_firstChild[index] = child;
+			} else {
+				_nextSibling[previous] = child;
+			}
+			previous = child;
+			if (uscxml::isState(childElem, true))
+				_properChildren[index]++;
+
+			addState(childElem, index, depth + 1);
+
+		} else if (kXMLCharTransition.iequals(childElem->getLocalName()) == 0) {
+			size_t transition = _transitions.size();
+			_transitions.push_back(childElem);
+			_transIndex[childElem] = transition;
+			_childTransitions[index].push_back(transition);
+			// transitions in <initial> originate from the containing state
+			_transSource.push_back(kind == INITIAL && parent != npos ? parent : index);
+		}
+	}
+
+	_last[index] = _elements.size() - 1;
+}
+
+void StateIndex::buildLCA() {
+	if (_elements.size() == 0)
+		return;
+
+	// iterative Euler tour, recording every state when entered and when returning from a child
+	_firstVisit.resize(_elements.size());
+	_euler.reserve(2 * _elements.size());
+
+	std::vector<std::pair<size_t, size_t> > stack; // state and next child to visit
+	_firstVisit[0] = 0;
+	_euler.push_back(0);
+	stack.push_back(std::make_pair(0, _firstChild[0]));
+
+	while(stack.size() > 0) {
+		size_t child = stack.back().second;
+		if (child == npos) {
+			stack.pop_back();
+			if (stack.size() > 0)
+				_euler.push_back(stack.back().first);
+			continue;
+		}
+		stack.back().second = _nextSibling[child];
+		_firstVisit[child] = _euler.size();
+		_euler.push_back(child);
+		stack.push_back(std::make_pair(child, _firstChild[child]));
+	}
+
+	// floor(log2(n)) for all range lengths
+	_log2.resize(_euler.size() + 1);
+	_log2[0] = _log2[1] = 0;
+	for (size_t i = 2; i <= _euler.size(); i++) {
+		_log2[i] = _log2[i / 2] + 1;
+	}
+
+	// sparse table with the shallowest state per range of length 2^k
+	_sparse.push_back(_euler);
+	for (size_t k = 1; ((size_t)1 << k) <= _euler.size(); k++) {
+		size_t half = (size_t)1 << (k - 1);
+		size_t length = _euler.size() - ((size_t)1 << k) + 1;
+		const std::vector<size_t>& below = _sparse[k - 1];
+		std::vector<size_t> level(length);
+		for (size_t i = 0; i < length; i++) {
+			level[i] = (_depth[below[i]] <= _depth[below[i + half]] ? below[i] : below[i + half]);
+		}
+		_sparse.push_back(level);
+	}
+}
+
+void StateIndex::resolveTransitions() {
+	_transTargets.resize(_transitions.size());
+	_transDomain.resize(_transitions.size(), npos);
+
+	for (size_t i = 0; i < _transitions.size(); i++) {
+		DOMElement* transition = _transitions[i];
+		if (!HAS_ATTR(transition, kXMLCharTarget))
+			continue;
+
+		std::list<std::string> targetIds = tokenize(ATTR(transition, kXMLCharTarget));
+		for (auto targetIter = targetIds.begin(); targetIter != targetIds.end(); targetIter++) {
+			auto stateIter = _stateIds.find(*targetIter);
+			if (stateIter != _stateIds.end()) {
+				_transTargets[i].push_back(stateIter->second);
+			}
+		}
+		if (_transTargets[i].size() == 0)
+			continue;
+
+		size_t source = _transSource[i];
+		bool internal = HAS_ATTR(transition, kXMLCharType) && iequals(ATTR(transition, kXMLCharType), "internal");
+
+		if (internal && isCompound(source)) {
+			bool allDescendants = true;
+			for (auto target : _transTargets[i]) {
+				if (!isDescendant(target, source)) {
+					allDescendants = false;
+					break;
+				}
+			}
+			if (allDescendants) {
+				_transDomain[i] = source;
+				continue;
+			}
+		}
+
+		std::vector<size_t> states;
+		states.reserve(_transTargets[i].size() + 1);
+		states.push_back(source);
+		states.insert(states.end(), _transTargets[i].begin(), _transTargets[i].end());
+		_transDomain[i] = findLCCA(states);
+	}
+}
+
+size_t StateIndex::indexOf(const DOMElement* state) const {
+	auto iter = _stateIndex.find(state);
+	if (iter == _stateIndex.end())
+		return npos;
+	return iter->second;
+}
+
+size_t StateIndex::transitionIndexOf(const DOMElement* transition) const {
+	auto iter = _transIndex.find(transition);
+	if (iter == _transIndex.end())
+		return npos;
+	return iter->second;
+}
+
+size_t StateIndex::getLCA(size_t s1, size_t s2) const {
+	size_t from = _firstVisit[s1];
+	size_t to = _firstVisit[s2];
+	if (from > to)
+		std::swap(from, to);
+
+	size_t k = _log2[to - from + 1];
+	size_t left = _sparse[k][from];
+	size_t right = _sparse[k][to - ((size_t)1 << k) + 1];
+	return (_depth[left] <= _depth[right] ? left : right);
+}
+
+bool StateIndex::isState(size_t state, bool properOnly) const {
+	if (!properOnly)
+		return true;
+	return _kind[state] != HISTORY && _kind[state] != INITIAL;
+}
+
+bool StateIndex::isCompound(size_t state) const {
+	if (!isState(state) || _kind[state] == PARALLEL)
+		return false;
+	return _properChildren[state] > 0;
+}
+
+bool StateIndex::isAtomic(size_t state) const {
+	if (!isState(state))
+		return false;
+	if (_kind[state] == FINAL)
+		return true;
+	if (_kind[state] == PARALLEL)
+		return false;
+	return _properChildren[state] == 0;
+}
+
+bool StateIndex::isInExitSet(size_t state, size_t transition) const {
+	size_t domain = _transDomain[transition];
+	if (domain == npos || !isDescendant(state, domain))
+		return false;
+	return (_kind[state] == STATE || _kind[state] == PARALLEL || _kind[state] == FINAL);
+}
+
+bool StateIndex::conflicts(size_t t1, size_t t2) const {
+	size_t s1 = _transSource[t1];
+	size_t s2 = _transSource[t2];
+	if (s1 == s2 || isDescendant(s1, s2) || isDescendant(s2, s1))
+		return true;
+
+	size_t d1 = _transDomain[t1];
+	size_t d2 = _transDomain[t2];
+	if (d1 == npos || d2 == npos)
+		return false;
+
+	// exit sets are all exitable descendants of the domain, they are either nested or disjoint
+	size_t inner = npos;
+	if (d1 == d2 || isDescendant(d2, d1)) {
+		inner = d2;
+	} else if (isDescendant(d1, d2)) {
+		inner = d1;
+	} else {
+		return false;
+	}
+	return _exitables[_last[inner] + 1] - _exitables[inner + 1] > 0;
+}
+
+/**
+ * The lowest compound state that is a proper ancestor of all given states,
+ * the first state's uppermost ancestor if there is none.
+ */
+size_t StateIndex::findLCCA(const std::vector<size_t>& states) const {
+	if (states.size() == 0)
+		return npos;
+
+	size_t front = states.front();
+	if (_parent[front] == npos)
+		return npos;
+
+	size_t lca = front;
+	for (size_t i = 1; i < states.size(); i++) {
+		lca = getLCA(lca, states[i]);
+	}
+
+	// the lca is a proper ancestor unless it is one of the states
+	for (size_t i = 0; i < states.size(); i++) {
+		if (states[i] == lca) {
+			lca = _parent[lca];
+			break;
+		}
+	}
+
+	for (size_t ancestor = lca; ancestor != npos; ancestor = _parent[ancestor]) {
+		if (isCompound(ancestor))
+			return ancestor;
+	}
+
+	size_t uppermost = _parent[front];
+	while (_parent[uppermost] != npos)
+		uppermost = _parent[uppermost];
+	return uppermost;
+}
+
+std::list<DOMElement*> StateIndex::getChildStates(const DOMElement* state, bool properOnly) const {
+	size_t index = indexOf(state);
+	if (index == npos)
+		return uscxml::getChildStates(state, properOnly);
+
+	std::list<DOMElement*> children;
+	for (size_t child = _firstChild[index]; child != npos; child = _nextSibling[child]) {
+		if (isState(child, properOnly))
+			children.push_back(_elements[child]);
+	}
+	return children;
+}
+
+std::list<DOMElement*> StateIndex::getProperAncestors(const DOMElement* s1, const DOMElement* s2) const {
+	size_t index = indexOf(s1);
+	if (index == npos)
+		return uscxml::getProperAncestors(s1, s2);
+
+	std::list<DOMElement*> ancestors;
+	for (size_t ancestor = _parent[index]; ancestor != npos; ancestor = _parent[ancestor]) {
+		if (_kind[ancestor] != PARALLEL && _kind[ancestor] != STATE && _kind[ancestor] != SCXML)
+			break;
+		if (_elements[ancestor] == s2)
+			break;
+		ancestors.push_back(_elements[ancestor]);
+	}
+	return ancestors;
+}
+
+DOMElement* StateIndex::findLCCA(const std::list<DOMElement*>& states) const {
+	std::vector<size_t> indices;
+	indices.reserve(states.size());
+	for (auto state : states) {
+		size_t index = indexOf(state);
+		if (index == npos)
+			return uscxml::findLCCA(states);
+		indices.push_back(index);
+	}
+
+	size_t lcca = findLCCA(indices);
+	return (lcca == npos ? NULL : _elements[lcca]);
+}
+
+DOMElement* StateIndex::getState(const std::string& stateId) const {
+	auto iter = _stateIds.find(stateId);
+	if (iter == _stateIds.end())
+		return NULL;
+	return _elements[iter->second];
+}
+
+std::list<DOMElement*> StateIndex::getStates(const std::list<std::string>& stateIds) const {
+	std::list<DOMElement*> states;
+	for (auto stateId : stateIds) {
+		states.push_back(getState(stateId));
+	}
+	return states;
+}
+
+std::list<DOMElement*> StateIndex::getTargetStates(const DOMElement* transition) const {
+	size_t index = transitionIndexOf(transition);
+	if (index == npos)
+		return uscxml::getTargetStates(transition, _elements.size() > 0 ? _elements[0] : NULL);
+
+	std::list<DOMElement*> targets;
+	for (auto target : _transTargets[index]) {
+		targets.push_back(_elements[target]);
+	}
+	return targets;
+}
+
+DOMElement* StateIndex::getTransitionDomain(const DOMElement* transition) const {
+	size_t index = transitionIndexOf(transition);
+	if (index == npos)
+		return uscxml::getTransitionDomain(transition, _elements.size() > 0 ? _elements[0] : NULL);
+
+	size_t domain = _transDomain[index];
+	return (domain == npos ? NULL : _elements[domain]);
+}
+
+std::list<DOMElement*> StateIndex::getExitSet(const DOMElement* transition) const {
+	size_t index = transitionIndexOf(transition);
+	if (index == npos)
+		return uscxml::getExitSet(transition, _elements.size() > 0 ? _elements[0] : NULL);
+
+	std::list<DOMElement*> statesToExit;
+	size_t domain = _transDomain[index];
+	if (domain == npos)
+		return statesToExit;
+
+	for (size_t state = domain + 1; state <= _last[domain]; state++) {
+		if (_kind[state] == STATE || _kind[state] == PARALLEL || _kind[state] == FINAL)
+			statesToExit.push_back(_elements[state]);
+	}
+	return statesToExit;
+}
+
+bool StateIndex::conflicts(const DOMElement* t1, const DOMElement* t2) const {
+	size_t index1 = transitionIndexOf(t1);
+	size_t index2 = transitionIndexOf(t2);
+	if (index1 == npos || index2 == npos)
+		return uscxml::conflicts(t1, t2, _elements.size() > 0 ? _elements[0] : NULL);
+	return conflicts(index1, index2);
+}
+
+std::vector<size_t> StateIndex::getInitialStates(size_t state) const {
+	std::vector<size_t> initials;
+
+	if (isAtomic(state))
+		return initials;
+
+	if (_kind[state] == PARALLEL) {
+		for (size_t child = _firstChild[state]; child != npos; child = _nextSibling[child]) {
+			if (isState(child))
+				initials.push_back(child);
+		}
+		return initials;
+	}
+
+	if (!isCompound(state))
+		return initials;
+
+	// initial attribute at element
+	if (HAS_ATTR(_elements[state], kXMLCharInitial)) {
+		std::list<std::string> stateIds = tokenize(ATTR(_elements[state], kXMLCharInitial));
+		for (auto stateId : stateIds) {
+			auto iter = _stateIds.find(stateId);
+			if (iter != _stateIds.end())
+				initials.push_back(iter->second);
+		}
+		return initials;
+	}
+
+	// initial element as child
+	for (size_t child = _firstChild[state]; child != npos; child = _nextSibling[child]) {
+		if (_kind[child] == INITIAL) {
+			if (_childTransitions[child].size() > 0) {
+				const std::vector<size_t>& targets = _transTargets[_childTransitions[child].front()];
+				initials.insert(initials.end(), targets.begin(), targets.end());
+			}
+			return initials;
+		}
+	}
+
+	// first child state
+	for (size_t child = _firstChild[state]; child != npos; child = _nextSibling[child]) {
+		if (isState(child)) {
+			initials.push_back(child);
+			break;
+		}
+	}
+	return initials;
+}
+
+std::list<DOMElement*> StateIndex::getInitialStates(const DOMElement* state) const {
+	size_t index = (state == NULL ? 0 : indexOf(state));
+	if (index == npos)
+		return uscxml::getInitialStates(state, _elements.size() > 0 ? _elements[0] : NULL);
+
+	std::list<DOMElement*> initials;
+	if (index >= _elements.size())
+		return initials;
+
+	std::vector<size_t> indices = getInitialStates(index);
+	for (auto initial : indices) {
+		initials.push_back(_elements[initial]);
+	}
+	return initials;
+}
+
+std::list<DOMElement*> StateIndex::getReachableStates() const {
+	std::list<DOMElement*> reachable;
+	if (_elements.size() == 0)
+		return reachable;
+
+	std::vector<bool> seen(_elements.size(), false);
+	std::vector<size_t> additions; // states added in last iteration
+	std::vector<size_t> current; // new states caused by states added
+
+	additions.push_back(0);
+	seen[0] = true;
+
+	while (additions.size() > 0) {
+		// reachable per initial attribute or document order
+		for (auto state : additions) {
+			std::vector<size_t> initials = getInitialStates(state);
+			for (auto initial : initials) {
+				if (!seen[initial]) {
+					seen[initial] = true;
+					current.push_back(initial);
+				}
+			}
+		}
+
+		// reachable per target attribute in transitions
+		for (auto state : additions) {
+			for (auto transition : _childTransitions[state]) {
+				for (auto target : _transTargets[transition]) {
+					if (!seen[target]) {
+						seen[target] = true;
+						current.push_back(target);
+					}
+				}
+			}
+		}
+
+		// reachable via a reachable child state
+		for (auto state : additions) {
+			if (!isAtomic(state))
+				continue;
+			for (size_t parent = _parent[state]; parent != npos && isState(parent); parent = _parent[parent]) {
+				if (!seen[parent]) {
+					seen[parent] = true;
+					current.push_back(parent);
+				}
+			}
+		}
+
+		for (auto state : additions) {
+			reachable.push_back(_elements[state]);
+		}
+		additions.swap(current);
+		current.clear();
+	}
+
+	return reachable;
+}
+
+}
@@ -0,0 +1,176 @@
+/**
+ *  @file
+ *  @author     2017 Stefan Radomski (stefan.radomski@cs.tu-darmstadt.de)
+ *  @copyright  Simplified BSD
+ *
+ *  @cond
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the FreeBSD license as published by the FreeBSD
+ *  project.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *  You should have received a copy of the FreeBSD license along with this
+ *  program. If not, see <http://www.opensource.org/licenses/bsd-license>.
+ *  @endcond
+ */
+
+#ifndef STATEINDEX_H_4F6C21B8
+#define STATEINDEX_H_4F6C21B8
+
+#include "uscxml/Common.h"
+
+#include <string>
+#include <list>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <xercesc/dom/DOM.hpp>
+
+// forward declare
+namespace XERCESC_NS {
+class DOMElement;
+}
+
+namespace uscxml {
+
+/**
+ * The state tree of a document as arrays for the predicates in Predicates.h.
+ *
+ * States, including history and initial pseudo-states, are numbered in
+ * document order, so the descendants of a state are the range up to its
+ * last descendant. Lowest common ancestors are found in constant time per
+ * range minimum query on an Euler tour. Transitions are indexed with their
+ * source, targets and transition domain.
+ *
+ * The index is not updated with the DOM, build it again after moving,
+ * adding or removing states, transitions or their targets.
+ */
+class USCXML_API StateIndex {
+public:
+	static const size_t npos = (size_t)-1;
+
+	StateIndex(const XERCESC_NS::DOMElement* root);
+
+	size_t size() const {
+		return _elements.size();
+	}
+
+	/// The state's document order or npos if it is not a state in the index
+	size_t indexOf(const XERCESC_NS::DOMElement* state) const;
+	/// The transition's document order or npos if it is not a transition in the index
+	size_t transitionIndexOf(const XERCESC_NS::DOMElement* transition) const;
+
+	XERCESC_NS::DOMElement* getElement(size_t state) const {
+		return _elements[state];
+	}
+	const std::vector<XERCESC_NS::DOMElement*>& getStates() const {
+		return _elements;
+	}
+	const std::vector<XERCESC_NS::DOMElement*>& getTransitions() const {
+		return _transitions;
+	}
+
+	size_t getParent(size_t state) const {
+		return _parent[state];
+	}
+	size_t getFirstChild(size_t state) const {
+		return _firstChild[state];
+	}
+	size_t getNextSibling(size_t state) const {
+		return _nextSibling[state];
+	}
+	size_t getDepth(size_t state) const {
+		return _depth[state];
+	}
+	/// The last descendant in document order or the state itself
+	size_t getLastDescendant(size_t state) const {
+		return _last[state];
+	}
+
+	/// Whether s1 is a proper descendant of s2, false if either is npos
+	bool isDescendant(size_t s1, size_t s2) const {
+		return s2 < _last.size() && s1 > s2 && s1 <= _last[s2];
+	}
+	size_t getLCA(size_t s1, size_t s2) const;
+
+	bool isState(size_t state, bool properOnly = true) const;
+	bool isCompound(size_t state) const;
+	bool isAtomic(size_t state) const;
+
+	size_t getSourceState(size_t transition) const {
+		return _transSource[transition];
+	}
+	const std::vector<size_t>& getTargetStates(size_t transition) const {
+		return _transTargets[transition];
+	}
+	/// The transition domain or npos for targetless transitions
+	size_t getTransitionDomain(size_t transition) const {
+		return _transDomain[transition];
+	}
+	/// Whether the state is in the exit set of a transition
+	bool isInExitSet(size_t state, size_t transition) const;
+	bool conflicts(size_t t1, size_t t2) const;
+
+	size_t findLCCA(const std::vector<size_t>& states) const;
+
+	/// See the equally named functions in Predicates.h
+	std::list<XERCESC_NS::DOMElement*> getChildStates(const XERCESC_NS::DOMElement* state, bool properOnly = true) const;
+	std::list<XERCESC_NS::DOMElement*> getProperAncestors(const XERCESC_NS::DOMElement* s1, const XERCESC_NS::DOMElement* s2) const;
+	XERCESC_NS::DOMElement* findLCCA(const std::list<XERCESC_NS::DOMElement*>& states) const;
+	XERCESC_NS::DOMElement* getState(const std::string& stateId) const;
+	std::list<XERCESC_NS::DOMElement*> getStates(const std::list<std::string>& stateIds) const;
+	std::list<XERCESC_NS::DOMElement*> getTargetStates(const XERCESC_NS::DOMElement* transition) const;
+	XERCESC_NS::DOMElement* getTransitionDomain(const XERCESC_NS::DOMElement* transition) const;
+	std::list<XERCESC_NS::DOMElement*> getExitSet(const XERCESC_NS::DOMElement* transition) const;
+	bool conflicts(const XERCESC_NS::DOMElement* t1, const XERCESC_NS::DOMElement* t2) const;
+	std::list<XERCESC_NS::DOMElement*> getInitialStates(const XERCESC_NS::DOMElement* state) const;
+	std::list<XERCESC_NS::DOMElement*> getReachableStates() const;
+
+protected:
+	enum Kind {
+		SCXML,
+		STATE,
+		PARALLEL,
+		FINAL,
+		HISTORY,
+		INITIAL
+	};
+
+	void addState(XERCESC_NS::DOMElement* state, size_t parent, size_t depth);
+	void resolveTransitions();
+	void buildLCA();
+	std::vector<size_t> getInitialStates(size_t state) const;
+
+	std::vector<XERCESC_NS::DOMElement*> _elements;
+	std::vector<Kind> _kind;
+	std::vector<size_t> _parent;
+	std::vector<size_t> _firstChild;
+	std::vector<size_t> _nextSibling;
+	std::vector<size_t> _depth;
+	std::vector<size_t> _last;
+	std::vector<size_t> _properChildren; // number of proper child states
+	std::vector<size_t> _exitables; // prefix sums of <state>, <parallel> and <final> elements
+
+	// Euler tour with the first occurrence per state and a sparse table of minimal depths
+	std::vector<size_t> _euler;
+	std::vector<size_t> _firstVisit;
+	std::vector<std::vector<size_t> > _sparse;
+	std::vector<unsigned char> _log2;
+
+	std::vector<XERCESC_NS::DOMElement*> _transitions;
+	std::vector<size_t> _transSource;
+	std::vector<std::vector<size_t> > _transTargets;
+	std::vector<size_t> _transDomain;
+	std::vector<std::vector<size_t> > _childTransitions; // per state in document order
+
+	std::unordered_map<const XERCESC_NS::DOMElement*, size_t> _stateIndex;
+	std::unordered_map<const XERCESC_NS::DOMElement*, size_t> _transIndex;
+	std::map<std::string, size_t> _stateIds;
+};
+
+}
+
+#endif /* end of include guard: STATEINDEX_H_4F6C21B8 */
@@ -24,6 +24,7 @@
 #include <cassert>
 
 #include "uscxml/interpreter/Logging.h"
+#include "uscxml/util/MappedFile.h"
 #include "uscxml/config.h"
 
 #include <curl/curl.h>
@@ -430,6 +431,26 @@ std::list<std::string> URLImpl::pathComponents() const {
 	return pathList;
 }
 
+std::string URLImpl::localPath() const {
+	if (!iequals(scheme(), "file") || ((UriUriA*)_uri)->pathHead == NULL)
+		return "";
+	std::string hostName = host();
+	if (hostName.size() > 0 && !iequals(hostName, "localhost"))
+		return "";
+
+	// without query and fragment, the filename functions expect the file scheme
+	std::string fileURL = "file://" + path();
+	std::string fileName(fileURL.size() + 1, '\0');
+#ifdef _WIN32
+	int err = uriUriStringToWindowsFilenameA(fileURL.c_str(), &fileName[0]);
+#else
+	int err = uriUriStringToUnixFilenameA(fileURL.c_str(), &fileName[0]);
+#endif
+	if (err != URI_SUCCESS)
+		return "";
+	return fileName.c_str();
+}
+
 std::map<std::string, std::string> URLImpl::query() const {
 	UriQueryListA * queryList;
 	UriQueryListA * currList;
@@ -611,6 +632,23 @@ const void URLImpl::download(bool blocking) {
 	if (_isDownloaded)
 		return;
 
+	std::string fileName = localPath();
+	if (fileName.size() > 0) {
+		// no need for curl and the fetcher thread with local files
+		downloadStarted();
+		try {
+			MappedFile file(fileName);
+			writeHandler((void*)file.data(), 1, file.size(), this);
+		} catch (ErrorEvent e) {
+			downloadFailed(CURLE_FILE_COULDNT_READ_FILE);
+			if (blocking)
+				throw e;
+			return;
+		}
+		downloadCompleted();
+		return;
+	}
+
 	URL url(shared_from_this());
 	URLFetcher::fetchURL(url);
 
@@ -63,6 +63,7 @@ public:
 	std::map<std::string, std::string> query() const;
 	std::string path() const;
 	std::list<std::string> pathComponents() const;
+	std::string localPath() const;
 
 	void normalize();
 
@@ -187,6 +188,11 @@ public:
 		return _impl->pathComponents();
 	}
 
+	/// The decoded filesystem path for local file URLs or an empty string
+	std::string localPath() {
+		return _impl->localPath();
+	}
+
 	void normalize() {
 		return _impl->normalize();
 	}
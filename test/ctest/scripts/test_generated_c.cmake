@@ -8,8 +8,20 @@ execute_process(COMMAND ${CMAKE_COMMAND} -E make_directory ${OUTDIR})
 
 # message(FATAL_ERROR "PROJECT_BINARY_DIR: ${PROJECT_BINARY_DIR}")
 
-message(STATUS "${USCXML_TRANSFORM_BIN} -t${TARGETLANG} -i ${TESTFILE} -o ${OUTDIR}/${TEST_FILE_NAME}.machine.c")
-execute_process(COMMAND time -p ${USCXML_TRANSFORM_BIN} -t${TARGETLANG} -i ${TESTFILE} -o ${OUTDIR}/${TEST_FILE_NAME}.machine.c RESULT_VARIABLE CMD_RESULT)
+# optional comma-separated key=value pairs passed as -X to the transformer
+set(TRANSFORM_ARGS "")
+if (TRANSFORM_OPTIONS)
+	string(REPLACE "," ";" TRANSFORM_OPTIONS_LIST "${TRANSFORM_OPTIONS}")
+	foreach(TRANSFORM_OPTION ${TRANSFORM_OPTIONS_LIST})
+		list(APPEND TRANSFORM_ARGS "-X" "${TRANSFORM_OPTION}")
+		# keep the artifacts of the variants apart
+		string(REPLACE "=" "-" TRANSFORM_OPTION_SUFFIX "${TRANSFORM_OPTION}")
+		set(TEST_FILE_NAME "${TEST_FILE_NAME}.${TRANSFORM_OPTION_SUFFIX}")
+	endforeach()
+endif()
+
+message(STATUS "${USCXML_TRANSFORM_BIN} -t${TARGETLANG} ${TRANSFORM_ARGS} -i ${TESTFILE} -o ${OUTDIR}/${TEST_FILE_NAME}.machine.c")
+execute_process(COMMAND time -p ${USCXML_TRANSFORM_BIN} -t${TARGETLANG} ${TRANSFORM_ARGS} -i ${TESTFILE} -o ${OUTDIR}/${TEST_FILE_NAME}.machine.c RESULT_VARIABLE CMD_RESULT)
 if (CMD_RESULT)
     message(FATAL_ERROR "Error running ${USCXML_TRANSFORM_BIN}: ${CMD_RESULT}")
 endif ()
@@ -0,0 +1,56 @@
+# see test/CMakeLists.txt for passed variables
+
+set(CMAKE_MODULE_PATH ${PROJECT_SOURCE_DIR}/contrib/cmake)
+include("${CMAKE_MODULE_PATH}/FileInformation.cmake")
+
+get_filename_component(TEST_FILE_NAME ${TESTFILE} NAME)
+execute_process(COMMAND ${CMAKE_COMMAND} -E make_directory ${OUTDIR})
+
+message(STATUS "${USCXML_TRANSFORM_BIN} -t${TARGETLANG} -X className=TestMachine -i ${TESTFILE} -o ${OUTDIR}/${TEST_FILE_NAME}.machine.h")
+execute_process(COMMAND time -p ${USCXML_TRANSFORM_BIN} -t${TARGETLANG} -X className=TestMachine -i ${TESTFILE} -o ${OUTDIR}/${TEST_FILE_NAME}.machine.h RESULT_VARIABLE CMD_RESULT)
+if (CMD_RESULT)
+    message(FATAL_ERROR "Error running ${USCXML_TRANSFORM_BIN}: ${CMD_RESULT}")
+endif ()
+message(STATUS "time for transforming to c++ class template")
+
+set(LIBRARY_PATH "-L${CMAKE_LIBRARY_OUTPUT_DIRECTORY}" "-L/opt/local/lib")
+set(LIBRARY_FILE "-luscxml")
+set(INCLUDE_PATH
+	"-I${PROJECT_SOURCE_DIR}/contrib/src"
+	"-I${PROJECT_SOURCE_DIR}/src"
+	"-I${PROJECT_BINARY_DIR}"
+	"-I${LIBEVENT_INCLUDE_DIR}"
+)
+
+set(COMPILE_CMD_BIN
+        "-O0"
+        "-std=c++11"
+        "-Wl,-search_paths_first"
+        "-Wl,-headerpad_max_install_names"
+        "-o" "${OUTDIR}/${TEST_FILE_NAME}"
+        ${LIBRARY_PATH}
+        ${LIBRARY_FILE}
+        ${INCLUDE_PATH}
+        "-include" "${OUTDIR}/${TEST_FILE_NAME}.machine.h"
+        "-Wl,-rpath,${CMAKE_LIBRARY_OUTPUT_DIRECTORY}"
+        "-DAUTOINCLUDE_TEST=ON"
+        "${SCAFFOLDING_FOR_GENERATED_CPP}")
+
+message(STATUS "${CXX_BIN} ${COMPILE_CMD_BIN}")
+execute_process(
+        COMMAND time -p ${CXX_BIN} ${COMPILE_CMD_BIN}
+        WORKING_DIRECTORY ${OUTDIR} RESULT_VARIABLE CMD_RESULT)
+if (CMD_RESULT)
+    message(FATAL_ERROR "Error running g++ ${CXX_BIN}: ${CMD_RESULT}")
+endif ()
+message(STATUS "time for transforming to binary")
+
+message(STATUS "${OUTDIR}/${TEST_FILE_NAME}")
+execute_process(
+        COMMAND time -p ${OUTDIR}/${TEST_FILE_NAME}
+        WORKING_DIRECTORY ${OUTDIR}
+        RESULT_VARIABLE CMD_RESULT)
+if (CMD_RESULT)
+    message(FATAL_ERROR "Error running generated c++ test: ${CMD_RESULT}")
+endif ()
+message(STATUS "time for execution")
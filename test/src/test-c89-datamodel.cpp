@@ -0,0 +1,178 @@
+#define protected public
+#include "uscxml/config.h"
+#include "uscxml/Interpreter.h"
+#include "uscxml/interpreter/InterpreterImpl.h"
+#include "uscxml/interpreter/Logging.h"
+#include "uscxml/plugins/datamodel/c89/C89DataModel.h"
+#include "uscxml/plugins/invoker/dirmon/DirMonInvoker.h"
+#include "uscxml/debug/Benchmark.h"
+#include "uscxml/util/DOM.h"
+
+#include <boost/algorithm/string.hpp>
+#include <assert.h>
+#include <iostream>
+
+using namespace uscxml;
+using namespace XERCESC_NS;
+
+class C89DMCallbacks : public DataModelCallbacks {
+public:
+	std::string name = "c89";
+	std::string sessionId = "c89";
+	std::map<std::string, IOProcessor> ioProcs;
+	std::map<std::string, Invoker> invokers;
+	DOMDocument* document = NULL;
+
+	const std::string& getName() {
+		return name;
+	}
+	const std::string& getSessionId()  {
+		return sessionId;
+	}
+	const std::map<std::string, IOProcessor>& getIOProcessors() {
+		return ioProcs;
+	}
+	bool isInState(const std::string& stateId) {
+		return false;
+	}
+	DOMDocument* getDocument() const {
+		return document;
+	}
+	const std::map<std::string, Invoker>& getInvokers() {
+		return invokers;
+	}
+	Logger getLogger() {
+		return Logger::getDefault();
+	}
+};
+
+void testEvaluation() {
+	C89DMCallbacks callbacks;
+	std::shared_ptr<DataModelImpl> dmImpl = C89DataModel().create(&callbacks);
+	C89DataModel* dm = (C89DataModel*)dmImpl.get();
+
+	dm->init("Var1", Data("0", Data::INTERPRETED));
+	dm->init("Var2", Data("1.5", Data::INTERPRETED));
+	dm->init("Var3", Data("foo", Data::VERBATIM));
+
+	assert(dm->isDeclared("Var1"));
+	assert(!dm->isDeclared("Var4"));
+	assert(dm->evalAsBool("Var1 == 0"));
+	assert(dm->evalAsData("Var2 * 2").atom == "3");
+	assert(dm->evalAsData("Var3").atom == "foo");
+
+	dm->assign("Var1", Data("Var1 + 1", Data::INTERPRETED));
+	assert(dm->evalAsBool("Var1==1"));
+	assert(!dm->evalAsBool(dm->andExpressions({ "Var1==1", "Var2 < 1" })));
+
+	// expressions not in the document are not cached
+	size_t cached = dm->_tokenCache.size();
+	for (size_t i = 0; i < 100; i++) {
+		dm->evalAsBool("Var1 == " + toStr(i));
+		dm->assign("Var3", Data("bar" + toStr(i), Data::VERBATIM));
+	}
+	assert(dm->_tokenCache.size() == cached);
+
+	try {
+		dm->evalAsBool("Var1 +* 2");
+		assert(false);
+	} catch (ErrorEvent e) {
+	}
+}
+
+void testPrecompile() {
+	Interpreter interpreter = Interpreter::fromXML("\
+		<scxml datamodel=\"c89\">\
+			<datamodel><data id=\"Var1\" expr=\"0\" /></datamodel>\
+			<state id=\"s0\"><transition cond=\"Var1 &gt; 1\" target=\"s0\" /></state>\
+		</scxml>", "");
+
+	C89DMCallbacks callbacks;
+	callbacks.document = interpreter.getImpl()->getDocument();
+	std::shared_ptr<DataModelImpl> dmImpl = C89DataModel().create(&callbacks);
+	C89DataModel* dm = (C89DataModel*)dmImpl.get();
+
+	// tokens of the document are shared across evaluations
+	assert(dm->_tokenCache.find("Var1 > 1") != dm->_tokenCache.end());
+	dm->init("Var1", Data("0", Data::INTERPRETED));
+	size_t cached = dm->_tokenCache.size();
+	assert(!dm->evalAsBool("Var1 > 1"));
+	assert(dm->_tokenCache.size() == cached);
+}
+
+size_t benchmarkCharts(const std::string& path, const std::string& name, bool cacheTokens, size_t iterations) {
+	DirectoryWatch* watcher = new DirectoryWatch(path, true);
+	watcher->updateEntries(true);
+	std::map<std::string, struct stat> entries = watcher->getAllEntries();
+
+	size_t evaluations = 0;
+	for (auto entry : entries) {
+		if (!boost::ends_with(entry.first, ".scxml") || entry.first.find("sub") != std::string::npos)
+			continue;
+
+		Interpreter interpreter = Interpreter::fromURL(path + PATH_SEPERATOR + entry.first);
+		if (!interpreter)
+			continue;
+
+		C89DMCallbacks callbacks;
+		callbacks.document = interpreter.getImpl()->getDocument();
+
+		if (!cacheTokens)
+			setenv("USCXML_NOCACHE_C89_TOKENS", "1", 1);
+		std::shared_ptr<DataModelImpl> dm = C89DataModel().create(&callbacks);
+		unsetenv("USCXML_NOCACHE_C89_TOKENS");
+
+		DOMElement* scxml = callbacks.document->getDocumentElement();
+		std::list<DOMElement*> datas = DOMUtils::inDocumentOrder({ XML_PREFIX(scxml).str() + "data" }, scxml);
+		for (auto data : datas) {
+			try {
+				dm->init(ATTR(data, kXMLCharId),
+				         HAS_ATTR(data, kXMLCharExpr) ? Data(ATTR(data, kXMLCharExpr), Data::INTERPRETED) : Data());
+			} catch (ErrorEvent e) {}
+		}
+
+		std::list<DOMElement*> conditionals = DOMUtils::inDocumentOrder({
+			XML_PREFIX(scxml).str() + "transition",
+			XML_PREFIX(scxml).str() + "if",
+			XML_PREFIX(scxml).str() + "elseif"
+		}, scxml);
+
+		for (auto conditional : conditionals) {
+			if (!HAS_ATTR(conditional, kXMLCharCond))
+				continue;
+			std::string cond = ATTR(conditional, kXMLCharCond);
+			for (size_t i = 0; i < iterations; i++) {
+				Benchmark bench(name);
+				try {
+					dm->evalAsBool(cond);
+				} catch (ErrorEvent e) {}
+				evaluations++;
+			}
+		}
+	}
+	delete watcher;
+	return evaluations;
+}
+
+int main(int argc, char** argv) {
+	testEvaluation();
+	testPrecompile();
+
+	if (argc < 2) {
+		return EXIT_SUCCESS;
+	}
+
+	size_t iterations = 10;
+	const char* envBenchmarkRuns = getenv("USCXML_BENCHMARK_ITERATIONS");
+	if (envBenchmarkRuns != NULL)
+		iterations = strTo<size_t>(envBenchmarkRuns);
+
+	size_t cached = benchmarkCharts(argv[1], "c89.cached", true, iterations);
+	size_t uncached = benchmarkCharts(argv[1], "c89.uncached", false, iterations);
+	assert(cached == uncached);
+
+	std::cout << cached << " condition evaluations per run" << std::endl;
+	Benchmark::report(std::cout);
+
+	return EXIT_SUCCESS;
+}
@@ -161,6 +161,9 @@ public:
 
 		// register callbacks with scxml context
 		ctx.is_matched = &isMatched;
+#ifdef USCXML_HAS_EVENT_ID
+		ctx.event_id = &eventId;
+#endif
 		ctx.is_true = &isTrue;
 		ctx.raise_done_event = &raiseDoneEvent;
 		ctx.invoke = &invoke;
@@ -309,7 +312,17 @@ public:
 			return USCXML_ERR_IDLE;
 		}
 
+#ifdef USCXML_BATCH
+		// take the batched path with a batch of one
+		uscxml_ctx* ctxs[1] = { &toRun->ctx };
+		USCXML_BIT_ALIGN unsigned char planes[USCXML_BATCH_BYTES(1)];
+		uscxml_batch batch;
+		uscxml_batch_init(&batch, ctxs, 1, planes);
+		batch.results = &state;
+		uscxml_step_batch(&batch);
+#else
 		state = uscxml_step(&toRun->ctx);
+#endif
 		return state;
 	}
 
@@ -320,6 +333,13 @@ public:
 		return (nameMatch(t->event, event->name.c_str()));
 	}
 
+#ifdef USCXML_HAS_EVENT_ID
+	static int eventId(const uscxml_ctx* ctx, const void* e) {
+		Event* event = (Event*)e;
+		return uscxml_event_id(ctx->machine, event->name.c_str());
+	}
+#endif
+
 	static int isTrue(const uscxml_ctx* ctx, const char* expr) {
 		try {
 			return USER_DATA(ctx)->dataModel.evalAsBool(expr);
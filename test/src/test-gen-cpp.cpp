@@ -0,0 +1,419 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sstream>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <boost/algorithm/string.hpp> // trim
+
+#include <iostream>
+
+#include "uscxml/config.h"
+
+#ifndef AUTOINCLUDE_TEST
+// a header generated per uscxml-transform -tcpp -X className=TestMachine
+#include "test-cpp-machine.scxml.h"
+#endif
+
+#include "uscxml/plugins/Factory.h"
+#include "uscxml/plugins/DataModel.h"
+#include "uscxml/plugins/DataModelImpl.h"
+#include "uscxml/plugins/IOProcessor.h"
+#include "uscxml/plugins/Invoker.h"
+#include "uscxml/util/UUID.h"
+#include "uscxml/util/String.h"
+#include "uscxml/util/Convenience.h"
+
+#include "uscxml/interpreter/EventQueue.h"
+#include "uscxml/interpreter/BasicDelayedEventQueue.h"
+#include "uscxml/interpreter/Logging.h"
+
+#ifndef USCXML_TEST_DATAMODEL
+#define USCXML_TEST_DATAMODEL "ecmascript"
+#endif
+
+using namespace uscxml;
+
+/**
+ * Runtime services for a state-chart generated by ChartToCpp, see the
+ * comment atop the generated class template for the expected interface.
+ */
+class Host : public DataModelCallbacks, public DelayedEventQueueCallbacks {
+public:
+	typedef uscxml::Event Event;
+
+	Host() : machine(NULL) {
+		sessionId = uscxml::UUID::getUUID();
+		name = "TestMachine";
+		delayQueue = DelayedEventQueue(std::shared_ptr<DelayedEventQueueImpl>(new BasicDelayedEventQueue(this)));
+		dataModel = Factory::getInstance()->createDataModel(USCXML_TEST_DATAMODEL, this);
+	}
+
+	virtual ~Host() {
+		delayQueue.cancelAllDelayed();
+	}
+
+	// DataModelCallbacks
+
+	const std::string& getName() {
+		return name;
+	}
+	const std::string& getSessionId() {
+		return sessionId;
+	}
+	const std::map<std::string, IOProcessor>& getIOProcessors() {
+		return ioProcs;
+	}
+	bool isInState(const std::string& stateId) {
+		return machine != NULL && machine->isInState(stateId.c_str());
+	}
+	XERCESC_NS::DOMDocument* getDocument() const {
+		return NULL;
+	}
+	const std::map<std::string, Invoker>& getInvokers() {
+		return invokers;
+	}
+	Logger getLogger() {
+		return Logger::getDefault();
+	}
+
+	// DelayedEventQueueCallbacks
+
+	void eventReady(Event& e, const std::string& eventUUID) {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::string target = sendTargets[eventUUID];
+		sendTargets.erase(eventUUID);
+		sendIds.erase(eventUUID);
+
+		if (target == "#_internal") {
+			e.eventType = Event::INTERNAL;
+			iq.push_back(e);
+		} else if (target == "#_external" || target == "#_scxml_" + sessionId) {
+			e.eventType = Event::EXTERNAL;
+			eq.push_back(e);
+		} else {
+			// test496
+			Event error;
+			error.name = "error.communication";
+			error.eventType = Event::PLATFORM;
+			iq.push_back(error);
+		}
+		monitor.notify_all();
+	}
+
+	// interface for the generated class template
+
+	const char* eventName(const Event& event) {
+		return event.name.c_str();
+	}
+
+	const Event* dequeueInternal() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (iq.size() == 0)
+			return NULL;
+		currEvent = iq.front();
+		iq.pop_front();
+		dataModel.setEvent(currEvent);
+		return &currEvent;
+	}
+
+	const Event* dequeueExternal() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (eq.size() == 0)
+			return NULL;
+		currEvent = eq.front();
+		eq.pop_front();
+		dataModel.setEvent(currEvent);
+		return &currEvent;
+	}
+
+	template <typename DoneData>
+	void raiseDoneEvent(const char* state, const DoneData* doneData) {
+		Event e;
+		e.name = std::string("done.state.") + state;
+
+		try {
+			if (doneData != NULL) {
+				if (doneData->content != NULL) {
+					e.data = Data(doneData->content, Data::VERBATIM);
+				} else if (doneData->contentexpr != NULL) {
+					e.data = dataModel.evalAsData(doneData->contentexpr);
+				} else {
+					setParams(e, doneData->params, doneData->nrParams);
+				}
+			}
+		} catch (Event error) {
+			raise(error.name.c_str());
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		iq.push_back(e);
+	}
+
+	void raise(const char* event) {
+		Event e;
+		e.name = event;
+		e.eventType = (boost::starts_with(e.name, "error.") ? Event::PLATFORM : Event::INTERNAL);
+		std::lock_guard<std::mutex> lock(mutex);
+		iq.push_back(e);
+	}
+
+	template <typename Send>
+	void send(const Send& send) {
+		Event e;
+		std::string target;
+		size_t delayMs = send.delay;
+
+		try {
+			if (send.target != NULL) {
+				target = send.target;
+			} else if (send.targetexpr != NULL) {
+				target = dataModel.evalAsData(send.targetexpr).atom;
+			} else {
+				target = "#_external";
+			}
+
+			std::string type = "http://www.w3.org/TR/scxml/#SCXMLEventProcessor";
+			if (send.type != NULL) {
+				type = send.type;
+			} else if (send.typeexpr != NULL) {
+				type = dataModel.evalAsData(send.typeexpr).atom;
+			}
+			if (type != "http://www.w3.org/TR/scxml/#SCXMLEventProcessor" || target.substr(0, 2) != "#_") {
+				raise("error.execution");
+				return;
+			}
+			e.origintype = type;
+			e.origin = "#_scxml_" + sessionId;
+
+			e.name = (send.eventexpr != NULL ? dataModel.evalAsData(send.eventexpr).atom : std::string(send.event != NULL ? send.event : ""));
+
+			if (send.delayexpr != NULL) {
+				NumAttr delay(boost::trim_copy(dataModel.evalAsData(send.delayexpr).atom));
+				if (iequals(delay.unit, "s")) {
+					delayMs = strTo<double>(delay.value) * 1000;
+				} else {
+					delayMs = strTo<size_t>(delay.value);
+				}
+			}
+
+			setParams(e, send.params, send.nrParams);
+			if (send.namelist != NULL) {
+				std::list<std::string> names = tokenize(send.namelist);
+				for (auto name : names) {
+					e.params.insert(std::make_pair(name, dataModel.evalAsData(name)));
+				}
+			}
+
+			if (send.contentexpr != NULL) {
+				e.data = dataModel.evalAsData(send.contentexpr);
+			} else if (send.content != NULL) {
+				e.data = dataModel.getAsData(send.content);
+				if (e.data.empty())
+					e.data = Data(spaceNormalize(send.content), Data::VERBATIM);
+			}
+		} catch (Event error) {
+			raise(error.name.c_str());
+			return;
+		}
+
+		if (send.id != NULL) {
+			e.sendid = send.id;
+		} else {
+			e.sendid = uscxml::UUID::getUUID();
+			if (send.idlocation != NULL) {
+				dataModel.assign(send.idlocation, Data(e.sendid, Data::VERBATIM));
+			} else {
+				e.hideSendId = true;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			sendTargets[e.getUUID()] = target;
+			sendIds[e.getUUID()] = e.sendid;
+		}
+		if (delayMs > 0) {
+			delayQueue.enqueueDelayed(e, delayMs, e.getUUID());
+		} else {
+			eventReady(e, e.getUUID());
+		}
+	}
+
+	void cancel(const char* sendId, const char* sendIdExpr) {
+		std::string id;
+		try {
+			id = (sendId != NULL ? sendId : dataModel.evalAsData(sendIdExpr).atom);
+		} catch (Event error) {
+			raise(error.name.c_str());
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto sent = sendIds.begin(); sent != sendIds.end();) {
+			if (sent->second == id) {
+				delayQueue.cancelDelayed(sent->first);
+				sendTargets.erase(sent->first);
+				sent = sendIds.erase(sent);
+			} else {
+				sent++;
+			}
+		}
+	}
+
+	template <typename Invoke>
+	void invoke(const Invoke& invoke, bool uninvoke) {
+		// nested machines and invokers are not supported by this host
+		if (!uninvoke)
+			raise("error.execution");
+	}
+
+	void log(const char* label, const char* expr) {
+		try {
+			std::cout << (label != NULL ? label : "") << (label != NULL && expr != NULL ? ": " : "");
+			if (expr != NULL)
+				std::cout << dataModel.evalAsData(expr).atom;
+			std::cout << std::endl;
+		} catch (Event error) {
+			raise(error.name.c_str());
+		}
+	}
+
+	/// Values of expressions with the native datamodel
+	template <typename T>
+	void log(const char* label, const T& value) {
+		std::cout << (label != NULL ? label : "") << (label != NULL ? ": " : "") << value << std::endl;
+	}
+
+	bool isTrue(const char* expr) {
+		try {
+			return dataModel.evalAsBool(expr);
+		} catch (Event error) {
+			raise(error.name.c_str());
+		}
+		return false;
+	}
+
+	void assign(const char* location, const char* expr, const char* content) {
+		std::string key = location;
+		if (key == "_sessionid" || key == "_name" || key == "_ioprocessors" || key == "_invokers" || key == "_event") {
+			raise("error.execution");
+			return;
+		}
+		try {
+			if (expr != NULL) {
+				dataModel.assign(key, Data(expr, Data::INTERPRETED));
+			} else if (content != NULL) {
+				dataModel.assign(key, Data(content, Data::INTERPRETED));
+			}
+		} catch (Event error) {
+			raise(error.name.c_str());
+		}
+	}
+
+	void script(const char* src, const char* content) {
+		try {
+			if (content != NULL) {
+				dataModel.evalAsData(content);
+			} else if (src != NULL) {
+				raise("error.execution");
+			}
+		} catch (Event error) {
+			raise(error.name.c_str());
+		}
+	}
+
+	void initData(const char* id, const char* src, const char* expr, const char* content) {
+		try {
+			Data d;
+			if (expr != NULL) {
+				d = Data(expr, Data::INTERPRETED);
+			} else if (content != NULL) {
+				d = dataModel.getAsData(content);
+				if (d.empty())
+					d = Data(escape(spaceNormalize(content)), Data::VERBATIM);
+			}
+			dataModel.init(id, d);
+		} catch (Event error) {
+			raise(error.name.c_str());
+		}
+	}
+
+	bool foreachInit(const char* array, const char* item, const char* index) {
+		try {
+			foreachs.push_back(std::make_pair(dataModel.getLength(array), (size_t)0));
+			return true;
+		} catch (Event error) {
+			raise(error.name.c_str());
+		}
+		return false;
+	}
+
+	bool foreachNext(const char* array, const char* item, const char* index) {
+		std::pair<size_t, size_t>& iteration = foreachs.back();
+		if (iteration.second < iteration.first) {
+			try {
+				dataModel.setForeach((item != NULL ? item : ""), array, (index != NULL ? index : ""), iteration.second++);
+				return true;
+			} catch (Event error) {
+				raise(error.name.c_str());
+			}
+		}
+		foreachs.pop_back();
+		return false;
+	}
+
+	/// Wait until an external event is available
+	void waitForEvents() {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (eq.size() == 0)
+			monitor.wait_for(lock, std::chrono::milliseconds(20));
+	}
+
+	TestMachine<Host>* machine;
+
+protected:
+	template <typename Param>
+	void setParams(Event& e, const Param* params, size_t nrParams) {
+		for (size_t i = 0; i < nrParams; i++) {
+			const char* expr = (params[i].expr != NULL ? params[i].expr : params[i].location);
+			e.params.insert(std::make_pair(params[i].name, dataModel.evalAsData(expr)));
+		}
+	}
+
+	std::string name;
+	std::string sessionId;
+	std::map<std::string, IOProcessor> ioProcs;
+	std::map<std::string, Invoker> invokers;
+
+	DataModel dataModel;
+	DelayedEventQueue delayQueue;
+
+	std::mutex mutex;
+	std::condition_variable monitor;
+	std::deque<Event> iq;
+	std::deque<Event> eq;
+	Event currEvent;
+
+	std::map<std::string, std::string> sendTargets; // event uuid to target
+	std::map<std::string, std::string> sendIds; // event uuid to sendid
+	std::list<std::pair<size_t, size_t> > foreachs; // iterations and current iteration per nested foreach
+};
+
+int main(int argc, char** argv) {
+	Host host;
+	TestMachine<Host> machine(host);
+	host.machine = &machine;
+
+	int err;
+	while((err = machine.step()) != TestMachine<Host>::ERR_DONE) {
+		if (err == TestMachine<Host>::ERR_IDLE)
+			host.waitForEvents();
+	}
+
+	if (!machine.isInState("pass")) {
+		std::cerr << "Generated C++ machine did not end in pass" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return EXIT_SUCCESS;
+}
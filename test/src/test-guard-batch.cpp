@@ -0,0 +1,204 @@
+#include "uscxml/config.h"
+#include "uscxml/Interpreter.h"
+#include "uscxml/plugins/Factory.h"
+#include "uscxml/plugins/DataModelImpl.h"
+#include "uscxml/interpreter/Logging.h"
+
+#include <assert.h>
+#include <iostream>
+
+using namespace uscxml;
+
+class GuardDMCallbacks : public DataModelCallbacks {
+public:
+	std::string name = "guards";
+	std::string sessionId = "guards";
+	std::map<std::string, IOProcessor> ioProcs;
+	std::map<std::string, Invoker> invokers;
+
+	const std::string& getName() {
+		return name;
+	}
+	const std::string& getSessionId()  {
+		return sessionId;
+	}
+	const std::map<std::string, IOProcessor>& getIOProcessors() {
+		return ioProcs;
+	}
+	bool isInState(const std::string& stateId) {
+		return false;
+	}
+	XERCESC_NS::DOMDocument* getDocument() const {
+		return NULL;
+	}
+	const std::map<std::string, Invoker>& getInvokers() {
+		return invokers;
+	}
+	Logger getLogger() {
+		return Logger::getDefault();
+	}
+};
+
+/**
+ * A batch has to evaluate every guard once and agree with evalAsBool.
+ */
+void testBatch(const std::string& type, const std::string& incFunc, const std::string& throwing) {
+	GuardDMCallbacks callbacks;
+	std::shared_ptr<DataModelImpl> dm = Factory::getInstance()->createDataModel(type, &callbacks);
+
+	dm->init("count", Data("0", Data::INTERPRETED));
+	dm->eval(incFunc);
+
+	std::vector<std::string> guards;
+	guards.push_back("inc(true)");
+	guards.push_back(throwing);
+	guards.push_back("inc(false)");
+	guards.push_back("count == 2");
+
+	std::vector<bool> result;
+	std::vector<ErrorEvent> errors;
+	dm->evalAsBoolBatch(guards, result, errors);
+
+	// side effects of the guards happened exactly once
+	assert(dm->evalAsData("count").atom == "2");
+
+	assert(result.size() == guards.size() && errors.size() == guards.size());
+	assert(!errors[0] && result[0]);
+	assert(errors[1] && errors[1].name == "error.execution");
+	assert(!errors[2] && !result[2]);
+	assert(!errors[3] && result[3]);
+
+	// the scalar path throws for the failed guard
+	try {
+		dm->evalAsBool(throwing);
+		assert(false);
+	} catch (ErrorEvent e) {
+	}
+}
+
+/**
+ * The microstepper selects the same transitions and raises error.execution
+ * for a throwing guard as with guards evaluated one by one.
+ */
+void testMicroStep(const std::string& type, const std::string& incFunc, const std::string& throwing) {
+	Interpreter interpreter = Interpreter::fromXML("\
+		<scxml xmlns=\"http://www.w3.org/2005/07/scxml\" datamodel=\"" + type + "\">\
+			<datamodel><data id=\"count\" expr=\"0\" /></datamodel>\
+			<script>" + incFunc + "</script>\
+			<state id=\"s0\">\
+				<onentry><raise event=\"foo\" /></onentry>\
+				<transition event=\"foo\" cond=\"" + throwing + "\" target=\"fail\" />\
+				<transition event=\"foo\" cond=\"inc(true)\" target=\"s1\" />\
+			</state>\
+			<state id=\"s1\">\
+				<transition event=\"error.execution\" cond=\"count == 1\" target=\"pass\" />\
+				<transition event=\"*\" target=\"fail\" />\
+			</state>\
+			<final id=\"pass\" />\
+			<final id=\"fail\" />\
+		</scxml>", "");
+
+	InterpreterState state = USCXML_UNDEF;
+	while((state = interpreter.step()) != USCXML_FINISHED) {}
+	if (!interpreter.isInState("pass")) {
+		std::cerr << "Guards in " << type << " datamodel did not behave as when evaluated one by one" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * Only the guards the selection reaches are evaluated, each of them once.
+ */
+void testReachable(const std::string& type, const std::string& incFunc) {
+	Interpreter interpreter = Interpreter::fromXML("\
+		<scxml xmlns=\"http://www.w3.org/2005/07/scxml\" datamodel=\"" + type + "\">\
+			<datamodel><data id=\"count\" expr=\"0\" /></datamodel>\
+			<script>" + incFunc + "</script>\
+			<state id=\"s0\">\
+				<onentry><raise event=\"foo\" /></onentry>\
+				<transition event=\"foo\" cond=\"inc(false)\" target=\"fail\" />\
+				<transition event=\"foo\" cond=\"inc(true)\" target=\"p\" />\
+				<transition event=\"foo\" cond=\"inc(true)\" target=\"fail\" />\
+			</state>\
+			<parallel id=\"p\">\
+				<onentry><raise event=\"bar\" /></onentry>\
+				<state id=\"r1\">\
+					<state id=\"a1\"><transition event=\"bar\" cond=\"inc(true)\" target=\"a2\" /></state>\
+					<state id=\"a2\" />\
+				</state>\
+				<state id=\"r2\">\
+					<state id=\"b1\">\
+						<transition event=\"bar\" cond=\"inc(true)\" target=\"b2\" />\
+						<transition event=\"bar\" cond=\"inc(true)\" target=\"fail\" />\
+					</state>\
+					<state id=\"b2\" />\
+				</state>\
+				<transition event=\"bar\" cond=\"inc(true)\" target=\"fail\" />\
+			</parallel>\
+			<final id=\"fail\" />\
+		</scxml>", "");
+
+	while(interpreter.step(0) != USCXML_IDLE) {}
+
+	// two guards in s0, one per region, none pre-empted by a transition taken before
+	std::string count = interpreter.getActionLanguage()->dataModel.evalAsData("count").atom;
+	if (!interpreter.isInState("a2") || !interpreter.isInState("b2") || count != "4") {
+		std::cerr << "Guards in " << type << " datamodel were evaluated " << count << " times instead of 4" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * A side-effecting guard is evaluated once, also when it is the only enabled one.
+ */
+void testSideEffects() {
+	Interpreter interpreter = Interpreter::fromXML("\
+		<scxml xmlns=\"http://www.w3.org/2005/07/scxml\" datamodel=\"ecmascript\">\
+			<datamodel><data id=\"x\" expr=\"4\" /></datamodel>\
+			<state id=\"s0\">\
+				<onentry><raise event=\"foo\" /></onentry>\
+				<transition event=\"foo\" cond=\"(x = x + 1) &gt; 5\" target=\"fail\" />\
+				<transition event=\"foo\" cond=\"(x = x + 1) &gt; 5\" target=\"s1\" />\
+				<transition event=\"foo\" cond=\"(x = x + 1) &gt; 5\" target=\"fail\" />\
+			</state>\
+			<state id=\"s1\">\
+				<transition cond=\"x == 6\" target=\"pass\" />\
+				<transition target=\"fail\" />\
+			</state>\
+			<final id=\"pass\" />\
+			<final id=\"fail\" />\
+		</scxml>", "");
+
+	while(interpreter.step() != USCXML_FINISHED) {}
+	if (!interpreter.isInState("pass")) {
+		std::cerr << "Side-effecting guards were not evaluated exactly once each" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+int main(int argc, char** argv) {
+	try {
+		const char* microSteppers[] = { "large", "fast" };
+		for (size_t i = 0; i < 2; i++) {
+			setenv("USCXML_MICROSTEPPER", microSteppers[i], 1);
+
+			if (Factory::getInstance()->hasDataModel("ecmascript")) {
+				std::string incFunc = "function inc(v) { count++; return v; }";
+				testBatch("ecmascript", incFunc, "undefined.foo");
+				testMicroStep("ecmascript", incFunc, "undefined.foo");
+				testReachable("ecmascript", incFunc);
+				testSideEffects();
+			}
+			if (Factory::getInstance()->hasDataModel("lua")) {
+				std::string incFunc = "function inc(v) count = count + 1; return v end";
+				testBatch("lua", incFunc, "nil + 1");
+				testMicroStep("lua", incFunc, "nil + 1");
+				testReachable("lua", incFunc);
+			}
+		}
+	} catch (Event e) {
+		std::cerr << e << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return EXIT_SUCCESS;
+}
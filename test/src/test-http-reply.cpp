@@ -0,0 +1,144 @@
+#include "uscxml/config.h"
+#include "uscxml/Interpreter.h"
+#include "uscxml/server/HTTPServer.h"
+#include "uscxml/util/URL.h"
+#include "uscxml/util/UUID.h"
+#include "uscxml/interpreter/Logging.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+using namespace uscxml;
+
+std::string fileContent = std::string("file\0content", 12);
+std::string blobContent = std::string("blob\0content", 12);
+
+/**
+ * Replies with a string, blob or file depending on the last path component.
+ */
+class ReplyServlet : public HTTPServlet {
+public:
+	virtual bool requestFromHTTP(const HTTPServer::Request& request) {
+		const std::string& path = request.data.compound.at("path").atom;
+		std::string kind = path.substr(path.find_last_of("/") + 1);
+
+		HTTPServer::Reply reply(request);
+		reply.headers["Content-Type"] = "application/octet-stream";
+		if (kind == "string") {
+			reply.content = "string content";
+		} else if (kind == "blob") {
+			reply.blob = Blob(blobContent.data(), blobContent.size());
+		} else if (kind == "file") {
+			reply.file = file;
+		} else if (kind == "missing") {
+			reply.file = file + ".missing";
+		}
+		HTTPServer::reply(std::move(reply));
+		return true;
+	}
+	virtual void setURL(const std::string& url) {
+		this->url = url;
+	}
+	virtual bool canAdaptPath() {
+		return false;
+	}
+
+	std::string url;
+	std::string file;
+};
+
+std::string get(const std::string& url) {
+	return URL(url).getInContent();
+}
+
+void testServerReplies(const std::string& file) {
+	ReplyServlet servlet;
+	servlet.file = file;
+	assert(HTTPServer::registerServlet("reply", &servlet));
+
+	assert(get(servlet.url + "/string") == "string content");
+	assert(get(servlet.url + "/blob") == blobContent);
+	assert(get(servlet.url + "/file") == fileContent);
+
+	// an unreadable file is a 404
+	try {
+		get(servlet.url + "/missing");
+		assert(false);
+	} catch (ErrorEvent e) {
+	}
+
+	HTTPServer::unregisterServlet(&servlet);
+}
+
+void testRespondElement(const std::string& file) {
+	std::string tmpDir = URL::getTempDir();
+
+	// an error in respond is answered with the error's name
+	std::string xml = "\
+		<scxml datamodel=\"ecmascript\" xmlns=\"http://www.w3.org/2005/07/scxml\">\
+			<datamodel><data id=\"origin\" /></datamodel>\
+			<state id=\"s0\">\
+				<transition event=\"http.get\" cond=\"_event.data.query.kind == 'string'\">\
+					<respond to=\"_event.origin\"><content expr=\"'string content'\" /></respond>\
+				</transition>\
+				<transition event=\"http.get\" cond=\"_event.data.query.kind == 'file'\">\
+					<respond to=\"_event.origin\"><content fileexpr=\"'file://" + file + "'\" /></respond>\
+				</transition>\
+				<transition event=\"http.get\" cond=\"_event.data.query.kind == 'missing'\">\
+					<assign location=\"origin\" expr=\"_event.origin\" />\
+					<respond to=\"_event.origin\"><content fileexpr=\"'file://" + file + ".missing'\" /></respond>\
+				</transition>\
+				<transition event=\"http.get\" cond=\"_event.data.query.kind == 'directory'\">\
+					<assign location=\"origin\" expr=\"_event.origin\" />\
+					<respond to=\"_event.origin\"><content fileexpr=\"'file://" + tmpDir + "'\" /></respond>\
+				</transition>\
+				<transition event=\"error.execution\">\
+					<respond to=\"origin\"><content expr=\"_event.name\" /></respond>\
+				</transition>\
+			</state>\
+		</scxml>";
+
+	Interpreter interpreter = Interpreter::fromXML(xml, "");
+	while(interpreter.step(0) != USCXML_IDLE) {}
+
+	std::string location = interpreter.getActionLanguage()->dataModel.evalAsData("_ioprocessors['http'].location").atom;
+
+	std::atomic<bool> done(false);
+	std::thread client([&location, &done] {
+		assert(get(location + "?kind=string") == "string content");
+		assert(get(location + "?kind=file") == fileContent);
+		assert(get(location + "?kind=missing") == "error.execution");
+		assert(get(location + "?kind=directory") == "error.execution");
+		done = true;
+	});
+
+	while(!done) {
+		interpreter.step(10);
+	}
+	client.join();
+}
+
+int main(int argc, char** argv) {
+	std::string file = URL::getTempDir() + PATH_SEPERATOR + "test-http-reply-" + UUID::getUUID() + ".bin";
+	{
+		std::ofstream fileStream(file.c_str(), std::ios::binary);
+		fileStream << fileContent;
+	}
+
+	try {
+		HTTPServer::getInstance(8095, 0, NULL);
+		testServerReplies(file);
+		testRespondElement(file);
+	} catch (Event e) {
+		std::cerr << e << std::endl;
+		remove(file.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	remove(file.c_str());
+	return EXIT_SUCCESS;
+}
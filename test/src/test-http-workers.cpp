@@ -0,0 +1,225 @@
+#include "uscxml/config.h"
+#include "uscxml/server/HTTPServer.h"
+#include "uscxml/util/URL.h"
+
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace uscxml;
+
+/**
+ * Queues requests from all event loops, they are answered from another thread.
+ */
+class QueueingServlet : public HTTPServlet {
+public:
+	virtual bool requestFromHTTP(const HTTPServer::Request& request) {
+		std::lock_guard<std::mutex> lock(mutex);
+		threads.insert(std::this_thread::get_id());
+		requests.push_back(request);
+		cond.notify_all();
+		return true;
+	}
+	virtual void setURL(const std::string& url) {
+		this->url = url;
+	}
+	virtual bool canAdaptPath() {
+		return false;
+	}
+
+	std::string url;
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::list<HTTPServer::Request> requests;
+	std::set<std::thread::id> threads;
+};
+
+/**
+ * Blocks the event loop dispatching a request until released.
+ */
+class BlockingServlet : public HTTPServlet {
+public:
+	virtual bool requestFromHTTP(const HTTPServer::Request& request) {
+		std::unique_lock<std::mutex> lock(mutex);
+		blocked = true;
+		cond.notify_all();
+		while(!released)
+			cond.wait(lock);
+		evhttp_send_reply(request.evhttpReq, 200, "OK", NULL);
+		return true;
+	}
+	virtual void setURL(const std::string& url) {
+		this->url = url;
+	}
+	virtual bool canAdaptPath() {
+		return false;
+	}
+
+	std::string url;
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool blocked = false;
+	bool released = false;
+};
+
+/**
+ * Answers right away from the event loop.
+ */
+class EchoServlet : public HTTPServlet {
+public:
+	virtual bool requestFromHTTP(const HTTPServer::Request& request) {
+		HTTPServer::Reply reply(request);
+		reply.content = request.getPath();
+		reply.headers["Content-Type"] = "text/plain";
+		HTTPServer::reply(reply);
+		return true;
+	}
+	virtual void setURL(const std::string& url) {
+		this->url = url;
+	}
+	virtual bool canAdaptPath() {
+		return false;
+	}
+
+	std::string url;
+};
+
+/**
+ * A servlet blocking one event loop does not keep the others from answering.
+ */
+void testBlockingServlet() {
+	BlockingServlet blocking;
+	EchoServlet echo;
+	HTTPServer::registerServlet("blocking", &blocking);
+	HTTPServer::registerServlet("echo", &echo);
+
+	std::thread blocked([&blocking] {
+		URL(blocking.url).getInContent();
+	});
+	{
+		std::unique_lock<std::mutex> lock(blocking.mutex);
+		while(!blocking.blocked)
+			blocking.cond.wait(lock);
+	}
+
+	// connections accepted by the blocked loop wait, the others are answered meanwhile
+	std::atomic<size_t> answered(0);
+	std::vector<std::thread> clients;
+	for (size_t i = 0; i < 16; i++) {
+		clients.push_back(std::thread([&echo, &answered, i] {
+			try {
+				if (URL(echo.url + "/" + toStr(i)).getInContent() == "/echo/" + toStr(i))
+					answered++;
+			} catch (...) {
+			}
+		}));
+	}
+	for (size_t i = 0; i < 500 && answered == 0; i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	size_t answeredWhileBlocked = answered;
+
+	{
+		std::lock_guard<std::mutex> lock(blocking.mutex);
+		blocking.released = true;
+		blocking.cond.notify_all();
+	}
+	blocked.join();
+	for (auto& client : clients) {
+		client.join();
+	}
+
+	if (answeredWhileBlocked == 0) {
+		std::cerr << "No request was answered while a servlet blocked an event loop" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	assert(answered == 16);
+
+	HTTPServer::unregisterServlet(&blocking);
+	HTTPServer::unregisterServlet(&echo);
+}
+
+int main(int argc, char** argv) {
+	// run with USCXML_HTTP_WORKERS=2
+	HTTPServer::getInstance(8096, 0, NULL);
+
+	QueueingServlet servlet;
+	if (!HTTPServer::registerServlet("workers", &servlet)) {
+		std::cerr << "Could not register servlet" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	size_t nrRequests = 64;
+
+	// reply with the path, HTTPServer::reply has to pass it to the request's own event loop
+	std::thread replier([&servlet, nrRequests] {
+		for (size_t i = 0; i < nrRequests; i++) {
+			std::unique_lock<std::mutex> lock(servlet.mutex);
+			while(servlet.requests.empty())
+				servlet.cond.wait(lock);
+			HTTPServer::Request request = servlet.requests.front();
+			servlet.requests.pop_front();
+			lock.unlock();
+
+			HTTPServer::Reply reply(request);
+			reply.content = request.data.compound["path"].atom;
+			reply.headers["Content-Type"] = "text/plain";
+			HTTPServer::reply(reply);
+		}
+	});
+
+	// every connection is accepted by one of the event loops
+	size_t failures = 0;
+	std::mutex failuresMutex;
+	std::vector<std::thread> clients;
+	for (size_t i = 0; i < nrRequests; i++) {
+		clients.push_back(std::thread([&servlet, &failures, &failuresMutex, i] {
+			std::stringstream path;
+			path << "/workers/" << i;
+			std::string content;
+			try {
+				URL url(servlet.url + "/" + toStr(i));
+				content = url.getInContent();
+			} catch (...) {
+			}
+			if (content != path.str()) {
+				std::lock_guard<std::mutex> lock(failuresMutex);
+				std::cerr << "Expected '" << path.str() << "' but got '" << content << "'" << std::endl;
+				failures++;
+			}
+		}));
+	}
+
+	for (auto& client : clients) {
+		client.join();
+	}
+	replier.join();
+
+	if (failures > 0) {
+		std::cerr << failures << " of " << nrRequests << " requests were not answered" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+#if defined(__linux__)
+	// with SO_REUSEPORT, the kernel spreads the connections over both loops
+	if (servlet.threads.size() < 2) {
+		std::cerr << "All requests were dispatched by a single event loop" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+#endif
+
+	HTTPServer::unregisterServlet(&servlet);
+
+#if defined(__linux__)
+	testBlockingServlet();
+#endif
+	return EXIT_SUCCESS;
+}
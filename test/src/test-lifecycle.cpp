@@ -1,8 +1,13 @@
 #include "uscxml/config.h"
 #include "uscxml/Interpreter.h"
 #include "uscxml/interpreter/InterpreterMonitor.h"
+#include "uscxml/interpreter/InterpreterImpl.h"
 #include "uscxml/interpreter/Logging.h"
+#include "uscxml/util/URL.h"
+#include "uscxml/util/UUID.h"
 #include <iostream>
+#include <fstream>
+#include <stdio.h>
 #include <boost/algorithm/string.hpp>
 #include <xercesc/util/PlatformUtils.hpp>
 
@@ -348,6 +353,96 @@ int main(int argc, char** argv) {
 			assert(interpreter.step() == USCXML_MICROSTEPPED);
 			assert(interpreter.step() == USCXML_FINISHED);
 		}
+
+		if (1) {
+			// sessions from a cached template run on their own copy
+			const char* xml =
+			    "<scxml>"
+			    "	<state id=\"start\">"
+			    "		<transition target=\"done\" />"
+			    " </state>"
+			    " <final id=\"done\" />"
+			    "</scxml>";
+
+			Interpreter first = Interpreter::fromTemplate(xml, "");
+			Interpreter second = Interpreter::fromTemplate(xml, "");
+			assert(first.getImpl()->getDocument() != second.getImpl()->getDocument());
+
+			while(first.step() != USCXML_FINISHED) {}
+			assert(second.getState() == USCXML_INSTANTIATED);
+			while(second.step() != USCXML_FINISHED) {}
+
+			// so do datamodels asking for the document
+			Interpreter third = Interpreter::fromTemplate(xml, "");
+			const DataModelCallbacks* callbacks = third.getImpl().get();
+			assert(callbacks->getDocument() != NULL);
+			assert(callbacks->getDocument() != first.getImpl()->getDocument());
+			assert(callbacks->getDocument() == third.getImpl()->getDocument());
+
+			Interpreter::clearTemplates();
+		}
+
+		if (1) {
+			// templates from an URL follow changes of its content
+			std::string file = URL::getTempDir() + PATH_SEPERATOR + "test-lifecycle-" + UUID::getUUID() + ".scxml";
+			std::string finals[] = { "pass", "other" };
+
+			for (size_t i = 0; i < 2; i++) {
+				std::ofstream stream(file.c_str());
+				stream << "<scxml><final id=\"" << finals[i] << "\" /></scxml>";
+				stream.close();
+
+				Interpreter interpreter = Interpreter::fromTemplate(file);
+				while(interpreter.step() != USCXML_FINISHED) {}
+				assert(interpreter.isInState(finals[i]));
+			}
+
+			remove(file.c_str());
+			Interpreter::clearTemplates();
+		}
+
+		if (1) {
+			// an edited file replaces its template instead of adding another one
+			std::string file = URL::getTempDir() + PATH_SEPERATOR + "test-lifecycle-" + UUID::getUUID() + ".scxml";
+			std::weak_ptr<DocumentTemplate> previous;
+
+			for (size_t i = 0; i < 3; i++) {
+				std::ofstream stream(file.c_str());
+				stream << "<scxml><final id=\"pass" << std::string(i, 's') << "\" /></scxml>";
+				stream.close();
+
+				Interpreter interpreter = Interpreter::fromTemplate(file);
+				std::shared_ptr<DocumentTemplate> tmpl = interpreter.getImpl()->getTemplate();
+				assert(tmpl);
+				assert(previous.expired());
+				assert(Interpreter::fromTemplate(file).getImpl()->getTemplate() == tmpl);
+				previous = tmpl;
+			}
+
+			remove(file.c_str());
+			Interpreter::clearTemplates();
+			assert(previous.expired());
+		}
+
+		if (1) {
+			// only the most recently used templates are kept
+			Interpreter::setMaxTemplates(2);
+			std::weak_ptr<DocumentTemplate> templates[3];
+			for (size_t i = 0; i < 3; i++) {
+				std::string xml = "<scxml><final id=\"pass" + toStr(i) + "\" /></scxml>";
+				templates[i] = Interpreter::fromTemplate(xml, "").getImpl()->getTemplate();
+				if (i == 1) {
+					// using the first again makes the second the oldest
+					assert(Interpreter::fromTemplate("<scxml><final id=\"pass0\" /></scxml>", "").getImpl()->getTemplate() == templates[0].lock());
+				}
+			}
+			assert(!templates[0].expired());
+			assert(templates[1].expired());
+			assert(!templates[2].expired());
+
+			Interpreter::setMaxTemplates(64);
+			Interpreter::clearTemplates();
+		}
 	}
 	return EXIT_SUCCESS;
 }
@@ -2,6 +2,10 @@
 #include "uscxml/plugins/datamodel/lua/LuaDataModel.h"
 #include "uscxml/plugins/Factory.h"
 #include "uscxml/interpreter/Logging.h"
+#include "uscxml/messages/Event.h"
+#include "uscxml/debug/Benchmark.h"
+
+#include <assert.h>
 
 #include <iostream>
 
@@ -91,6 +95,26 @@ public:
 
 };
 
+// a payload with width^depth leafs
+static Data nestedPayload(size_t width, size_t depth) {
+	Data data;
+	for (size_t i = 0; i < width; i++) {
+		if (depth > 1) {
+			data.compound["key" + toStr(i)] = nestedPayload(width, depth - 1);
+			data.array.push_back(nestedPayload(width, depth - 1));
+		} else {
+			data.compound["key" + toStr(i)] = Data(i);
+			data.array.push_back(Data("item" + toStr(i), Data::VERBATIM));
+		}
+	}
+	// either an array or a compound
+	if (depth % 2)
+		data.array.clear();
+	else
+		data.compound.clear();
+	return data;
+}
+
 int main(int argc, char** argv) {
 	try {
 		DataModel lua = Factory::getInstance()->createDataModel("lua", new DMCallbacks());
@@ -109,6 +133,113 @@ int main(int argc, char** argv) {
 			std::cout << "TEST3.4:" << d4.asJSON() << std::endl << std::endl;
 
 		}
+
+		{
+			// by default, compound and array data are plain tables
+			Event e("test");
+			e.data = Data::fromJSON("{\"foo\": [1, 2], \"qux\": true}");
+			lua.setEvent(e);
+			assert(lua.evalAsBool("type(_event.data) == 'table'"));
+			assert(lua.evalAsBool("type(_event.data.foo) == 'table'"));
+			lua.eval("table.insert(_event.data.foo, 3)");
+			assert(lua.evalAsBool("#_event.data.foo == 3 and _event.data.foo[3] == 3"));
+			assert(lua.evalAsBool("table.concat(_event.data.foo, ',') == '1,2,3'"));
+			lua.eval("keys = 0; for k, v in pairs(_event.data) do keys = keys + 1 end");
+			assert(lua.evalAsBool("keys == 2"));
+			lua.eval("sum = 0; for i, v in ipairs(_event.data.foo) do sum = sum + v end");
+			assert(lua.evalAsBool("sum == 6"));
+
+			lua.assign("assigned", e.data);
+			assert(lua.evalAsBool("type(assigned) == 'table'"));
+		}
+
+		// proxies are opt-in
+		setenv("USCXML_LUA_DATA_PROXIES", "1", 1);
+		lua = Factory::getInstance()->createDataModel("lua", new DMCallbacks());
+
+		{
+			// data proxies have to behave like tables
+			Data d1 = Data::fromJSON("{\"foo\": [1, 2, {\"bar\": \"baz\"}], \"qux\": true}");
+			lua.assign("proxied", d1);
+			assert(lua.evalAsBool("type(proxied) == 'userdata'"));
+			assert(lua.evalAsData("proxied").asJSON() == d1.asJSON());
+			assert(lua.evalAsBool("#proxied.foo == 3"));
+			assert(lua.evalAsBool("proxied.foo[3].bar == 'baz'"));
+			assert(lua.evalAsBool("proxied.qux == true"));
+
+			lua.eval("alias = proxied.foo; proxied.foo[4] = 'appended'; alias[1] = 10");
+			assert(lua.evalAsBool("#proxied.foo == 4"));
+			assert(lua.evalAsBool("proxied.foo[1] == 10"));
+			assert(lua.evalAsData("proxied.foo[4]").atom == "appended");
+
+			Event e("test");
+			e.data = d1;
+			lua.setEvent(e);
+			lua.eval("_event.data.qux = false");
+			assert(lua.evalAsBool("_event.data.qux == false"));
+			assert(e.data.compound["qux"].atom == "true");
+		}
+
+		{
+			// reading _event.data does not copy, the proxies see the event's own data
+			Event e("test");
+			e.data = Data::fromJSON("{\"foo\": {\"bar\": \"baz\"}, \"list\": [1, 2]}");
+			lua.setEvent(e);
+			assert(lua.evalAsData("_event.data.foo.bar").atom == "baz");
+			lua.eval("stashed = _event.data.foo");
+
+			e.data.compound["foo"].compound["bar"] = Data("changed", Data::VERBATIM);
+			assert(lua.evalAsData("_event.data.foo.bar").atom == "changed");
+			assert(lua.evalAsData("stashed.bar").atom == "changed");
+			assert(lua.evalAsBool("#_event.data.list == 2"));
+
+			// the interpreter releases the event before replacing it, proxies take its data over
+			lua.releaseEvent(e);
+			assert(e.data.compound.empty());
+			e.data = Data::fromJSON("{\"foo\": {\"bar\": \"other\"}}");
+			assert(lua.evalAsData("stashed.bar").atom == "changed");
+			assert(lua.evalAsData("_event.data.foo.bar").atom == "changed");
+
+			// writes after the release stay with the datamodel
+			lua.eval("stashed.bar = 'written'");
+			assert(lua.evalAsData("_event.data.foo.bar").atom == "written");
+			assert(e.data.compound["foo"].compound["bar"].atom == "other");
+		}
+
+		{
+			size_t iterations = 100;
+			const char* envBenchmarkRuns = getenv("USCXML_BENCHMARK_ITERATIONS");
+			if (envBenchmarkRuns != NULL)
+				iterations = strTo<size_t>(envBenchmarkRuns);
+
+			Data payload = nestedPayload(10, 5);
+
+			for (size_t i = 0; i < iterations; i++) {
+				Benchmark bench("lua.assign");
+				lua.assign("payload", payload);
+			}
+			for (size_t i = 0; i < iterations; i++) {
+				Benchmark bench("lua.index");
+				lua.evalAsBool("payload.key9[10].key9[10].key9 == 9");
+			}
+			for (size_t i = 0; i < iterations; i++) {
+				Benchmark bench("lua.evalAsData");
+				lua.evalAsData("payload.key1");
+			}
+
+			Event e("payload");
+			e.data = payload;
+			for (size_t i = 0; i < iterations; i++) {
+				Benchmark bench("lua.setEvent");
+				lua.setEvent(e);
+			}
+			for (size_t i = 0; i < iterations; i++) {
+				Benchmark bench("lua.iterate");
+				lua.eval("local items = _event.data.key2; for i = 1, #items do local item = items[i] end");
+			}
+
+			Benchmark::report(std::cout);
+		}
 	} catch (Event e) {
 		std::cout << e << std::endl;
 	}
@@ -0,0 +1,168 @@
+#define protected public
+#include "uscxml/config.h"
+#include "uscxml/Interpreter.h"
+#include "uscxml/interpreter/Logging.h"
+#include "uscxml/plugins/datamodel/native/NativeDataModel.h"
+#include "uscxml/messages/Event.h"
+
+#include <assert.h>
+#include <iostream>
+#include <set>
+
+using namespace uscxml;
+
+class NativeDMCallbacks : public DataModelCallbacks {
+public:
+	std::string name = "native";
+	std::string sessionId = "native";
+	std::map<std::string, IOProcessor> ioProcs;
+	std::map<std::string, Invoker> invokers;
+	std::set<std::string> activeStates;
+
+	const std::string& getName() {
+		return name;
+	}
+	const std::string& getSessionId()  {
+		return sessionId;
+	}
+	const std::map<std::string, IOProcessor>& getIOProcessors() {
+		return ioProcs;
+	}
+	bool isInState(const std::string& stateId) {
+		return activeStates.find(stateId) != activeStates.end();
+	}
+	XERCESC_NS::DOMDocument* getDocument() const {
+		return NULL;
+	}
+	const std::map<std::string, Invoker>& getInvokers() {
+		return invokers;
+	}
+	Logger getLogger() {
+		return Logger::getDefault();
+	}
+};
+
+bool throwsExecution(NativeDataModel* dm, const std::string& expr) {
+	try {
+		dm->evalAsData(expr);
+	} catch (ErrorEvent e) {
+		return true;
+	}
+	return false;
+}
+
+void testExpressions() {
+	NativeDMCallbacks callbacks;
+	callbacks.activeStates.insert("s1");
+
+	std::shared_ptr<DataModelImpl> dmImpl = NativeDataModel().create(&callbacks);
+	NativeDataModel* dm = (NativeDataModel*)dmImpl.get();
+
+	dm->init("x", Data("3", Data::INTERPRETED));
+	dm->init("y", Data("x + 4", Data::INTERPRETED));
+	dm->init("s", Data("foo", Data::VERBATIM));
+	dm->init("b", Data("x < y and In('s1')", Data::INTERPRETED));
+
+	assert(dm->_slotTypes[dm->_slotIndex["x"]] == NativeDataModel::TYPE_INT);
+	assert(dm->_slotTypes[dm->_slotIndex["s"]] == NativeDataModel::TYPE_STRING);
+	assert(dm->_slotTypes[dm->_slotIndex["b"]] == NativeDataModel::TYPE_BOOL);
+
+	assert(dm->evalAsData("y * 2 - x % 2").atom == "13");
+	assert(dm->evalAsData("s + 'bar'").atom == "foobar");
+	assert(dm->evalAsBool("b && !In('s2')"));
+	assert(dm->evalAsBool("x == 3 || 1 / 0 == 1")); // short-circuit
+	assert(dm->evalAsBool("_sessionid == 'native'"));
+
+	// statically rejected
+	assert(throwsExecution(dm, "x + s"));
+	assert(throwsExecution(dm, "!x"));
+	assert(throwsExecution(dm, "undeclared + 1"));
+	assert(!dm->isValidSyntax("x +"));
+	assert(dm->isValidSyntax("undeclared + 1"));
+
+	// runtime errors
+	assert(throwsExecution(dm, "x / (y - 7)"));
+
+	// integer overflow is an error, not undefined behavior
+	dm->init("max", Data("9223372036854775807", Data::INTERPRETED));
+	dm->init("min", Data("-9223372036854775807 - 1", Data::INTERPRETED));
+	assert(throwsExecution(dm, "max + 1"));
+	assert(throwsExecution(dm, "min - 1"));
+	assert(throwsExecution(dm, "max * 2"));
+	assert(throwsExecution(dm, "min * -1"));
+	assert(throwsExecution(dm, "-min"));
+	assert(throwsExecution(dm, "min / -1"));
+	assert(throwsExecution(dm, "9223372036854775808"));
+	assert(dm->evalAsBool("min % -1 == 0"));
+	assert(dm->evalAsBool("max / -1 == -max"));
+	assert(dm->evalAsBool("-4611686018427387904 * 2 == min"));
+	assert(dm->evalAsBool("max + min == -1"));
+
+	// typed assignment
+	dm->assign("x", Data("x * 10", Data::INTERPRETED));
+	assert(dm->evalAsBool("x == 30"));
+	try {
+		dm->assign("x", Data("'foo'", Data::INTERPRETED));
+		assert(false);
+	} catch (ErrorEvent e) {}
+
+	// records
+	Data record;
+	record.compound["count"] = Data(2);
+	record.compound["name"] = Data("bar", Data::VERBATIM);
+	dm->init("r", record);
+	assert(dm->evalAsBool("r.count == 2 and r.name == 'bar'"));
+	dm->assign("r.count", Data("r.count + 1", Data::INTERPRETED));
+	dm->assign("r.nested.flag", Data("true", Data::INTERPRETED));
+	assert(dm->evalAsBool("r.count == 3 and r.nested.flag"));
+	assert(dm->getLength("r") == 3);
+
+	// event
+	Event event("foo.bar");
+	event.data.compound["value"] = Data(5);
+	dm->setEvent(event);
+	assert(dm->evalAsBool("_event.name == 'foo.bar' and _event.data.value + x == 35"));
+
+	// serialization round trip through data
+	Data serialized = Data::fromJSON(Data::toJSON(dm->evalAsData("r")));
+	std::shared_ptr<DataModelImpl> otherImpl = NativeDataModel().create(&callbacks);
+	NativeDataModel* other = (NativeDataModel*)otherImpl.get();
+	other->init("r", serialized);
+	assert(other->evalAsBool("r.count == 3 and r.name == 'bar' and r.nested.flag"));
+}
+
+void testInterpreter() {
+	const char* xml =
+	    "<scxml xmlns=\"http://www.w3.org/2005/07/scxml\" datamodel=\"typed\" initial=\"s0\">"
+	    "  <datamodel>"
+	    "    <data id=\"count\" expr=\"0\"/>"
+	    "    <data id=\"limit\" type=\"int\" expr=\"5\"/>"
+	    "  </datamodel>"
+	    "  <state id=\"s0\">"
+	    "    <onentry><raise event=\"loop\"/></onentry>"
+	    "    <transition event=\"loop\" cond=\"count &lt; limit\" target=\"s0\">"
+	    "      <assign location=\"count\" expr=\"count + 1\"/>"
+	    "    </transition>"
+	    "    <transition event=\"loop\" cond=\"count == limit and In('s0')\" target=\"pass\"/>"
+	    "    <transition event=\"*\" target=\"fail\"/>"
+	    "  </state>"
+	    "  <final id=\"pass\"/>"
+	    "  <final id=\"fail\"/>"
+	    "</scxml>";
+
+	Interpreter interpreter = Interpreter::fromXML(xml, "");
+	InterpreterState state;
+	while ((state = interpreter.step()) != USCXML_FINISHED) {}
+	assert(interpreter.isInState("pass"));
+}
+
+int main(int argc, char** argv) {
+	try {
+		testExpressions();
+		testInterpreter();
+	} catch (Event e) {
+		std::cout << e << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
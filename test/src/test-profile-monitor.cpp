@@ -0,0 +1,115 @@
+#include "uscxml/config.h"
+#include "uscxml/Interpreter.h"
+#include "uscxml/debug/ProfileMonitor.h"
+#include "uscxml/transform/ChartToC.h"
+#include "uscxml/util/URL.h"
+#include "uscxml/util/UUID.h"
+#include "uscxml/interpreter/Logging.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace uscxml;
+
+std::string chart(const std::string& target) {
+	return "\
+		<scxml xmlns=\"http://www.w3.org/2005/07/scxml\">\
+			<state id=\"s0\">\
+				<onentry><raise event=\"foo\" /></onentry>\
+				<transition event=\"foo\" target=\"" + target + "\" />\
+			</state>\
+			<final id=\"" + target + "\" />\
+		</scxml>";
+}
+
+void run(Interpreter interpreter, ProfileMonitor* monitor) {
+	interpreter.addMonitor(monitor);
+	InterpreterState state = USCXML_UNDEF;
+	while((state = interpreter.step()) != USCXML_FINISHED) {}
+}
+
+/// The counter of the state whose XPath mentions the id, 0 if there is none
+size_t count(Data profile, const std::string& stateId, const std::string& counter) {
+	for (auto& state : profile["states"].compound) {
+		if (state.first.find("'" + stateId + "'") != std::string::npos || state.first.find("\"" + stateId + "\"") != std::string::npos)
+			return strTo<size_t>(state.second[counter].atom);
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	std::string profileFile = URL::getTempDir() + PATH_SEPERATOR + "test-profile-" + UUID::getUUID() + ".json";
+
+	try {
+		std::string documentA = chart("pass");
+		std::string documentB = chart("other");
+
+		{
+			// interpreters of one document share a monitor
+			ProfileMonitor monitor(profileFile);
+			run(Interpreter::fromXML(documentA, ""), &monitor);
+			run(Interpreter::fromXML(documentA, ""), &monitor);
+
+			// other documents are not counted
+			Interpreter other = Interpreter::fromXML(documentB, "");
+			run(other, &monitor);
+
+			Data profile = monitor.getProfile();
+			assert(count(profile, "pass", "entered") == 2);
+			assert(count(profile, "s0", "dwell") == 2);
+			assert(count(profile, "other", "entered") == 0);
+			assert(profile["document"]["md5"].atom == ProfileMonitor::documentId(Interpreter::fromXML(documentA, "")));
+			assert(profile["document"]["md5"].atom != ProfileMonitor::documentId(other));
+
+			// completions are not written before the flush interval passed
+			std::ifstream profileStream(profileFile);
+			assert(!profileStream);
+		}
+
+		{
+			// accumulated over runs
+			ProfileMonitor monitor(profileFile);
+			run(Interpreter::fromXML(documentA, ""), &monitor);
+			assert(count(monitor.getProfile(), "pass", "entered") == 3);
+		}
+
+		{
+			// the generated C accepts the profile only for its document
+			Transformer transformer = ChartToC::transform(Interpreter::fromXML(documentA, ""));
+			std::multimap<std::string, std::string> extensions;
+			extensions.insert(std::make_pair("profile", profileFile));
+			transformer.setExtensions(extensions);
+			std::stringstream ss;
+			transformer.writeTo(ss);
+			assert(ss.str().find("static USCXML_HOT int") != std::string::npos);
+
+			transformer = ChartToC::transform(Interpreter::fromXML(documentB, ""));
+			transformer.setExtensions(extensions);
+			try {
+				transformer.writeTo(ss);
+				assert(false);
+			} catch (ErrorEvent e) {
+			}
+		}
+
+		{
+			// an existing profile for another document is discarded
+			ProfileMonitor monitor(profileFile);
+			run(Interpreter::fromXML(documentB, ""), &monitor);
+			Data profile = monitor.getProfile();
+			assert(count(profile, "pass", "entered") == 0);
+			assert(count(profile, "other", "entered") == 1);
+		}
+
+	} catch (Event e) {
+		std::cerr << e << std::endl;
+		remove(profileFile.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	remove(profileFile.c_str());
+	return EXIT_SUCCESS;
+}
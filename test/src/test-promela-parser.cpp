@@ -13,6 +13,7 @@
 #include <assert.h>
 #include <boost/algorithm/string.hpp>
 #include <iostream>
+#include <set>
 
 using namespace uscxml;
 using namespace XERCESC_NS;
@@ -319,6 +320,71 @@ void testPromelaParser() {
 	}
 }
 
+class PromelaDMCallbacks : public DataModelCallbacks {
+public:
+	std::string name = "promela";
+	std::string sessionId = "promela";
+	std::map<std::string, IOProcessor> ioProcs;
+	std::map<std::string, Invoker> invokers;
+	std::set<std::string> activeStates;
+
+	const std::string& getName() {
+		return name;
+	}
+	const std::string& getSessionId()  {
+		return sessionId;
+	}
+	const std::map<std::string, IOProcessor>& getIOProcessors() {
+		return ioProcs;
+	}
+	bool isInState(const std::string& stateId) {
+		return activeStates.find(stateId) != activeStates.end();
+	}
+	DOMDocument* getDocument() const {
+		return NULL;
+	}
+	const std::map<std::string, Invoker>& getInvokers() {
+		return invokers;
+	}
+	Logger getLogger() {
+		return Logger::getDefault();
+	}
+};
+
+void testCompiledExpressions() {
+	PromelaDMCallbacks callbacks;
+	callbacks.activeStates.insert("s1");
+
+	std::shared_ptr<DataModelImpl> dmImpl = PromelaDataModel().create(&callbacks);
+	PromelaDataModel* dm = (PromelaDataModel*)dmImpl.get();
+
+	dm->init("x", Data(3), { {"type", "int"} });
+	dm->init("y", Data(4), { {"type", "int"} });
+	dm->init("s", Data("foo", Data::VERBATIM), { {"type", "string"} });
+
+	// integer expressions over scalars are compiled
+	assert(dm->evalAsBool("x + 1 == y"));
+	assert(dm->getCompiled("x + 1 == y", PromelaParser::PROMELA_EXPR).isCompiled);
+	assert(dm->evalAsData("x * y - 2").atom == "10");
+	assert(dm->evalAsData("config[s1]").atom == "true");
+	assert(dm->evalAsBool("config[s1] && !config[s2]"));
+
+	// the compiled form sees assignments
+	dm->assign("x", Data(4));
+	assert(!dm->evalAsBool("x + 1 == y"));
+	assert(dm->evalAsData("x").atom == "4");
+
+	// strings are evaluated on the AST
+	assert(dm->evalAsBool("s == 'foo'"));
+	assert(!dm->getCompiled("s == 'foo'", PromelaParser::PROMELA_EXPR).isCompiled);
+
+	// a scalar holding a non-integer falls back to the AST as well
+	dm->assign("y", Data("bar", Data::VERBATIM));
+	assert(dm->evalAsData("y").atom == "bar");
+	dm->assign("y", Data(5));
+	assert(dm->evalAsBool("x + 1 == y"));
+}
+
 int main(int argc, char** argv) {
 	try {
 		::xercesc_3_1::XMLPlatformUtils::Initialize();
@@ -328,4 +394,5 @@ int main(int argc, char** argv) {
 
 	testInlinePromela();
 	testPromelaParser();
+	testCompiledExpressions();
 }
@@ -0,0 +1,182 @@
+#include "uscxml/config.h"
+#include "uscxml/util/RadixTree.h"
+#include "uscxml/server/HTTPServer.h"
+#include "uscxml/util/URL.h"
+
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace uscxml;
+
+void testPrefixes() {
+	RadixTree<int> tree;
+	tree.insert("session1/basichttp", 1);
+	tree.insert("session1", 2);
+	tree.insert("session10", 3);
+
+	std::vector<std::pair<size_t, int> > prefixes = tree.getPrefixesOf("session1/basichttp/sub");
+	assert(prefixes.size() == 2);
+	assert(prefixes[0].first == 8 && prefixes[0].second == 2);
+	assert(prefixes[1].first == 18 && prefixes[1].second == 1);
+
+	assert(tree.erase("session1"));
+	assert(!tree.erase("session1"));
+	assert(!tree.contains("session1"));
+	assert(tree.contains("session10"));
+	assert(tree.contains("session1/basichttp"));
+}
+
+/**
+ * Every caller of synchronize() waits for the versions retired before,
+ * no matter who erased them.
+ */
+void testConcurrentSynchronize() {
+	RadixTree<int> tree;
+	tree.insert("a", 1);
+	tree.insert("b", 2);
+
+	RadixTree<int>::Snapshot reader = tree.snapshot();
+	tree.erase("a");
+
+	std::atomic<bool> firstDone(false);
+	std::atomic<bool> secondDone(false);
+	std::thread first([&tree, &firstDone] {
+		tree.synchronize();
+		firstDone = true;
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	std::thread second([&tree, &secondDone] {
+		tree.erase("b");
+		tree.synchronize();
+		secondDone = true;
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	// the reader still holds the version with "a"
+	assert(!firstDone);
+	assert(!secondDone);
+
+	reader.reset();
+	first.join();
+	second.join();
+	assert(firstDone && secondDone);
+}
+
+/**
+ * Versions retired after the call are not waited for, and the wait can be bounded.
+ */
+void testBoundedSynchronize() {
+	RadixTree<int> tree;
+	tree.insert("a", 1);
+
+	RadixTree<int>::Snapshot reader = tree.snapshot();
+	tree.erase("a");
+	assert(!tree.synchronize(std::chrono::milliseconds(50)));
+
+	std::atomic<bool> done(false);
+	std::thread waiter([&tree, &done] {
+		tree.synchronize();
+		done = true;
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	// a newer version held by another reader is none of the waiter's business
+	tree.insert("b", 2);
+	RadixTree<int>::Snapshot newer = tree.snapshot();
+	tree.erase("b");
+
+	reader.reset();
+	waiter.join();
+	assert(done);
+	assert(!tree.synchronize(std::chrono::milliseconds(10)));
+
+	newer.reset();
+	assert(tree.synchronize(std::chrono::milliseconds(10)));
+}
+
+#define SERVLET_ALIVE 0x5E7C1E7
+class SlowServlet : public HTTPServlet {
+public:
+	SlowServlet() : alive(SERVLET_ALIVE) {}
+	virtual ~SlowServlet() {
+		alive = 0;
+	}
+
+	virtual bool requestFromHTTP(const HTTPServer::Request& request) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		if (alive != SERVLET_ALIVE) {
+			std::cerr << "Request dispatched to an unregistered servlet" << std::endl;
+			abort();
+		}
+		evhttp_send_reply(request.evhttpReq, 200, "OK", NULL);
+		return true;
+	}
+	virtual void setURL(const std::string& url) {
+		this->url = url;
+	}
+	virtual bool canAdaptPath() {
+		return false;
+	}
+
+	std::string url;
+	std::atomic<int> alive;
+};
+
+/**
+ * Servlets unregistered concurrently while dispatching requests to them
+ * can be deleted as soon as unregisterServlet returns.
+ */
+void testConcurrentUnregister() {
+	for (size_t round = 0; round < 20; round++) {
+		std::vector<SlowServlet*> servlets;
+		std::vector<std::thread> threads;
+
+		for (size_t i = 0; i < 2; i++) {
+			std::stringstream path;
+			path << "unregister" << round << "-" << i;
+			servlets.push_back(new SlowServlet());
+			HTTPServer::registerServlet(path.str(), servlets.back());
+		}
+
+		for (auto servlet : servlets) {
+			std::string url = servlet->url;
+			threads.push_back(std::thread([url] {
+				try {
+					URL(url).download(true);
+				} catch (...) {
+					// unregistered before the request arrived
+				}
+			}));
+		}
+
+		// the requests are being processed now
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+		for (auto servlet : servlets) {
+			threads.push_back(std::thread([servlet] {
+				HTTPServer::unregisterServlet(servlet);
+				delete servlet;
+			}));
+		}
+
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	testPrefixes();
+	testConcurrentSynchronize();
+	testBoundedSynchronize();
+
+	HTTPServer::getInstance(8097, 0, NULL);
+	testConcurrentUnregister();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+#include "uscxml/config.h"
+#include "uscxml/server/HTTPServer.h"
+#include "uscxml/util/URL.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <vector>
+
+using namespace uscxml;
+using namespace std::chrono;
+
+class BenchServlet : public HTTPServlet {
+public:
+	BenchServlet() : requests(0) {}
+
+	virtual bool requestFromHTTP(const HTTPServer::Request& request) {
+		requests++;
+		evhttp_send_reply(request.evhttpReq, 200, "OK", NULL);
+		return true;
+	}
+	virtual void setURL(const std::string& url) {
+		this->url = url;
+	}
+	virtual bool canAdaptPath() {
+		return false;
+	}
+
+	std::string url;
+	std::atomic<size_t> requests;
+};
+
+/**
+ * Measure requests per second with many servlets registered, e.g. one
+ * per BasicHTTPIOProcessor in a large number of sessions.
+ */
+int main(int argc, char** argv) {
+	size_t nrServlets = (argc > 1 ? strtol(argv[1], NULL, 10) : 30000);
+	size_t nrRequests = (argc > 2 ? strtol(argv[2], NULL, 10) : 2000);
+
+	HTTPServer::getInstance(8099, 0, NULL);
+
+	std::vector<BenchServlet*> servlets;
+	system_clock::time_point start = system_clock::now();
+	for (size_t i = 0; i < nrServlets; i++) {
+		std::stringstream path;
+		path << "session" << i << "/basichttp";
+		BenchServlet* servlet = new BenchServlet();
+		if (!HTTPServer::registerServlet(path.str(), servlet)) {
+			std::cerr << "Could not register servlet at " << path.str() << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		servlets.push_back(servlet);
+	}
+	long registerMs = duration_cast<milliseconds>(system_clock::now() - start).count();
+
+	start = system_clock::now();
+	for (size_t i = 0; i < nrRequests; i++) {
+		BenchServlet* servlet = servlets[(i * 7919) % servlets.size()];
+		// alternate between the servlet's own path and paths below
+		URL url(i % 2 == 0 ? servlet->url : servlet->url + "/sub/path");
+		url.download(true);
+	}
+	long requestMs = duration_cast<milliseconds>(system_clock::now() - start).count();
+
+	size_t answered = 0;
+	for (auto servlet : servlets) {
+		answered += servlet->requests;
+	}
+
+	std::cout << "\"Servlets\", \"Register (ms)\", \"Requests\", \"Requests/s\"" << std::endl;
+	std::cout << nrServlets << ", " << registerMs << ", " << nrRequests << ", " << (requestMs > 0 ? (nrRequests * 1000) / requestMs : nrRequests) << std::endl;
+
+	if (answered != nrRequests) {
+		std::cerr << "Only " << answered << " of " << nrRequests << " requests reached their servlet" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	for (auto servlet : servlets) {
+		HTTPServer::unregisterServlet(servlet);
+		delete servlet;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+#include "uscxml/config.h"
+#include "uscxml/util/ShardedMap.h"
+
+#include <assert.h>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace uscxml;
+
+typedef ShardedMap<std::weak_ptr<int> > WeakMap;
+
+/// Counts the entries still stored, expired or not
+class InspectableMap : public WeakMap {
+public:
+	InspectableMap(size_t nrShards) : WeakMap(nrShards, [](const std::weak_ptr<int>& value) {
+		return value.expired();
+	}) {}
+
+	size_t stored() {
+		size_t count = 0;
+		for (auto& shard : _shards) {
+			count += std::atomic_load(&shard.entries)->size();
+		}
+		return count;
+	}
+};
+
+void testInsertFindErase() {
+	ShardedMap<int> map(4);
+	int value = 0;
+
+	assert(!map.find("foo", value));
+	map.insert("foo", 1);
+	map.insert("bar", 2);
+	assert(map.find("foo", value) && value == 1);
+	assert(map.find("bar", value) && value == 2);
+
+	map.insert("foo", 3);
+	assert(map.find("foo", value) && value == 3);
+
+	assert(map.erase("foo"));
+	assert(!map.erase("foo"));
+	assert(!map.find("foo", value));
+	assert(map.find("bar", value) && value == 2);
+}
+
+void testLazyExpiry() {
+	// a single shard, so every write sees all entries
+	InspectableMap map(1);
+	std::shared_ptr<int> a = std::make_shared<int>(1);
+	std::shared_ptr<int> b = std::make_shared<int>(2);
+	std::shared_ptr<int> c = std::make_shared<int>(3);
+	std::weak_ptr<int> value;
+
+	map.insert("a", a);
+	map.insert("b", b);
+	assert(map.stored() == 2);
+
+	// expired entries are absent but still stored
+	a.reset();
+	assert(map.toMap().size() == 1);
+	assert(map.stored() == 2);
+
+	// removed when their shard is written to
+	map.insert("c", c);
+	assert(map.stored() == 2);
+	assert(!map.find("a", value));
+	assert(map.find("c", value) && value.lock() == c);
+
+	// or when found
+	b.reset();
+	assert(map.stored() == 2);
+	assert(!map.find("b", value));
+	assert(map.stored() == 1);
+
+	c.reset();
+	assert(map.erase("c"));
+	assert(map.stored() == 0);
+}
+
+void testToMap() {
+	ShardedMap<int> map(8);
+	for (int i = 0; i < 100; i++) {
+		map.insert("key" + std::to_string(i), i);
+	}
+	map.erase("key50");
+
+	std::map<std::string, int> all = map.toMap();
+	assert(all.size() == 99);
+	assert(all.find("key50") == all.end());
+	for (auto& entry : all) {
+		assert(entry.first == "key" + std::to_string(entry.second));
+	}
+	assert(all.begin()->first == "key0");
+	assert(all.rbegin()->first == "key99");
+}
+
+void testConcurrent() {
+	ShardedMap<int> map(16);
+	std::vector<std::thread> threads;
+	size_t nrThreads = 8;
+	int nrKeys = 1000;
+
+	for (size_t t = 0; t < nrThreads; t++) {
+		threads.push_back(std::thread([&map, t, nrThreads, nrKeys] {
+			std::string prefix = std::to_string(t) + "-";
+			int value = 0;
+			for (int i = 0; i < nrKeys; i++) {
+				map.insert(prefix + std::to_string(i), i);
+				if (!map.find(prefix + std::to_string(i), value) || value != i) {
+					std::cerr << "Inserted key " << prefix << i << " not found" << std::endl;
+					abort();
+				}
+				// keys of other threads might or might not be there yet
+				map.find(std::to_string((t + 1) % nrThreads) + "-" + std::to_string(i), value);
+				if (i % 2 == 1)
+					map.erase(prefix + std::to_string(i));
+			}
+		}));
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	assert(map.toMap().size() == nrThreads * nrKeys / 2);
+}
+
+int main(int argc, char** argv) {
+	testInsertFindErase();
+	testLazyExpiry();
+	testToMap();
+	testConcurrent();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+#include "uscxml/config.h"
+#include "uscxml/Interpreter.h"
+#include "uscxml/interpreter/InterpreterImpl.h"
+#include "uscxml/util/DOM.h"
+#include "uscxml/util/Predicates.h"
+#include "uscxml/util/StateIndex.h"
+#include "uscxml/interpreter/Logging.h"
+
+#include <iostream>
+#include <set>
+
+using namespace uscxml;
+using namespace XERCESC_NS;
+
+size_t failures = 0;
+
+std::set<DOMElement*> asSet(const std::list<DOMElement*>& elements) {
+	return std::set<DOMElement*>(elements.begin(), elements.end());
+}
+
+void fail(const std::string& file, const std::string& what, const DOMElement* transition) {
+	std::cerr << file << ": " << what << " differs for " << DOMUtils::xPathForNode(transition) << std::endl;
+	failures++;
+}
+
+/**
+ * The StateIndex has to answer exactly as the predicates on the DOM.
+ */
+void compare(const std::string& file) {
+	Interpreter interpreter = Interpreter::fromURL(file);
+	DOMElement* root = interpreter.getImpl()->getDocument()->getDocumentElement();
+	StateIndex index(root);
+
+	const std::vector<DOMElement*>& transitions = index.getTransitions();
+	for (size_t i = 0; i < transitions.size(); i++) {
+		DOMElement* t1 = transitions[i];
+
+		if (index.getTransitionDomain(t1) != getTransitionDomain(t1, root))
+			fail(file, "transition domain", t1);
+		if (asSet(index.getTargetStates(t1)) != asSet(getTargetStates(t1, root)))
+			fail(file, "target states", t1);
+		if (asSet(index.getExitSet(t1)) != asSet(getExitSet(t1, root)))
+			fail(file, "exit set", t1);
+
+		for (size_t j = 0; j < transitions.size(); j++) {
+			DOMElement* t2 = transitions[j];
+			if (index.conflicts(t1, t2) != conflicts(t1, t2, root)) {
+				fail(file, "conflict with " + DOMUtils::xPathForNode(t2), t1);
+			}
+		}
+	}
+
+	if (asSet(index.getReachableStates()) != asSet(getReachableStates(root))) {
+		std::cerr << file << ": reachable states differ" << std::endl;
+		failures++;
+	}
+}
+
+int main(int argc, char** argv) {
+	try {
+		for (int i = 1; i < argc; i++) {
+			compare(argv[i]);
+		}
+	} catch (Event e) {
+		std::cerr << e << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	if (failures > 0) {
+		std::cerr << failures << " differences between StateIndex and Predicates" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return EXIT_SUCCESS;
+}
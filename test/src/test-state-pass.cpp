@@ -15,6 +15,8 @@
 #include "uscxml/util/Convenience.h" // iequals
 
 #include "uscxml/interpreter/Logging.h"
+#include "uscxml/plugins/Factory.h"
+#include "uscxml/transform/CompiledMicroStep.h"
 
 #include "uscxml/messages/Event.h"
 #include "uscxml/server/HTTPServer.h"
@@ -64,6 +66,9 @@ int main(int argc, char** argv) {
 
 	HTTPServer::getInstance(7080, 7443);
 
+	// available via USCXML_MICROSTEPPER=compiled
+	Factory::getInstance()->registerMicrostepper(new CompiledMicroStep());
+
 	while(iterations--) {
 		try {
 			Interpreter interpreter = Interpreter::fromURL(documentURI);
@@ -0,0 +1,93 @@
+#include "uscxml/config.h"
+#include "uscxml/plugins/DataModel.h"
+#include "uscxml/plugins/DataModelImpl.h"
+#include "uscxml/plugins/Factory.h"
+#include "uscxml/interpreter/Logging.h"
+#include "uscxml/messages/Event.h"
+
+#include <assert.h>
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+using namespace uscxml;
+
+class DMCallbacks : public DataModelCallbacks {
+public:
+	std::string name = "asdf";
+	std::string sessionId = "asdf";
+	std::map<std::string, IOProcessor> ioProcs;
+	std::map<std::string, Invoker> invokers;
+
+	virtual ~DMCallbacks() {}
+	const std::string& getName() {
+		return name;
+	}
+	const std::string& getSessionId()  {
+		return sessionId;
+	}
+	const std::map<std::string, IOProcessor>& getIOProcessors() {
+		return ioProcs;
+	}
+	virtual bool isInState(const std::string& stateId) {
+		return false;
+	}
+	virtual XERCESC_NS::DOMDocument* getDocument() const {
+		return nullptr;
+	}
+	virtual const std::map<std::string, Invoker>& getInvokers() {
+		return invokers;
+	}
+	virtual Logger getLogger() {
+		return Logger::getDefault();
+	}
+};
+
+/**
+ * All V8 sessions share one isolate, set them up from several threads at once.
+ */
+int main(int argc, char** argv) {
+	size_t nrThreads = 8;
+	size_t nrSessions = 20;
+	std::atomic<size_t> failed(0);
+	std::atomic<bool> go(false);
+
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < nrThreads; t++) {
+		threads.push_back(std::thread([t, nrSessions, &failed, &go] {
+			while(!go) {
+				std::this_thread::yield();
+			}
+			for (size_t i = 0; i < nrSessions; i++) {
+				try {
+					DMCallbacks callbacks;
+					callbacks.sessionId = "session-" + toStr(t) + "-" + toStr(i);
+
+					DataModel dm = Factory::getInstance()->createDataModel("ecmascript", &callbacks);
+					dm.init("thread", Data(t));
+					dm.assign("session", Data(i));
+
+					// every session sees its own context only
+					if (dm.evalAsData("_sessionid").atom != callbacks.sessionId ||
+					        !dm.evalAsBool("thread == " + toStr(t) + " && session == " + toStr(i))) {
+						failed++;
+					}
+				} catch (Event e) {
+					std::cerr << e << std::endl;
+					failed++;
+				}
+			}
+		}));
+	}
+
+	go = true;
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	if (failed > 0) {
+		std::cerr << failed << " sessions failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
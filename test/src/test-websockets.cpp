@@ -0,0 +1,206 @@
+#include "uscxml/config.h"
+#include "uscxml/server/HTTPServer.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+using namespace uscxml;
+
+#define WS_PORT 8092
+#define FRAME_SIZE (1024 * 1024)
+#define NR_FRAMES 128
+
+/// The payload length announced in an encoded header
+uint64_t payloadLength(const unsigned char* header, size_t headerSize) {
+	uint64_t length = header[1] & 0x7f;
+	if (length == 126) {
+		assert(headerSize == 4);
+		return (header[2] << 8) + header[3];
+	}
+	if (length == 127) {
+		assert(headerSize == 10);
+		length = 0;
+		for (size_t i = 2; i < 10; i++) {
+			length = (length << 8) + header[i];
+		}
+		return length;
+	}
+	assert(headerSize == 2);
+	return length;
+}
+
+void testFrameHeaders() {
+	uint64_t lengths[] = { 0, 125, 126, 65535, 65536, 4294967296ULL };
+	size_t headerSizes[] = { 2, 2, 4, 4, 10, 10 };
+
+	for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+		unsigned char header[EVWS_MAX_HEADER_SIZE];
+		size_t headerSize = evws_frame_header((char*)header, EVWS_BINARY_FRAME, lengths[i]);
+		if (headerSize != headerSizes[i] || payloadLength(header, headerSize) != lengths[i]) {
+			std::cerr << "Wrong header for a payload of " << lengths[i] << " bytes" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		assert(header[0] == 0x82); // fin and binary
+		assert((header[1] & 0x80) == 0); // not masked
+	}
+}
+
+#ifndef _WIN32
+
+uint64_t wsStat(const std::string& name) {
+	return strTo<uint64_t>(HTTPServer::getWSStats()[name].atom);
+}
+
+/// Connect to the websocket server and never read past the handshake
+int connectWS(const std::string& path) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(WS_PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	int err = connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+	assert(err == 0);
+
+	struct timeval tv;
+	tv.tv_sec = 10;
+	tv.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	std::string handshake =
+	    "GET " + path + " HTTP/1.1\r\n"
+	    "Host: localhost\r\n"
+	    "Upgrade: websocket\r\n"
+	    "Connection: Upgrade\r\n"
+	    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+	    "Sec-WebSocket-Version: 13\r\n"
+	    "\r\n";
+	ssize_t n = send(fd, handshake.data(), handshake.size(), 0);
+	assert(n == (ssize_t)handshake.size());
+
+	// the connection is known to the server once it replied
+	std::string reply;
+	char c;
+	while(reply.size() < 4 || reply.substr(reply.size() - 4) != "\r\n\r\n") {
+		n = recv(fd, &c, 1, 0);
+		assert(n == 1);
+		reply += c;
+	}
+	assert(reply.substr(0, 12) == "HTTP/1.1 101");
+	return fd;
+}
+
+/// Read exactly size bytes
+void readFully(int fd, char* buffer, size_t size) {
+	while(size > 0) {
+		ssize_t n = recv(fd, buffer, size, 0);
+		assert(n > 0);
+		buffer += n;
+		size -= n;
+	}
+}
+
+/// Wait for a counter to reach a value, the frames are sent from the event loop
+void waitFor(const std::string& name, uint64_t value) {
+	for (size_t i = 0; i < 1000 && wsStat(name) < value; i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+}
+
+void broadcast(const std::string& path, const std::string& frame) {
+	for (size_t i = 0; i < NR_FRAMES; i++) {
+		HTTPServer::wsBroadcast(path.c_str(), EVWS_BINARY_FRAME, frame.data(), frame.size());
+	}
+}
+
+/**
+ * A connection that does not read loses frames, but only whole ones.
+ */
+void testDropFrames(const std::string& frame) {
+	HTTPServer::setWSQueueLimit(256 * 1024, HTTPServer::WS_DROP_FRAMES);
+	int fd = connectWS("/queue-drop");
+
+	uint64_t sent = wsStat("framesSent");
+	uint64_t dropped = wsStat("framesDropped");
+	uint64_t closed = wsStat("connectionsClosed");
+
+	broadcast("/queue-drop", frame);
+	for (size_t i = 0; i < 1000 && wsStat("framesSent") + wsStat("framesDropped") < sent + dropped + NR_FRAMES; i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	uint64_t nowSent = wsStat("framesSent") - sent;
+	uint64_t nowDropped = wsStat("framesDropped") - dropped;
+	assert(nowSent + nowDropped == NR_FRAMES);
+	assert(nowDropped > 0);
+	assert(nowSent > 0);
+	assert(wsStat("connectionsClosed") == closed);
+
+	// everything queued arrives as complete frames
+	std::string payload(FRAME_SIZE, 0);
+	for (size_t i = 0; i < nowSent; i++) {
+		unsigned char header[10];
+		readFully(fd, (char*)header, 10);
+		assert(header[0] == 0x82);
+		assert(payloadLength(header, 10) == FRAME_SIZE);
+		readFully(fd, &payload[0], FRAME_SIZE);
+		assert(payload == frame);
+	}
+
+	close(fd);
+}
+
+/**
+ * A connection that does not read is closed.
+ */
+void testDisconnect(const std::string& frame) {
+	HTTPServer::setWSQueueLimit(256 * 1024, HTTPServer::WS_DISCONNECT);
+	int fd = connectWS("/queue-close");
+
+	uint64_t dropped = wsStat("framesDropped");
+	uint64_t closed = wsStat("connectionsClosed");
+
+	broadcast("/queue-close", frame);
+	waitFor("connectionsClosed", closed + 1);
+	assert(wsStat("connectionsClosed") == closed + 1);
+	assert(wsStat("framesDropped") == dropped);
+
+	// the client sees the end of the stream after the frames that made it to the kernel
+	char buffer[64 * 1024];
+	ssize_t n;
+	while((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {}
+	assert(n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK));
+
+	close(fd);
+}
+#endif
+
+int main(int argc, char** argv) {
+	testFrameHeaders();
+
+#ifndef _WIN32
+	HTTPServer::getInstance(8093, WS_PORT, NULL);
+
+	std::string frame(FRAME_SIZE, 0);
+	for (size_t i = 0; i < FRAME_SIZE; i++) {
+		frame[i] = (char)(i % 251);
+	}
+
+	testDropFrames(frame);
+	testDisconnect(frame);
+#endif
+
+	return EXIT_SUCCESS;
+}